@@ -84,7 +84,14 @@ CAnimBlendHierarchy::RemoveQuaternionFlips(void)
 void
 CAnimBlendHierarchy::RemoveAnimSequences(void)
 {
-	delete[] sequences;
+	int i;
+
+	// sequences from a relocatable chunk weren't allocated with new[]
+	if(base::cRelocatableChunk::IsLoadedChunkData(sequences)){
+		for(i = 0; i < numSequences; i++)
+			sequences[i].~CAnimBlendSequence();
+	}else
+		delete[] sequences;
 	sequences = nil;
 	numSequences = 0;
 }
@@ -127,3 +134,23 @@ CAnimBlendHierarchy::MoveMemory(bool onlyone)
 			return;
 }
 #endif
+
+void
+CAnimBlendHierarchy::Write(base::cRelocatableChunkWriter &writer, bool allocSpace)
+{
+	int i;
+
+	if(allocSpace)
+		writer.AllocateRaw(this, sizeof(*this), sizeof(void*), false, true);
+
+	// the uncompressed cache is runtime state, the key frames are written the way they are now
+	void *link = nil;
+	writer.Override(&linkPtr, &link, sizeof(link));
+
+	if(sequences){
+		writer.AllocateRaw(sequences, numSequences*sizeof(CAnimBlendSequence), sizeof(void*), false, true);
+		for(i = 0; i < numSequences; i++)
+			sequences[i].Write(writer);
+		writer.AddPatch(&sequences);
+	}
+}
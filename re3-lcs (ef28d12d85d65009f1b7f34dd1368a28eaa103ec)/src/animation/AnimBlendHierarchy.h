@@ -30,6 +30,7 @@ public:
 	void Uncompress(void);
 	void RemoveUncompressedData(void);
 	void MoveMemory(bool onlyone = false);
+	void Write(base::cRelocatableChunkWriter &writer, bool allocSpace);
 	bool IsCompressed() { return !!compressed; };
 };
 
@@ -3,6 +3,9 @@
 #include "AnimBlendSequence.h"
 #include "MemoryHeap.h"
 
+base::cRelocatableChunkClassInfo CAnimBlendSequence::msClassInfo("CAnimBlendSequence", VTABLE_ADDR(&msClassInstance), sizeof(msClassInstance));
+CAnimBlendSequence CAnimBlendSequence::msClassInstance;
+
 CAnimBlendSequence::CAnimBlendSequence(void)
 {
 	type = 0;
@@ -12,12 +15,18 @@ CAnimBlendSequence::CAnimBlendSequence(void)
 	boneTag = -1;
 }
 
+// Key frames loaded from a relocatable chunk are freed with the chunk
+static void
+FreeKeyFrames(void *kfs)
+{
+	if(kfs && !base::cRelocatableChunk::IsLoadedChunkData(kfs))
+		RwFree(kfs);
+}
+
 CAnimBlendSequence::~CAnimBlendSequence(void)
 {
-	if(keyFrames)
-		RwFree(keyFrames);
-	if(keyFramesCompressed)
-		RwFree(keyFramesCompressed);
+	FreeKeyFrames(keyFrames);
+	FreeKeyFrames(keyFramesCompressed);
 }
 
 void
@@ -112,8 +121,11 @@ CAnimBlendSequence::Uncompress(void)
 	}
 	REGISTER_MEMPTR(&keyFrames);
 
-	RwFree(keyFramesCompressed);
-	keyFramesCompressed = nil;
+	// compressed frames in a chunk stay around, so they don't have to be made again
+	if(!base::cRelocatableChunk::IsLoadedChunkData(keyFramesCompressed)){
+		RwFree(keyFramesCompressed);
+		keyFramesCompressed = nil;
+	}
 
 	POP_MEMID();
 }
@@ -173,8 +185,9 @@ CAnimBlendSequence::RemoveUncompressedData(void)
 {
 	if(numFrames == 0)
 		return;
-	CompressKeyframes();
-	RwFree(keyFrames);
+	if(keyFramesCompressed == nil)
+		CompressKeyframes();
+	FreeKeyFrames(keyFrames);
 	keyFrames = nil;
 }
 
@@ -182,13 +195,14 @@ CAnimBlendSequence::RemoveUncompressedData(void)
 bool
 CAnimBlendSequence::MoveMemory(void)
 {
-	if(keyFrames){
+	// chunk memory isn't on the heap
+	if(keyFrames && !base::cRelocatableChunk::IsLoadedChunkData(keyFrames)){
 		void *newaddr = gMainHeap.MoveMemory(keyFrames);
 		if(newaddr != keyFrames){
 			keyFrames = newaddr;
 			return true;
 		}
-	}else if(keyFramesCompressed){
+	}else if(keyFramesCompressed && !base::cRelocatableChunk::IsLoadedChunkData(keyFramesCompressed)){
 		void *newaddr = gMainHeap.MoveMemory(keyFramesCompressed);
 		if(newaddr != keyFramesCompressed){
 			keyFramesCompressed = newaddr;
@@ -198,3 +212,18 @@ CAnimBlendSequence::MoveMemory(void)
 	return false;
 }
 #endif
+
+// the sequence itself is allocated by the hierarchy
+void
+CAnimBlendSequence::Write(base::cRelocatableChunkWriter &writer)
+{
+	writer.Class(VTABLE_ADDR(this), msClassInfo);
+	if(keyFrames){
+		writer.AllocateRaw(keyFrames, numFrames * (HasTranslation() ? sizeof(KeyFrameTrans) : sizeof(KeyFrame)), sizeof(void*), false, true);
+		writer.AddPatch(&keyFrames);
+	}
+	if(keyFramesCompressed){
+		writer.AllocateRaw(keyFramesCompressed, numFrames * (HasTranslation() ? sizeof(KeyFrameTransCompressed) : sizeof(KeyFrameCompressed)), sizeof(void*), false, true);
+		writer.AddPatch(&keyFramesCompressed);
+	}
+}
@@ -69,6 +69,9 @@ public:
 	void *keyFrames;
 	void *keyFramesCompressed;
 
+	static CAnimBlendSequence msClassInstance;
+	static base::cRelocatableChunkClassInfo msClassInfo;
+
 	CAnimBlendSequence(void);
 	virtual ~CAnimBlendSequence(void);
 	void SetName(char *name);
@@ -89,6 +92,7 @@ public:
 	void CompressKeyframes(void);
 	void RemoveUncompressedData(void);
 	bool MoveMemory(void);
+	void Write(base::cRelocatableChunkWriter &writer);
 
 	void SetBoneTag(int tag) { boneTag = tag; }
 };
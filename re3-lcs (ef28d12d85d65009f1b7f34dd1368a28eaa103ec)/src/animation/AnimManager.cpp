@@ -11,6 +11,11 @@
 #include "AnimBlendAssocGroup.h"
 #include "AnimManager.h"
 #include "Streaming.h"
+#ifdef ANIM_CHUNK_CACHE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "crossplatform.h"
+#endif
 
 CAnimBlock CAnimManager::ms_aAnimBlocks[NUMANIMBLOCKS];
 CAnimBlendHierarchy CAnimManager::ms_aAnimations[NUMANIMATIONS];
@@ -19,6 +24,44 @@ int32 CAnimManager::ms_numAnimations;
 CAnimBlendAssocGroup *CAnimManager::ms_aAnimAssocGroups;
 CLinkList<CAnimBlendHierarchy*> CAnimManager::ms_animCache;
 
+#ifdef ANIM_CHUNK_CACHE
+#define ANIMCHUNK_IDENT 0x4D494E41	// "ANIM"
+#define ANIMCHUNK_VERSION 1	// bump when the hierarchy or sequence structs change
+
+// Root of the chunk an IFP is saved as. The hierarchies are copied out of it on load,
+// their sequences and key frames stay in the chunk.
+struct AnimFileChunk
+{
+	uint64 ifpModTime;	// the chunk is out of date when the IFP changes
+	uint32 ifpSize;
+	int32 numAnims;
+	char blockName[MAX_ANIMBLOCK_NAME];
+	CAnimBlendHierarchy *anims;
+};
+
+static base::cRelocatableChunk gPedAnimChunk;
+
+static bool
+StatAnimFile(const char *filename, uint64 &modTime, uint32 &size)
+{
+	struct stat st;
+	int ret;
+
+#ifdef _WIN32
+	ret = stat(filename, &st);
+#else
+	char *real = casepath(filename);
+	ret = stat(real ? real : filename, &st);
+	free(real);
+#endif
+	if(ret != 0)
+		return false;
+	modTime = st.st_mtime;
+	size = st.st_size;
+	return true;
+}
+#endif
+
 AnimAssocDesc aStdAnimDescs[] = {
 	{ ANIM_WALK,  ASSOC_REPEAT | ASSOC_MOVEMENT | ASSOC_HAS_TRANSLATION | ASSOC_WALK },
 	{ ANIM_RUN,  ASSOC_REPEAT | ASSOC_MOVEMENT | ASSOC_HAS_TRANSLATION | ASSOC_WALK },
@@ -1185,6 +1228,9 @@ CAnimManager::Shutdown(void)
 
 	for(i = 0; i < ms_numAnimations; i++)
 		ms_aAnimations[i].Shutdown();
+#ifdef ANIM_CHUNK_CACHE
+	gPedAnimChunk.Unload();
+#endif
 
 	ms_animCache.Shutdown();
 
@@ -1433,7 +1479,15 @@ CAnimManager::BlendAnimation(RpClump *clump, AssocGroupId groupId, AnimationId a
 void
 CAnimManager::LoadAnimFiles(void)
 {
+#ifdef ANIM_CHUNK_CACHE
+	if(!LoadAnimChunk("ANIM\\PED.IFP", "ANIM\\PED.CHK")){
+		int32 firstAnim = ms_numAnimations;
+		LoadAnimFile("ANIM\\PED.IFP");
+		SaveAnimChunk("ANIM\\PED.IFP", "ANIM\\PED.CHK", firstAnim);
+	}
+#else
 	LoadAnimFile("ANIM\\PED.IFP");
+#endif
 	ms_aAnimAssocGroups = new CAnimBlendAssocGroup[NUM_ANIM_ASSOC_GROUPS];
 	CreateAnimAssocGroups();
 }
@@ -1641,6 +1695,99 @@ CAnimManager::LoadAnimFile(RwStream *stream, bool compress, char (*uncompressedA
 		ms_numAnimations = animIndex;
 }
 
+#ifdef ANIM_CHUNK_CACHE
+bool
+CAnimManager::LoadAnimChunk(const char *ifpname, const char *chunkname)
+{
+	AnimFileChunk *root;
+	base::sChunkHeader *header;
+	uint64 modTime;
+	uint32 size;
+	int i;
+
+	if(!StatAnimFile(ifpname, modTime, size))
+		return false;
+#ifdef _WIN32
+	root = (AnimFileChunk*)gPedAnimChunk.Load(chunkname, true);
+#else
+	char *real = casepath(chunkname);
+	root = (AnimFileChunk*)gPedAnimChunk.Load(real ? real : chunkname, true);
+	free(real);
+#endif
+	if(root == nil)
+		return false;
+	header = (base::sChunkHeader*)((uint8*)root - sizeof(base::sChunkHeader));
+	if(header->ident != ANIMCHUNK_IDENT || header->version != ANIMCHUNK_VERSION ||
+	   root->ifpModTime != modTime || root->ifpSize != size ||
+	   root->numAnims <= 0 || ms_numAnimations + root->numAnims > ARRAY_SIZE(ms_aAnimations)){
+		debug("%s is out of date\n", chunkname);
+		gPedAnimChunk.Unload();
+		return false;
+	}
+
+	CAnimBlock *animBlock = GetAnimationBlock(root->blockName);
+	if(animBlock){
+		if(animBlock->numAnims == 0){
+			animBlock->numAnims = root->numAnims;
+			animBlock->firstIndex = ms_numAnimations;
+		}
+	}else{
+		animBlock = &ms_aAnimBlocks[ms_numAnimBlocks++];
+		strncpy(animBlock->name, root->blockName, MAX_ANIMBLOCK_NAME);
+		animBlock->numAnims = root->numAnims;
+		animBlock->firstIndex = ms_numAnimations;
+	}
+
+	debug("Loading ANIMS %s from %s\n", animBlock->name, chunkname);
+	animBlock->isLoaded = true;
+
+	for(i = 0; i < animBlock->numAnims; i++)
+		ms_aAnimations[animBlock->firstIndex + i] = root->anims[i];
+	if(animBlock->firstIndex + animBlock->numAnims > ms_numAnimations)
+		ms_numAnimations = animBlock->firstIndex + animBlock->numAnims;
+	return true;
+}
+
+// Writes the hierarchies LoadAnimFile just read, starting at firstAnim
+void
+CAnimManager::SaveAnimChunk(const char *ifpname, const char *chunkname, int32 firstAnim)
+{
+	base::cRelocatableChunkWriter writer;
+	AnimFileChunk root;
+	CAnimBlock *animBlock;
+	FILE *file;
+	int i;
+
+	animBlock = nil;
+	for(i = 0; i < ms_numAnimBlocks; i++)
+		if(ms_aAnimBlocks[i].isLoaded && ms_aAnimBlocks[i].firstIndex == firstAnim)
+			animBlock = &ms_aAnimBlocks[i];
+	if(animBlock == nil || animBlock->numAnims <= 0)
+		return;
+
+	memset(&root, 0, sizeof(root));
+	if(!StatAnimFile(ifpname, root.ifpModTime, root.ifpSize))
+		return;
+	root.numAnims = animBlock->numAnims;
+	strncpy(root.blockName, animBlock->name, MAX_ANIMBLOCK_NAME);
+	root.anims = &ms_aAnimations[animBlock->firstIndex];
+
+	writer.AllocateRaw(&root, sizeof(root), sizeof(void*), false, true);
+	writer.AllocateRaw(root.anims, root.numAnims*sizeof(CAnimBlendHierarchy), sizeof(void*), false, true);
+	writer.AddPatch(&root.anims);
+	for(i = 0; i < root.numAnims; i++)
+		root.anims[i].Write(writer, false);
+
+	file = fcaseopen(chunkname, "wb");
+	if(file == nil){
+		debug("couldn't open %s for writing\n", chunkname);
+		return;
+	}
+	writer.Save(file, ANIMCHUNK_IDENT, ANIMCHUNK_VERSION, true, nil);
+	fclose(file);
+}
+#endif
+
 void
 CAnimManager::RemoveLastAnimFile(void)
 {
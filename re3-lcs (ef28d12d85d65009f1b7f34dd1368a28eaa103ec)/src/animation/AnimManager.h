@@ -165,5 +165,9 @@ public:
 	static void LoadAnimFile(RwStream *stream, bool compress, char (*uncompressedAnims)[32] = nil);
 	static void CreateAnimAssocGroups(void);
 	static void RemoveLastAnimFile(void);
+#ifdef ANIM_CHUNK_CACHE
+	static bool LoadAnimChunk(const char *ifpname, const char *chunkname);
+	static void SaveAnimChunk(const char *ifpname, const char *chunkname, int32 firstAnim);
+#endif
 	static CAnimBlendAssocGroup* GetAnimAssocGroups(void) { return ms_aAnimAssocGroups; }
 };
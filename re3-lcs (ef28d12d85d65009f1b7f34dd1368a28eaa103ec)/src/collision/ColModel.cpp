@@ -210,6 +210,40 @@ CColModel::operator=(const CColModel &other)
 bool
 CColModel::Write(base::cRelocatableChunkWriter &writer, bool allocSpace)
 {
-	assert(0 && "TODO(LCS)");
-	return 1;
+	int i, numVertices;
+
+	if(allocSpace)
+		writer.AllocateRaw(this, sizeof(*this), sizeof(void*), false, true);
+
+	numVertices = 0;
+	for(i = 0; i < numTriangles; i++){
+		numVertices = Max(numVertices, triangles[i].a+1);
+		numVertices = Max(numVertices, triangles[i].b+1);
+		numVertices = Max(numVertices, triangles[i].c+1);
+	}
+
+	// volumes shared with another model are only written once
+	if(numSpheres && !writer.IsAllocated(spheres))
+		writer.AllocateRaw(spheres, numSpheres*sizeof(CColSphere), sizeof(void*), false, true);
+	if(numLines && !writer.IsAllocated(lines))
+		writer.AllocateRaw(lines, numLines*sizeof(CColLine), sizeof(void*), false, true);
+	if(numBoxes && !writer.IsAllocated(boxes))
+		writer.AllocateRaw(boxes, numBoxes*sizeof(CColBox), sizeof(void*), false, true);
+	if(numVertices && !writer.IsAllocated(vertices))
+		writer.AllocateRaw(vertices, numVertices*sizeof(CompressedVector), sizeof(void*), false, true);
+	if(numTriangles && !writer.IsAllocated(triangles))
+		writer.AllocateRaw(triangles, numTriangles*sizeof(CColTriangle), sizeof(void*), false, true);
+	writer.AddPatch(&spheres);
+	writer.AddPatch(&lines);
+	writer.AddPatch(&boxes);
+	writer.AddPatch(&vertices);
+	writer.AddPatch(&triangles);
+
+	// The chunk owns the volumes of the loaded copy. The planes (and the link pointer
+	// stuffed behind them) are calculated again when needed. This model keeps both.
+	bool owns = false;
+	void *planes = nil;
+	writer.Override(&ownsCollisionVolumes, &owns, sizeof(owns));
+	writer.Override(&trianglePlanes, &planes, sizeof(planes));
+	return true;
 }
@@ -199,6 +199,7 @@ enum Config {
 // #define USE_CUSTOM_ALLOCATOR		// use CMemoryHeap for allocation. use with care, not finished yet
 //#define COMPRESSED_COL_VECTORS	// use compressed vectors for collision vertices
 //#define ANIM_COMPRESSION	// only keep most recently used anims uncompressed
+#define ANIM_CHUNK_CACHE	// save PED.IFP as a relocatable chunk and map that on later boots
 
 #define GTA_TRAIN
 #define GTA_BRIDGE
@@ -419,6 +420,7 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 #undef DEBUGMENU
 
 #undef DRAW_GAME_VERSION_TEXT
+#undef ANIM_CHUNK_CACHE
 
 //#undef NASTY_GAME
 //#undef NO_CDCHECK
@@ -1,36 +1,616 @@
 #include "common.h"
 #include "relocatableChunk.h"
 
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
 namespace base
 {
-	// TODO(LCS): add actual code (all of these are stubs)
+	VALIDATE_SIZE(sChunkHeader, 0x30);
+
+	// Function pointers are saved relative to this, so they only survive a reload by the same executable
+	static void FuncBase(void) {}
+
+	static uint32 AlignUp(uint32 n, uint32 align) { return (n + align-1) & ~(align-1); }
+
+	// The data starts right after the header, so objects can't be aligned any stricter than this
+#define CHUNK_MAX_ALIGN 0x10
+
+	// Fixup writes a pointer there
+	static bool IsValidOffset(uint32 offset, uint32 dataSize)
+	{
+		return dataSize >= sizeof(void*) && offset <= dataSize - sizeof(void*);
+	}
+
+	// Checks the tables are inside the file, every entry points into the data
+	// and all classes are known before anything gets touched
+	static bool IsValidChunk(const sChunkHeader& header, uint32 size)
+	{
+		uint32 i, tabSize;
+
+		if (header.pointerSize != sizeof(void*) || header.fileSize > size || header.fileSize < sizeof(sChunkHeader))
+			return false;
+		tabSize = header.fileSize - sizeof(sChunkHeader);
+		if (header.dataSize > tabSize ||
+		    header.patchTab > tabSize || header.numPatches > (tabSize - header.patchTab) / sizeof(uint32) ||
+		    header.classTab > tabSize || header.numClasses > (tabSize - header.classTab) / sizeof(sChunkClass) ||
+		    header.classNames > tabSize ||
+		    header.funcTab > tabSize || header.numFuncs > (tabSize - header.funcTab) / sizeof(uint32))
+			return false;
+
+		const uint8* data = (const uint8*)&header + sizeof(sChunkHeader);
+		const uint32* patches = (const uint32*)(data + header.patchTab);
+		for (i = 0; i < header.numPatches; i++)
+			if (!IsValidOffset(patches[i], header.dataSize))
+				return false;
+		const uint32* funcs = (const uint32*)(data + header.funcTab);
+		for (i = 0; i < header.numFuncs; i++)
+			if (!IsValidOffset(funcs[i], header.dataSize))
+				return false;
+		const sChunkClass* classes = (const sChunkClass*)(data + header.classTab);
+		for (i = 0; i < header.numClasses; i++) {
+			if (!IsValidOffset(classes[i].offset, header.dataSize))
+				return false;
+			const char* name = (const char*)data + header.classNames + classes[i].name;
+			if (classes[i].name >= tabSize - header.classNames || memchr(name, '\0', tabSize - header.classNames - classes[i].name) == nil)
+				return false;
+			if (cRelocatableChunkClassInfo::Find(name) == nil) {
+				debug("relocatable chunk uses unknown class %s\n", name);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	cRelocatableChunk* cRelocatableChunk::ms_pFirstLoaded;
+
+	void cRelocatableChunk::AddToLoaded(void)
+	{
+		m_pNextLoaded = ms_pFirstLoaded;
+		ms_pFirstLoaded = this;
+	}
+
+	void cRelocatableChunk::RemoveFromLoaded(void)
+	{
+		cRelocatableChunk** pp;
+		for (pp = &ms_pFirstLoaded; *pp; pp = &(*pp)->m_pNextLoaded)
+			if (*pp == this) {
+				*pp = m_pNextLoaded;
+				break;
+			}
+		m_pNextLoaded = nil;
+	}
+
+	bool cRelocatableChunk::IsLoadedChunkData(const void* p)
+	{
+		cRelocatableChunk* chunk;
+		for (chunk = ms_pFirstLoaded; chunk; chunk = chunk->m_pNextLoaded)
+			if ((uintptr)p >= (uintptr)chunk->m_pData && (uintptr)p < (uintptr)chunk->m_pData + chunk->m_size)
+				return true;
+		return false;
+	}
+
+	// Loads a whole chunk image of size bytes that's already in memory, data stays owned by the caller.
+	// With bShrink the fixed up objects are copied into a buffer of their own.
+	// Returns the root object.
+	void* cRelocatableChunk::Load(void* data, uint32 size, bool bShrink)
+	{
+		sChunkHeader* header = (sChunkHeader*)data;
+
+		Unload();
+		if (size < sizeof(sChunkHeader))
+			return nil;
+		if (header->bFixedUp) {
+			// the tables may be gone already, but the objects still have to be inside the buffer
+			if (header->pointerSize != sizeof(void*) || header->fileSize > size || header->fileSize < sizeof(sChunkHeader) ||
+			    header->dataSize > header->fileSize - sizeof(sChunkHeader))
+				return nil;
+		} else if (!IsValidChunk(*header, size))
+			return nil;
+		Fixup(data);
+		if (bShrink || header->bShrink) {
+			m_pData = Shrink(data);
+			m_bOwned = true;
+		} else
+			m_pData = data;
+		m_size = ((sChunkHeader*)m_pData)->fileSize;
+		AddToLoaded();
+		return (uint8*)m_pData + sizeof(sChunkHeader);
+	}
+
+	// Maps (or reads) the file and fixes it up in place, the chunk stays loaded until Unload.
+	// Returns the root object.
+	void* cRelocatableChunk::Load(const char* name, bool bShrink)
+	{
+		sChunkHeader* header;
+		uint32 size;
+
+		Unload();
+#ifndef _WIN32
+		int fd = open(name, O_RDONLY);
+		if (fd < 0)
+			return nil;
+		struct stat st;
+		if (fstat(fd, &st) < 0 || st.st_size < (off_t)sizeof(sChunkHeader) || st.st_size > 0x7FFFFFFF) {
+			close(fd);
+			return nil;
+		}
+		size = st.st_size;
+		// private mapping, fixing up only copies the pages that hold pointers
+		void* mem = mmap(nil, size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+		close(fd);
+		if (mem == MAP_FAILED)
+			return nil;
+		m_bMapped = true;
+		m_pData = mem;
+		m_size = size;
+#else
+		FILE* file = fopen(name, "rb");
+		if (file == nil)
+			return nil;
+		fseek(file, 0, SEEK_END);
+		size = ftell(file);
+		fseek(file, 0, SEEK_SET);
+		if (size < sizeof(sChunkHeader)) {
+			fclose(file);
+			return nil;
+		}
+		m_pData = cMainMemoryManager::Instance()->AllocateAligned(size);
+		m_bOwned = true;
+		m_size = size;
+		if (fread(m_pData, 1, size, file) != size) {
+			fclose(file);
+			Unload();
+			return nil;
+		}
+		fclose(file);
+#endif
+
+		header = (sChunkHeader*)m_pData;
+		if (header->bFixedUp || !IsValidChunk(*header, size)) {
+			debug("%s isn't a valid relocatable chunk\n", name);
+			Unload();
+			return nil;
+		}
+		Fixup(m_pData);
+
+		if (bShrink || header->bShrink) {
+#ifndef _WIN32
+			// give the pages with the tables back
+			uint32 pageSize = sysconf(_SC_PAGESIZE);
+			uint32 keep = AlignUp(sizeof(sChunkHeader) + header->dataSize, pageSize);
+			if (keep < m_size) {
+				munmap((uint8*)m_pData + keep, m_size - keep);
+				m_size = keep;
+			}
+			header->patchTab = header->classTab = header->classNames = header->funcTab = header->dataSize;
+			header->numPatches = header->numClasses = header->numFuncs = 0;
+			header->fileSize = sizeof(sChunkHeader) + header->dataSize;
+#else
+			void* shrunk = Shrink(m_pData);
+			Unload();
+			m_pData = shrunk;
+			m_bOwned = true;
+			m_size = ((sChunkHeader*)m_pData)->fileSize;
+#endif
+		}
+		AddToLoaded();
+		return (uint8*)m_pData + sizeof(sChunkHeader);
+	}
+
+	void cRelocatableChunk::Unload(void)
+	{
+		RemoveFromLoaded();
+#ifndef _WIN32
+		if (m_bMapped)
+			munmap(m_pData, m_size);
+#endif
+		if (m_bOwned)
+			cMainMemoryManager::Instance()->Free(m_pData);
+		m_pData = nil;
+		m_size = 0;
+		m_bMapped = false;
+		m_bOwned = false;
+	}
+
+	// data is what follows the header
+	void cRelocatableChunk::Fixup(const sChunkHeader& header, void* data)
+	{
+		uint8* base = (uint8*)data;
+		uint32 i;
+
+		const uint32* patches = (const uint32*)(base + header.patchTab);
+		for (i = 0; i < header.numPatches; i++)
+			*(uintptr*)(base + patches[i]) += (uintptr)base;
+
+		const sChunkClass* classes = (const sChunkClass*)(base + header.classTab);
+		const char* names = (const char*)base + header.classNames;
+		for (i = 0; i < header.numClasses; i++) {
+			cRelocatableChunkClassInfo* info = cRelocatableChunkClassInfo::Find(names + classes[i].name);
+			assert(info);
+			*(void**)(base + classes[i].offset) = *(void**)info->m_pVmt;
+		}
+
+		const uint32* funcs = (const uint32*)(base + header.funcTab);
+		for (i = 0; i < header.numFuncs; i++)
+			*(uintptr*)(base + funcs[i]) += (uintptr)&FuncBase;
+	}
+
+	// data is the header
+	void cRelocatableChunk::Fixup(void* data)
+	{
+		sChunkHeader* header = (sChunkHeader*)data;
+		if (header->bFixedUp)
+			return;
+		Fixup(*header, (uint8*)data + sizeof(sChunkHeader));
+		header->bFixedUp = true;
+	}
+
+	// Copies the fixed up objects of a chunk into a new buffer without the tables,
+	// data is what follows the header. Returns the new header, the old buffer can be freed.
+	void* cRelocatableChunk::Shrink(const sChunkHeader& header, void* data)
+	{
+		uint8* oldBase = (uint8*)data;
+		sChunkHeader* newHeader;
+		uint8* newBase;
+		uint32 i;
+
+		assert(header.bFixedUp);
+		newHeader = (sChunkHeader*)cMainMemoryManager::Instance()->AllocateAligned(sizeof(sChunkHeader) + header.dataSize);
+		newBase = (uint8*)newHeader + sizeof(sChunkHeader);
+		*newHeader = header;
+		newHeader->fileSize = sizeof(sChunkHeader) + header.dataSize;
+		newHeader->patchTab = newHeader->classTab = newHeader->classNames = newHeader->funcTab = header.dataSize;
+		newHeader->numPatches = newHeader->numClasses = newHeader->numFuncs = 0;
+		memcpy(newBase, oldBase, header.dataSize);
+
+		// the patch table is still in the old buffer
+		const uint32* patches = (const uint32*)(oldBase + header.patchTab);
+		for (i = 0; i < header.numPatches; i++)
+			*(uintptr*)(newBase + patches[i]) += newBase - oldBase;
+		return newHeader;
+	}
+
+	void* cRelocatableChunk::Shrink(void* data)
+	{
+		return Shrink(*(sChunkHeader*)data, (uint8*)data + sizeof(sChunkHeader));
+	}
+
+
+	cRelocatableChunkClassInfo* cRelocatableChunkClassInfo::ms_pFirst;
+
+	// These are static objects, pVmt is read only when a chunk gets loaded
+	cRelocatableChunkClassInfo::cRelocatableChunkClassInfo(const char* class_name, const void* pVmt, int size)
+	{
+		m_name = class_name;
+		m_pVmt = pVmt;
+		m_size = size;
+		m_pNext = ms_pFirst;
+		ms_pFirst = this;
+	}
+
+	cRelocatableChunkClassInfo* cRelocatableChunkClassInfo::Find(const char* name)
+	{
+		cRelocatableChunkClassInfo* info;
+		for (info = ms_pFirst; info; info = info->m_pNext)
+			if (strcmp(info->m_name, name) == 0)
+				return info;
+		return nil;
+	}
+
+
+	template<typename T> static void Grow(T*& array, int32& max, int32 num)
+	{
+		if (num <= max)
+			return;
+		int32 newMax = Max(Max(max * 2, num), 64);
+		array = (T*)realloc(array, newMax * sizeof(T));
+		assert(array);
+		max = newMax;
+	}
+
+	cRelocatableChunkWriter::cRelocatableChunkWriter()
+	{
+		m_pBlocks = nil;
+		m_numBlocks = m_maxBlocks = 0;
+		m_pPatches = nil;
+		m_numPatches = m_maxPatches = 0;
+		m_pFuncs = nil;
+		m_numFuncs = m_maxFuncs = 0;
+		m_pClasses = nil;
+		m_numClasses = m_maxClasses = 0;
+		m_pOverrides = nil;
+		m_numOverrides = m_maxOverrides = 0;
+	}
+
+	cRelocatableChunkWriter::~cRelocatableChunkWriter()
+	{
+		Clear();
+		free(m_pBlocks);
+		free(m_pPatches);
+		free(m_pFuncs);
+		free(m_pClasses);
+		free(m_pOverrides);
+	}
+
+	sDataBlock* cRelocatableChunkWriter::FindBlock(void* addr)
+	{
+		int32 lo = 0, hi = m_numBlocks;
+		// find the last block starting at or before addr
+		while (lo < hi) {
+			int32 mid = (lo + hi) / 2;
+			if ((uintptr)m_pBlocks[mid].addr <= (uintptr)addr)
+				lo = mid + 1;
+			else
+				hi = mid;
+		}
+		if (lo == 0)
+			return nil;
+		sDataBlock* block = &m_pBlocks[lo - 1];
+		if ((uintptr)addr < (uintptr)block->addr + Max(block->size, 1u))
+			return block;
+		return nil;
+	}
+
+	bool cRelocatableChunkWriter::GetOffset(void* addr, uint32& offset)
+	{
+		sDataBlock* block = FindBlock(addr);
+		if (block == nil)
+			return false;
+		offset = block->offset + ((uintptr)addr - (uintptr)block->addr);
+		return true;
+	}
+
+	// addr is a pointer inside an allocated block that points into an allocated block
+	void cRelocatableChunkWriter::AddPatch(void* addr)
+	{
+		Grow(m_pPatches, m_maxPatches, m_numPatches + 1);
+		m_pPatches[m_numPatches++] = addr;
+	}
+
+	void cRelocatableChunkWriter::AddPatchWithInfo(const char* str, int unk, void* addr)
+	{
+		AddPatch(addr);
+	}
+
+	// Adds the memory at addr to the chunk, it's copied when the chunk is saved so it can still be changed until then.
+	// Without bCopy only the space is reserved and saved as zeros.
+	void cRelocatableChunkWriter::AllocateRaw(void* addr, uint32 size, uint32 align, bool a5, bool bCopy)
+	{
+		int32 i;
+
+		if (addr == nil || IsAllocated(addr))
+			return;
+		if (align == 0)
+			align = 1;
+		assert((align & (align-1)) == 0 && align <= CHUNK_MAX_ALIGN);
+
+		Grow(m_pBlocks, m_maxBlocks, m_numBlocks + 1);
+		for (i = m_numBlocks; i > 0 && (uintptr)m_pBlocks[i-1].addr > (uintptr)addr; i--);
+		memmove(&m_pBlocks[i+1], &m_pBlocks[i], (m_numBlocks - i) * sizeof(sDataBlock));
+		assert(i + 1 > m_numBlocks || (uintptr)addr + size <= (uintptr)m_pBlocks[i+1].addr);
+		m_pBlocks[i].addr = addr;
+		m_pBlocks[i].size = size;
+		m_pBlocks[i].align = align;
+		m_pBlocks[i].offset = 0;
+		m_pBlocks[i].order = m_numBlocks;
+		m_pBlocks[i].bCopy = bCopy;
+		m_numBlocks++;
+	}
+
+	void cRelocatableChunkWriter::Clear()
+	{
+		m_numBlocks = 0;
+		m_numPatches = 0;
+		m_numFuncs = 0;
+		m_numClasses = 0;
+		m_numOverrides = 0;
+	}
+
+	// ptr is where the vtable pointer of an allocated object is
+	void cRelocatableChunkWriter::Class(void* ptr, const cRelocatableChunkClassInfo& classInfo)
+	{
+		Grow(m_pClasses, m_maxClasses, m_numClasses + 1);
+		m_pClasses[m_numClasses].addr = ptr;
+		m_pClasses[m_numClasses].pInfo = &classInfo;
+		m_numClasses++;
+	}
+
+	void cRelocatableChunkWriter::DebugFileLine(void*)
+	{
+		// no debug info in the chunks we write
+	}
+
+	// Saves value instead of what's at addr, for runtime state that mustn't end up in the chunk
+	// without changing the object that's being written
+	void cRelocatableChunkWriter::Override(void* addr, const void* value, uint32 size)
+	{
+		assert(size <= sizeof(m_pOverrides->value));
+		Grow(m_pOverrides, m_maxOverrides, m_numOverrides + 1);
+		m_pOverrides[m_numOverrides].addr = addr;
+		m_pOverrides[m_numOverrides].size = size;
+		memcpy(m_pOverrides[m_numOverrides].value, value, size);
+		m_numOverrides++;
+	}
+
+	// ptr is where a function pointer is
+	void cRelocatableChunkWriter::PatchFunc(void* ptr)
+	{
+		Grow(m_pFuncs, m_maxFuncs, m_numFuncs + 1);
+		m_pFuncs[m_numFuncs++] = ptr;
+	}
+
+	bool cRelocatableChunkWriter::IsAllocated(void* addr)
+	{
+		return FindBlock(addr) != nil;
+	}
+
+	void cRelocatableChunkWriter::Reserve(int numBlocks, int numPatches)
+	{
+		Grow(m_pBlocks, m_maxBlocks, numBlocks);
+		Grow(m_pPatches, m_maxPatches, numPatches);
+	}
+
+	void cRelocatableChunkWriter::Save(const char* filename, uint32 ident, uint32 version, bool bShrink)
+	{
+		FILE* file = fopen(filename, "wb");
+		if (file == nil) {
+			debug("couldn't open %s for writing\n", filename);
+			return;
+		}
+		Save(file, ident, version, bShrink, nil);
+		fclose(file);
+	}
+
+	static int CompareOffsets(const void* a, const void* b)
+	{
+		uint32 ia = *(const uint32*)a;
+		uint32 ib = *(const uint32*)b;
+		return ia < ib ? -1 : ia > ib ? 1 : 0;
+	}
+
+	static uint32 RemoveDuplicates(uint32* offsets, uint32 num)
+	{
+		uint32 i, n;
+		qsort(offsets, num, sizeof(uint32), CompareOffsets);
+		for (i = 0, n = 0; i < num; i++)
+			if (n == 0 || offsets[n-1] != offsets[i])
+				offsets[n++] = offsets[i];
+		return n;
+	}
+
+	void cRelocatableChunkWriter::Save(void* file, uint32 ident, uint32 version, bool bShrink, sChunkHeader* pHeader)
+	{
+		sChunkHeader header;
+		int32 i, j;
+		uint32 offset, dataSize, slot, target, numPatches, numFuncs, namesSize;
 
-	void* cRelocatableChunk::Load(void* data, bool bShrink) { return nil; }
-	void* cRelocatableChunk::Load(const char* name, bool bShrink) { return nil; }
-	void cRelocatableChunk::Fixup(const sChunkHeader& header, void* data) {}
-	void cRelocatableChunk::Fixup(void* data) {}
-	void* cRelocatableChunk::Shrink(const sChunkHeader& header, void* data) { return nil; }
-	void* cRelocatableChunk::Shrink(void* data) { return nil; }
+		// lay out the blocks in the order they were allocated
+		sDataBlock** order = (sDataBlock**)malloc(Max(m_numBlocks, 1) * sizeof(sDataBlock*));
+		for (i = 0; i < m_numBlocks; i++)
+			order[m_pBlocks[i].order] = &m_pBlocks[i];
+		offset = 0;
+		for (i = 0; i < m_numBlocks; i++) {
+			offset = AlignUp(offset, order[i]->align);
+			order[i]->offset = offset;
+			offset += order[i]->size;
+		}
+		dataSize = AlignUp(offset, CHUNK_MAX_ALIGN);
 
-	cRelocatableChunkClassInfo::cRelocatableChunkClassInfo(const char* class_name, const void* pVmt, int size) {}
+		uint8* data = (uint8*)calloc(Max(dataSize, 1u), 1);
+		for (i = 0; i < m_numBlocks; i++)
+			if (order[i]->bCopy)
+				memcpy(data + order[i]->offset, order[i]->addr, order[i]->size);
+		free(order);
+		for (i = 0; i < m_numOverrides; i++)
+			if (GetOffset(m_pOverrides[i].addr, slot) && slot + m_pOverrides[i].size <= dataSize)
+				memcpy(data + slot, m_pOverrides[i].value, m_pOverrides[i].size);
 
-	cRelocatableChunkWriter::cRelocatableChunkWriter() {}
-	cRelocatableChunkWriter::~cRelocatableChunkWriter() {}
+		// pointers become offsets into the data, a pointer may have been added more than once
+		uint32* patches = (uint32*)malloc(Max(m_numPatches, 1) * sizeof(uint32));
+		numPatches = 0;
+		for (i = 0; i < m_numPatches; i++) {
+			if (!GetOffset(m_pPatches[i], slot) || slot + sizeof(void*) > dataSize) {
+				debug("relocatable chunk: patch at %p isn't in the chunk\n", m_pPatches[i]);
+				continue;
+			}
+			patches[numPatches++] = slot;
+		}
+		numPatches = RemoveDuplicates(patches, numPatches);
+		for (i = 0, j = 0; i < (int32)numPatches; i++) {
+			slot = patches[i];
+			void* ptr = *(void**)(data + slot);
+			if (ptr == nil)
+				continue;
+			if (!GetOffset(ptr, target)) {
+				debug("relocatable chunk: pointer %p isn't in the chunk\n", ptr);
+				*(void**)(data + slot) = nil;
+				continue;
+			}
+			*(uintptr*)(data + slot) = target;
+			patches[j++] = slot;
+		}
+		numPatches = j;
 
-	void cRelocatableChunkWriter::AddPatch(void* addr) {}
-	void cRelocatableChunkWriter::AddPatchWithInfo(const char* str, int unk, void* addr) {}
-	void cRelocatableChunkWriter::AllocateRaw(void* addr, uint32 size, uint32 align, bool a5, bool a6) {}
+		uint32* funcs = (uint32*)malloc(Max(m_numFuncs, 1) * sizeof(uint32));
+		numFuncs = 0;
+		for (i = 0; i < m_numFuncs; i++)
+			if (GetOffset(m_pFuncs[i], slot) && slot + sizeof(void*) <= dataSize)
+				funcs[numFuncs++] = slot;
+		numFuncs = RemoveDuplicates(funcs, numFuncs);
+		for (i = 0, j = 0; i < (int32)numFuncs; i++) {
+			slot = funcs[i];
+			if (*(void**)(data + slot) == nil)
+				continue;
+			*(uintptr*)(data + slot) -= (uintptr)&FuncBase;
+			funcs[j++] = slot;
+		}
+		numFuncs = j;
 
-	void cRelocatableChunkWriter::Clear() {}
-	void cRelocatableChunkWriter::Class(void* ptr, const cRelocatableChunkClassInfo& classInfo) {}
-	void cRelocatableChunkWriter::DebugFileLine(void*) {}
+		// vtables are looked up by class name when loading
+		sChunkClass* classes = (sChunkClass*)malloc(Max(m_numClasses, 1) * sizeof(sChunkClass));
+		const cRelocatableChunkClassInfo** infos = (const cRelocatableChunkClassInfo**)malloc(Max(m_numClasses, 1) * sizeof(void*));
+		uint32* nameOffsets = (uint32*)malloc(Max(m_numClasses, 1) * sizeof(uint32));
+		int32 numInfos = 0;
+		int32 numClasses = 0;
+		namesSize = 0;
+		for (i = 0; i < m_numClasses; i++) {
+			if (!GetOffset(m_pClasses[i].addr, slot) || slot + sizeof(void*) > dataSize)
+				continue;
+			*(void**)(data + slot) = nil;
+			for (j = 0; j < numInfos; j++)
+				if (infos[j] == m_pClasses[i].pInfo)
+					break;
+			if (j == numInfos) {
+				infos[numInfos] = m_pClasses[i].pInfo;
+				nameOffsets[numInfos] = namesSize;
+				namesSize += strlen(m_pClasses[i].pInfo->m_name) + 1;
+				numInfos++;
+			}
+			classes[numClasses].offset = slot;
+			classes[numClasses].name = nameOffsets[j];
+			numClasses++;
+		}
 
-	void cRelocatableChunkWriter::PatchFunc(void* ptr) {}
+		memset(&header, 0, sizeof(header));
+		header.ident = ident;
+		header.version = version;
+		header.dataSize = dataSize;
+		header.patchTab = dataSize;
+		header.numPatches = numPatches;
+		header.classTab = header.patchTab + numPatches * sizeof(uint32);
+		header.numClasses = numClasses;
+		header.classNames = header.classTab + numClasses * sizeof(sChunkClass);
+		header.funcTab = AlignUp(header.classNames + namesSize, 4);
+		header.numFuncs = numFuncs;
+		header.fileSize = sizeof(sChunkHeader) + header.funcTab + numFuncs * sizeof(uint32);
+		header.pointerSize = sizeof(void*);
+		header.bShrink = bShrink;
+		header.bFixedUp = false;
 
-	bool cRelocatableChunkWriter::IsAllocated(void* addr) { return false; }
+		static const uint8 zeros[4] = { 0, 0, 0, 0 };
+		FILE* f = (FILE*)file;
+		fwrite(&header, sizeof(header), 1, f);
+		fwrite(data, 1, dataSize, f);
+		fwrite(patches, sizeof(uint32), numPatches, f);
+		fwrite(classes, sizeof(sChunkClass), numClasses, f);
+		for (i = 0; i < numInfos; i++)
+			fwrite(infos[i]->m_name, 1, strlen(infos[i]->m_name) + 1, f);
+		fwrite(zeros, 1, header.funcTab - (header.classNames + namesSize), f);
+		fwrite(funcs, sizeof(uint32), numFuncs, f);
 
-	void cRelocatableChunkWriter::Reserve(int, int) {}
+		free(data);
+		free(patches);
+		free(funcs);
+		free(classes);
+		free(infos);
+		free(nameOffsets);
 
-	void cRelocatableChunkWriter::Save(const char* filename, uint32 a3, uint32 a4, bool a5) {}
-	void cRelocatableChunkWriter::Save(void* file, uint32 a3, uint32 a4, bool a5, sChunkHeader* pHeader) {}
-};
\ No newline at end of file
+		if (pHeader)
+			*pHeader = header;
+	}
+};
@@ -2,52 +2,135 @@
 
 namespace base
 {
-	// TODO(LCS): add actual struct fields
+	// A relocatable chunk is a snapshot of an object graph in one contiguous block.
+	// Pointers inside the block are stored as offsets from the start of the data,
+	// the patch table lists where they are so loading is a single pass over it.
+	// Layout: sChunkHeader, data (first object is the root), patch table,
+	// class table, class names, function table.
+
+	struct sChunkHeader
+	{
+		uint32 ident;
+		uint32 version;
+		uint32 fileSize;	// everything, header included
+		uint32 dataSize;	// the objects, what's left after Shrink
+		uint32 patchTab;	// offsets of the pointers to fix up, all tables are relative to the data
+		uint32 numPatches;
+		uint32 classTab;	// sChunkClass
+		uint32 numClasses;
+		uint32 classNames;	// sChunkClass::name is relative to this
+		uint32 funcTab;	// offsets of function pointers
+		uint32 numFuncs;
+		uint16 pointerSize;
+		bool bShrink;	// drop the tables once the chunk is fixed up
+		bool bFixedUp;
+	};
+
+	struct sChunkClass
+	{
+		uint32 offset;	// of the vtable pointer
+		uint32 name;
+	};
+
+	struct sDataBlock
+	{
+		void* addr;
+		uint32 size;
+		uint32 align;
+		uint32 offset;	// assigned by Save
+		int32 order;	// blocks are laid out in the order they were allocated
+		bool bCopy;	// else the block is written as zeros
+	};
 
-	struct sChunkHeader;
-	struct sDataBlock;
 	struct sFileLine;
 
 	class cRelocatableChunk
 	{
+		void* m_pData;	// the header, data follows it
+		uint32 m_size;
+		bool m_bMapped;
+		bool m_bOwned;
+		cRelocatableChunk* m_pNextLoaded;
+
+		static cRelocatableChunk* ms_pFirstLoaded;
+
+		void AddToLoaded(void);
+		void RemoveFromLoaded(void);
 	public:
-		void* Load(void* data, bool bShrink);
+		cRelocatableChunk() : m_pData(nil), m_size(0), m_bMapped(false), m_bOwned(false), m_pNextLoaded(nil) {}
+		~cRelocatableChunk() { Unload(); }
+
+		void* Load(void* data, uint32 size, bool bShrink);
 		void* Load(const char* name, bool bShrink);
+		void Unload(void);
 		void Fixup(const sChunkHeader& header, void* data);
 		void Fixup(void* data);
 		void* Shrink(const sChunkHeader& header, void* data);
 		void* Shrink(void* data);
+
+		// Objects in a chunk didn't come from the heap, so whatever frees their members has to ask
+		static bool IsLoadedChunkData(const void* p);
 	};
 
 #define VTABLE_ADDR(obj) ((void*)obj)	// TODO: make this portable
 
 	class cRelocatableChunkClassInfo
 	{
+		friend class cRelocatableChunk;
+		friend class cRelocatableChunkWriter;
+
+		const char* m_name;
+		const void* m_pVmt;	// object whose vtable is used, might not be constructed yet
+		int m_size;
+		cRelocatableChunkClassInfo* m_pNext;
+
+		static cRelocatableChunkClassInfo* ms_pFirst;
 	public:
 		cRelocatableChunkClassInfo(const char* class_name, const void* pVmt, int size);
+
+		static cRelocatableChunkClassInfo* Find(const char* name);
 	};
 
 	class cRelocatableChunkWriter
 	{
+		sDataBlock* m_pBlocks;	// sorted by address
+		int32 m_numBlocks;
+		int32 m_maxBlocks;
+		void** m_pPatches;
+		int32 m_numPatches;
+		int32 m_maxPatches;
+		void** m_pFuncs;
+		int32 m_numFuncs;
+		int32 m_maxFuncs;
+		struct sClassPatch { void* addr; const cRelocatableChunkClassInfo* pInfo; }* m_pClasses;
+		int32 m_numClasses;
+		int32 m_maxClasses;
+		struct sOverride { void* addr; uint32 size; uint8 value[8]; }* m_pOverrides;
+		int32 m_numOverrides;
+		int32 m_maxOverrides;
+
+		sDataBlock* FindBlock(void* addr);
+		bool GetOffset(void* addr, uint32& offset);
 	public:
 		cRelocatableChunkWriter();
 		~cRelocatableChunkWriter();
 
 		void AddPatch(void* addr);
 		void AddPatchWithInfo(const char* str, int unk, void* addr);
-		void AllocateRaw(void* addr, uint32 size, uint32 align, bool a5 = false, bool a6 = false);
+		void AllocateRaw(void* addr, uint32 size, uint32 align, bool a5 = false, bool bCopy = false);
 
 		void Clear();
 		void Class(void* ptr, const cRelocatableChunkClassInfo& classInfo);
 		void DebugFileLine(void*);
+		void Override(void* addr, const void* value, uint32 size);
 
 		void PatchFunc(void* ptr);
 
 		bool IsAllocated(void* addr);
 
-		void Reserve(int, int);
+		void Reserve(int numBlocks, int numPatches);
 
-		void Save(const char* filename, uint32 a3, uint32 a4, bool a5);
-		void Save(void* file, uint32 a3, uint32 a4, bool a5, sChunkHeader* pHeader);
+		void Save(const char* filename, uint32 ident, uint32 version, bool bShrink);
+		void Save(void* file, uint32 ident, uint32 version, bool bShrink, sChunkHeader* pHeader);
 	};
-};
\ No newline at end of file
+};
@@ -8,6 +8,12 @@ CAnimBlendClumpData::CAnimBlendClumpData(void)
 	numFrames = 0;
 	velocity2d = nil;
 	frames = nil;
+#ifdef ANIM_LOD
+	lod = 0;
+	lodTime = 0.0f;
+	lodTimeShare = 1.0f;
+	lodMoveDelta = CVector2D(0.0f, 0.0f);
+#endif
 	link.Init();
 }
 
@@ -11,7 +11,10 @@ struct AnimBlendFrameData
 		VELOCITY_EXTRACTION = 8,
 		VELOCITY_EXTRACTION_3D = 0x10,
 		UPDATE_KEYFRAMES = 0x20,
-		COMPRESSED = 0x40
+		COMPRESSED = 0x40,
+#ifdef ANIM_LOD
+		LOD_DETAIL = 0x80,	// not evaluated at ANIMLOD_QUARTER
+#endif
 	};
 
 	uint8 flag;
@@ -36,6 +39,12 @@ public:
 	};
 	// order of frames is determined by RW hierarchy
 	AnimBlendFrameData *frames;
+#ifdef ANIM_LOD
+	uint8 lod;
+	float lodTime;	// not yet passed to the anims
+	float lodTimeShare;	// of the last update that falls on this frame
+	CVector2D lodMoveDelta;	// repeated on skipped frames
+#endif
 
 	CAnimBlendClumpData(void);
 	~CAnimBlendClumpData(void);
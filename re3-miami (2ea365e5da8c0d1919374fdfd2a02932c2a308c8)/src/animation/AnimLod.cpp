@@ -0,0 +1,110 @@
+#include "common.h"
+
+#ifdef ANIM_LOD
+#include "main.h"
+#include "RwHelper.h"
+#include "Timer.h"
+#include "Pools.h"
+#include "Ped.h"
+#include "Renderer.h"
+#include "Font.h"
+#include "Sprite.h"
+#include "Bones.h"
+#include "AnimBlendClumpData.h"
+#include "RpAnimBlend.h"
+#include "AnimLod.h"
+
+bool CAnimLod::ms_bEnabled = true;
+bool CAnimLod::ms_bShowLods;
+float CAnimLod::ms_fHalfRateSize = 0.06f;
+float CAnimLod::ms_fQuarterRateSize = 0.03f;
+
+// Bones that don't change the silhouette much, left in their last pose at ANIMLOD_QUARTER
+bool
+IsAnimLodDetailBone(int32 boneTag)
+{
+	switch(boneTag){
+	case BONE_l_hand:
+	case BONE_l_finger:
+	case BONE_r_hand:
+	case BONE_r_finger:
+	case BONE_l_foot:
+	case BONE_r_foot:
+		return true;
+	}
+	return false;
+}
+
+int32
+CAnimLod::ChooseLod(CPed *ped)
+{
+	if(!ms_bEnabled || ped->bOffscreen || ped->IsPlayer() || ped->CharCreatedBy == MISSION_CHAR)
+		return ANIMLOD_FULL;
+
+	float size = CRenderer::GetProjectedSize(ped);
+	if(size < ms_fQuarterRateSize)
+		return ANIMLOD_QUARTER;
+	if(size < ms_fHalfRateSize)
+		return ANIMLOD_HALF;
+	return ANIMLOD_FULL;
+}
+
+bool
+CAnimLod::Update(CPed *ped, float &timeDelta)
+{
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(ped->GetClump());
+	int32 lod = ChooseLod(ped);
+	int32 rate = 1 << lod;
+
+	clumpData->lodTime += timeDelta;
+	// peds are spread over the frames, coming closer updates right away
+	if(lod >= clumpData->lod && ((CTimer::GetFrameCounter() + CPools::GetPedPool()->GetJustIndex(ped)) & (rate-1)) != 0){
+		if(clumpData->velocity2d)
+			*clumpData->velocity2d = clumpData->lodMoveDelta;
+		return false;
+	}
+
+	// nodes that weren't evaluated have to catch up
+	if(clumpData->lod == ANIMLOD_QUARTER && lod != ANIMLOD_QUARTER)
+		clumpData->frames[0].flag |= AnimBlendFrameData::UPDATE_KEYFRAMES;
+	clumpData->lod = lod;
+	clumpData->lodTimeShare = timeDelta / clumpData->lodTime;
+	timeDelta = clumpData->lodTime;
+	clumpData->lodTime = 0.0f;
+	return true;
+}
+
+void
+CAnimLod::RenderDebugText(CPed *ped)
+{
+	static const char *lodNames[NUM_ANIMLODS] = { "full", "1/2", "1/4" };
+	static const CRGBA lodColours[NUM_ANIMLODS] = { CRGBA(0, 255, 0, 255), CRGBA(255, 255, 0, 255), CRGBA(255, 0, 0, 255) };
+	float width, height;
+	RwV3d screenCoords;
+
+	if(ped->m_rwObject == nil)
+		return;
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(ped->GetClump());
+	if(clumpData == nil)
+		return;
+	CVector bitAbove = ped->GetPosition();
+	bitAbove.z += 1.2f;
+	if(!CSprite::CalcScreenCoors(bitAbove, &screenCoords, &width, &height, true))
+		return;
+
+	DefinedState();
+	CFont::SetPropOn();
+	CFont::SetBackgroundOn();
+	CFont::SetScale(SCREEN_SCALE_X(0.4f), SCREEN_SCALE_Y(0.6f));
+	CFont::SetCentreOn();
+	CFont::SetCentreSize(SCREEN_WIDTH);
+	CFont::SetJustifyOff();
+	CFont::SetColor(lodColours[clumpData->lod]);
+	CFont::SetBackGroundOnlyTextOn();
+	CFont::SetFontStyle(1);
+	sprintf(gString, "anim %s %.3f", lodNames[clumpData->lod], CRenderer::GetProjectedSize(ped));
+	AsciiToUnicode(gString, gUString);
+	CFont::PrintString(screenCoords.x, screenCoords.y, gUString);
+	DefinedState();
+}
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+class CPed;
+
+enum
+{
+	ANIMLOD_FULL,	// every frame
+	ANIMLOD_HALF,	// every second frame
+	ANIMLOD_QUARTER,	// every fourth frame, without partial anims and detail bones
+	NUM_ANIMLODS
+};
+
+// How often the anims of a ped are updated, from its size on screen.
+// Skipped frames add up and are passed to the next update, which spreads
+// the ped's movement over the frames until the one after.
+class CAnimLod
+{
+public:
+	static bool ms_bEnabled;
+	static bool ms_bShowLods;
+	static float ms_fHalfRateSize;	// projected sizes below which the rate drops
+	static float ms_fQuarterRateSize;
+
+	static int32 ChooseLod(CPed *ped);
+	// false if the update should be skipped this frame, otherwise timeDelta is the accumulated time
+	static bool Update(CPed *ped, float &timeDelta);
+	static void RenderDebugText(CPed *ped);
+};
+
+bool IsAnimLodDetailBone(int32 boneTag);
@@ -11,6 +11,9 @@
 #include "AnimBlendAssocGroup.h"
 #include "AnimManager.h"
 #include "Streaming.h"
+#ifdef HASHED_NAME_LOOKUP
+#include "NameIndex.h"
+#endif
 
 CAnimBlock CAnimManager::ms_aAnimBlocks[NUMANIMBLOCKS];
 CAnimBlendHierarchy CAnimManager::ms_aAnimations[NUMANIMATIONS];
@@ -18,6 +21,9 @@ int32 CAnimManager::ms_numAnimBlocks;
 int32 CAnimManager::ms_numAnimations;
 CAnimBlendAssocGroup *CAnimManager::ms_aAnimAssocGroups;
 CLinkList<CAnimBlendHierarchy*> CAnimManager::ms_animCache;
+#ifdef HASHED_NAME_LOOKUP
+static CNameIndex gAnimBlockNameIndex;
+#endif
 
 AnimAssocDesc aStdAnimDescs[] = {
 	{ ANIM_WALK, ASSOC_REPEAT | ASSOC_MOVEMENT | ASSOC_HAS_TRANSLATION | ASSOC_WALK },
@@ -972,6 +978,9 @@ CAnimManager::Initialise(void)
 {
 	ms_numAnimations = 0;
 	ms_numAnimBlocks = 0;
+#ifdef HASHED_NAME_LOOKUP
+	gAnimBlockNameIndex.Clear();
+#endif
 	ms_animCache.Init(25);
 }
 
@@ -1030,23 +1039,32 @@ CAnimManager::RemoveFromUncompressedCache(CAnimBlendHierarchy *hier)
 CAnimBlock*
 CAnimManager::GetAnimationBlock(const char *name)
 {
+#ifdef HASHED_NAME_LOOKUP
+	int i = gAnimBlockNameIndex.Find(name);
+	return i == -1 ? nil : &ms_aAnimBlocks[i];
+#else
 	int i;
 
 	for(i = 0; i < ms_numAnimBlocks; i++)
 		if(strcasecmp(ms_aAnimBlocks[i].name, name) == 0)
 			return &ms_aAnimBlocks[i];
 	return nil;
+#endif
 }
 
 int32
 CAnimManager::GetAnimationBlockIndex(const char *name)
 {
+#ifdef HASHED_NAME_LOOKUP
+	return gAnimBlockNameIndex.Find(name);
+#else
 	int i;
 
 	for(i = 0; i < ms_numAnimBlocks; i++)
 		if(strcasecmp(ms_aAnimBlocks[i].name, name) == 0)
 			return i;
 	return -1;
+#endif
 }
 
 int32
@@ -1056,6 +1074,9 @@ CAnimManager::RegisterAnimBlock(const char *name)
 	if(animBlock == nil){
 		animBlock = &ms_aAnimBlocks[ms_numAnimBlocks++];
 		strncpy(animBlock->name, name, MAX_ANIMBLOCK_NAME);
+#ifdef HASHED_NAME_LOOKUP
+		gAnimBlockNameIndex.Add(animBlock->name, animBlock - ms_aAnimBlocks);
+#endif
 		animBlock->numAnims = 0;
 		assert(animBlock->refCount == 0);
 	}
@@ -1278,15 +1299,23 @@ CAnimManager::LoadAnimFile(const char *filename)
 void
 CAnimManager::LoadAnimFile(RwStream *stream, bool compress, char (*uncompressedAnims)[32])
 {
-	#define ROUNDSIZE(x) if((x) & 3) (x) += 4 - ((x)&3)
-	struct IfpHeader {
-		char ident[4];
-		uint32 size;
-	};
-	IfpHeader anpk, info, name, dgan, cpan, anim;
+	CAnimBlock *animBlock = LoadAnimBlockHeader(stream);
+	animBlock->isLoaded = true;
+	LoadAnimBlockAnims(stream, animBlock, compress, uncompressedAnims);
+}
+
+#define ROUNDSIZE(x) if((x) & 3) (x) += 4 - ((x)&3)
+struct IfpHeader {
+	char ident[4];
+	uint32 size;
+};
+
+// Reads the block header and reserves the block's range in ms_aAnimations
+CAnimBlock*
+CAnimManager::LoadAnimBlockHeader(RwStream *stream)
+{
+	IfpHeader anpk, info;
 	char buf[256];
-	int j, k, l;
-	float *fbuf = (float*)buf;
 
 	// block name
 	RwStreamRead(stream, &anpk, sizeof(IfpHeader));
@@ -1303,12 +1332,29 @@ CAnimManager::LoadAnimFile(RwStream *stream, bool compress, char (*uncompressedA
 	}else{
 		animBlock = &ms_aAnimBlocks[ms_numAnimBlocks++];
 		strncpy(animBlock->name, buf+4, MAX_ANIMBLOCK_NAME);
+#ifdef HASHED_NAME_LOOKUP
+		gAnimBlockNameIndex.Add(animBlock->name, animBlock - ms_aAnimBlocks);
+#endif
 		animBlock->numAnims = *(int*)buf;
 		animBlock->firstIndex = ms_numAnimations;
 	}
 
 	debug("Loading ANIMS %s\n", animBlock->name);
-	animBlock->isLoaded = true;
+
+	if(animBlock->firstIndex + animBlock->numAnims > ms_numAnimations)
+		ms_numAnimations = animBlock->firstIndex + animBlock->numAnims;
+	return animBlock;
+}
+
+// Reads the hierarchies of a block whose header has been read already.
+// Only touches the block's own range of ms_aAnimations, so this is safe to run off the game thread.
+void
+CAnimManager::LoadAnimBlockAnims(RwStream *stream, CAnimBlock *animBlock, bool compress, char (*uncompressedAnims)[32])
+{
+	IfpHeader info, name, dgan, cpan, anim;
+	char buf[256];
+	int j, k, l;
+	float *fbuf = (float*)buf;
 
 	int animIndex = animBlock->firstIndex;
 	for(j = 0; j < animBlock->numAnims; j++){
@@ -1437,15 +1483,17 @@ CAnimManager::LoadAnimFile(RwStream *stream, bool compress, char (*uncompressedA
 			hier->CalcTotalTime();
 		}
 	}
-	if(animIndex > ms_numAnimations)
-		ms_numAnimations = animIndex;
 }
+#undef ROUNDSIZE
 
 void
 CAnimManager::RemoveLastAnimFile(void)
 {
 	int i;
 	ms_numAnimBlocks--;
+#ifdef HASHED_NAME_LOOKUP
+	gAnimBlockNameIndex.Remove(ms_aAnimBlocks[ms_numAnimBlocks].name, ms_numAnimBlocks);
+#endif
 	ms_numAnimations = ms_aAnimBlocks[ms_numAnimBlocks].firstIndex;
 	for(i = 0; i < ms_aAnimBlocks[ms_numAnimBlocks].numAnims; i++)
 		ms_aAnimations[ms_aAnimBlocks[ms_numAnimBlocks].firstIndex + i].Shutdown();
@@ -139,6 +139,8 @@ public:
 	static void LoadAnimFiles(void);
 	static void LoadAnimFile(const char *filename);
 	static void LoadAnimFile(RwStream *stream, bool compress, char (*uncompressedAnims)[32] = nil);
+	static CAnimBlock *LoadAnimBlockHeader(RwStream *stream);
+	static void LoadAnimBlockAnims(RwStream *stream, CAnimBlock *animBlock, bool compress, char (*uncompressedAnims)[32] = nil);
 	static void CreateAnimAssocGroups(void);
 	static void RemoveLastAnimFile(void);
 	static CAnimBlendAssocGroup* GetAnimAssocGroups(void) { return ms_aAnimAssocGroups; }
@@ -192,7 +192,7 @@ CCutsceneMgr::LoadCutsceneData(const char *szCutsceneName)
 	if (!bIsEverythingRemovedFromTheWorldForTheBiggestFuckoffCutsceneEver)
 		CStreaming::RemoveCurrentZonesModels();
 
-	ms_pCutsceneDir->numEntries = 0;
+	ms_pCutsceneDir->Clear();
 	ms_pCutsceneDir->ReadDirFile("ANIM\\CUTS.DIR");
 
 	CStreaming::RemoveUnusedModelsInLoadedList();
@@ -31,7 +31,7 @@ FrameUpdateCallBackNonSkinned(AnimBlendFrameData *frame, void *arg)
 	AnimBlendFrameUpdateData *updateData = (AnimBlendFrameUpdateData*)arg;
 
 	if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION &&
-	   gpAnimBlendClump->velocity2d){
+	   updateData->clumpData->velocity2d){
 		if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION_3D)
 			FrameUpdateCallBackWith3dVelocityExtractionNonSkinned(frame, arg);
 		else
@@ -140,11 +140,11 @@ FrameUpdateCallBackWithVelocityExtractionNonSkinned(AnimBlendFrameData *frame, v
 	}
 
 	if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
-		gpAnimBlendClump->velocity2d->x = transx - curx;
-		gpAnimBlendClump->velocity2d->y = transy - cury;
+		updateData->clumpData->velocity2d->x = transx - curx;
+		updateData->clumpData->velocity2d->y = transy - cury;
 		if(looped){
-			gpAnimBlendClump->velocity2d->x += endx;
-			gpAnimBlendClump->velocity2d->y += endy;
+			updateData->clumpData->velocity2d->x += endx;
+			updateData->clumpData->velocity2d->y += endy;
 		}
 		mat->pos.x = pos.x - transx;
 		mat->pos.y = pos.y - transy;
@@ -220,9 +220,9 @@ FrameUpdateCallBackWith3dVelocityExtractionNonSkinned(AnimBlendFrameData *frame,
 	}
 
 	if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
-		*gpAnimBlendClump->velocity3d = trans - cur;
+		*updateData->clumpData->velocity3d = trans - cur;
 		if(looped)
-			*gpAnimBlendClump->velocity3d += end;
+			*updateData->clumpData->velocity3d += end;
 		mat->pos.x = (pos - trans).x + frame->resetPos.x;
 		mat->pos.y = (pos - trans).y + frame->resetPos.y;
 		mat->pos.z = (pos - trans).z + frame->resetPos.z;
@@ -242,7 +242,7 @@ FrameUpdateCallBackSkinned(AnimBlendFrameData *frame, void *arg)
 	AnimBlendFrameUpdateData *updateData = (AnimBlendFrameUpdateData*)arg;
 
 	if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION &&
-	   gpAnimBlendClump->velocity2d){
+	   updateData->clumpData->velocity2d){
 		if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION_3D)
 			FrameUpdateCallBackWith3dVelocityExtractionSkinned(frame, arg);
 		else
@@ -352,11 +352,11 @@ FrameUpdateCallBackWithVelocityExtractionSkinned(AnimBlendFrameData *frame, void
 	}
 
 	if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
-		gpAnimBlendClump->velocity2d->x = transx - curx;
-		gpAnimBlendClump->velocity2d->y = transy - cury;
+		updateData->clumpData->velocity2d->x = transx - curx;
+		updateData->clumpData->velocity2d->y = transy - cury;
 		if(looped){
-			gpAnimBlendClump->velocity2d->x += endx;
-			gpAnimBlendClump->velocity2d->y += endy;
+			updateData->clumpData->velocity2d->x += endx;
+			updateData->clumpData->velocity2d->y += endy;
 		}
 		xform->t.x = pos.x - transx;
 		xform->t.y = pos.y - transy;
@@ -432,9 +432,9 @@ FrameUpdateCallBackWith3dVelocityExtractionSkinned(AnimBlendFrameData *frame, vo
 	}
 
 	if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
-		*gpAnimBlendClump->velocity3d = trans - cur;
+		*updateData->clumpData->velocity3d = trans - cur;
 		if(looped)
-			*gpAnimBlendClump->velocity3d += end;
+			*updateData->clumpData->velocity3d += end;
 		xform->t.x = (pos - trans).x + frame->resetPos.x;
 		xform->t.y = (pos - trans).y + frame->resetPos.y;
 		xform->t.z = (pos - trans).z + frame->resetPos.z;
@@ -444,7 +444,9 @@ FrameUpdateCallBackWith3dVelocityExtractionSkinned(AnimBlendFrameData *frame, vo
 void
 FrameUpdateCallBackOffscreen(AnimBlendFrameData *frame, void *arg)
 {
-	if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION && gpAnimBlendClump->velocity2d)
+	AnimBlendFrameUpdateData *updateData = (AnimBlendFrameUpdateData*)arg;
+
+	if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION && updateData->clumpData->velocity2d)
 		FrameUpdateCallBackWithVelocityExtractionSkinned(frame, arg);
 }
 
@@ -464,7 +466,7 @@ FrameUpdateCallBackNonSkinnedCompressed(AnimBlendFrameData *frame, void *arg)
 	AnimBlendFrameUpdateData *updateData = (AnimBlendFrameUpdateData*)arg;
 
 	if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION &&
-	   gpAnimBlendClump->velocity2d){
+	   updateData->clumpData->velocity2d){
 		if(updateData->foobar)
 			for(node = updateData->nodes; *node; node++)
 				if((*node)->sequence && (*node)->association->IsPartial())
@@ -509,9 +511,9 @@ FrameUpdateCallBackNonSkinnedCompressed(AnimBlendFrameData *frame, void *arg)
 		}
 
 		if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
-			*gpAnimBlendClump->velocity3d = trans - cur;
+			*updateData->clumpData->velocity3d = trans - cur;
 			if(looped)
-				*gpAnimBlendClump->velocity3d += end;
+				*updateData->clumpData->velocity3d += end;
 			mat->pos.x = (pos - trans).x + frame->resetPos.x;
 			mat->pos.y = (pos - trans).y + frame->resetPos.y;
 			mat->pos.z = (pos - trans).z + frame->resetPos.z;
@@ -571,7 +573,7 @@ FrameUpdateCallBackSkinnedCompressed(AnimBlendFrameData *frame, void *arg)
 	AnimBlendFrameUpdateData *updateData = (AnimBlendFrameUpdateData*)arg;
 
 	if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION &&
-	   gpAnimBlendClump->velocity2d){
+	   updateData->clumpData->velocity2d){
 		if(updateData->foobar)
 			for(node = updateData->nodes; *node; node++)
 				if((*node)->sequence && (*node)->association->IsPartial())
@@ -618,9 +620,9 @@ FrameUpdateCallBackSkinnedCompressed(AnimBlendFrameData *frame, void *arg)
 		}
 
 		if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
-			*gpAnimBlendClump->velocity3d = trans - cur;
+			*updateData->clumpData->velocity3d = trans - cur;
 			if(looped)
-				*gpAnimBlendClump->velocity3d += end;
+				*updateData->clumpData->velocity3d += end;
 			xform->t.x = (pos - trans).x + frame->resetPos.x;
 			xform->t.y = (pos - trans).y + frame->resetPos.y;
 			xform->t.z = (pos - trans).z + frame->resetPos.z;
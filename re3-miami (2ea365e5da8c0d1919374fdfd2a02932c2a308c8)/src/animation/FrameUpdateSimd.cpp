@@ -0,0 +1,500 @@
+#include "common.h"
+
+#ifdef SIMD_ANIM_UPDATE
+#include "Timer.h"
+#include "Pools.h"
+#include "Ped.h"
+#include "RwHelper.h"
+#include "AnimBlendClumpData.h"
+#include "AnimBlendHierarchy.h"
+#include "AnimBlendAssociation.h"
+#include "RpAnimBlend.h"
+#include "Simd4.h"
+#ifdef ANIM_LOD
+#include "AnimLod.h"
+#endif
+
+// The frame callbacks of FrameUpdate.cpp four frames at a time.
+// Key frames are advanced one node at a time as before, the slerps, lerps and sums
+// over the associations are done for four frames in the lanes of one vector.
+// Frames with velocity extraction still go through the callbacks.
+
+bool gbSimdAnimUpdate = true;
+
+// stand-ins for lanes without a key frame, so every lane can be loaded the same way
+static KeyFrameTrans zeroKeyFrame;
+static KeyFrameTransCompressed zeroKeyFrameCompressed;
+
+struct vquat
+{
+	vfloat x, y, z, w;
+};
+
+// sin on [-PI/2, PI/2], which is all Slerp needs
+static inline vfloat
+Sin4(vfloat x)
+{
+	vfloat x2 = Mul(x, x);
+	vfloat p = Splat(-1.0f/39916800.0f);
+	p = Add(Mul(p, x2), Splat(1.0f/362880.0f));
+	p = Add(Mul(p, x2), Splat(-1.0f/5040.0f));
+	p = Add(Mul(p, x2), Splat(1.0f/120.0f));
+	p = Add(Mul(p, x2), Splat(-1.0f/6.0f));
+	p = Add(Mul(p, x2), Splat(1.0f));
+	return Mul(x, p);
+}
+
+// Rotations and translations of one node in four frames, either kind of key frame
+struct NodeLanes
+{
+	const void *rotA[4];
+	const void *rotB[4];
+	const void *transA[4];	// points at deltaTime, which is followed by the translation
+	const void *transB[4];
+	float t[4];
+	float theta[4];
+	float invSin[4];
+	float rotBlend[4];
+	float transBlend[4];
+
+	void LoadRotations(vquat &a, vquat &b, bool compressed) const;
+	void LoadTranslations(vquat &a, vquat &b, bool compressed) const;
+};
+
+// Transposed into x, y, z, w of four lanes
+void
+NodeLanes::LoadRotations(vquat &a, vquat &b, bool compressed) const
+{
+	if(compressed){
+		vfloat scale = Splat(1.0f/4096.0f);
+		a.x = LoadInt16(((const KeyFrameCompressed*)rotA[0])->rot);
+		a.y = LoadInt16(((const KeyFrameCompressed*)rotA[1])->rot);
+		a.z = LoadInt16(((const KeyFrameCompressed*)rotA[2])->rot);
+		a.w = LoadInt16(((const KeyFrameCompressed*)rotA[3])->rot);
+		b.x = LoadInt16(((const KeyFrameCompressed*)rotB[0])->rot);
+		b.y = LoadInt16(((const KeyFrameCompressed*)rotB[1])->rot);
+		b.z = LoadInt16(((const KeyFrameCompressed*)rotB[2])->rot);
+		b.w = LoadInt16(((const KeyFrameCompressed*)rotB[3])->rot);
+		Transpose(a.x, a.y, a.z, a.w);
+		Transpose(b.x, b.y, b.z, b.w);
+		a.x = Mul(a.x, scale); a.y = Mul(a.y, scale); a.z = Mul(a.z, scale); a.w = Mul(a.w, scale);
+		b.x = Mul(b.x, scale); b.y = Mul(b.y, scale); b.z = Mul(b.z, scale); b.w = Mul(b.w, scale);
+	}else{
+		a.x = Load(&((const KeyFrame*)rotA[0])->rotation.x);
+		a.y = Load(&((const KeyFrame*)rotA[1])->rotation.x);
+		a.z = Load(&((const KeyFrame*)rotA[2])->rotation.x);
+		a.w = Load(&((const KeyFrame*)rotA[3])->rotation.x);
+		b.x = Load(&((const KeyFrame*)rotB[0])->rotation.x);
+		b.y = Load(&((const KeyFrame*)rotB[1])->rotation.x);
+		b.z = Load(&((const KeyFrame*)rotB[2])->rotation.x);
+		b.w = Load(&((const KeyFrame*)rotB[3])->rotation.x);
+		Transpose(a.x, a.y, a.z, a.w);
+		Transpose(b.x, b.y, b.z, b.w);
+	}
+}
+
+// x, y, z end up in y, z, w. Loading from deltaTime keeps the reads inside the key frame.
+void
+NodeLanes::LoadTranslations(vquat &a, vquat &b, bool compressed) const
+{
+	if(compressed){
+		vfloat scale = Splat(1.0f/1024.0f);
+		a.x = LoadInt16(&((const KeyFrameTransCompressed*)transA[0])->deltaTime);
+		a.y = LoadInt16(&((const KeyFrameTransCompressed*)transA[1])->deltaTime);
+		a.z = LoadInt16(&((const KeyFrameTransCompressed*)transA[2])->deltaTime);
+		a.w = LoadInt16(&((const KeyFrameTransCompressed*)transA[3])->deltaTime);
+		b.x = LoadInt16(&((const KeyFrameTransCompressed*)transB[0])->deltaTime);
+		b.y = LoadInt16(&((const KeyFrameTransCompressed*)transB[1])->deltaTime);
+		b.z = LoadInt16(&((const KeyFrameTransCompressed*)transB[2])->deltaTime);
+		b.w = LoadInt16(&((const KeyFrameTransCompressed*)transB[3])->deltaTime);
+		Transpose(a.x, a.y, a.z, a.w);
+		Transpose(b.x, b.y, b.z, b.w);
+		a.y = Mul(a.y, scale); a.z = Mul(a.z, scale); a.w = Mul(a.w, scale);
+		b.y = Mul(b.y, scale); b.z = Mul(b.z, scale); b.w = Mul(b.w, scale);
+	}else{
+		a.x = Load(&((const KeyFrameTrans*)transA[0])->deltaTime);
+		a.y = Load(&((const KeyFrameTrans*)transA[1])->deltaTime);
+		a.z = Load(&((const KeyFrameTrans*)transA[2])->deltaTime);
+		a.w = Load(&((const KeyFrameTrans*)transA[3])->deltaTime);
+		b.x = Load(&((const KeyFrameTrans*)transB[0])->deltaTime);
+		b.y = Load(&((const KeyFrameTrans*)transB[1])->deltaTime);
+		b.z = Load(&((const KeyFrameTrans*)transB[2])->deltaTime);
+		b.w = Load(&((const KeyFrameTrans*)transB[3])->deltaTime);
+		Transpose(a.x, a.y, a.z, a.w);
+		Transpose(b.x, b.y, b.z, b.w);
+	}
+}
+
+// The scalar half of CAnimBlendNode::Update(Compressed): advance the key frames
+// and find what to interpolate between
+static void
+SetupLane(NodeLanes &lanes, int32 l, CAnimBlendNode *node, float weight, bool compressed)
+{
+	float blend;
+	const void *zero = compressed ? (const void*)&zeroKeyFrameCompressed : (const void*)&zeroKeyFrame;
+
+	lanes.rotA[l] = lanes.rotB[l] = zero;
+	lanes.transA[l] = lanes.transB[l] = compressed ? (const void*)&zeroKeyFrameCompressed.deltaTime : (const void*)&zeroKeyFrame.deltaTime;
+	lanes.t[l] = 0.0f;
+	lanes.theta[l] = 0.0f;
+	lanes.invSin[l] = 0.0f;
+	lanes.rotBlend[l] = 0.0f;
+	lanes.transBlend[l] = 0.0f;
+	if(node == nil || node->sequence == nil)
+		return;
+
+	if(node->association->IsRunning()){
+		node->remainingTime -= node->association->timeStep;
+		if(node->remainingTime <= 0.0f){
+			if(compressed)
+				node->NextKeyFrameCompressed();
+			else
+				node->NextKeyFrame();
+		}
+	}
+
+	blend = node->association->GetBlendAmount(weight);
+	if(blend <= 0.0f)
+		return;
+
+	CAnimBlendSequence *seq = node->sequence;
+	if(compressed){
+		KeyFrameTransCompressed *kfA = (KeyFrameTransCompressed*)seq->GetKeyFrameCompressed(node->frameA);
+		KeyFrameTransCompressed *kfB = (KeyFrameTransCompressed*)seq->GetKeyFrameCompressed(node->frameB);
+		lanes.t[l] = kfA->deltaTime == 0 ? 0.0f : (kfA->GetDeltaTime() - node->remainingTime)/kfA->GetDeltaTime();
+		if(seq->type & CAnimBlendSequence::KF_ROT){
+			lanes.rotA[l] = kfA;
+			lanes.rotB[l] = kfB;
+		}
+		if(seq->type & CAnimBlendSequence::KF_TRANS){
+			lanes.transA[l] = &kfA->deltaTime;
+			lanes.transB[l] = &kfB->deltaTime;
+		}
+	}else{
+		KeyFrameTrans *kfA = (KeyFrameTrans*)seq->GetKeyFrame(node->frameA);
+		KeyFrameTrans *kfB = (KeyFrameTrans*)seq->GetKeyFrame(node->frameB);
+		lanes.t[l] = kfA->deltaTime == 0.0f ? 0.0f : (kfA->deltaTime - node->remainingTime)/kfA->deltaTime;
+		if(seq->type & CAnimBlendSequence::KF_ROT){
+			lanes.rotA[l] = kfA;
+			lanes.rotB[l] = kfB;
+		}
+		if(seq->type & CAnimBlendSequence::KF_TRANS){
+			lanes.transA[l] = &kfA->deltaTime;
+			lanes.transB[l] = &kfB->deltaTime;
+		}
+	}
+	if(seq->type & CAnimBlendSequence::KF_ROT){
+		lanes.theta[l] = node->theta;
+		lanes.invSin[l] = node->invSin;
+		lanes.rotBlend[l] = blend;
+	}
+	if(seq->type & CAnimBlendSequence::KF_TRANS)
+		lanes.transBlend[l] = blend;
+}
+
+// Frames idx[0..n-1], none of them with velocity extraction
+static void
+UpdateFrames4(CAnimBlendClumpData *clumpData, CAnimBlendNode **nodes, int32 numNodes, bool partials,
+	const int32 *idx, int32 n, bool skinned, bool compressed)
+{
+	int32 i, l;
+	float weight[4];
+	float transBlendSum[4];
+	NodeLanes lanes;
+	vquat rot, qA, qB, tA, tB;
+	vfloat posX, posY, posZ;
+	CAnimBlendNode *node;
+#ifdef FIX_BUGS
+	bool fixFlips = true;
+#else
+	bool fixFlips = skinned;
+#endif
+
+	for(l = 0; l < 4; l++){
+		weight[l] = 1.0f;
+		transBlendSum[l] = 0.0f;
+		if(l < n && partials)
+			for(i = 0; i < numNodes; i++){
+				node = &nodes[i][idx[l]];
+				if(node->sequence && node->association->IsPartial())
+					weight[l] -= node->association->blendAmount;
+			}
+	}
+
+	rot.x = rot.y = rot.z = rot.w = Splat(0.0f);
+	posX = posY = posZ = Splat(0.0f);
+	for(i = 0; i < numNodes; i++){
+		for(l = 0; l < 4; l++){
+			node = l < n ? &nodes[i][idx[l]] : nil;
+			SetupLane(lanes, l, node, weight[l], compressed);
+			if(node && node->sequence && node->sequence->HasTranslation())
+				transBlendSum[l] += node->association->blendAmount;
+		}
+
+		// Slerp, see CQuaternion::Slerp
+		vfloat t = Load(lanes.t);
+		vfloat theta = Load(lanes.theta);
+		vfloat invSin = Load(lanes.invSin);
+		vmask flip = CmpGt(theta, Splat(PI/2));
+		vfloat th = Select(flip, Sub(Splat(PI), theta), theta);
+		vfloat w1 = Mul(Sin4(Mul(Sub(Splat(1.0f), t), th)), invSin);
+		vfloat w2 = Mul(Sin4(Mul(t, th)), invSin);
+		w2 = Select(flip, Neg(w2), w2);
+		vmask same = CmpEq(theta, Splat(0.0f));
+		w1 = Select(same, Splat(0.0f), w1);
+		w2 = Select(same, Splat(1.0f), w2);
+		vfloat rotBlend = Load(lanes.rotBlend);
+		w1 = Mul(w1, rotBlend);
+		w2 = Mul(w2, rotBlend);
+
+		lanes.LoadRotations(qA, qB, compressed);
+		vquat q;
+		q.x = Add(Mul(w1, qB.x), Mul(w2, qA.x));
+		q.y = Add(Mul(w1, qB.y), Mul(w2, qA.y));
+		q.z = Add(Mul(w1, qB.z), Mul(w2, qA.z));
+		q.w = Add(Mul(w1, qB.w), Mul(w2, qA.w));
+		if(fixFlips){
+			vfloat dot = Add(Add(Mul(rot.x, q.x), Mul(rot.y, q.y)), Add(Mul(rot.z, q.z), Mul(rot.w, q.w)));
+			vmask opposite = CmpLt(dot, Splat(0.0f));
+			q.x = Select(opposite, Neg(q.x), q.x);
+			q.y = Select(opposite, Neg(q.y), q.y);
+			q.z = Select(opposite, Neg(q.z), q.z);
+			q.w = Select(opposite, Neg(q.w), q.w);
+		}
+		rot.x = Add(rot.x, q.x);
+		rot.y = Add(rot.y, q.y);
+		rot.z = Add(rot.z, q.z);
+		rot.w = Add(rot.w, q.w);
+
+		lanes.LoadTranslations(tA, tB, compressed);
+		vfloat transBlend = Load(lanes.transBlend);
+		posX = Add(posX, Mul(Add(tB.y, Mul(t, Sub(tA.y, tB.y))), transBlend));
+		posY = Add(posY, Mul(Add(tB.z, Mul(t, Sub(tA.z, tB.z))), transBlend));
+		posZ = Add(posZ, Mul(Add(tB.w, Mul(t, Sub(tA.w, tB.w))), transBlend));
+	}
+
+	// CQuaternion::Normalise
+	vfloat sq = Add(Add(Mul(rot.x, rot.x), Mul(rot.y, rot.y)), Add(Mul(rot.z, rot.z), Mul(rot.w, rot.w)));
+	vmask empty = CmpEq(sq, Splat(0.0f));
+	vfloat invLen = RecipSqrt(Select(empty, Splat(1.0f), sq));
+	rot.x = Mul(rot.x, invLen);
+	rot.y = Mul(rot.y, invLen);
+	rot.z = Mul(rot.z, invLen);
+	rot.w = Select(empty, Splat(1.0f), Mul(rot.w, invLen));
+
+	float rx[4], ry[4], rz[4], rw[4], px[4], py[4], pz[4];
+	Store(rx, rot.x); Store(ry, rot.y); Store(rz, rot.z); Store(rw, rot.w);
+	Store(px, posX); Store(py, posY); Store(pz, posZ);
+	for(l = 0; l < n; l++){
+		AnimBlendFrameData *frame = &clumpData->frames[idx[l]];
+		if(skinned){
+			RpHAnimStdInterpFrame *xform = frame->hanimFrame;
+			if((frame->flag & AnimBlendFrameData::IGNORE_ROTATION) == 0){
+				xform->q.imag.x = rx[l];
+				xform->q.imag.y = ry[l];
+				xform->q.imag.z = rz[l];
+				xform->q.real = rw[l];
+			}
+			if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
+				float transBlendAmount = transBlendSum[l];
+				xform->t.x = transBlendAmount*px[l] + (1.0f-transBlendAmount)*frame->resetPos.x;
+				xform->t.y = transBlendAmount*py[l] + (1.0f-transBlendAmount)*frame->resetPos.y;
+				xform->t.z = transBlendAmount*pz[l] + (1.0f-transBlendAmount)*frame->resetPos.z;
+			}
+		}else{
+			RwMatrix *mat = RwFrameGetMatrix(frame->frame);
+			if((frame->flag & AnimBlendFrameData::IGNORE_ROTATION) == 0){
+				RwMatrixSetIdentity(mat);
+				CQuaternion(rx[l], ry[l], rz[l], rw[l]).Get(mat);
+			}
+			if((frame->flag & AnimBlendFrameData::IGNORE_TRANSLATION) == 0){
+				mat->pos.x = px[l] + frame->resetPos.x;
+				mat->pos.y = py[l] + frame->resetPos.y;
+				mat->pos.z = pz[l] + frame->resetPos.z;
+			}
+			RwMatrixUpdate(mat);
+		}
+	}
+}
+
+// Does what ForAllFrames with the FrameUpdateCallBack(Non)Skinned(Compressed) callbacks does
+void
+FrameUpdateSimd(CAnimBlendClumpData *clumpData, AnimBlendFrameUpdateData *updateData, bool skinned, bool compressed)
+{
+	int32 i, j, n, numNodes;
+	int32 idx[4];
+	CAnimBlendNode *nodes[16];
+	AnimBlendFrameUpdateData single;
+	void (*callback)(AnimBlendFrameData*, void*);
+
+	for(numNodes = 0; updateData->nodes[numNodes]; numNodes++)
+		nodes[numNodes] = updateData->nodes[numNodes];
+	if(compressed)
+		callback = skinned ? FrameUpdateCallBackSkinnedCompressed : FrameUpdateCallBackNonSkinnedCompressed;
+	else
+		callback = skinned ? FrameUpdateCallBackSkinned : FrameUpdateCallBackNonSkinned;
+
+	n = 0;
+	for(i = 0; i < clumpData->numFrames; i++){
+		AnimBlendFrameData *frame = &clumpData->frames[i];
+		if(frame->flag & AnimBlendFrameData::VELOCITY_EXTRACTION && clumpData->velocity2d){
+			single.foobar = updateData->foobar;
+			single.clumpData = clumpData;
+			for(j = 0; j < numNodes; j++)
+				single.nodes[j] = nodes[j] + i;
+			single.nodes[numNodes] = nil;
+			callback(frame, &single);
+			continue;
+		}
+#ifdef ANIM_LOD
+		if(frame->flag & AnimBlendFrameData::LOD_DETAIL && clumpData->lod == ANIMLOD_QUARTER)
+			continue;
+#endif
+		idx[n++] = i;
+		if(n == 4){
+			UpdateFrames4(clumpData, nodes, numNodes, !!updateData->foobar, idx, n, skinned, compressed);
+			n = 0;
+		}
+	}
+	if(n > 0)
+		UpdateFrames4(clumpData, nodes, numNodes, !!updateData->foobar, idx, n, skinned, compressed);
+
+	// where the callbacks leave them
+	for(j = 0; j < numNodes; j++)
+		updateData->nodes[j] = nodes[j] + clumpData->numFrames;
+}
+
+#define BENCH_MAXFRAMES 64
+#define BENCH_ITERATIONS 50
+
+// Output of one frame, as the callbacks leave it
+static void
+GetFrameResult(AnimBlendFrameData *frame, bool skinned, float *out)
+{
+	if(skinned){
+		RpHAnimStdInterpFrame *xform = frame->hanimFrame;
+		out[0] = xform->q.imag.x;
+		out[1] = xform->q.imag.y;
+		out[2] = xform->q.imag.z;
+		out[3] = xform->q.real;
+		out[4] = xform->t.x;
+		out[5] = xform->t.y;
+		out[6] = xform->t.z;
+		out[7] = out[8] = out[9] = out[10] = out[11] = 0.0f;
+	}else{
+		RwMatrix *mat = RwFrameGetMatrix(frame->frame);
+		out[0] = mat->right.x; out[1] = mat->right.y; out[2] = mat->right.z;
+		out[3] = mat->up.x; out[4] = mat->up.y; out[5] = mat->up.z;
+		out[6] = mat->at.x; out[7] = mat->at.y; out[8] = mat->at.z;
+		out[9] = mat->pos.x; out[10] = mat->pos.y; out[11] = mat->pos.z;
+	}
+}
+
+// Nodes as the update gathers them, false if an anim isn't uncompressed right now
+static bool
+GatherBenchNodes(CAnimBlendClumpData *clumpData, AnimBlendFrameUpdateData *updateData)
+{
+	int i;
+	CAnimBlendLink *link;
+
+	i = 0;
+	updateData->foobar = 0;
+	updateData->clumpData = clumpData;
+	for(link = clumpData->link.next; link; link = link->next){
+		CAnimBlendAssociation *assoc = CAnimBlendAssociation::FromLink(link);
+		if(assoc->hierarchy->sequences == nil)
+			continue;
+		if(assoc->hierarchy->compressed && !assoc->hierarchy->keepCompressed)
+			return false;
+		if(i < 11)
+			updateData->nodes[i++] = assoc->GetNode(0);
+		if((assoc->flags & ASSOC_MOVEMENT) == 0)
+			updateData->foobar = 1;
+	}
+	updateData->nodes[i] = nil;
+	return true;
+}
+
+static void
+EvaluateFrames(CAnimBlendClumpData *clumpData, AnimBlendFrameUpdateData *nodes, bool skinned, bool compressed, bool simd)
+{
+	AnimBlendFrameUpdateData updateData = *nodes;
+	if(simd)
+		FrameUpdateSimd(clumpData, &updateData, skinned, compressed);
+	else if(compressed)
+		clumpData->ForAllFrames(skinned ? FrameUpdateCallBackSkinnedCompressed : FrameUpdateCallBackNonSkinnedCompressed, &updateData);
+	else
+		clumpData->ForAllFrames(skinned ? FrameUpdateCallBackSkinned : FrameUpdateCallBackNonSkinned, &updateData);
+}
+
+// Poses every ped on screen with the callbacks and with FrameUpdateSimd, with the
+// associations held still so both see the same key frames, then times both over the crowd
+void
+BenchmarkFrameUpdateSimd(void)
+{
+	int i, j, k, pass;
+	int32 numPeds, numFrames;
+	float maxError;
+	float time[2];
+	static float results[BENCH_MAXFRAMES][12];
+	float result[12];
+	CAnimBlendClumpData *clumps[NUMPEDS];
+	AnimBlendFrameUpdateData nodes[NUMPEDS];
+	bool skinned[NUMPEDS];
+	bool compressed[NUMPEDS];
+	float timeSteps[NUMPEDS][11];
+
+	numPeds = 0;
+	for(i = 0; i < CPools::GetPedPool()->GetSize(); i++){
+		CPed *ped = CPools::GetPedPool()->GetSlot(i);
+		if(ped == nil || ped->m_rwObject == nil || ped->bOffscreen || RwObjectGetType(ped->m_rwObject) != rpCLUMP)
+			continue;
+		CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(ped->GetClump());
+		if(clumpData == nil || clumpData->link.next == nil || clumpData->numFrames > BENCH_MAXFRAMES)
+			continue;
+		if(!GatherBenchNodes(clumpData, &nodes[numPeds]))
+			continue;
+		clumps[numPeds] = clumpData;
+		skinned[numPeds] = !!IsClumpSkinned(ped->GetClump());
+		compressed[numPeds] = !!(clumpData->frames[0].flag & AnimBlendFrameData::COMPRESSED);
+		numPeds++;
+	}
+
+	// hold the key frames still
+	for(i = 0; i < numPeds; i++)
+		for(j = 0; nodes[i].nodes[j]; j++){
+			timeSteps[i][j] = nodes[i].nodes[j]->association->timeStep;
+			nodes[i].nodes[j]->association->timeStep = 0.0f;
+		}
+
+	numFrames = 0;
+	maxError = 0.0f;
+	for(i = 0; i < numPeds; i++){
+		EvaluateFrames(clumps[i], &nodes[i], skinned[i], compressed[i], false);
+		for(j = 0; j < clumps[i]->numFrames; j++)
+			GetFrameResult(&clumps[i]->frames[j], skinned[i], results[j]);
+		EvaluateFrames(clumps[i], &nodes[i], skinned[i], compressed[i], true);
+		for(j = 0; j < clumps[i]->numFrames; j++){
+			GetFrameResult(&clumps[i]->frames[j], skinned[i], result);
+			for(k = 0; k < 12; k++)
+				maxError = Max(maxError, Abs(result[k] - results[j][k]));
+		}
+		numFrames += clumps[i]->numFrames;
+	}
+
+	for(pass = 0; pass < 2; pass++){
+		uint32 start = CTimer::GetCurrentTimeInCycles();
+		for(k = 0; k < BENCH_ITERATIONS; k++)
+			for(i = 0; i < numPeds; i++)
+				EvaluateFrames(clumps[i], &nodes[i], skinned[i], compressed[i], pass == 1);
+		time[pass] = (float)(CTimer::GetCurrentTimeInCycles() - start) / CTimer::GetCyclesPerMillisecond() / BENCH_ITERATIONS;
+	}
+
+	for(i = 0; i < numPeds; i++)
+		for(j = 0; nodes[i].nodes[j]; j++)
+			nodes[i].nodes[j]->association->timeStep = timeSteps[i][j];
+
+	debug("Frame update: %d peds, %d frames, callbacks %.3f ms, SIMD %.3f ms, max difference %f\n",
+		numPeds, numFrames, time[0], time[1], maxError);
+}
+#endif
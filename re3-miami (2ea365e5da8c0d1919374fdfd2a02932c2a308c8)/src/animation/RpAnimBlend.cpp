@@ -11,6 +11,12 @@
 #include "AnimManager.h"
 #include "RpAnimBlend.h"
 #include "PedModelInfo.h"
+#ifdef PARALLEL_ANIM_UPDATE
+#include "JobPool.h"
+#endif
+#ifdef ANIM_LOD
+#include "AnimLod.h"
+#endif
 
 RwInt32 ClumpOffset;
 
@@ -176,6 +182,11 @@ RpAnimBlendClumpInitSkinned(RpClump *clump)
 	}
 	clumpData->ForAllFrames(FrameInitCBskin, nil);
 	clumpData->frames[0].flag |= AnimBlendFrameData::VELOCITY_EXTRACTION;
+#ifdef ANIM_LOD
+	for(i = 0; i < numBones; i++)
+		if(IsAnimLodDetailBone(frames[i].nodeID))
+			frames[i].flag |= AnimBlendFrameData::LOD_DETAIL;
+#endif
 }
 
 void
@@ -435,47 +446,60 @@ RpAnimBlendNodeUpdateKeyframes(AnimBlendFrameData *frames, AnimBlendFrameUpdateD
 		CAnimBlendAssociation *a = (*node)->association;
 		for(i = 0; i < numNodes; i++)
 			if((frames[i].flag & AnimBlendFrameData::VELOCITY_EXTRACTION) == 0 ||
-			   gpAnimBlendClump->velocity2d == nil){
+			   updateData->clumpData->velocity2d == nil){
 				if((*node)[i].sequence)
 					(*node)[i].FindKeyFrame(a->currentTime - a->timeStep);
 			}
 	}
 }
 
-// TODO:
-// CAnimBlendClumpData::LoadFramesIntoSPR
-// CAnimBlendClumpData::ForAllFramesInSPR
-void
-RpAnimBlendClumpUpdateAnimations(RpClump *clump, float timeDelta, bool doRender)
+// Partial anims are left out at ANIMLOD_QUARTER, as long as there is something else to play
+static bool
+SkipPartialAnims(CAnimBlendClumpData *clumpData)
+{
+#ifdef ANIM_LOD
+	CAnimBlendLink *link;
+
+	if(clumpData->lod != ANIMLOD_QUARTER)
+		return false;
+	for(link = clumpData->link.next; link; link = link->next){
+		CAnimBlendAssociation *assoc = CAnimBlendAssociation::FromLink(link);
+		if(!assoc->IsPartial() && assoc->hierarchy->sequences)
+			return true;
+	}
+#endif
+	return false;
+}
+
+// Update blend and get node array, returns the speed factor for UpdateTime
+static float
+UpdateBlendAndTimeStep(CAnimBlendClumpData *clumpData, float timeDelta, AnimBlendFrameUpdateData *updateData)
 {
 	int i;
 	CAnimBlendAssociation *assoc;
-	AnimBlendFrameUpdateData updateData;
 	float totalLength = 0.0f;
 	float totalBlend = 0.0f;
 	CAnimBlendLink *link, *next;
-	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(clump);
-	gpAnimBlendClump = clumpData;
+	bool skipPartial = SkipPartialAnims(clumpData);
 
-	if(clumpData->link.next == nil)
-		return;
-
-	// Update blend and get node array
 	i = 0;
-	updateData.foobar = 0;
+	updateData->foobar = 0;
+	updateData->clumpData = clumpData;
 	for(link = clumpData->link.next; link; link = next){
 		next = link->next;
 		assoc = CAnimBlendAssociation::FromLink(link);
 		if(assoc->UpdateBlend(timeDelta)){
 			if(assoc->hierarchy->sequences){
+				if(skipPartial && assoc->IsPartial())
+					continue;
 				CAnimManager::UncompressAnimation(assoc->hierarchy);
 				if(i < 11)
-					updateData.nodes[i++] = assoc->GetNode(0);
+					updateData->nodes[i++] = assoc->GetNode(0);
 				if(assoc->flags & ASSOC_MOVEMENT){
 					totalLength += assoc->hierarchy->totalLength/assoc->speed * assoc->blendAmount;
 					totalBlend += assoc->blendAmount;
 				}else
-					updateData.foobar = 1;
+					updateData->foobar = 1;
 			}else
 				debug("anim %s is not loaded\n", assoc->hierarchy->name);
 		}
@@ -486,32 +510,217 @@ RpAnimBlendClumpUpdateAnimations(RpClump *clump, float timeDelta, bool doRender)
 		assoc->UpdateTimeStep(timeDelta, totalLength == 0.0f ? 1.0f : totalBlend/totalLength);
 	}
 
-	updateData.nodes[i] = nil;
+	updateData->nodes[i] = nil;
+	return totalLength == 0.0f ? 1.0f : totalBlend/totalLength;
+}
 
+// ForAllFrames, except that detail bones keep their last pose at ANIMLOD_QUARTER
+static void
+ForAllAnimatedFrames(CAnimBlendClumpData *clumpData, void (*cb)(AnimBlendFrameData*, void*), AnimBlendFrameUpdateData *updateData)
+{
+#ifdef ANIM_LOD
+	int i;
+	CAnimBlendNode **node;
+
+	if(clumpData->lod == ANIMLOD_QUARTER){
+		for(i = 0; i < clumpData->numFrames; i++){
+			if(clumpData->frames[i].flag & AnimBlendFrameData::LOD_DETAIL){
+				for(node = updateData->nodes; *node; node++)
+					++*node;
+			}else
+				cb(&clumpData->frames[i], updateData);
+		}
+		return;
+	}
+#endif
+	clumpData->ForAllFrames(cb, updateData);
+}
+
+// The move delta of an update covers all frames since the last one, hand it out over the frames until the next
+static void
+ShareLodMoveDelta(CAnimBlendClumpData *clumpData)
+{
+#ifdef ANIM_LOD
+	if(clumpData->velocity2d){
+		if(clumpData->lodTimeShare < 1.0f)
+			*clumpData->velocity2d *= clumpData->lodTimeShare;
+		clumpData->lodMoveDelta = *clumpData->velocity2d;
+	}
+	clumpData->lodTimeShare = 1.0f;
+#endif
+}
+
+// Only writes to the frames of this clump
+static void
+UpdateFrames(CAnimBlendClumpData *clumpData, AnimBlendFrameUpdateData *updateData, bool skinned, bool doRender)
+{
 #ifdef ANIM_COMPRESSION
 	if(clumpData->frames[0].flag & AnimBlendFrameData::COMPRESSED){
-		if(IsClumpSkinned(clump))
-			clumpData->ForAllFrames(FrameUpdateCallBackSkinnedCompressed, &updateData);
+#ifdef SIMD_ANIM_UPDATE
+		if(gbSimdAnimUpdate)
+			FrameUpdateSimd(clumpData, updateData, skinned, true);
+		else
+#endif
+		if(skinned)
+			ForAllAnimatedFrames(clumpData, FrameUpdateCallBackSkinnedCompressed, updateData);
 		else
-			clumpData->ForAllFrames(FrameUpdateCallBackNonSkinnedCompressed, &updateData);
+			ForAllAnimatedFrames(clumpData, FrameUpdateCallBackNonSkinnedCompressed, updateData);
 	}else
 #endif
 	if(doRender){
 		if(clumpData->frames[0].flag & AnimBlendFrameData::UPDATE_KEYFRAMES)
-			RpAnimBlendNodeUpdateKeyframes(clumpData->frames, &updateData, clumpData->numFrames);
-		if(IsClumpSkinned(clump))
-			clumpData->ForAllFrames(FrameUpdateCallBackSkinned, &updateData);
+			RpAnimBlendNodeUpdateKeyframes(clumpData->frames, updateData, clumpData->numFrames);
+#ifdef SIMD_ANIM_UPDATE
+		if(gbSimdAnimUpdate)
+			FrameUpdateSimd(clumpData, updateData, skinned, false);
+		else
+#endif
+		if(skinned)
+			ForAllAnimatedFrames(clumpData, FrameUpdateCallBackSkinned, updateData);
 		else
-			clumpData->ForAllFrames(FrameUpdateCallBackNonSkinned, &updateData);
+			ForAllAnimatedFrames(clumpData, FrameUpdateCallBackNonSkinned, updateData);
 		clumpData->frames[0].flag &= ~AnimBlendFrameData::UPDATE_KEYFRAMES;
 	}else{
-		clumpData->ForAllFrames(FrameUpdateCallBackOffscreen, &updateData);
+		clumpData->ForAllFrames(FrameUpdateCallBackOffscreen, updateData);
 		clumpData->frames[0].flag |= AnimBlendFrameData::UPDATE_KEYFRAMES;
 	}
+}
+
+static void
+UpdateTime(CAnimBlendClumpData *clumpData, float timeDelta, float relSpeed)
+{
+	CAnimBlendLink *link;
+
+	for(link = clumpData->link.next; link; link = link->next)
+		CAnimBlendAssociation::FromLink(link)->UpdateTime(timeDelta, relSpeed);
+}
 
+// TODO:
+// CAnimBlendClumpData::LoadFramesIntoSPR
+// CAnimBlendClumpData::ForAllFramesInSPR
+void
+RpAnimBlendClumpUpdateAnimations(RpClump *clump, float timeDelta, bool doRender)
+{
+	AnimBlendFrameUpdateData updateData;
+	float relSpeed;
+	CAnimBlendClumpData *clumpData = *RPANIMBLENDCLUMPDATA(clump);
+	gpAnimBlendClump = clumpData;
+
+	if(clumpData->link.next == nil)
+		return;
+
+	relSpeed = UpdateBlendAndTimeStep(clumpData, timeDelta, &updateData);
+	UpdateFrames(clumpData, &updateData, IsClumpSkinned(clump), doRender);
+	ShareLodMoveDelta(clumpData);
+	UpdateTime(clumpData, timeDelta, relSpeed);
+	RwFrameUpdateObjects(RpClumpGetFrame(clump));
+}
+
+#ifdef PARALLEL_ANIM_UPDATE
+bool gbParallelAnimUpdate = true;
+
+// Nodes of whatever the clump has now, callbacks of other clumps may have changed that
+static void
+GatherNodes(CAnimBlendClumpData *clumpData, AnimBlendFrameUpdateData *updateData)
+{
+	int i;
+	CAnimBlendAssociation *assoc;
+	CAnimBlendLink *link;
+	bool skipPartial = SkipPartialAnims(clumpData);
+
+	i = 0;
+	updateData->foobar = 0;
+	updateData->clumpData = clumpData;
 	for(link = clumpData->link.next; link; link = link->next){
 		assoc = CAnimBlendAssociation::FromLink(link);
-		assoc->UpdateTime(timeDelta, totalLength == 0.0f ? 1.0f : totalBlend/totalLength);
+		if(assoc->hierarchy->sequences){
+			if(skipPartial && assoc->IsPartial())
+				continue;
+			CAnimManager::UncompressAnimation(assoc->hierarchy);
+			if(i < 11)
+				updateData->nodes[i++] = assoc->GetNode(0);
+			if((assoc->flags & ASSOC_MOVEMENT) == 0)
+				updateData->foobar = 1;
+		}
 	}
-	RwFrameUpdateObjects(RpClumpGetFrame(clump));
+	updateData->nodes[i] = nil;
 }
+
+// false if the anim cache threw out one of them again to make room for another clump's
+static bool
+AreNodesUncompressed(AnimBlendFrameUpdateData *updateData)
+{
+	CAnimBlendNode **node;
+
+	for(node = updateData->nodes; *node; node++){
+		CAnimBlendHierarchy *hier = (*node)->association->hierarchy;
+		if(hier->compressed && !hier->keepCompressed)
+			return false;
+	}
+	return true;
+}
+
+static void
+UpdateFramesJob(int32 i, void *data)
+{
+	AnimBlendClumpUpdateJob *job = &((AnimBlendClumpUpdateJob*)data)[i];
+	if(job->clumpData)
+		UpdateFrames(job->clumpData, &job->updateData, job->skinned, job->doRender);
+}
+
+// Same as calling RpAnimBlendClumpUpdateAnimations for every job, except that
+// each step is done for all clumps before the next one. Blending and UpdateTime,
+// and with them all association callbacks, run here in job order;
+// only the frame evaluation in between goes to the job pool.
+void
+RpAnimBlendClumpUpdateAnimationsBatch(AnimBlendClumpUpdateJob *jobs, int32 numJobs)
+{
+	int i;
+	AnimBlendClumpUpdateJob *job;
+	bool uncompressed;
+
+	for(i = 0; i < numJobs; i++){
+		job = &jobs[i];
+		job->clumpData = *RPANIMBLENDCLUMPDATA(job->clump);
+		gpAnimBlendClump = job->clumpData;
+		if(job->clumpData->link.next == nil){
+			job->clumpData = nil;
+			continue;
+		}
+		job->skinned = !!IsClumpSkinned(job->clump);
+		job->relSpeed = UpdateBlendAndTimeStep(job->clumpData, job->timeDelta, &job->updateData);
+	}
+
+	uncompressed = true;
+	for(i = 0; i < numJobs; i++)
+		if(jobs[i].clumpData)
+			GatherNodes(jobs[i].clumpData, &jobs[i].updateData);
+	for(i = 0; i < numJobs; i++)
+		if(jobs[i].clumpData && !AreNodesUncompressed(&jobs[i].updateData))
+			uncompressed = false;
+
+	if(uncompressed)
+		CJobPool::ParallelFor(numJobs, UpdateFramesJob, jobs);
+	else{
+		// More anims than fit into the cache, uncompress each one right before it's used
+		for(i = 0; i < numJobs; i++){
+			job = &jobs[i];
+			if(job->clumpData == nil)
+				continue;
+			if(!uncompressed)
+				GatherNodes(job->clumpData, &job->updateData);
+			UpdateFrames(job->clumpData, &job->updateData, job->skinned, job->doRender);
+		}
+	}
+
+	for(i = 0; i < numJobs; i++){
+		job = &jobs[i];
+		if(job->clumpData == nil)
+			continue;
+		gpAnimBlendClump = job->clumpData;
+		ShareLodMoveDelta(job->clumpData);
+		UpdateTime(job->clumpData, job->timeDelta, job->relSpeed);
+		RwFrameUpdateObjects(RpClumpGetFrame(job->clump));
+	}
+}
+#endif
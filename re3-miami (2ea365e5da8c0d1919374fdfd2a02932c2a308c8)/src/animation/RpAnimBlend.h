@@ -9,8 +9,24 @@ struct AnimBlendFrameUpdateData
 {
 	int foobar;	// TODO: figure out what this actually means
 	CAnimBlendNode *nodes[16];
+	CAnimBlendClumpData *clumpData;
 };
 
+#ifdef PARALLEL_ANIM_UPDATE
+struct AnimBlendClumpUpdateJob
+{
+	RpClump *clump;
+	float timeDelta;
+	bool doRender;
+
+	// filled in by the update
+	bool skinned;
+	float relSpeed;
+	CAnimBlendClumpData *clumpData;
+	AnimBlendFrameUpdateData updateData;
+};
+#endif
+
 extern RwInt32 ClumpOffset;
 #define RPANIMBLENDCLUMPDATA(o) (RWPLUGINOFFSET(CAnimBlendClumpData*, o, ClumpOffset))
 
@@ -37,6 +53,10 @@ CAnimBlendAssociation *RpAnimBlendClumpGetFirstAssociation(RpClump *clump, uint3
 CAnimBlendAssociation *RpAnimBlendClumpGetFirstAssociation(RpClump *clump);
 void RpAnimBlendNodeUpdateKeyframes(AnimBlendFrameData *frames, AnimBlendFrameUpdateData *updateData, int32 numNodes);
 void RpAnimBlendClumpUpdateAnimations(RpClump* clump, float timeDelta, bool doRender = true);
+#ifdef PARALLEL_ANIM_UPDATE
+extern bool gbParallelAnimUpdate;
+void RpAnimBlendClumpUpdateAnimationsBatch(AnimBlendClumpUpdateJob *jobs, int32 numJobs);
+#endif
 
 
 extern CAnimBlendClumpData *gpAnimBlendClump;
@@ -46,3 +66,9 @@ void FrameUpdateCallBackOffscreen(AnimBlendFrameData *frame, void *arg);
 
 void FrameUpdateCallBackNonSkinnedCompressed(AnimBlendFrameData *frame, void *arg);
 void FrameUpdateCallBackSkinnedCompressed(AnimBlendFrameData *frame, void *arg);
+
+#ifdef SIMD_ANIM_UPDATE
+extern bool gbSimdAnimUpdate;
+void FrameUpdateSimd(CAnimBlendClumpData *clumpData, AnimBlendFrameUpdateData *updateData, bool skinned, bool compressed);
+void BenchmarkFrameUpdateSimd(void);
+#endif
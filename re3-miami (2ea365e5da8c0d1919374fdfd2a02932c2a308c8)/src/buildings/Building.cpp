@@ -3,10 +3,53 @@
 #include "Building.h"
 #include "Streaming.h"
 #include "Pools.h"
+#ifdef STATIC_BUILDING_BVH
+#include "BuildingBVH.h"
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+#include "GroundCache.h"
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+#include "BuildingCulling.h"
+#endif
+#ifdef SECTOR_ENTITY_ARRAYS
+#include "World.h"
+#endif
 
 void *CBuilding::operator new(size_t sz) { return CPools::GetBuildingPool()->New();  }
 void CBuilding::operator delete(void *p, size_t sz) { CPools::GetBuildingPool()->Delete((CBuilding*)p); }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+// The arrays keep the bounding sphere of the model. The sector lists don't change
+// with the model, so the entries go back into the arrays of the lists that have it.
+static void
+UpdateSectorArrays(CBuilding *building, const CRect &bounds, bool add)
+{
+	int x, y, xstart, xend, ystart, yend;
+	CPtrNode *node;
+
+	xstart = CWorld::GetSectorIndexX(bounds.left);
+	xend   = CWorld::GetSectorIndexX(bounds.right);
+	ystart = CWorld::GetSectorIndexY(bounds.top);
+	yend   = CWorld::GetSectorIndexY(bounds.bottom);
+	for(y = ystart; y <= yend; y++)
+		for(x = xstart; x <= xend; x++){
+			CPtrList *lists = CWorld::GetSector(x, y)->m_lists;
+			for(int l = ENTITYLIST_BUILDINGS; l <= ENTITYLIST_BUILDINGS_OVERLAP; l++){
+				if(!add){
+					CWorld::GetSectorArray(&lists[l])->Remove(building);
+					continue;
+				}
+				for(node = lists[l].first; node; node = node->next)
+					if(node->item == building){
+						CWorld::GetSectorArray(&lists[l])->Add(building, nil);
+						break;
+					}
+			}
+		}
+}
+#endif
+
 void
 CBuilding::ReplaceWithNewModel(int32 id)
 {
@@ -14,7 +57,32 @@ CBuilding::ReplaceWithNewModel(int32 id)
 
 	if (CModelInfo::GetModelInfo(m_modelIndex)->GetNumRefs() == 0)
 		CStreaming::RemoveModel(m_modelIndex);
+#ifdef GROUND_HEIGHT_CACHE
+	CGroundCache::InvalidateEntity(this);
+#endif
+#ifdef SECTOR_ENTITY_ARRAYS
+	CRect bounds = GetBoundRect();
+	UpdateSectorArrays(this, bounds, false);
+#endif
+#ifdef STATIC_BUILDING_BVH
+	// the new model has different bounds
+	bool inBVH = CBuildingBVH::RemoveBuilding(this);
+	m_modelIndex = id;
+	if(inBVH)
+		CBuildingBVH::AddBuilding(this);
+#else
 	m_modelIndex = id;
+#endif
+#ifdef SECTOR_ENTITY_ARRAYS
+	UpdateSectorArrays(this, bounds, true);
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	CBuildingCulling::RemoveBuilding(this);
+	CBuildingCulling::AddBuilding(this);
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+	CGroundCache::InvalidateEntity(this);
+#endif
 
 	if(bIsBIGBuilding)
 		if(m_level == LEVEL_GENERIC || m_level == CGame::currLevel)
@@ -4,6 +4,7 @@
 #include "Game.h"
 #include "MemoryHeap.h"
 #include "Pools.h"
+#include "ColTriangleBVH.h"
 
 CColModel::CColModel(void)
 {
@@ -17,6 +18,9 @@ CColModel::CColModel(void)
 	vertices = nil;
 	triangles = nil;
 	trianglePlanes = nil;
+#ifdef COLMODEL_TRIANGLE_BVH
+	triangleBVH = nil;
+#endif
 	level = LEVEL_GENERIC;	// generic col slot
 	ownsCollisionVolumes = true;
 }
@@ -50,6 +54,9 @@ CColModel::RemoveCollisionVolumes(void)
 		RwFree(vertices);
 		RwFree(triangles);
 		CCollision::RemoveTrianglePlanes(this);
+#ifdef COLMODEL_TRIANGLE_BVH
+		RwFree(triangleBVH);
+#endif
 	}
 	numSpheres = 0;
 	numLines = 0;
@@ -60,6 +67,9 @@ CColModel::RemoveCollisionVolumes(void)
 	boxes = nil;
 	vertices = nil;
 	triangles = nil;
+#ifdef COLMODEL_TRIANGLE_BVH
+	triangleBVH = nil;
+#endif
 }
 
 void
@@ -202,5 +212,11 @@ CColModel::operator=(const CColModel &other)
 			RwFree(vertices);
 		vertices = nil;
 	}
+
+#ifdef COLMODEL_TRIANGLE_BVH
+	if(triangleBVH)
+		RwFree(triangleBVH);
+	triangleBVH = other.triangleBVH ? CColTriangleBVH::Build(*this) : nil;
+#endif
 	return *this;
 }
@@ -23,6 +23,9 @@ struct CColModel
 	CompressedVector *vertices;
 	CColTriangle *triangles;
 	CColTrianglePlane *trianglePlanes;
+#ifdef COLMODEL_TRIANGLE_BVH
+	struct CColTriangleBVH *triangleBVH;
+#endif
 
 	CColModel(void);
 	~CColModel(void);
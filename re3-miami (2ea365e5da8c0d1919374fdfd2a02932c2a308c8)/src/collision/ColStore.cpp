@@ -13,11 +13,37 @@
 #include "ColStore.h"
 #include "VarConsole.h"
 #include "Pools.h"
+#ifdef HASHED_NAME_LOOKUP
+#include "NameIndex.h"
+#endif
+#ifdef ASYNC_COLLISION_STREAMING
+#include "World.h"
+#include "PlayerInfo.h"
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+#include "GroundCache.h"
+#endif
 
 CPool<ColDef,ColDef> *CColStore::ms_pColPool;
+#ifdef HASHED_NAME_LOOKUP
+static CNameIndex gColNameIndex;
+#endif
 #ifndef MASTER
 bool bDispColInMem;
 #endif
+#ifdef ASYNC_COLLISION_STREAMING
+#define HEIGHTFIELD_SIZE 16	// cells per side
+#define HEIGHTFIELD_NOGROUND (-1000.0f)
+
+bool CColStore::ms_bAsyncCollision = true;
+float CColStore::ms_fLookAheadTime = 2.0f;
+float CColStore::ms_fLookAheadRadius = 40.0f;
+
+// Ground heights at the cell corners, sampled once a slot has been in memory.
+// They stay valid when the slot is removed, buildings don't move.
+static float gaHeightFields[COLSTORESIZE][HEIGHTFIELD_SIZE+1][HEIGHTFIELD_SIZE+1];
+static bool gaHasHeightField[COLSTORESIZE];
+#endif
 
 void
 CColStore::Initialise(void)
@@ -55,6 +81,9 @@ CColStore::AddColSlot(const char *name)
 	def->minIndex = INT16_MAX;
 	def->maxIndex = INT16_MIN;
 	strcpy(def->name, name);
+#ifdef HASHED_NAME_LOOKUP
+	gColNameIndex.Add(def->name, ms_pColPool->GetJustIndex(def));
+#endif
 	return ms_pColPool->GetJustIndex(def);
 }
 
@@ -64,6 +93,9 @@ CColStore::RemoveColSlot(int slot)
 	if(GetSlot(slot)){
 		if(GetSlot(slot)->isLoaded)
 			RemoveCol(slot);
+#ifdef HASHED_NAME_LOOKUP
+		gColNameIndex.Remove(GetSlot(slot)->name, slot);
+#endif
 		ms_pColPool->Delete(GetSlot(slot));
 	}
 }
@@ -71,6 +103,9 @@ CColStore::RemoveColSlot(int slot)
 int
 CColStore::FindColSlot(const char *name)
 {
+#ifdef HASHED_NAME_LOOKUP
+	return gColNameIndex.Find(name);
+#else
 	ColDef *def;
 	int size = ms_pColPool->GetSize();
 	for(int i = 0; i < size; i++){
@@ -79,6 +114,7 @@ CColStore::FindColSlot(const char *name)
 			return i;
 	}
 	return -1;
+#endif
 }
 
 char*
@@ -112,18 +148,83 @@ CColStore::LoadCol(int32 slot, uint8 *buffer, int32 bufsize)
 		success = CFileLoader::LoadCollisionFileFirstTime(buffer, bufsize, slot);
 	else
 		success = CFileLoader::LoadCollisionFile(buffer, bufsize, slot);
-	if(success)
+	if(success){
 		def->isLoaded = true;
-	else
+#ifdef GROUND_HEIGHT_CACHE
+		CGroundCache::Invalidate(def->bounds);
+#endif
+	}else
 		debug("Failed to load Collision\n");
 	return success;
 }
 
+#ifdef ASYNC_STREAM_DECODE
+// Hands models decoded by CFileLoader::DecodeCollisionFile to their model infos,
+// the decoded models are left empty
+void
+CColStore::LoadDecodedCol(int32 slot, CDecodedColModel *models, int32 numModels)
+{
+	int i, modelIndex;
+	CBaseModelInfo *mi;
+	CColModel *col;
+	ColDef *def = GetSlot(slot);
+	bool firstTime = def->minIndex > def->maxIndex;
+
+	for(i = 0; i < numModels; i++){
+		CColModel &src = models[i].model;
+		if(firstTime){
+			mi = CModelInfo::GetModelInfo(models[i].name, &modelIndex);
+			if(mi)
+				IncludeModelIndex(slot, modelIndex);
+		}else
+			mi = CModelInfo::GetModelInfo(models[i].name, def->minIndex, def->maxIndex);
+		if(mi == nil){
+			debug("colmodel %s can't find a modelinfo\n", models[i].name);
+			continue;
+		}
+
+		col = firstTime ? nil : mi->GetColModel();
+		if(col == nil){
+			col = new CColModel;
+			col->level = slot;
+			mi->SetColModel(col, true);
+		}
+		col->boundingSphere = src.boundingSphere;
+		col->boundingBox = src.boundingBox;
+		col->numSpheres = src.numSpheres;
+		col->numLines = src.numLines;
+		col->numBoxes = src.numBoxes;
+		col->numTriangles = src.numTriangles;
+		col->spheres = src.spheres;
+		col->lines = src.lines;
+		col->boxes = src.boxes;
+		col->vertices = src.vertices;
+		col->triangles = src.triangles;
+#ifdef COLMODEL_TRIANGLE_BVH
+		col->triangleBVH = src.triangleBVH;
+		src.triangleBVH = nil;
+#endif
+		src.spheres = nil;
+		src.lines = nil;
+		src.boxes = nil;
+		src.vertices = nil;
+		src.triangles = nil;
+	}
+	def->isLoaded = true;
+#ifdef GROUND_HEIGHT_CACHE
+	CGroundCache::Invalidate(def->bounds);
+#endif
+}
+#endif
+
 void
 CColStore::RemoveCol(int32 slot)
 {
 	int id;
 	GetSlot(slot)->isLoaded = false;
+#ifdef GROUND_HEIGHT_CACHE
+	CGroundCache::Invalidate(GetBoundingBox(slot));
+#endif
 	for(id = 0; id < MODELINFOSIZE; id++){
 		CBaseModelInfo *mi = CModelInfo::GetModelInfo(id);
 		if(mi){
@@ -165,20 +266,51 @@ CColStore::AddCollisionNeededAtPosn(const CVector2D &pos)
 	secondPosition = pos;
 }
 
+#ifdef PREDICTIVE_STREAMING
+static bool
+IsPredictedPosnInside(int32 slot)
+{
+	int i;
+	for(i = 0; i < CStreaming::ms_numPredictedPositions; i++)
+		if(CColStore::GetBoundingBox(slot).IsPointInside(CStreaming::ms_aPredictedPositions[i]))
+			return true;
+	return false;
+}
+#endif
+
 void
 CColStore::LoadCollision(const CVector2D &pos)
 {
 	int i;
+#ifdef ASYNC_COLLISION_STREAMING
+	CVector2D ahead;
+	bool builtHeightField = false;
+#endif
 
 	if(CStreaming::ms_disableStreaming)
 		return;
 
+#ifdef ASYNC_COLLISION_STREAMING
+	// where the player is going to be, move speed is per 1/50 s
+	ahead = pos + CVector2D(FindPlayerSpeed()) * 50.0f * ms_fLookAheadTime;
+#endif
+
 	for(i = 1; i < COLSTORESIZE; i++){
 		if(GetSlot(i) == nil)
 			continue;
 
 		bool wantThisOne = false;
 
+#ifdef ASYNC_COLLISION_STREAMING
+		// one per frame, spreads the line tests out after a teleport
+		if(ms_bAsyncCollision && GetSlot(i)->isLoaded && !gaHasHeightField[i] && !builtHeightField){
+			BuildHeightField(i);
+			builtHeightField = true;
+		}
+		if(ms_bAsyncCollision && GetBoundingBox(i).IsPointInside(ahead, ms_fLookAheadRadius))
+			wantThisOne = true;
+		else
+#endif
 		if(GetBoundingBox(i).IsPointInside(pos) ||
 		   bLoadAtSecondPosition && GetBoundingBox(i).IsPointInside(secondPosition, -119.0f) ||
 		   strcmp(GetColName(i), "yacht") == 0){
@@ -206,6 +338,13 @@ CColStore::LoadCollision(const CVector2D &pos)
 
 		if(wantThisOne)
 			CStreaming::RequestCol(i, STREAMFLAGS_PRIORITY);
+#ifdef PREDICTIVE_STREAMING
+		else if(IsPredictedPosnInside(i)){
+			// needed in a few seconds, keep it or load it without holding anything else up
+			if(!CStreaming::HasColLoaded(i))
+				CStreaming::RequestCol(i, 0);
+		}
+#endif
 		else
 			CStreaming::RemoveCol(i);
 	}
@@ -233,6 +372,14 @@ CColStore::EnsureCollisionIsInMemory(const CVector2D &pos)
 	for(i = 1; i < COLSTORESIZE; i++)
 		if(GetSlot(i) && GetBoundingBox(i).IsPointInside(pos, -110.0f) &&
 		   !CStreaming::HasColLoaded(i)){
+#ifdef ASYNC_COLLISION_STREAMING
+			// Don't wait for it, KeepPhysicalsOnFallbackGround holds everything until it's there.
+			// Slots that were never loaded have no height field, those are still waited for.
+			if(ms_bAsyncCollision && gaHasHeightField[i]){
+				CStreaming::RequestCol(i, STREAMFLAGS_PRIORITY);
+				continue;
+			}
+#endif
 			CStreaming::RequestCol(i, 0);
 			if(TheCamera.GetScreenFadeStatus() == FADE_0)
 				FrontEndMenuManager.MessageScreen("LOADCOL", false);
@@ -253,3 +400,106 @@ CColStore::HasCollisionLoaded(const CVector2D &pos)
 			return false;
 	return true;
 }
+
+#ifdef ASYNC_COLLISION_STREAMING
+void
+CColStore::BuildHeightField(int32 slot)
+{
+	int x, y;
+	CRect &bounds = GetBoundingBox(slot);
+	CColPoint point;
+	CEntity *entity;
+	float stepX = (bounds.right - bounds.left)/HEIGHTFIELD_SIZE;
+	float stepY = (bounds.bottom - bounds.top)/HEIGHTFIELD_SIZE;
+
+	for(y = 0; y <= HEIGHTFIELD_SIZE; y++)
+		for(x = 0; x <= HEIGHTFIELD_SIZE; x++){
+			CVector p(bounds.left + x*stepX, bounds.top + y*stepY, 1000.0f);
+			if(CWorld::ProcessVerticalLine(p, -100.0f, point, entity, true, false, false, false, false, true, nil))
+				gaHeightFields[slot][y][x] = point.point.z;
+			else
+				gaHeightFields[slot][y][x] = HEIGHTFIELD_NOGROUND;
+		}
+	gaHasHeightField[slot] = true;
+}
+
+// Lowest corner of the height field cell at pos, so it's below the real ground rather
+// than above it. Fails if there's no height field yet or pos is under it (tunnels, bridges).
+bool
+CColStore::GetFallbackGroundZ(const CVector &pos, float &z)
+{
+	int i, x, y;
+	float h;
+
+	for(i = 1; i < COLSTORESIZE; i++){
+		if(GetSlot(i) == nil || !gaHasHeightField[i] || !GetBoundingBox(i).IsPointInside(pos))
+			continue;
+		CRect &bounds = GetBoundingBox(i);
+		x = (pos.x - bounds.left)/(bounds.right - bounds.left)*HEIGHTFIELD_SIZE;
+		y = (pos.y - bounds.top)/(bounds.bottom - bounds.top)*HEIGHTFIELD_SIZE;
+		x = clamp(x, 0, HEIGHTFIELD_SIZE-1);
+		y = clamp(y, 0, HEIGHTFIELD_SIZE-1);
+		h = Min(Min(gaHeightFields[i][y][x], gaHeightFields[i][y][x+1]),
+			Min(gaHeightFields[i][y+1][x], gaHeightFields[i][y+1][x+1]));
+		if(h == HEIGHTFIELD_NOGROUND || pos.z < h - 3.0f)
+			continue;
+		z = h;
+		return true;
+	}
+	return false;
+}
+
+// Stand-in for the collision EnsureCollisionIsInMemory used to wait for. Puts ent back on
+// the height field if it sank below it, without a height sample there nothing is changed.
+void
+CColStore::KeepOnFallbackGround(CPhysical *ent)
+{
+	float groundZ, bottom;
+
+	if(!ent->bUsesCollision || ent->GetIsStatic() || HasCollisionLoaded(ent->GetPosition()))
+		return;
+	if(!GetFallbackGroundZ(ent->GetPosition(), groundZ))
+		return;
+	bottom = ent->GetPosition().z + ent->GetColModel()->boundingBox.min.z;
+	if(bottom >= groundZ)
+		return;
+	ent->GetMatrix().GetPosition().z += groundZ - bottom;
+	ent->GetMatrix().UpdateRW();
+	ent->UpdateRwFrame();
+	ent->RemoveAndAdd();
+	if(ent->m_vecMoveSpeed.z < 0.0f)
+		ent->m_vecMoveSpeed.z = 0.0f;
+}
+
+// Everything that can fall, planes and helis can go below the field on purpose
+void
+CColStore::KeepPhysicalsOnFallbackGround(void)
+{
+	int i;
+
+	if(!ms_bAsyncCollision)
+		return;
+	// usually all collision around is in memory
+	for(i = 1; i < COLSTORESIZE; i++)
+		if(GetSlot(i) && !GetSlot(i)->isLoaded && gaHasHeightField[i])
+			break;
+	if(i == COLSTORESIZE)
+		return;
+
+	for(i = CPools::GetVehiclePool()->GetSize()-1; i >= 0; i--){
+		CVehicle *veh = CPools::GetVehiclePool()->GetSlot(i);
+		if(veh && !veh->IsPlane() && !veh->IsHeli())
+			KeepOnFallbackGround(veh);
+	}
+	for(i = CPools::GetPedPool()->GetSize()-1; i >= 0; i--){
+		CPed *ped = CPools::GetPedPool()->GetSlot(i);
+		if(ped && !ped->InVehicle())
+			KeepOnFallbackGround(ped);
+	}
+	for(i = CPools::GetObjectPool()->GetSize()-1; i >= 0; i--){
+		CObject *obj = CPools::GetObjectPool()->GetSlot(i);
+		if(obj)
+			KeepOnFallbackGround(obj);
+	}
+}
+#endif
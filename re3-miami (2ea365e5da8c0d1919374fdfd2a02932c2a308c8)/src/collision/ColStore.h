@@ -1,6 +1,19 @@
 #pragma once
 
 #include "templates.h"
+#ifdef ASYNC_STREAM_DECODE
+#include "ColModel.h"
+
+// Collision model decoded off the game thread, not yet attached to its model info
+struct CDecodedColModel {
+	char name[24];
+	CColModel model;
+};
+#endif
+
+#ifdef ASYNC_COLLISION_STREAMING
+class CPhysical;
+#endif
 
 struct ColDef {	// made up name
 	int32 unused;
@@ -25,6 +38,9 @@ public:
 	static CRect &GetBoundingBox(int32 slot);
 	static void IncludeModelIndex(int32 slot, int32 modelIndex);
 	static bool LoadCol(int32 storeID, uint8 *buffer, int32 bufsize);
+#ifdef ASYNC_STREAM_DECODE
+	static void LoadDecodedCol(int32 slot, CDecodedColModel *models, int32 numModels);
+#endif
 	static void RemoveCol(int32 slot);
 	static void AddCollisionNeededAtPosn(const CVector2D &pos);
 	static void LoadAllCollision(void);
@@ -33,6 +49,16 @@ public:
 	static void RequestCollision(const CVector2D &pos);
 	static void EnsureCollisionIsInMemory(const CVector2D &pos);
 	static bool HasCollisionLoaded(const CVector2D &pos);
+#ifdef ASYNC_COLLISION_STREAMING
+	static bool ms_bAsyncCollision;
+	static float ms_fLookAheadTime;	// also load what the player reaches within this many seconds
+	static float ms_fLookAheadRadius;
+
+	static void BuildHeightField(int32 slot);
+	static bool GetFallbackGroundZ(const CVector &pos, float &z);
+	static void KeepOnFallbackGround(CPhysical *ent);
+	static void KeepPhysicalsOnFallbackGround(void);
+#endif
 
 	static ColDef *GetSlot(int slot) {
 		assert(slot >= 0);
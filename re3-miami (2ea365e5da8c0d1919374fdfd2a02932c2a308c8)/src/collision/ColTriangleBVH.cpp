@@ -0,0 +1,263 @@
+#include "common.h"
+
+#ifdef COLMODEL_TRIANGLE_BVH
+#include "ColModel.h"
+#include "MemoryHeap.h"
+#include "ColTriangleBVH.h"
+
+#define COLBVH_LEAF_SIZE 4
+#define COLBVH_STACK_SIZE 64
+
+struct CColBVHBuildTriangle
+{
+	CVector min;
+	CVector max;
+	uint16 index;
+};
+
+struct CColBVHBuildState
+{
+	CColBVHBuildTriangle *tris;
+	CColTriangleBVHNode *nodes;
+	uint16 *indices;
+	int32 numNodes;
+};
+
+static float
+GetAxis(const CVector &v, int axis)
+{
+	return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static float
+GetCentre(const CColBVHBuildTriangle &tri, int axis)
+{
+	return GetAxis(tri.min, axis) + GetAxis(tri.max, axis);
+}
+
+static void
+GrowBox(CVector &min, CVector &max, const CVector &v)
+{
+	min.x = Min(min.x, v.x);
+	min.y = Min(min.y, v.y);
+	min.z = Min(min.z, v.z);
+	max.x = Max(max.x, v.x);
+	max.y = Max(max.y, v.y);
+	max.z = Max(max.z, v.z);
+}
+
+// does the line from p0 hit the box before the end of the line
+static bool
+LineHitsBox(const CVector &p0, const CVector &invDir, const CVector &min, const CVector &max)
+{
+	float t0 = 0.0f;
+	float t1 = 1.0f;
+	float lo, hi;
+
+	lo = (min.x - p0.x)*invDir.x;
+	hi = (max.x - p0.x)*invDir.x;
+	t0 = Max(t0, Min(lo, hi));
+	t1 = Min(t1, Max(lo, hi));
+	if(t0 > t1)
+		return false;
+
+	lo = (min.y - p0.y)*invDir.y;
+	hi = (max.y - p0.y)*invDir.y;
+	t0 = Max(t0, Min(lo, hi));
+	t1 = Min(t1, Max(lo, hi));
+	if(t0 > t1)
+		return false;
+
+	lo = (min.z - p0.z)*invDir.z;
+	hi = (max.z - p0.z)*invDir.z;
+	t0 = Max(t0, Min(lo, hi));
+	t1 = Min(t1, Max(lo, hi));
+	return t0 <= t1;
+}
+
+static bool
+SphereHitsBox(const CVector &center, float radius, const CVector &min, const CVector &max)
+{
+	return center.x + radius >= min.x && center.x - radius <= max.x &&
+		center.y + radius >= min.y && center.y - radius <= max.y &&
+		center.z + radius >= min.z && center.z - radius <= max.z;
+}
+
+// Quickselect, afterwards the nth triangle is in place along axis
+// and nothing before it has a larger centre
+static void
+SelectNth(CColBVHBuildTriangle *tris, int32 count, int32 nth, int axis)
+{
+	int32 lo = 0;
+	int32 hi = count-1;
+	while(lo < hi){
+		float pivot = GetCentre(tris[(lo+hi)/2], axis);
+		int32 i = lo;
+		int32 j = hi;
+		while(i <= j){
+			while(GetCentre(tris[i], axis) < pivot) i++;
+			while(GetCentre(tris[j], axis) > pivot) j--;
+			if(i <= j){
+				CColBVHBuildTriangle tmp = tris[i];
+				tris[i] = tris[j];
+				tris[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+		if(nth <= j)
+			hi = j;
+		else if(nth >= i)
+			lo = i;
+		else
+			break;
+	}
+}
+
+// same splits as BuildNode, so we know the size before allocating
+static int32
+CountNodes(int32 count)
+{
+	if(count <= COLBVH_LEAF_SIZE)
+		return 1;
+	return 1 + CountNodes(count/2) + CountNodes(count - count/2);
+}
+
+static void
+BuildNode(CColBVHBuildState &state, int32 node, int32 first, int32 count)
+{
+	int32 i, axis, half;
+	CVector centreMin, centreMax, size;
+	CColTriangleBVHNode *n = &state.nodes[node];
+	CColBVHBuildTriangle *tris = state.tris;
+
+	n->min = tris[first].min;
+	n->max = tris[first].max;
+	centreMin = centreMax = tris[first].min + tris[first].max;
+	for(i = first+1; i < first+count; i++){
+		GrowBox(n->min, n->max, tris[i].min);
+		GrowBox(n->min, n->max, tris[i].max);
+		GrowBox(centreMin, centreMax, tris[i].min + tris[i].max);
+	}
+
+	if(count <= COLBVH_LEAF_SIZE){
+		n->first = first;
+		n->count = count;
+		for(i = first; i < first+count; i++)
+			state.indices[i] = tris[i].index;
+		return;
+	}
+
+	// split at the median of the longest axis
+	size = centreMax - centreMin;
+	axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	half = count/2;
+	SelectNth(&tris[first], count, half, axis);
+
+	n->first = state.numNodes;
+	n->count = 0;
+	state.numNodes += 2;
+	BuildNode(state, n->first, first, half);
+	BuildNode(state, n->first+1, first+half, count-half);
+}
+
+// nil if the model is too small to be worth it
+CColTriangleBVH*
+CColTriangleBVH::Build(const CColModel &model)
+{
+	int32 i, numNodes;
+	CColTriangleBVH *bvh;
+	CColBVHBuildState state;
+
+	if(model.numTriangles < COLBVH_MINTRIANGLES)
+		return nil;
+
+	numNodes = CountNodes(model.numTriangles);
+	PUSH_MEMID(MEMID_COLLISION);
+	bvh = (CColTriangleBVH*)RwMalloc(sizeof(CColTriangleBVH) +
+		numNodes*sizeof(CColTriangleBVHNode) + model.numTriangles*sizeof(uint16));
+	POP_MEMID();
+	bvh->numNodes = numNodes;
+	bvh->numIndices = model.numTriangles;
+
+	state.tris = new CColBVHBuildTriangle[model.numTriangles];
+	state.nodes = bvh->GetNodes();
+	state.indices = bvh->GetIndices();
+	state.numNodes = 1;
+	for(i = 0; i < model.numTriangles; i++){
+		const CColTriangle &tri = model.triangles[i];
+		state.tris[i].min = state.tris[i].max = model.vertices[tri.a].Get();
+		GrowBox(state.tris[i].min, state.tris[i].max, model.vertices[tri.b].Get());
+		GrowBox(state.tris[i].min, state.tris[i].max, model.vertices[tri.c].Get());
+		state.tris[i].index = i;
+	}
+	BuildNode(state, 0, 0, model.numTriangles);
+	assert(state.numNodes == numNodes);
+	delete[] state.tris;
+	return bvh;
+}
+
+int32
+CColTriangleBVH::CollectLine(const CVector &p0, const CVector &p1, uint16 *tris, int32 maxTris) const
+{
+	int32 stack[COLBVH_STACK_SIZE];
+	int32 sp, i, n;
+	const CColTriangleBVHNode *nodes = GetNodes();
+	const uint16 *indices = GetIndices();
+
+	// avoid 0*inf in the slab test, a huge value does the same job
+	CVector dir = p1 - p0;
+	CVector invDir(dir.x != 0.0f ? 1.0f/dir.x : 1.0e30f,
+		dir.y != 0.0f ? 1.0f/dir.y : 1.0e30f,
+		dir.z != 0.0f ? 1.0f/dir.z : 1.0e30f);
+
+	n = 0;
+	sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0){
+		const CColTriangleBVHNode *node = &nodes[stack[--sp]];
+		if(!LineHitsBox(p0, invDir, node->min, node->max))
+			continue;
+		if(node->count == 0){
+			assert(sp+2 <= COLBVH_STACK_SIZE);
+			stack[sp++] = node->first+1;
+			stack[sp++] = node->first;
+			continue;
+		}
+		if(n + node->count > maxTris)
+			return -1;
+		for(i = 0; i < node->count; i++)
+			tris[n++] = indices[node->first + i];
+	}
+	return n;
+}
+
+int32
+CColTriangleBVH::CollectSphere(const CVector &center, float radius, uint16 *tris, int32 maxTris) const
+{
+	int32 stack[COLBVH_STACK_SIZE];
+	int32 sp, i, n;
+	const CColTriangleBVHNode *nodes = GetNodes();
+	const uint16 *indices = GetIndices();
+
+	n = 0;
+	sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0){
+		const CColTriangleBVHNode *node = &nodes[stack[--sp]];
+		if(!SphereHitsBox(center, radius, node->min, node->max))
+			continue;
+		if(node->count == 0){
+			assert(sp+2 <= COLBVH_STACK_SIZE);
+			stack[sp++] = node->first+1;
+			stack[sp++] = node->first;
+			continue;
+		}
+		if(n + node->count > maxTris)
+			return -1;
+		for(i = 0; i < node->count; i++)
+			tris[n++] = indices[node->first + i];
+	}
+	return n;
+}
+#endif
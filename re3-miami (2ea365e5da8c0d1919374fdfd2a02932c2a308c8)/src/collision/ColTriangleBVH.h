@@ -0,0 +1,36 @@
+#pragma once
+
+struct CColModel;
+
+#define COLBVH_MINTRIANGLES 32	// smaller meshes are cheaper to test linearly
+
+// Bounding volume hierarchy over the triangles of one col model, in model space.
+// Built once when the model is loaded and kept in a single allocation:
+// header, nodes, then the triangle indices the leaves point into.
+// Queries only collect candidate triangles whose box is touched,
+// the exact tests are still done by CCollision.
+
+struct CColTriangleBVHNode
+{
+	CVector min;
+	CVector max;
+	uint16 first;	// first child or first index
+	uint16 count;	// triangles in a leaf, 0 for inner nodes
+};
+
+struct CColTriangleBVH
+{
+	int32 numNodes;
+	int32 numIndices;
+
+	CColTriangleBVHNode *GetNodes(void) { return (CColTriangleBVHNode*)(this+1); }
+	const CColTriangleBVHNode *GetNodes(void) const { return (const CColTriangleBVHNode*)(this+1); }
+	uint16 *GetIndices(void) { return (uint16*)(GetNodes() + numNodes); }
+	const uint16 *GetIndices(void) const { return (const uint16*)(GetNodes() + numNodes); }
+
+	// these return the number of triangles written to tris or -1 if there are more than maxTris
+	int32 CollectLine(const CVector &p0, const CVector &p1, uint16 *tris, int32 maxTris) const;
+	int32 CollectSphere(const CVector &center, float radius, uint16 *tris, int32 maxTris) const;
+
+	static CColTriangleBVH *Build(const CColModel &model);
+};
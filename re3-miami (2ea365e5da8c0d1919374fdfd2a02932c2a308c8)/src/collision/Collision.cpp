@@ -23,6 +23,10 @@
 #include "Collision.h"
 #include "Camera.h"
 #include "ColStore.h"
+#include "Pools.h"
+#include "ColTriangleBVH.h"
+#include "CollisionSimd.h"
+#include "JobPool.h"
 
 #ifdef VU_COLLISION
 #include "VuCollision.h"
@@ -70,6 +74,13 @@ GetVUresult(CVuVector &point, CVuVector &normal, float &dist)
 
 eLevelName CCollision::ms_collisionInMemory;
 CLinkList<CColModel*> CCollision::ms_colModelCache;
+#ifdef COLMODEL_TRIANGLE_BVH
+bool CCollision::ms_bUseTriangleBVH = true;
+#endif
+#ifdef COLLISION_TRIANGLE_LISTS
+uint32 CCollision::ms_numTriangleQueries;
+uint32 CCollision::ms_numTrianglesTested;
+#endif
 
 void
 CCollision::Init(void)
@@ -586,7 +597,15 @@ CCollision::TestLineOfSight(const CColLine &line, const CMatrix &matrix, CColMod
 			return true;
 	}
 
+#ifdef SIMD_COLLISION
+	int32 boxMask = 0;
+#endif
 	for(i = 0; i < model.numBoxes; i++){
+#ifdef SIMD_COLLISION
+		if((i & 3) == 0)
+			boxMask = CCollisionSimd::LineBoxes4(newline, &model.boxes[i], Min(model.numBoxes - i, 4));
+		if(!(boxMask & 1<<(i&3))) continue;
+#endif
 		if(ignoreSeeThrough && IsSeeThrough(model.boxes[i].surface)) continue;
 		if(ignoreShootThrough && IsShootThrough(model.boxes[i].surface)) continue;
 		if(TestLineBox(newline, model.boxes[i]))
@@ -594,7 +613,15 @@ CCollision::TestLineOfSight(const CColLine &line, const CMatrix &matrix, CColMod
 	}
 
 	CalculateTrianglePlanes(&model);
+#ifdef COLLISION_TRIANGLE_LISTS
+	uint16 bvhTris[MAX_CANDIDATE_TRIANGLES];
+	int32 numTris;
+	const uint16 *tris = GetLineTriangles(model, newline, bvhTris, numTris);
+	for(int32 j = 0; j < numTris; j++){
+		i = tris ? tris[j] : j;
+#else
 	for(i = 0; i < model.numTriangles; i++){
+#endif
 		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
 		if(ignoreShootThrough && IsShootThrough(model.triangles[i].surface)) continue;
 		if(TestLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i]))
@@ -1442,14 +1469,30 @@ CCollision::ProcessLineOfSight(const CColLine &line,
 		ProcessLineSphere(newline, model.spheres[i], point, coldist);
 	}
 
+#ifdef SIMD_COLLISION
+	int32 boxMask = 0;
+#endif
 	for(i = 0; i < model.numBoxes; i++){
+#ifdef SIMD_COLLISION
+		if((i & 3) == 0)
+			boxMask = CCollisionSimd::LineBoxes4(newline, &model.boxes[i], Min(model.numBoxes - i, 4));
+		if(!(boxMask & 1<<(i&3))) continue;
+#endif
 		if(ignoreSeeThrough && IsSeeThrough(model.boxes[i].surface)) continue;
 		if(ignoreShootThrough && IsShootThrough(model.boxes[i].surface)) continue;
 		ProcessLineBox(newline, model.boxes[i], point, coldist);
 	}
 
 	CalculateTrianglePlanes(&model);
+#ifdef COLLISION_TRIANGLE_LISTS
+	uint16 bvhTris[MAX_CANDIDATE_TRIANGLES];
+	int32 numTris;
+	const uint16 *tris = GetLineTriangles(model, newline, bvhTris, numTris);
+	for(int32 j = 0; j < numTris; j++){
+		i = tris ? tris[j] : j;
+#else
 	for(i = 0; i < model.numTriangles; i++){
+#endif
 		if(ignoreSeeThrough && IsSeeThrough(model.triangles[i].surface)) continue;
 		if(ignoreShootThrough && IsShootThrough(model.triangles[i].surface)) continue;
 		ProcessLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i], point, coldist);
@@ -1606,14 +1649,30 @@ CCollision::ProcessVerticalLine(const CColLine &line,
 		ProcessLineSphere(newline, model.spheres[i], point, coldist);
 	}
 
+#ifdef SIMD_COLLISION
+	int32 boxMask = 0;
+#endif
 	for(i = 0; i < model.numBoxes; i++){
+#ifdef SIMD_COLLISION
+		if((i & 3) == 0)
+			boxMask = CCollisionSimd::LineBoxes4(newline, &model.boxes[i], Min(model.numBoxes - i, 4));
+		if(!(boxMask & 1<<(i&3))) continue;
+#endif
 		if(ignoreSeeThrough && IsSeeThroughVertical(model.boxes[i].surface)) continue;
 		ProcessLineBox(newline, model.boxes[i], point, coldist);
 	}
 
 	CalculateTrianglePlanes(&model);
 	TempStoredPoly.valid = false;
+#ifdef COLLISION_TRIANGLE_LISTS
+	uint16 bvhTris[MAX_CANDIDATE_TRIANGLES];
+	int32 numTris;
+	const uint16 *tris = GetLineTriangles(model, newline, bvhTris, numTris);
+	for(int32 j = 0; j < numTris; j++){
+		i = tris ? tris[j] : j;
+#else
 	for(i = 0; i < model.numTriangles; i++){
+#endif
 		if(ignoreSeeThrough && IsSeeThroughVertical(model.triangles[i].surface)) continue;
 		ProcessLineTriangle(newline, model.vertices, model.triangles[i], model.trianglePlanes[i], point, coldist, &TempStoredPoly);
 	}
@@ -1645,11 +1704,78 @@ enum {
 #ifdef GTA_PS2
 #define SPR(off) ((uint8*)(0x70000000 + (off)))
 #else
-static uint8 fakeSPR[16*1024];
+static JOBLOCAL uint8 fakeSPR[16*1024];
 #define SPR(off) ((uint8*)(fakeSPR + (off)))
 #endif
 #endif
 
+#ifdef ISLAND_WORLD_PROCESS
+// Models island jobs are testing against without the world lock, their planes must stay
+static CColModel *gapPinnedColModels[JOBPOOL_MAXTHREADS+1];
+
+static bool
+IsColModelPinned(CColModel *model)
+{
+	for(int i = 0; i < ARRAY_SIZE(gapPinnedColModels); i++)
+		if(gapPinnedColModels[i] == model)
+			return true;
+	return false;
+}
+
+static void
+PinColModel(CColModel *model)
+{
+	for(int i = 0; i < ARRAY_SIZE(gapPinnedColModels); i++)
+		if(gapPinnedColModels[i] == nil){
+			gapPinnedColModels[i] = model;
+			return;
+		}
+	assert(0 && "too many pinned col models");
+}
+
+static void
+UnpinColModel(CColModel *model)
+{
+	for(int i = 0; i < ARRAY_SIZE(gapPinnedColModels); i++)
+		if(gapPinnedColModels[i] == model){
+			gapPinnedColModels[i] = nil;
+			return;
+		}
+}
+
+// Island jobs (see CWorld::Process) hold the world lock everywhere but in the col model test.
+// B's planes are made and pinned first and A is tested from a copy, callers may
+// change a shared model under the lock (the wheel lines of vehicles) meanwhile.
+static JOBLOCAL bool gbColModelsUnlocked;
+
+static int32
+ProcessColModelsUnlocked(const CMatrix &matrixA, CColModel &modelA,
+	const CMatrix &matrixB, CColModel &modelB,
+	CColPoint *spherepoints, CColPoint *linepoints, float *linedists)
+{
+	CColModel copyA;
+	int32 n;
+
+	CCollision::CalculateTrianglePlanes(&modelB);
+	PinColModel(&modelB);
+	copyA.boundingSphere = modelA.boundingSphere;
+	copyA.boundingBox = modelA.boundingBox;
+	copyA.numSpheres = modelA.numSpheres;
+	copyA.spheres = modelA.spheres;
+	copyA.numLines = modelA.numLines;
+	copyA.lines = modelA.lines;
+	copyA.ownsCollisionVolumes = false;
+
+	gbColModelsUnlocked = true;
+	CJobPool::UnlockWorld();
+	n = CCollision::ProcessColModels(matrixA, copyA, matrixB, modelB, spherepoints, linepoints, linedists);
+	CJobPool::LockWorld();
+	gbColModelsUnlocked = false;
+	UnpinColModel(&modelB);
+	return n;
+}
+#endif
+
 // This checks model A's spheres and lines against model B's spheres, boxes and triangles.
 // Returns the number of A's spheres that collide.
 // Returned ColPoints are in world space.
@@ -1659,6 +1785,10 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 	const CMatrix &matrixB, CColModel &modelB,
 	CColPoint *spherepoints, CColPoint *linepoints, float *linedists)
 {
+#ifdef ISLAND_WORLD_PROCESS
+	if(CJobPool::HoldsWorldLock())
+		return ProcessColModelsUnlocked(matrixA, modelA, matrixB, modelB, spherepoints, linepoints, linedists);
+#endif
 #ifdef VU_COLLISION
 	CVuVector *aSpheresA = (CVuVector*)SPR(0x0000);
 	CVuVector *aSpheresB = (CVuVector*)SPR(0x0800);
@@ -1717,6 +1847,9 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 	for(i = 0; i < modelB.numBoxes; i++)
 		if(TestSphereBox(*(CColSphere*)&bsphereAB, modelB.boxes[i]))
 			aBoxIndicesB[numBoxesB++] = i;
+#ifdef ISLAND_WORLD_PROCESS
+	if(!gbColModelsUnlocked)	// done under the lock
+#endif
 	CalculateTrianglePlanes(&modelB);
 	if(modelB.numTriangles){
 		VuTriangle vutri;
@@ -1961,15 +2094,15 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 
 	return numCollisions;	// sphere collisions
 #else
-	static int aSphereIndicesA[MAXNUMSPHERES];
-	static int aLineIndicesA[MAXNUMLINES];
-	static int aSphereIndicesB[MAXNUMSPHERES];
-	static int aBoxIndicesB[MAXNUMBOXES];
-	static int aTriangleIndicesB[MAXNUMTRIS];
-	static bool aCollided[MAXNUMLINES];
-	static CColSphere aSpheresA[MAXNUMSPHERES];
-	static CColLine aLinesA[MAXNUMLINES];
-	static CMatrix matAB, matBA;
+	static JOBLOCAL int aSphereIndicesA[MAXNUMSPHERES];
+	static JOBLOCAL int aLineIndicesA[MAXNUMLINES];
+	static JOBLOCAL int aSphereIndicesB[MAXNUMSPHERES];
+	static JOBLOCAL int aBoxIndicesB[MAXNUMBOXES];
+	static JOBLOCAL int aTriangleIndicesB[MAXNUMTRIS];
+	static JOBLOCAL bool aCollided[MAXNUMLINES];
+	static JOBLOCAL CColSphere aSpheresA[MAXNUMSPHERES];
+	static JOBLOCAL CColLine aLinesA[MAXNUMLINES];
+	static JOBLOCAL CMatrix matAB, matBA;
 	CColSphere s;
 	int i, j;
 
@@ -2020,13 +2153,37 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 		if(TestSphereBox(s, modelA.boundingBox))
 			aSphereIndicesB[numSpheresB++] = i;
 	}
+#ifdef SIMD_COLLISION
+	int32 mask = 0;
+	for(i = 0; i < modelB.numBoxes; i++){
+		if((i & 3) == 0)
+			mask = CCollisionSimd::SphereBoxes4(bsphereAB, &modelB.boxes[i], Min(modelB.numBoxes - i, 4));
+		if((mask & 1<<(i&3)) && TestSphereBox(bsphereAB, modelB.boxes[i]))
+			aBoxIndicesB[numBoxesB++] = i;
+	}
+#else
 	for(i = 0; i < modelB.numBoxes; i++)
 		if(TestSphereBox(bsphereAB, modelB.boxes[i]))
 			aBoxIndicesB[numBoxesB++] = i;
+#endif
+#ifdef ISLAND_WORLD_PROCESS
+	if(!gbColModelsUnlocked)	// done under the lock
+#endif
 	CalculateTrianglePlanes(&modelB);
+#ifdef COLLISION_TRIANGLE_LISTS
+	static JOBLOCAL uint16 aBVHTrianglesB[MAX_CANDIDATE_TRIANGLES];
+	int32 numTris;
+	const uint16 *tris = GetSphereTriangles(modelB, bsphereAB, aBVHTrianglesB, numTris);
+	for(j = 0; j < numTris; j++){
+		i = tris ? tris[j] : j;
+		if(TestSphereTriangle(bsphereAB, modelB.vertices, modelB.triangles[i], modelB.trianglePlanes[i]))
+			aTriangleIndicesB[numTrianglesB++] = i;
+	}
+#else
 	for(i = 0; i < modelB.numTriangles; i++)
 		if(TestSphereTriangle(bsphereAB, modelB.vertices, modelB.triangles[i], modelB.trianglePlanes[i]))
 			aTriangleIndicesB[numTrianglesB++] = i;
+#endif
 	assert(numSpheresB <= MAXNUMSPHERES);
 	assert(numBoxesB <= MAXNUMBOXES);
 	assert(numTrianglesB <= MAXNUMTRIS);
@@ -2052,13 +2209,19 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 				aSpheresA[aSphereIndicesA[i]],
 				modelB.boxes[aBoxIndicesB[j]],
 				spherepoints[numCollisions], coldist);
-		for(j = 0; j < numTrianglesB; j++)
+		for(j = 0; j < numTrianglesB; j++){
+#ifdef SIMD_COLLISION
+			if((j & 3) == 0)
+				mask = CCollisionSimd::SphereTriangles4(aSpheresA[aSphereIndicesA[i]], modelB, &aTriangleIndicesB[j], Min(numTrianglesB - j, 4));
+			if(!(mask & 1<<(j&3))) continue;
+#endif
 			hasCollided |= ProcessSphereTriangle(
 				aSpheresA[aSphereIndicesA[i]],
 				modelB.vertices,
 				modelB.triangles[aTriangleIndicesB[j]],
 				modelB.trianglePlanes[aTriangleIndicesB[j]],
 				spherepoints[numCollisions], coldist);
+		}
 
 		if(hasCollided)
 			numCollisions++;
@@ -2084,7 +2247,12 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 				modelB.boxes[aBoxIndicesB[j]],
 				linepoints[aLineIndicesA[i]],
 				linedists[aLineIndicesA[i]]);
-		for(j = 0; j < numTrianglesB; j++)
+		for(j = 0; j < numTrianglesB; j++){
+#ifdef SIMD_COLLISION
+			if((j & 3) == 0)
+				mask = CCollisionSimd::LineTriangles4(aLinesA[aLineIndicesA[i]], modelB, &aTriangleIndicesB[j], Min(numTrianglesB - j, 4));
+			if(!(mask & 1<<(j&3))) continue;
+#endif
 			aCollided[i] |= ProcessLineTriangle(
 				aLinesA[aLineIndicesA[i]],
 				modelB.vertices,
@@ -2092,6 +2260,7 @@ CCollision::ProcessColModels(const CMatrix &matrixA, CColModel &modelA,
 				modelB.trianglePlanes[aTriangleIndicesB[j]],
 				linepoints[aLineIndicesA[i]],
 				linedists[aLineIndicesA[i]]);
+		}
 	}
 	for(i = 0; i < numLinesA; i++)
 		if(aCollided[i]){
@@ -2141,6 +2310,94 @@ CCollision::DistToLine(const CVector *l0, const CVector *l1, const CVector *poin
 	return (*point - closest).Magnitude();
 }
 
+#ifdef COLLISION_TRIANGLE_LISTS
+// Candidate triangles for a line in model space.
+// Returns nil if all of them have to be tested, numTris is set either way.
+const uint16*
+CCollision::GetLineTriangles(const CColModel &model, const CColLine &line, uint16 *buf, int32 &numTris)
+{
+	const uint16 *tris = nil;
+	numTris = model.numTriangles;
+#ifdef COLMODEL_TRIANGLE_BVH
+	if(ms_bUseTriangleBVH && model.triangleBVH){
+		int32 n = model.triangleBVH->CollectLine(line.p0, line.p1, buf, MAX_CANDIDATE_TRIANGLES);
+		if(n >= 0){
+			tris = buf;
+			numTris = n;
+		}
+	}
+#endif
+#ifdef SIMD_COLLISION
+	if(CCollisionSimd::ms_bEnabled){
+		int32 n = CCollisionSimd::FilterLineTriangles(line, model, tris, numTris, buf, MAX_CANDIDATE_TRIANGLES);
+		if(n >= 0){
+			tris = buf;
+			numTris = n;
+		}
+	}
+#endif
+	ms_numTriangleQueries++;
+	ms_numTrianglesTested += numTris;
+	return tris;
+}
+
+// trianglePlanes have to be calculated
+const uint16*
+CCollision::GetSphereTriangles(const CColModel &model, const CSphere &sphere, uint16 *buf, int32 &numTris)
+{
+	const uint16 *tris = nil;
+	numTris = model.numTriangles;
+#ifdef COLMODEL_TRIANGLE_BVH
+	if(ms_bUseTriangleBVH && model.triangleBVH){
+		int32 n = model.triangleBVH->CollectSphere(sphere.center, sphere.radius, buf, MAX_CANDIDATE_TRIANGLES);
+		if(n >= 0){
+			tris = buf;
+			numTris = n;
+		}
+	}
+#endif
+#ifdef SIMD_COLLISION
+	if(CCollisionSimd::ms_bEnabled){
+		int32 n = CCollisionSimd::FilterSphereTriangles(sphere, model, tris, numTris, buf, MAX_CANDIDATE_TRIANGLES);
+		if(n >= 0){
+			tris = buf;
+			numTris = n;
+		}
+	}
+#endif
+	ms_numTriangleQueries++;
+	ms_numTrianglesTested += numTris;
+	return tris;
+}
+
+void
+CCollision::PrintTriangleStats(void)
+{
+#ifdef COLMODEL_TRIANGLE_BVH
+	int32 i, numModels, numTris, numBVHs, size;
+
+	numModels = numTris = numBVHs = size = 0;
+	for(i = 0; i < CPools::GetColModelPool()->GetSize(); i++){
+		CColModel *col = CPools::GetColModelPool()->GetSlot(i);
+		if(col == nil)
+			continue;
+		numModels++;
+		numTris += col->numTriangles;
+		if(col->triangleBVH){
+			numBVHs++;
+			size += sizeof(CColTriangleBVH) + col->triangleBVH->numNodes*sizeof(CColTriangleBVHNode) +
+				col->triangleBVH->numIndices*sizeof(uint16);
+		}
+	}
+	debug("Triangle BVH: %d of %d col models, %d triangles, %d bytes\n", numBVHs, numModels, numTris, size);
+#endif
+	debug("Triangle lists: %u queries, %u triangles tested, %.1f per query\n", ms_numTriangleQueries, ms_numTrianglesTested,
+		ms_numTriangleQueries ? (float)ms_numTrianglesTested/ms_numTriangleQueries : 0.0f);
+	ms_numTriangleQueries = 0;
+	ms_numTrianglesTested = 0;
+}
+#endif
+
 void
 CCollision::CalculateTrianglePlanes(CColModel *model)
 {
@@ -2159,6 +2416,10 @@ CCollision::CalculateTrianglePlanes(CColModel *model)
 		if(lptr == nil){
 			// make room if we have to, remove last in list
 			lptr = ms_colModelCache.tail.prev;
+#ifdef ISLAND_WORLD_PROCESS
+			while(IsColModelPinned(lptr->item))
+				lptr = lptr->prev;
+#endif
 			assert(lptr);
 			assert(lptr->item);
 			lptr->item->RemoveTrianglePlanes();
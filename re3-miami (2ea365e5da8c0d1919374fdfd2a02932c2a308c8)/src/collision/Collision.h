@@ -23,6 +23,12 @@ struct CStoredCollPoly
 #define MAX_COLLISION_POINTS 32
 #endif
 
+// Triangle loops go through a list of candidates instead of all triangles
+#if defined(COLMODEL_TRIANGLE_BVH) || defined(SIMD_COLLISION)
+#define COLLISION_TRIANGLE_LISTS
+#define MAX_CANDIDATE_TRIANGLES 512	// more than this and the query falls back to all triangles
+#endif
+
 class CCollision
 {
 public:
@@ -40,6 +46,16 @@ public:
 
 	static void CalculateTrianglePlanes(CColModel *model);
 	static void RemoveTrianglePlanes(CColModel *model);
+#ifdef COLMODEL_TRIANGLE_BVH
+	static bool ms_bUseTriangleBVH;
+#endif
+#ifdef COLLISION_TRIANGLE_LISTS
+	static uint32 ms_numTriangleQueries;
+	static uint32 ms_numTrianglesTested;
+	static const uint16 *GetLineTriangles(const CColModel &model, const CColLine &line, uint16 *buf, int32 &numTris);
+	static const uint16 *GetSphereTriangles(const CColModel &model, const CSphere &sphere, uint16 *buf, int32 &numTris);
+	static void PrintTriangleStats(void);
+#endif
 
 	// all these return true if there's a collision
 	static bool TestSphereSphere(const CSphere &s1, const CSphere &s2);
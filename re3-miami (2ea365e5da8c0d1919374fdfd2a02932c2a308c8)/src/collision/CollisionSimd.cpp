@@ -0,0 +1,329 @@
+#include "common.h"
+
+#ifdef SIMD_COLLISION
+#include "General.h"
+#include "Pools.h"
+#include "Collision.h"
+#include "CollisionSimd.h"
+#include "Simd4.h"
+
+// slack on the conservative tests, so rounding never throws out a real hit
+#define COLSIMD_EPSILON 0.001f
+// lines closer than this (sine squared) to the triangle plane are left to the exact test
+#define COLSIMD_PARALLEL 1.0e-8f
+
+bool CCollisionSimd::ms_bEnabled = true;
+
+//
+// Vectors of four lanes, gathered from the AoS collision data
+//
+
+struct CVectorSoA4
+{
+	float x[4];
+	float y[4];
+	float z[4];
+
+	void Set(int32 i, const CVector &v) { x[i] = v.x; y[i] = v.y; z[i] = v.z; }
+};
+
+struct vvector
+{
+	vfloat x, y, z;
+
+	vvector(void) {}
+	vvector(const CVectorSoA4 &v) : x(Load(v.x)), y(Load(v.y)), z(Load(v.z)) {}
+	vvector(const CVector &v) : x(Splat(v.x)), y(Splat(v.y)), z(Splat(v.z)) {}
+	vvector(vfloat x, vfloat y, vfloat z) : x(x), y(y), z(z) {}
+};
+
+static inline vvector Sub(const vvector &a, const vvector &b) { return vvector(Sub(a.x, b.x), Sub(a.y, b.y), Sub(a.z, b.z)); }
+static inline vfloat Dot(const vvector &a, const vvector &b) { return Add(Add(Mul(a.x, b.x), Mul(a.y, b.y)), Mul(a.z, b.z)); }
+static inline vvector Cross(const vvector &a, const vvector &b)
+{
+	return vvector(Sub(Mul(a.y, b.z), Mul(a.z, b.y)),
+		Sub(Mul(a.z, b.x), Mul(a.x, b.z)),
+		Sub(Mul(a.x, b.y), Mul(a.y, b.x)));
+}
+
+// Unused lanes repeat the first triangle, their bits are masked off at the end
+static void
+GatherTriangles(const CColModel &model, const int32 *idx, int32 n, CVectorSoA4 &a, CVectorSoA4 &b, CVectorSoA4 &c)
+{
+	int32 i;
+	for(i = 0; i < 4; i++){
+		const CColTriangle &tri = model.triangles[idx[i < n ? i : 0]];
+		a.Set(i, model.vertices[tri.a].Get());
+		b.Set(i, model.vertices[tri.b].Get());
+		c.Set(i, model.vertices[tri.c].Get());
+	}
+}
+
+static void
+GatherBoxes(const CColBox *boxes, int32 n, CVectorSoA4 &min, CVectorSoA4 &max)
+{
+	int32 i;
+	for(i = 0; i < 4; i++){
+		const CColBox &box = boxes[i < n ? i : 0];
+		min.Set(i, box.min);
+		max.Set(i, box.max);
+	}
+}
+
+// Moeller-Trumbore with some slack on the barycentric coordinates and line parameter.
+// The exact test projects onto a plane instead, which gives the same answer up to rounding.
+int32
+CCollisionSimd::LineTriangles4(const CColLine &line, const CColModel &model, const int32 *idx, int32 n)
+{
+	int32 lanes = (1<<n) - 1;
+	if(!ms_bEnabled)
+		return lanes;
+
+	CVectorSoA4 sa, sb, sc;
+	GatherTriangles(model, idx, n, sa, sb, sc);
+	vvector a(sa);
+	vvector e1 = Sub(vvector(sb), a);
+	vvector e2 = Sub(vvector(sc), a);
+	vvector dir(line.p1 - line.p0);
+
+	vvector pvec = Cross(dir, e2);
+	vfloat det = Dot(e1, pvec);
+	vvector tvec = Sub(vvector(line.p0), a);
+	vvector qvec = Cross(tvec, e1);
+	vfloat inv = Div(Splat(1.0f), det);
+	vfloat u = Mul(Dot(tvec, pvec), inv);
+	vfloat v = Mul(Dot(dir, qvec), inv);
+	vfloat t = Mul(Dot(e2, qvec), inv);
+
+	vfloat lo = Splat(-COLSIMD_EPSILON);
+	vfloat hi = Splat(1.0f + COLSIMD_EPSILON);
+	vmask hit = And(And(CmpGe(u, lo), CmpGe(v, lo)), CmpLe(Add(u, v), hi));
+	hit = And(hit, And(CmpGe(t, lo), CmpLe(t, hi)));
+	// this also catches det == 0, where the division above is garbage
+	vmask parallel = CmpLe(Mul(det, det), Mul(Splat(COLSIMD_PARALLEL), Mul(Dot(pvec, pvec), Dot(e1, e1))));
+	return MoveMask(Or(hit, parallel)) & lanes;
+}
+
+// Plane distance like the exact test and the triangle's bounding box
+int32
+CCollisionSimd::SphereTriangles4(const CSphere &sphere, const CColModel &model, const int32 *idx, int32 n)
+{
+	int32 i;
+	int32 lanes = (1<<n) - 1;
+	if(!ms_bEnabled)
+		return lanes;
+
+	CVectorSoA4 sa, sb, sc, snormal;
+	float dist[4];
+	GatherTriangles(model, idx, n, sa, sb, sc);
+	for(i = 0; i < 4; i++){
+		const CColTrianglePlane &plane = model.trianglePlanes[idx[i < n ? i : 0]];
+		snormal.Set(i, plane.normal);
+		dist[i] = plane.dist;
+	}
+	vvector a(sa), b(sb), c(sc);
+	vvector center(sphere.center);
+	vfloat radius = Splat(sphere.radius + COLSIMD_EPSILON);
+
+	vfloat planedist = Sub(Dot(vvector(snormal), center), Load(dist));
+	vmask hit = CmpLe(VAbs(planedist), radius);
+	hit = And(hit, CmpGe(Add(center.x, radius), VMin(VMin(a.x, b.x), c.x)));
+	hit = And(hit, CmpLe(Sub(center.x, radius), VMax(VMax(a.x, b.x), c.x)));
+	hit = And(hit, CmpGe(Add(center.y, radius), VMin(VMin(a.y, b.y), c.y)));
+	hit = And(hit, CmpLe(Sub(center.y, radius), VMax(VMax(a.y, b.y), c.y)));
+	hit = And(hit, CmpGe(Add(center.z, radius), VMin(VMin(a.z, b.z), c.z)));
+	hit = And(hit, CmpLe(Sub(center.z, radius), VMax(VMax(a.z, b.z), c.z)));
+	return MoveMask(hit) & lanes;
+}
+
+// Slab test, the exact test only counts lines that cross a face
+int32
+CCollisionSimd::LineBoxes4(const CColLine &line, const CColBox *boxes, int32 n)
+{
+	int32 lanes = (1<<n) - 1;
+	if(!ms_bEnabled)
+		return lanes;
+
+	CVectorSoA4 smin, smax;
+	GatherBoxes(boxes, n, smin, smax);
+	vfloat eps = Splat(COLSIMD_EPSILON);
+	vvector p0(line.p0);
+	// avoid 0*inf in the slab test, a huge value does the same job
+	CVector dir = line.p1 - line.p0;
+	vvector invDir(CVector(dir.x != 0.0f ? 1.0f/dir.x : 1.0e30f,
+		dir.y != 0.0f ? 1.0f/dir.y : 1.0e30f,
+		dir.z != 0.0f ? 1.0f/dir.z : 1.0e30f));
+	vvector min(smin), max(smax);
+
+	vfloat t0 = Splat(0.0f);
+	vfloat t1 = Splat(1.0f);
+	vfloat lo, hi;
+	lo = Mul(Sub(Sub(min.x, eps), p0.x), invDir.x);
+	hi = Mul(Sub(Add(max.x, eps), p0.x), invDir.x);
+	t0 = VMax(t0, VMin(lo, hi));
+	t1 = VMin(t1, VMax(lo, hi));
+	lo = Mul(Sub(Sub(min.y, eps), p0.y), invDir.y);
+	hi = Mul(Sub(Add(max.y, eps), p0.y), invDir.y);
+	t0 = VMax(t0, VMin(lo, hi));
+	t1 = VMin(t1, VMax(lo, hi));
+	lo = Mul(Sub(Sub(min.z, eps), p0.z), invDir.z);
+	hi = Mul(Sub(Add(max.z, eps), p0.z), invDir.z);
+	t0 = VMax(t0, VMin(lo, hi));
+	t1 = VMin(t1, VMax(lo, hi));
+	return MoveMask(CmpLe(t0, t1)) & lanes;
+}
+
+// Same comparisons as CCollision::TestSphereBox, so this one is exact
+int32
+CCollisionSimd::SphereBoxes4(const CSphere &sphere, const CColBox *boxes, int32 n)
+{
+	int32 lanes = (1<<n) - 1;
+	if(!ms_bEnabled)
+		return lanes;
+
+	CVectorSoA4 smin, smax;
+	GatherBoxes(boxes, n, smin, smax);
+	vvector min(smin), max(smax);
+	vvector center(sphere.center);
+	vfloat radius = Splat(sphere.radius);
+
+	vmask hit = And(CmpGe(Add(center.x, radius), min.x), CmpLe(Sub(center.x, radius), max.x));
+	hit = And(hit, And(CmpGe(Add(center.y, radius), min.y), CmpLe(Sub(center.y, radius), max.y)));
+	hit = And(hit, And(CmpGe(Add(center.z, radius), min.z), CmpLe(Sub(center.z, radius), max.z)));
+	return MoveMask(hit) & lanes;
+}
+
+// out may be the same buffer as tris
+int32
+CCollisionSimd::FilterLineTriangles(const CColLine &line, const CColModel &model, const uint16 *tris, int32 count, uint16 *out, int32 maxOut)
+{
+	int32 i, j, k, n, mask;
+	int32 idx[4];
+
+	n = 0;
+	for(i = 0; i < count; i += 4){
+		k = Min(count - i, 4);
+		for(j = 0; j < k; j++)
+			idx[j] = tris ? tris[i+j] : i+j;
+		mask = LineTriangles4(line, model, idx, k);
+		for(j = 0; j < k; j++)
+			if(mask & 1<<j){
+				if(n == maxOut)
+					return -1;
+				out[n++] = idx[j];
+			}
+	}
+	return n;
+}
+
+int32
+CCollisionSimd::FilterSphereTriangles(const CSphere &sphere, const CColModel &model, const uint16 *tris, int32 count, uint16 *out, int32 maxOut)
+{
+	int32 i, j, k, n, mask;
+	int32 idx[4];
+
+	n = 0;
+	for(i = 0; i < count; i += 4){
+		k = Min(count - i, 4);
+		for(j = 0; j < k; j++)
+			idx[j] = tris ? tris[i+j] : i+j;
+		mask = SphereTriangles4(sphere, model, idx, k);
+		for(j = 0; j < k; j++)
+			if(mask & 1<<j){
+				if(n == maxOut)
+					return -1;
+				out[n++] = idx[j];
+			}
+	}
+	return n;
+}
+
+//
+// Debug
+//
+
+static void
+RandomPointInBox(CVector &v, const CBox &box, float border)
+{
+	v.x = CGeneral::GetRandomNumberInRange(box.min.x - border, box.max.x + border);
+	v.y = CGeneral::GetRandomNumberInRange(box.min.y - border, box.max.y + border);
+	v.z = CGeneral::GetRandomNumberInRange(box.min.z - border, box.max.z + border);
+}
+
+// Random lines and spheres through every loaded col model, anything the scalar
+// tests accept but the prefilters threw out is an error.
+void
+CCollisionSimd::CheckAgainstScalar(void)
+{
+	int32 i, j, k, q, n, mask;
+	int32 idx[4];
+	int32 numModels = 0, numErrors = 0;
+	int32 numTris = 0, numTrisPassed = 0, numBoxes = 0, numBoxesPassed = 0;
+	bool enabled = ms_bEnabled;
+	CColPoint point;
+	CColLine line;
+	CColSphere sphere;
+	float dist;
+
+	ms_bEnabled = true;
+	for(i = 0; i < CPools::GetColModelPool()->GetSize(); i++){
+		CColModel *col = CPools::GetColModelPool()->GetSlot(i);
+		if(col == nil || (col->numTriangles == 0 && col->numBoxes == 0))
+			continue;
+		numModels++;
+		CCollision::CalculateTrianglePlanes(col);
+		for(q = 0; q < 16; q++){
+			RandomPointInBox(line.p0, col->boundingBox, 2.0f);
+			RandomPointInBox(line.p1, col->boundingBox, 2.0f);
+			sphere.Set(CGeneral::GetRandomNumberInRange(0.1f, 2.0f), line.p0, 0, 0);
+
+			for(j = 0; j < col->numTriangles; j += 4){
+				n = Min(col->numTriangles - j, 4);
+				for(k = 0; k < n; k++)
+					idx[k] = j+k;
+				mask = LineTriangles4(line, *col, idx, n);
+				for(k = 0; k < n; k++){
+					numTris++;
+					if(mask & 1<<k)
+						numTrisPassed++;
+					else if(CCollision::TestLineTriangle(line, col->vertices, col->triangles[j+k], col->trianglePlanes[j+k]))
+						numErrors++;
+				}
+				mask = SphereTriangles4(sphere, *col, idx, n);
+				for(k = 0; k < n; k++){
+					numTris++;
+					if(mask & 1<<k)
+						numTrisPassed++;
+					else if(CCollision::TestSphereTriangle(sphere, col->vertices, col->triangles[j+k], col->trianglePlanes[j+k]))
+						numErrors++;
+				}
+			}
+
+			for(j = 0; j < col->numBoxes; j += 4){
+				n = Min(col->numBoxes - j, 4);
+				mask = LineBoxes4(line, &col->boxes[j], n);
+				for(k = 0; k < n; k++){
+					numBoxes++;
+					dist = 1.0f;
+					if(mask & 1<<k)
+						numBoxesPassed++;
+					else if(CCollision::ProcessLineBox(line, col->boxes[j+k], point, dist))
+						numErrors++;
+				}
+				mask = SphereBoxes4(sphere, &col->boxes[j], n);
+				for(k = 0; k < n; k++){
+					numBoxes++;
+					if(mask & 1<<k)
+						numBoxesPassed++;
+					if(!!(mask & 1<<k) != CCollision::TestSphereBox(sphere, col->boxes[j+k]))
+						numErrors++;
+				}
+			}
+		}
+	}
+	ms_bEnabled = enabled;
+
+	debug("SIMD collision: %d col models, %d of %d triangles and %d of %d boxes passed, %d errors\n",
+		numModels, numTrisPassed, numTris, numBoxesPassed, numBoxes, numErrors);
+}
+#endif
@@ -0,0 +1,30 @@
+#pragma once
+
+struct CColModel;
+struct CColLine;
+struct CColBox;
+struct CSphere;
+
+// Four-wide prefilters for the PC collision loops, SSE2 on x86 and NEON on ARM
+// with a plain C fallback. They only throw out triangles and boxes that can't
+// collide, everything left is still handed to the exact scalar tests in CCollision,
+// so results don't change. The masks have bit i set if element i may collide.
+
+class CCollisionSimd
+{
+public:
+	static bool ms_bEnabled;
+
+	// idx are triangle indices, trianglePlanes must be calculated for the sphere tests
+	static int32 LineTriangles4(const CColLine &line, const CColModel &model, const int32 *idx, int32 n);
+	static int32 SphereTriangles4(const CSphere &sphere, const CColModel &model, const int32 *idx, int32 n);
+	static int32 LineBoxes4(const CColLine &line, const CColBox *boxes, int32 n);
+	static int32 SphereBoxes4(const CSphere &sphere, const CColBox *boxes, int32 n);
+
+	// Filter a list of triangles (nil for all count of them) into out,
+	// returns the number left or -1 if there are more than maxOut
+	static int32 FilterLineTriangles(const CColLine &line, const CColModel &model, const uint16 *tris, int32 count, uint16 *out, int32 maxOut);
+	static int32 FilterSphereTriangles(const CSphere &sphere, const CColModel &model, const uint16 *tris, int32 count, uint16 *out, int32 maxOut);
+
+	static void CheckAgainstScalar(void);
+};
@@ -5,6 +5,12 @@
 #include "ModelIndices.h"
 #include "PathFind.h"
 #include "Stats.h"
+#ifdef GROUND_HEIGHT_CACHE
+#include "GroundCache.h"
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+#include "BuildingCulling.h"
+#endif
 
 CEntity *CBridge::pLiftRoad;
 CEntity *CBridge::pLiftPart;
@@ -104,6 +110,13 @@ void CBridge::Update()
 			pLiftRoad->GetMatrix().GetPosition().z = DefaultZLiftRoad + liftHeight;
 			pLiftRoad->GetMatrix().UpdateRW();
 			pLiftRoad->UpdateRwFrame();
+#ifdef GROUND_HEIGHT_CACHE
+			CGroundCache::InvalidateEntity(pLiftRoad);
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+			CBuildingCulling::RemoveBuilding(pLiftRoad);
+			CBuildingCulling::AddBuilding(pLiftRoad);
+#endif
 		}
 		pWeight->GetMatrix().GetPosition().z = DefaultZLiftWeight - liftHeight;
 		pWeight->GetMatrix().UpdateRW();
@@ -0,0 +1,469 @@
+#include "common.h"
+
+#ifdef STATIC_BUILDING_BVH
+#include "Entity.h"
+#include "World.h"
+#include "ModelInfo.h"
+#include "Collision.h"
+#include "BuildingBVH.h"
+
+#define BVH_LEAF_SIZE 4
+#define BVH_STACK_SIZE 64
+
+CBuildingBVHNode *CBuildingBVH::ms_pNodes;
+int32 CBuildingBVH::ms_numNodes;
+CBuildingBVHEntry *CBuildingBVH::ms_pEntries;
+int32 CBuildingBVH::ms_numEntries;
+CBuildingBVHEntry CBuildingBVH::ms_aExtraEntries[NUMBVHEXTRABUILDINGS];
+int32 CBuildingBVH::ms_numExtraEntries;
+bool CBuildingBVH::ms_bBuilt;
+bool CBuildingBVH::ms_bEnabled = true;
+
+static float
+GetAxis(const CVector &v, int axis)
+{
+	return axis == 0 ? v.x : axis == 1 ? v.y : v.z;
+}
+
+static float
+GetCentre(const CBuildingBVHEntry &entry, int axis)
+{
+	return GetAxis(entry.min, axis) + GetAxis(entry.max, axis);
+}
+
+static void
+GrowBox(CVector &min, CVector &max, const CVector &v)
+{
+	min.x = Min(min.x, v.x);
+	min.y = Min(min.y, v.y);
+	min.z = Min(min.z, v.z);
+	max.x = Max(max.x, v.x);
+	max.y = Max(max.y, v.y);
+	max.z = Max(max.z, v.z);
+}
+
+// world space box around the col model's box
+static void
+SetEntryBounds(CBuildingBVHEntry &entry, CEntity *e)
+{
+	int i;
+	CColModel *col = e->GetColModel();
+	const CVector &min = col->boundingBox.min;
+	const CVector &max = col->boundingBox.max;
+
+	entry.entity = e;
+	entry.min = entry.max = e->GetMatrix() * min;
+	for(i = 1; i < 8; i++)
+		GrowBox(entry.min, entry.max, e->GetMatrix() * CVector(i&1 ? max.x : min.x, i&2 ? max.y : min.y, i&4 ? max.z : min.z));
+}
+
+static CVector
+GetInverseDir(const CColLine &line)
+{
+	// avoid 0*inf in the slab test, a huge value does the same job
+	CVector dir = line.p1 - line.p0;
+	return CVector(dir.x != 0.0f ? 1.0f/dir.x : 1.0e30f,
+		dir.y != 0.0f ? 1.0f/dir.y : 1.0e30f,
+		dir.z != 0.0f ? 1.0f/dir.z : 1.0e30f);
+}
+
+// does the line from p0 hit the box before maxDist (a fraction of the line)
+static bool
+LineHitsBox(const CVector &p0, const CVector &invDir, const CVector &min, const CVector &max, float maxDist)
+{
+	float t0 = 0.0f;
+	float t1 = maxDist;
+	float lo, hi;
+
+	lo = (min.x - p0.x)*invDir.x;
+	hi = (max.x - p0.x)*invDir.x;
+	t0 = Max(t0, Min(lo, hi));
+	t1 = Min(t1, Max(lo, hi));
+	if(t0 > t1)
+		return false;
+
+	lo = (min.y - p0.y)*invDir.y;
+	hi = (max.y - p0.y)*invDir.y;
+	t0 = Max(t0, Min(lo, hi));
+	t1 = Min(t1, Max(lo, hi));
+	if(t0 > t1)
+		return false;
+
+	lo = (min.z - p0.z)*invDir.z;
+	hi = (max.z - p0.z)*invDir.z;
+	t0 = Max(t0, Min(lo, hi));
+	t1 = Min(t1, Max(lo, hi));
+	return t0 <= t1;
+}
+
+static bool
+SphereHitsBox(const CVector &centre, float radius, const CVector &min, const CVector &max)
+{
+	return centre.x + radius >= min.x && centre.x - radius <= max.x &&
+		centre.y + radius >= min.y && centre.y - radius <= max.y &&
+		centre.z + radius >= min.z && centre.z - radius <= max.z;
+}
+
+// Quickselect, afterwards the nth entry is in place along axis
+// and nothing before it has a larger centre
+static void
+SelectNth(CBuildingBVHEntry *entries, int32 count, int32 nth, int axis)
+{
+	int32 lo = 0;
+	int32 hi = count-1;
+	while(lo < hi){
+		float pivot = GetCentre(entries[(lo+hi)/2], axis);
+		int32 i = lo;
+		int32 j = hi;
+		while(i <= j){
+			while(GetCentre(entries[i], axis) < pivot) i++;
+			while(GetCentre(entries[j], axis) > pivot) j--;
+			if(i <= j){
+				CBuildingBVHEntry tmp = entries[i];
+				entries[i] = entries[j];
+				entries[j] = tmp;
+				i++;
+				j--;
+			}
+		}
+		if(nth <= j)
+			hi = j;
+		else if(nth >= i)
+			lo = i;
+		else
+			break;
+	}
+}
+
+void
+CBuildingBVH::BuildNode(int32 node, int32 first, int32 count)
+{
+	int32 i, axis, half;
+	CVector centreMin, centreMax, size;
+	CBuildingBVHNode *n = &ms_pNodes[node];
+
+	n->min = ms_pEntries[first].min;
+	n->max = ms_pEntries[first].max;
+	centreMin = centreMax = (ms_pEntries[first].min + ms_pEntries[first].max);
+	for(i = first+1; i < first+count; i++){
+		GrowBox(n->min, n->max, ms_pEntries[i].min);
+		GrowBox(n->min, n->max, ms_pEntries[i].max);
+		GrowBox(centreMin, centreMax, ms_pEntries[i].min + ms_pEntries[i].max);
+	}
+
+	if(count <= BVH_LEAF_SIZE){
+		n->first = first;
+		n->count = count;
+		return;
+	}
+
+	// split at the median of the longest axis
+	size = centreMax - centreMin;
+	axis = size.x > size.y ? (size.x > size.z ? 0 : 2) : (size.y > size.z ? 1 : 2);
+	half = count/2;
+	SelectNth(&ms_pEntries[first], count, half, axis);
+
+	n->first = ms_numNodes;
+	n->count = 0;
+	ms_numNodes += 2;
+	BuildNode(n->first, first, half);
+	BuildNode(n->first+1, first+half, count-half);
+}
+
+// Called when the level has been loaded, every building is in
+// exactly one ENTITYLIST_BUILDINGS list
+void
+CBuildingBVH::Build(void)
+{
+	int32 x, y, n;
+	CPtrNode *node;
+
+	Shutdown();
+
+	n = 0;
+	for(y = 0; y < NUMSECTORS_Y; y++)
+		for(x = 0; x < NUMSECTORS_X; x++)
+			for(node = CWorld::GetSector(x, y)->m_lists[ENTITYLIST_BUILDINGS].first; node; node = node->next)
+				n++;
+	if(n == 0)
+		return;
+
+	ms_pEntries = new CBuildingBVHEntry[n];
+	ms_pNodes = new CBuildingBVHNode[2*n];
+	n = 0;
+	for(y = 0; y < NUMSECTORS_Y; y++)
+		for(x = 0; x < NUMSECTORS_X; x++)
+			for(node = CWorld::GetSector(x, y)->m_lists[ENTITYLIST_BUILDINGS].first; node; node = node->next)
+				SetEntryBounds(ms_pEntries[n++], (CEntity*)node->item);
+	ms_numEntries = n;
+
+	ms_numNodes = 1;
+	BuildNode(0, 0, n);
+	ms_bBuilt = true;
+}
+
+void
+CBuildingBVH::Shutdown(void)
+{
+	delete[] ms_pNodes;
+	delete[] ms_pEntries;
+	ms_pNodes = nil;
+	ms_pEntries = nil;
+	ms_numNodes = 0;
+	ms_numEntries = 0;
+	ms_numExtraEntries = 0;
+	ms_bBuilt = false;
+}
+
+void
+CBuildingBVH::AddBuilding(CEntity *entity)
+{
+	if(!ms_bBuilt)
+		return;
+	if(ms_numExtraEntries == NUMBVHEXTRABUILDINGS){
+		// too much has changed, go back to the sector lists
+		debug("Building BVH: too many buildings added, disabled\n");
+		Shutdown();
+		return;
+	}
+	SetEntryBounds(ms_aExtraEntries[ms_numExtraEntries++], entity);
+}
+
+// true if the building was in the tree
+bool
+CBuildingBVH::RemoveBuilding(CEntity *entity)
+{
+	int32 i;
+
+	if(!ms_bBuilt)
+		return false;
+	for(i = 0; i < ms_numExtraEntries; i++)
+		if(ms_aExtraEntries[i].entity == entity){
+			ms_aExtraEntries[i] = ms_aExtraEntries[--ms_numExtraEntries];
+			return true;
+		}
+	for(i = 0; i < ms_numEntries; i++)
+		if(ms_pEntries[i].entity == entity){
+			ms_pEntries[i].entity = nil;
+			return true;
+		}
+	return false;
+}
+
+static bool
+ProcessEntryLineOfSight(const CBuildingBVHEntry &entry, const CColLine &line, const CVector &invDir, CColPoint &point,
+                        float &mindist, bool ignoreSeeThrough, bool ignoreShootThrough)
+{
+	CEntity *e = entry.entity;
+	if(e == nil || !LineHitsBox(line.p0, invDir, entry.min, entry.max, mindist) ||
+	   e == CWorld::pIgnoreEntity || !e->bUsesCollision)
+		return false;
+	return CCollision::ProcessLineOfSight(line, e->GetMatrix(), *e->GetColModel(), point, mindist,
+	                                      ignoreSeeThrough, ignoreShootThrough);
+}
+
+bool
+CBuildingBVH::ProcessLineOfSight(const CColLine &line, CColPoint &point, float &dist, CEntity *&entity,
+                                 bool ignoreSeeThrough, bool ignoreShootThrough)
+{
+	int32 stack[BVH_STACK_SIZE];
+	int32 sp, i;
+	float mindist = dist;
+	CVector invDir = GetInverseDir(line);
+
+	sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0){
+		CBuildingBVHNode *n = &ms_pNodes[stack[--sp]];
+		if(!LineHitsBox(line.p0, invDir, n->min, n->max, mindist))
+			continue;
+		if(n->count == 0){
+			assert(sp+2 <= BVH_STACK_SIZE);
+			stack[sp++] = n->first;
+			stack[sp++] = n->first+1;
+			continue;
+		}
+		for(i = n->first; i < n->first + n->count; i++)
+			if(ProcessEntryLineOfSight(ms_pEntries[i], line, invDir, point, mindist, ignoreSeeThrough, ignoreShootThrough))
+				entity = ms_pEntries[i].entity;
+	}
+	for(i = 0; i < ms_numExtraEntries; i++)
+		if(ProcessEntryLineOfSight(ms_aExtraEntries[i], line, invDir, point, mindist, ignoreSeeThrough, ignoreShootThrough))
+			entity = ms_aExtraEntries[i].entity;
+
+	if(mindist < dist){
+		dist = mindist;
+		return true;
+	}else
+		return false;
+}
+
+static bool
+ProcessEntryVerticalLine(const CBuildingBVHEntry &entry, const CColLine &line, const CVector &invDir, CColPoint &point,
+                         float &mindist, bool ignoreSeeThrough, CStoredCollPoly *poly)
+{
+	CEntity *e = entry.entity;
+	if(e == nil || !LineHitsBox(line.p0, invDir, entry.min, entry.max, mindist) ||
+	   !e->bUsesCollision)
+		return false;
+	return CCollision::ProcessVerticalLine(line, e->GetMatrix(), *e->GetColModel(), point, mindist,
+	                                       ignoreSeeThrough, false, poly);
+}
+
+bool
+CBuildingBVH::ProcessVerticalLine(const CColLine &line, CColPoint &point, float &dist, CEntity *&entity,
+                                  bool ignoreSeeThrough, CStoredCollPoly *poly)
+{
+	int32 stack[BVH_STACK_SIZE];
+	int32 sp, i;
+	float mindist = dist;
+	CVector invDir = GetInverseDir(line);
+
+	sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0){
+		CBuildingBVHNode *n = &ms_pNodes[stack[--sp]];
+		if(!LineHitsBox(line.p0, invDir, n->min, n->max, mindist))
+			continue;
+		if(n->count == 0){
+			assert(sp+2 <= BVH_STACK_SIZE);
+			stack[sp++] = n->first;
+			stack[sp++] = n->first+1;
+			continue;
+		}
+		for(i = n->first; i < n->first + n->count; i++)
+			if(ProcessEntryVerticalLine(ms_pEntries[i], line, invDir, point, mindist, ignoreSeeThrough, poly))
+				entity = ms_pEntries[i].entity;
+	}
+	for(i = 0; i < ms_numExtraEntries; i++)
+		if(ProcessEntryVerticalLine(ms_aExtraEntries[i], line, invDir, point, mindist, ignoreSeeThrough, poly))
+			entity = ms_aExtraEntries[i].entity;
+
+	if(mindist < dist){
+		dist = mindist;
+		return true;
+	}else
+		return false;
+}
+
+static bool
+EntryBlocksLine(const CBuildingBVHEntry &entry, const CColLine &line, const CVector &invDir, bool ignoreSeeThrough)
+{
+	CEntity *e = entry.entity;
+	if(e == nil || !LineHitsBox(line.p0, invDir, entry.min, entry.max, 1.0f) ||
+	   e == CWorld::pIgnoreEntity || !e->bUsesCollision)
+		return false;
+	return CCollision::TestLineOfSight(line, e->GetMatrix(), *e->GetColModel(), ignoreSeeThrough, false);
+}
+
+bool
+CBuildingBVH::GetIsLineOfSightClear(const CColLine &line, bool ignoreSeeThrough)
+{
+	int32 stack[BVH_STACK_SIZE];
+	int32 sp, i;
+	CVector invDir = GetInverseDir(line);
+
+	sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0){
+		CBuildingBVHNode *n = &ms_pNodes[stack[--sp]];
+		if(!LineHitsBox(line.p0, invDir, n->min, n->max, 1.0f))
+			continue;
+		if(n->count == 0){
+			assert(sp+2 <= BVH_STACK_SIZE);
+			stack[sp++] = n->first;
+			stack[sp++] = n->first+1;
+			continue;
+		}
+		for(i = n->first; i < n->first + n->count; i++)
+			if(EntryBlocksLine(ms_pEntries[i], line, invDir, ignoreSeeThrough))
+				return false;
+	}
+	for(i = 0; i < ms_numExtraEntries; i++)
+		if(EntryBlocksLine(ms_aExtraEntries[i], line, invDir, ignoreSeeThrough))
+			return false;
+	return true;
+}
+
+// Same test as CWorld::TestSphereAgainstSectorList does for buildings
+static bool
+EntryHitsSphere(const CBuildingBVHEntry &entry, const CVector &centre, float radius, CEntity *entityToIgnore,
+                const CMatrix &sphereMat, CColModel &sphereCol)
+{
+	CEntity *e = entry.entity;
+	if(e == nil || !SphereHitsBox(centre, radius, entry.min, entry.max) ||
+	   e == entityToIgnore || !e->bUsesCollision)
+		return false;
+	if((centre - e->GetBoundCentre()).Magnitude() >= e->GetBoundRadius() + radius)
+		return false;
+	return CCollision::ProcessColModels(sphereMat, sphereCol, e->GetMatrix(), *e->GetColModel(),
+	                                    gaTempSphereColPoints, nil, nil) != 0;
+}
+
+CEntity*
+CBuildingBVH::TestSphere(const CVector &centre, float radius, CEntity *entityToIgnore)
+{
+	static CColModel sphereCol;
+	CColSphere sphere;
+	CMatrix sphereMat;
+	int32 stack[BVH_STACK_SIZE];
+	int32 sp, i;
+	CEntity *found = nil;
+
+	sphereCol.boundingSphere.Set(radius, CVector(0.0f, 0.0f, 0.0f));
+	sphereCol.boundingBox.Set(CVector(-radius, -radius, -radius), CVector(radius, radius, radius));
+	sphere.Set(radius, CVector(0.0f, 0.0f, 0.0f));
+	sphereCol.numSpheres = 1;
+	sphereCol.spheres = &sphere;
+	sphereCol.numLines = 0;
+	sphereCol.numBoxes = 0;
+	sphereCol.numTriangles = 0;
+	sphereCol.ownsCollisionVolumes = false;
+	sphereMat.SetTranslate(centre);
+
+	sp = 0;
+	stack[sp++] = 0;
+	while(sp > 0 && found == nil){
+		CBuildingBVHNode *n = &ms_pNodes[stack[--sp]];
+		if(!SphereHitsBox(centre, radius, n->min, n->max))
+			continue;
+		if(n->count == 0){
+			assert(sp+2 <= BVH_STACK_SIZE);
+			stack[sp++] = n->first;
+			stack[sp++] = n->first+1;
+			continue;
+		}
+		for(i = n->first; i < n->first + n->count; i++)
+			if(EntryHitsSphere(ms_pEntries[i], centre, radius, entityToIgnore, sphereMat, sphereCol)){
+				found = ms_pEntries[i].entity;
+				break;
+			}
+	}
+	for(i = 0; i < ms_numExtraEntries && found == nil; i++)
+		if(EntryHitsSphere(ms_aExtraEntries[i], centre, radius, entityToIgnore, sphereMat, sphereCol))
+			found = ms_aExtraEntries[i].entity;
+	sphereCol.spheres = nil;
+	return found;
+}
+
+void
+CBuildingBVH::PrintStats(void)
+{
+	int32 i, numLeaves, numRemoved;
+
+	if(!ms_bBuilt){
+		debug("Building BVH: not built\n");
+		return;
+	}
+	numLeaves = 0;
+	for(i = 0; i < ms_numNodes; i++)
+		if(ms_pNodes[i].count)
+			numLeaves++;
+	numRemoved = 0;
+	for(i = 0; i < ms_numEntries; i++)
+		if(ms_pEntries[i].entity == nil)
+			numRemoved++;
+	debug("Building BVH: %d buildings, %d nodes, %d leaves, %d removed, %d added\n",
+		ms_numEntries, ms_numNodes, numLeaves, numRemoved, ms_numExtraEntries);
+}
+#endif
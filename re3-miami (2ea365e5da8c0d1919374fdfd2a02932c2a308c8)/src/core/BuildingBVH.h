@@ -0,0 +1,57 @@
+#pragma once
+
+class CEntity;
+struct CColLine;
+struct CColPoint;
+struct CStoredCollPoly;
+
+#define NUMBVHEXTRABUILDINGS 64
+
+// Bounding volume hierarchy over the buildings in the sector lists, built once
+// the level is loaded. Long lines only visit the few boxes they pass through
+// instead of every building in every sector on the way.
+// Buildings added later go to a short list that is tested linearly,
+// removed buildings are cleared from their leaf.
+
+struct CBuildingBVHNode
+{
+	CVector min;
+	int32 first;	// first child or first entry
+	CVector max;
+	int32 count;	// entries in a leaf, 0 for inner nodes
+};
+
+struct CBuildingBVHEntry
+{
+	CEntity *entity;	// nil if removed
+	CVector min;
+	CVector max;
+};
+
+class CBuildingBVH
+{
+	static CBuildingBVHNode *ms_pNodes;
+	static int32 ms_numNodes;
+	static CBuildingBVHEntry *ms_pEntries;
+	static int32 ms_numEntries;
+	static CBuildingBVHEntry ms_aExtraEntries[NUMBVHEXTRABUILDINGS];
+	static int32 ms_numExtraEntries;
+	static bool ms_bBuilt;
+
+	static void BuildNode(int32 node, int32 first, int32 count);
+public:
+	static bool ms_bEnabled;
+
+	static void Build(void);
+	static void Shutdown(void);
+	static bool IsUsable(void) { return ms_bEnabled && ms_bBuilt; }
+	static void AddBuilding(CEntity *entity);
+	static bool RemoveBuilding(CEntity *entity);
+
+	static bool ProcessLineOfSight(const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, bool ignoreShootThrough);
+	static bool ProcessVerticalLine(const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly);
+	static bool GetIsLineOfSightClear(const CColLine &line, bool ignoreSeeThrough);
+	static CEntity *TestSphere(const CVector &centre, float radius, CEntity *entityToIgnore);
+
+	static void PrintStats(void);
+};
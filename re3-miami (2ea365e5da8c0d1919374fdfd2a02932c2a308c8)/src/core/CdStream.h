@@ -42,6 +42,15 @@ bool CdStreamAddImage(char const *path);
 char *CdStreamGetImageName(int32 cd);
 void CdStreamRemoveImages(void);
 int32 CdStreamGetNumImages(void);
+#ifdef BATCHED_CDSTREAM
+void CdStreamPrintStats(void);
+#endif
+#ifdef MAPPED_IMG
+void CdStreamMapImage(int32 cd, int32 fd);
+void CdStreamUnmapImages(void);
+void *CdStreamGetMappedData(uint32 offset, uint32 size);
+void CdStreamPrefetch(uint32 offset, uint32 size);
+#endif
 
 #ifdef FLUSHABLE_STREAMING
 extern bool flushStream[MAX_CDCHANNELS];
@@ -0,0 +1,674 @@
+#ifndef _WIN32
+#include "common.h"
+
+#ifdef BATCHED_CDSTREAM
+#include "crossplatform.h"
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/uio.h>
+
+#if defined __linux__ && defined __has_include
+#if __has_include(<linux/io_uring.h>)
+#define CDSTREAM_IO_URING
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+#endif
+
+#include "CdStream.h"
+#include "rwcore.h"
+#include "MemoryMgr.h"
+
+// Alternative to CdStreamPosix.cpp. Every channel read is split into a few segments
+// which are all handed to the kernel at once, through io_uring if we have it and
+// a small pool of preadv threads otherwise. All channels can be in flight at the same time.
+// CStreaming itself only ever drives two of them: it double buffers, processing one
+// channel's files while the other reads, and picks each read as the run of files that
+// follows the previous one on disc. A third channel would only wait for a buffer, so
+// the queue depth comes from the segments instead (up to 16 reads in flight).
+
+#define CDDEBUG(f, ...)   debug ("%s: " f "\n", "cdvd_stream", ## __VA_ARGS__)
+#define CDTRACE(f, ...)   printf("%s: " f "\n", "cdvd_stream", ## __VA_ARGS__)
+
+#define CDSTREAM_MAX_SEGMENTS 8		// per channel read
+#define CDSTREAM_MIN_SEGMENT_SIZE 32	// sectors
+#define CDSTREAM_NUM_READ_THREADS 4	// preadv fallback
+#define CDSTREAM_NUM_SEGMENTS (MAX_CDCHANNELS*CDSTREAM_MAX_SEGMENTS)
+
+#ifdef FLUSHABLE_STREAMING
+bool flushStream[MAX_CDCHANNELS];
+#endif
+
+struct CdReadInfo
+{
+	uint32 nSectorOffset;
+	uint32 nSectorsToRead;
+	void *pBuffer;
+	int32 hFile;
+	int32 nStatus;
+	int32 nPendingSegments;
+	bool bReading;
+	bool bFailed;
+	uint64 nStartTime;	// microseconds
+	pthread_cond_t doneCond;	// used for CdStreamSync
+};
+
+struct CdSegment
+{
+	int32 channel;
+	int32 hFile;
+	off_t offset;
+	struct iovec iov;
+};
+
+struct CdStreamStats
+{
+	uint32 numReads;
+	uint32 numSegments;
+	uint64 numBytes;
+	uint64 totalLatency;	// microseconds
+	uint32 maxLatency;
+	uint32 lastLatency[MAX_CDCHANNELS];
+};
+
+char gCdImageNames[MAX_CDIMAGES+1][64];
+int32 gNumImages;
+int32 gNumChannels;
+
+int32 gImgFiles[MAX_CDIMAGES]; // -1: error 0:unused otherwise: fd
+char *gImgNames[MAX_CDIMAGES];
+
+CdReadInfo *gpReadInfo;
+CdSegment gCdSegments[CDSTREAM_NUM_SEGMENTS];
+CdStreamStats gCdStreamStats;
+
+pthread_mutex_t gCdStreamMutex = PTHREAD_MUTEX_INITIALIZER;
+pthread_t gCdStreamThreads[CDSTREAM_NUM_READ_THREADS];
+int32 gNumCdStreamThreads;
+bool gbCdStreamShutdown;
+
+int32 lastPosnRead;
+
+int _gdwCdStreamFlags;
+
+static uint64
+GetTimeInMicroseconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64)ts.tv_sec*1000000 + ts.tv_nsec/1000;
+}
+
+// A read can return less than was asked for, move the segment on past what arrived.
+// Returns true if there is more to read, reading nothing at all is an error.
+static bool
+CdSegmentAdvance(CdSegment *pSegment, ssize_t result)
+{
+	if(result <= 0 || (size_t)result >= pSegment->iov.iov_len)
+		return false;
+	pSegment->iov.iov_base = (uint8*)pSegment->iov.iov_base + result;
+	pSegment->iov.iov_len -= result;
+	pSegment->offset += result;
+	return true;
+}
+
+// Called with gCdStreamMutex held
+static void
+CdStreamSegmentDone(int32 segment, bool bFailed)
+{
+	CdSegment *pSegment = &gCdSegments[segment];
+	CdReadInfo *pChannel = &gpReadInfo[pSegment->channel];
+
+	if(bFailed)
+		pChannel->bFailed = true;
+	pSegment->channel = -1;
+
+	if(--pChannel->nPendingSegments > 0)
+		return;
+
+	uint32 latency = GetTimeInMicroseconds() - pChannel->nStartTime;
+	gCdStreamStats.numReads++;
+	gCdStreamStats.numBytes += pChannel->nSectorsToRead * CDSTREAM_SECTOR_SIZE;
+	gCdStreamStats.totalLatency += latency;
+	gCdStreamStats.maxLatency = Max(gCdStreamStats.maxLatency, latency);
+	gCdStreamStats.lastLatency[pChannel - gpReadInfo] = latency;
+
+	pChannel->nStatus = pChannel->bFailed ? STREAM_ERROR : STREAM_NONE;
+	pChannel->nSectorsToRead = 0;
+	pChannel->bReading = false;
+	pthread_cond_broadcast(&pChannel->doneCond);
+}
+
+#ifdef CDSTREAM_IO_URING
+#define CDSTREAM_URING_ENTRIES 64
+#define CDSTREAM_URING_WAKEUP (~(uint64)0)
+
+struct CdUring
+{
+	int fd;
+	void *sqRing;
+	void *cqRing;
+	size_t sqRingSize;
+	size_t cqRingSize;
+	struct io_uring_sqe *sqes;
+	unsigned *sqHead, *sqTail, *sqMask, *sqArray;
+	unsigned *cqHead, *cqTail, *cqMask;
+	struct io_uring_cqe *cqes;
+};
+
+CdUring gCdUring = { -1 };
+
+static bool
+CdUringInit(void)
+{
+	struct io_uring_params params;
+	memset(&params, 0, sizeof(params));
+	gCdUring.fd = syscall(__NR_io_uring_setup, CDSTREAM_URING_ENTRIES, &params);
+	if(gCdUring.fd < 0)
+		return false;
+
+	gCdUring.sqRingSize = params.sq_off.array + params.sq_entries*sizeof(unsigned);
+	gCdUring.cqRingSize = params.cq_off.cqes + params.cq_entries*sizeof(struct io_uring_cqe);
+	gCdUring.sqRing = mmap(nil, gCdUring.sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, gCdUring.fd, IORING_OFF_SQ_RING);
+	gCdUring.cqRing = mmap(nil, gCdUring.cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, gCdUring.fd, IORING_OFF_CQ_RING);
+	gCdUring.sqes = (struct io_uring_sqe*)mmap(nil, params.sq_entries*sizeof(struct io_uring_sqe), PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, gCdUring.fd, IORING_OFF_SQES);
+	if(gCdUring.sqRing == MAP_FAILED || gCdUring.cqRing == MAP_FAILED || gCdUring.sqes == MAP_FAILED){
+		close(gCdUring.fd);
+		gCdUring.fd = -1;
+		return false;
+	}
+
+	uint8 *sq = (uint8*)gCdUring.sqRing;
+	uint8 *cq = (uint8*)gCdUring.cqRing;
+	gCdUring.sqHead = (unsigned*)(sq + params.sq_off.head);
+	gCdUring.sqTail = (unsigned*)(sq + params.sq_off.tail);
+	gCdUring.sqMask = (unsigned*)(sq + params.sq_off.ring_mask);
+	gCdUring.sqArray = (unsigned*)(sq + params.sq_off.array);
+	gCdUring.cqHead = (unsigned*)(cq + params.cq_off.head);
+	gCdUring.cqTail = (unsigned*)(cq + params.cq_off.tail);
+	gCdUring.cqMask = (unsigned*)(cq + params.cq_off.ring_mask);
+	gCdUring.cqes = (struct io_uring_cqe*)(cq + params.cq_off.cqes);
+	return true;
+}
+
+// Called with gCdStreamMutex held, submitted with CdUringSubmit
+static void
+CdUringQueue(uint8 opcode, int32 segment)
+{
+	unsigned tail = *gCdUring.sqTail;
+	unsigned index = tail & *gCdUring.sqMask;
+	struct io_uring_sqe *sqe = &gCdUring.sqes[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = opcode;
+	if(segment >= 0){
+		sqe->fd = gCdSegments[segment].hFile;
+		sqe->off = gCdSegments[segment].offset;
+		sqe->addr = (uint64)(uintptr)&gCdSegments[segment].iov;
+		sqe->len = 1;
+		sqe->user_data = segment;
+	}else{
+		sqe->fd = -1;
+		sqe->user_data = CDSTREAM_URING_WAKEUP;
+	}
+	gCdUring.sqArray[index] = index;
+	__atomic_store_n(gCdUring.sqTail, tail+1, __ATOMIC_RELEASE);
+}
+
+// Called with gCdStreamMutex held. Whatever the kernel doesn't take is taken back
+// out of the ring and fails its channel, so nobody waits for it forever.
+static void
+CdUringSubmit(int32 num)
+{
+	while(num > 0){
+		int ret = syscall(__NR_io_uring_enter, gCdUring.fd, num, 0, 0, nil, 0);
+		if(ret < 0 && errno == EINTR)
+			continue;
+		if(ret <= 0)
+			break;
+		num -= ret;
+	}
+	if(num == 0)
+		return;
+
+	CDTRACE("io_uring_enter failed (%s)", strerror(errno));
+	// no SQPOLL, so the kernel only reads the ring inside io_uring_enter
+	unsigned head = __atomic_load_n(gCdUring.sqHead, __ATOMIC_ACQUIRE);
+	unsigned tail = *gCdUring.sqTail;
+	__atomic_store_n(gCdUring.sqTail, head, __ATOMIC_RELEASE);
+	for(; head != tail; head++){
+		struct io_uring_sqe *sqe = &gCdUring.sqes[gCdUring.sqArray[head & *gCdUring.sqMask]];
+		if(sqe->user_data != CDSTREAM_URING_WAKEUP)
+			CdStreamSegmentDone((int32)sqe->user_data, true);
+	}
+}
+
+// Reaps completions, submission is done by CdStreamRead itself
+void *CdStreamThread(void *param)
+{
+	debug("Created cdstream thread (io_uring)\n");
+
+	for(;;){
+		syscall(__NR_io_uring_enter, gCdUring.fd, 0, 1, IORING_ENTER_GETEVENTS, nil, 0);
+
+		pthread_mutex_lock(&gCdStreamMutex);
+		int32 numRequeued = 0;
+		unsigned head = *gCdUring.cqHead;
+		unsigned tail = __atomic_load_n(gCdUring.cqTail, __ATOMIC_ACQUIRE);
+		for(; head != tail; head++){
+			struct io_uring_cqe *cqe = &gCdUring.cqes[head & *gCdUring.cqMask];
+			if(cqe->user_data == CDSTREAM_URING_WAKEUP)
+				continue;
+			int32 segment = (int32)cqe->user_data;
+			if(CdSegmentAdvance(&gCdSegments[segment], cqe->res)){
+				// short read, queue the rest
+				CdUringQueue(IORING_OP_READV, segment);
+				numRequeued++;
+			}else
+				CdStreamSegmentDone(segment, cqe->res <= 0);
+		}
+		__atomic_store_n(gCdUring.cqHead, head, __ATOMIC_RELEASE);
+		if(numRequeued > 0)
+			CdUringSubmit(numRequeued);
+		bool shutdown = gbCdStreamShutdown;
+		pthread_mutex_unlock(&gCdStreamMutex);
+
+		if(shutdown)
+			break;
+	}
+	pthread_exit(nil);
+}
+#endif
+
+// preadv fallback: threads pick segments off the queue and read them
+pthread_cond_t gCdSegmentCond = PTHREAD_COND_INITIALIZER;
+int32 gCdSegmentQueue[CDSTREAM_NUM_SEGMENTS];
+int32 gCdSegmentQueueHead;
+int32 gNumQueuedSegments;
+
+void *CdStreamReadThread(void *param)
+{
+	debug("Created cdstream thread (preadv)\n");
+
+	pthread_mutex_lock(&gCdStreamMutex);
+	for(;;){
+		while(gNumQueuedSegments == 0 && !gbCdStreamShutdown)
+			pthread_cond_wait(&gCdSegmentCond, &gCdStreamMutex);
+		if(gbCdStreamShutdown)
+			break;
+
+		int32 segment = gCdSegmentQueue[gCdSegmentQueueHead];
+		gCdSegmentQueueHead = (gCdSegmentQueueHead + 1) % CDSTREAM_NUM_SEGMENTS;
+		gNumQueuedSegments--;
+		CdSegment *pSegment = &gCdSegments[segment];
+		pthread_mutex_unlock(&gCdStreamMutex);
+
+		ssize_t result;
+		do
+			result = preadv(pSegment->hFile, &pSegment->iov, 1, pSegment->offset);
+		while(CdSegmentAdvance(pSegment, result) || (result < 0 && errno == EINTR));
+
+		pthread_mutex_lock(&gCdStreamMutex);
+		CdStreamSegmentDone(segment, result <= 0);
+	}
+	pthread_mutex_unlock(&gCdStreamMutex);
+	pthread_exit(nil);
+}
+
+void
+CdStreamInitThread(void)
+{
+	int32 i;
+
+	for(i = 0; i < CDSTREAM_NUM_SEGMENTS; i++)
+		gCdSegments[i].channel = -1;
+	for(i = 0; i < gNumChannels; i++)
+		pthread_cond_init(&gpReadInfo[i].doneCond, nil);
+	gbCdStreamShutdown = false;
+	gNumCdStreamThreads = 0;
+
+#ifdef CDSTREAM_IO_URING
+	if(CdUringInit()){
+		if(pthread_create(&gCdStreamThreads[0], nil, CdStreamThread, nil) == 0){
+			gNumCdStreamThreads = 1;
+			debug("Using io_uring for streaming\n");
+			return;
+		}
+		close(gCdUring.fd);
+		gCdUring.fd = -1;
+	}
+#endif
+
+	for(i = 0; i < CDSTREAM_NUM_READ_THREADS; i++){
+		if(pthread_create(&gCdStreamThreads[i], nil, CdStreamReadThread, nil) != 0){
+			CDTRACE("failed to create read thread");
+			break;
+		}
+		gNumCdStreamThreads++;
+	}
+	ASSERT(gNumCdStreamThreads > 0);
+	debug("Using %d preadv threads for streaming\n", gNumCdStreamThreads);
+}
+
+void
+CdStreamInit(int32 numChannels)
+{
+#ifdef __linux__
+	_gdwCdStreamFlags = O_RDONLY | O_NOATIME;
+#else
+	_gdwCdStreamFlags = O_RDONLY;
+#endif
+
+	gNumImages = 0;
+
+	gNumChannels = numChannels;
+	ASSERT( gNumChannels != 0 && gNumChannels <= MAX_CDCHANNELS );
+
+	gpReadInfo = (CdReadInfo *)calloc(numChannels, sizeof(CdReadInfo));
+	ASSERT( gpReadInfo != nil );
+
+	CDDEBUG("read info %p", gpReadInfo);
+
+	CdStreamInitThread();
+}
+
+uint32
+GetGTA3ImgSize(void)
+{
+	ASSERT( gImgFiles[0] > 0 );
+	struct stat statbuf;
+
+	char path[PATH_MAX];
+	realpath(gImgNames[0], path);
+	if (stat(path, &statbuf) == -1) {
+		// Try case-insensitivity
+		char* real = casepath(gImgNames[0], false);
+		if (real)
+		{
+			realpath(real, path);
+			free(real);
+			if (stat(path, &statbuf) != -1)
+				goto ok;
+		}
+
+		CDTRACE("can't get size of gta3.img");
+		ASSERT(0);
+		return 0;
+	}
+	ok:
+	return (uint32)statbuf.st_size;
+}
+
+void
+CdStreamShutdown(void)
+{
+	int32 i;
+
+	pthread_mutex_lock(&gCdStreamMutex);
+	gbCdStreamShutdown = true;
+#ifdef CDSTREAM_IO_URING
+	if(gCdUring.fd >= 0){
+		CdUringQueue(IORING_OP_NOP, -1);
+		CdUringSubmit(1);
+	}
+#endif
+	pthread_cond_broadcast(&gCdSegmentCond);
+	pthread_mutex_unlock(&gCdStreamMutex);
+
+	for(i = 0; i < gNumCdStreamThreads; i++)
+		pthread_join(gCdStreamThreads[i], nil);
+	gNumCdStreamThreads = 0;
+
+#ifdef CDSTREAM_IO_URING
+	if(gCdUring.fd >= 0){
+		close(gCdUring.fd);
+		gCdUring.fd = -1;
+	}
+#endif
+	for(i = 0; i < gNumChannels; i++)
+		pthread_cond_destroy(&gpReadInfo[i].doneCond);
+	free(gpReadInfo);
+	gpReadInfo = nil;
+}
+
+int32
+CdStreamRead(int32 channel, void *buffer, uint32 offset, uint32 size)
+{
+	int32 i, numSegments, segmentSize, segment;
+
+	ASSERT( channel < gNumChannels );
+	ASSERT( buffer != nil );
+
+	lastPosnRead = size + offset;
+
+	ASSERT( _GET_INDEX(offset) < MAX_CDIMAGES );
+	int32 hImage = gImgFiles[_GET_INDEX(offset)];
+	ASSERT( hImage > 0 );
+
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	ASSERT( pChannel != nil );
+
+	if ( pChannel->bReading ) {
+		if (pChannel->hFile == hImage - 1 && pChannel->nSectorOffset == _GET_OFFSET(offset) && pChannel->nSectorsToRead >= size)
+			return STREAM_SUCCESS;
+#ifdef FLUSHABLE_STREAMING
+		flushStream[channel] = 1;
+		CdStreamSync(channel);
+#else
+		return STREAM_NONE;
+#endif
+	}
+
+#ifdef MAPPED_IMG
+	// nothing to read, CStreaming takes the file straight from the mapping
+	if(CdStreamGetMappedData(offset, size)){
+		pChannel->nStatus = STREAM_NONE;
+		return STREAM_SUCCESS;
+	}
+#endif
+
+	if(size == 0)
+		return STREAM_SUCCESS;
+
+	segmentSize = Max((size + CDSTREAM_MAX_SEGMENTS-1) / CDSTREAM_MAX_SEGMENTS, CDSTREAM_MIN_SEGMENT_SIZE);
+	numSegments = (size + segmentSize-1) / segmentSize;
+
+	pthread_mutex_lock(&gCdStreamMutex);
+	pChannel->hFile = hImage - 1;
+	pChannel->nStatus = STREAM_NONE;
+	pChannel->nSectorOffset = _GET_OFFSET(offset);
+	pChannel->nSectorsToRead = size;
+	pChannel->pBuffer = buffer;
+	pChannel->nPendingSegments = numSegments;
+	pChannel->bFailed = false;
+	pChannel->bReading = true;
+	pChannel->nStartTime = GetTimeInMicroseconds();
+
+	segment = 0;
+	for(i = 0; i < numSegments; i++){
+		uint32 sector = i*segmentSize;
+		// each channel has enough segments for itself so this can't fail
+		while(gCdSegments[segment].channel != -1)
+			segment++;
+		CdSegment *pSegment = &gCdSegments[segment];
+		pSegment->channel = channel;
+		pSegment->hFile = pChannel->hFile;
+		pSegment->offset = ((off_t)pChannel->nSectorOffset + sector) * CDSTREAM_SECTOR_SIZE;
+		pSegment->iov.iov_base = (uint8*)buffer + sector*CDSTREAM_SECTOR_SIZE;
+		pSegment->iov.iov_len = Min(segmentSize, size - sector) * CDSTREAM_SECTOR_SIZE;
+#ifdef CDSTREAM_IO_URING
+		if(gCdUring.fd >= 0)
+			CdUringQueue(IORING_OP_READV, segment);
+		else
+#endif
+		{
+			gCdSegmentQueue[(gCdSegmentQueueHead + gNumQueuedSegments) % CDSTREAM_NUM_SEGMENTS] = segment;
+			gNumQueuedSegments++;
+		}
+	}
+	gCdStreamStats.numSegments += numSegments;
+
+#ifdef CDSTREAM_IO_URING
+	if(gCdUring.fd >= 0)
+		CdUringSubmit(numSegments);
+	else
+#endif
+		pthread_cond_broadcast(&gCdSegmentCond);
+	pthread_mutex_unlock(&gCdStreamMutex);
+
+	return STREAM_SUCCESS;
+}
+
+int32
+CdStreamGetStatus(int32 channel)
+{
+	ASSERT( channel < gNumChannels );
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	ASSERT( pChannel != nil );
+
+	if (gbCdStreamShutdown)
+		return STREAM_NONE;
+
+	pthread_mutex_lock(&gCdStreamMutex);
+	int32 status = STREAM_NONE;
+	if ( pChannel->bReading )
+		status = STREAM_READING;
+	else if ( pChannel->nStatus != STREAM_NONE )
+	{
+		status = pChannel->nStatus;
+		pChannel->nStatus = STREAM_NONE;
+	}
+	pthread_mutex_unlock(&gCdStreamMutex);
+
+	return status;
+}
+
+int32
+CdStreamGetLastPosn(void)
+{
+	return lastPosnRead;
+}
+
+// wait for channel to finish reading
+int32
+CdStreamSync(int32 channel)
+{
+	ASSERT( channel < gNumChannels );
+	CdReadInfo *pChannel = &gpReadInfo[channel];
+	ASSERT( pChannel != nil );
+
+	pthread_mutex_lock(&gCdStreamMutex);
+	// the kernel may still be writing into the buffer, so even a flush has to wait for the read
+	while ( pChannel->bReading )
+		pthread_cond_wait(&pChannel->doneCond, &gCdStreamMutex);
+	int32 status = pChannel->nStatus;
+#ifdef FLUSHABLE_STREAMING
+	if (flushStream[channel]) {
+		pChannel->nStatus = STREAM_NONE;
+		flushStream[channel] = false;
+		status = STREAM_NONE;
+	}
+#endif
+	pthread_mutex_unlock(&gCdStreamMutex);
+
+	return status;
+}
+
+void
+CdStreamPrintStats(void)
+{
+	int32 i;
+
+	pthread_mutex_lock(&gCdStreamMutex);
+	CdStreamStats stats = gCdStreamStats;
+	pthread_mutex_unlock(&gCdStreamMutex);
+
+	debug("cdstream: %d reads in %d segments, %d KB, avg latency %d us, max %d us\n",
+		stats.numReads, stats.numSegments, (int)(stats.numBytes/1024),
+		stats.numReads ? (int)(stats.totalLatency/stats.numReads) : 0, stats.maxLatency);
+	for(i = 0; i < gNumChannels; i++)
+		debug("cdstream: channel %d last latency %d us\n", i, stats.lastLatency[i]);
+}
+
+bool
+CdStreamAddImage(char const *path)
+{
+	ASSERT(path != nil);
+	ASSERT(gNumImages < MAX_CDIMAGES);
+
+	gImgFiles[gNumImages] = open(path, _gdwCdStreamFlags);
+
+	// Fix case sensitivity and backslashes.
+	if (gImgFiles[gNumImages] == -1) {
+		char* real = casepath(path, false);
+		if (real)
+		{
+			gImgFiles[gNumImages] = open(real, _gdwCdStreamFlags);
+			free(real);
+		}
+	}
+
+	if ( gImgFiles[gNumImages] == -1 ) {
+		assert(false);
+		return false;
+	}
+
+#ifdef MAPPED_IMG
+	CdStreamMapImage(gNumImages, gImgFiles[gNumImages]);
+#endif
+	gImgNames[gNumImages] = strdup(path);
+	gImgFiles[gNumImages]++; // because -1: error 0: not used
+
+	strcpy(gCdImageNames[gNumImages], path);
+
+	gNumImages++;
+
+	return true;
+}
+
+char *
+CdStreamGetImageName(int32 cd)
+{
+	ASSERT(cd < MAX_CDIMAGES);
+	if ( gImgFiles[cd] > 0)
+		return gCdImageNames[cd];
+
+	return nil;
+}
+
+void
+CdStreamRemoveImages(void)
+{
+	for ( int32 i = 0; i < gNumChannels; i++ ) {
+#ifdef FLUSHABLE_STREAMING
+		flushStream[i] = 1;
+#endif
+		CdStreamSync(i);
+	}
+
+	for ( int32 i = 0; i < gNumImages; i++ )
+	{
+		close(gImgFiles[i] - 1);
+		free(gImgNames[i]);
+		gImgFiles[i] = 0;
+	}
+
+#ifdef MAPPED_IMG
+	CdStreamUnmapImages();
+#endif
+	gNumImages = 0;
+}
+
+int32
+CdStreamGetNumImages(void)
+{
+	return gNumImages;
+}
+#endif
+#endif
@@ -0,0 +1,95 @@
+#ifndef _WIN32
+#include "common.h"
+
+#ifdef MAPPED_IMG
+#include <sys/types.h>
+#include <sys/stat.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include "CdStream.h"
+
+// Whole IMG archives mapped into memory. CStreaming parses files straight out of
+// the mapping, so CdStreamRead has nothing left to do for a mapped image.
+// Mappings are private and writable because the loaders patch some data in place,
+// those pages simply get copied on write.
+
+struct MappedImage
+{
+	uint8 *pData;
+	size_t size;
+};
+
+static MappedImage gMappedImages[MAX_CDIMAGES];
+
+void
+CdStreamMapImage(int32 cd, int32 fd)
+{
+	struct stat statbuf;
+	void *data;
+
+	ASSERT(cd < MAX_CDIMAGES);
+	gMappedImages[cd].pData = nil;
+	gMappedImages[cd].size = 0;
+
+	if(fstat(fd, &statbuf) == -1 || statbuf.st_size == 0)
+		return;
+	data = mmap(nil, statbuf.st_size, PROT_READ|PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if(data == MAP_FAILED){
+		debug("cdvd_stream: couldn't map image %d, falling back to reads\n", cd);
+		return;
+	}
+	// files are requested in no particular order
+	madvise(data, statbuf.st_size, MADV_RANDOM);
+	gMappedImages[cd].pData = (uint8*)data;
+	gMappedImages[cd].size = statbuf.st_size;
+}
+
+void
+CdStreamUnmapImages(void)
+{
+	for(int32 i = 0; i < MAX_CDIMAGES; i++){
+		if(gMappedImages[i].pData)
+			munmap(gMappedImages[i].pData, gMappedImages[i].size);
+		gMappedImages[i].pData = nil;
+		gMappedImages[i].size = 0;
+	}
+}
+
+// offset and size in sectors, like CdStreamRead.
+// nil if the range isn't completely inside a mapping, touching pages past the end would fault.
+void*
+CdStreamGetMappedData(uint32 offset, uint32 size)
+{
+	MappedImage *img;
+	size_t start, end;
+
+	if(_GET_INDEX(offset) >= MAX_CDIMAGES)
+		return nil;
+	img = &gMappedImages[_GET_INDEX(offset)];
+	if(img->pData == nil)
+		return nil;
+	start = (size_t)_GET_OFFSET(offset) * CDSTREAM_SECTOR_SIZE;
+	end = start + (size_t)size * CDSTREAM_SECTOR_SIZE;
+	if(end > img->size)
+		return nil;
+	return img->pData + start;
+}
+
+// Start paging in a file we're going to need soon
+void
+CdStreamPrefetch(uint32 offset, uint32 size)
+{
+	static size_t pageMask = sysconf(_SC_PAGESIZE) - 1;
+	uint8 *data;
+	uintptr start, end;
+
+	data = (uint8*)CdStreamGetMappedData(offset, size);
+	if(data == nil || size == 0)
+		return;
+	start = (uintptr)data & ~pageMask;
+	end = (uintptr)data + (size_t)size * CDSTREAM_SECTOR_SIZE;
+	madvise((void*)start, end - start, MADV_WILLNEED);
+}
+#endif
+#endif
@@ -1,5 +1,7 @@
 #ifndef _WIN32
 #include "common.h"
+
+#ifndef BATCHED_CDSTREAM	// see CdStreamBatch.cpp
 #include "crossplatform.h"
 #include <pthread.h>
 #include <signal.h>
@@ -255,6 +257,14 @@ CdStreamRead(int32 channel, void *buffer, uint32 offset, uint32 size)
 #endif
 	}
 
+#ifdef MAPPED_IMG
+	// nothing to read, CStreaming takes the file straight from the mapping
+	if ( CdStreamGetMappedData(offset, size) ) {
+		pChannel->nStatus = STREAM_NONE;
+		return STREAM_SUCCESS;
+	}
+#endif
+
 	pChannel->hFile = hImage - 1;
 	pChannel->nStatus = STREAM_NONE;
 	pChannel->nSectorOffset = _GET_OFFSET(offset);
@@ -509,6 +519,9 @@ CdStreamAddImage(char const *path)
 		return false;
 	}
 
+#ifdef MAPPED_IMG
+	CdStreamMapImage(gNumImages, gImgFiles[gNumImages]);
+#endif
 	gImgNames[gNumImages] = strdup(path);
 	gImgFiles[gNumImages]++; // because -1: error 0: not used
 
@@ -546,6 +559,9 @@ CdStreamRemoveImages(void)
 		gImgFiles[i] = 0;
 	}
 
+#ifdef MAPPED_IMG
+	CdStreamUnmapImages();
+#endif
 	gNumImages = 0;
 }
 
@@ -555,3 +571,4 @@ CdStreamGetNumImages(void)
 	return gNumImages;
 }
 #endif
+#endif
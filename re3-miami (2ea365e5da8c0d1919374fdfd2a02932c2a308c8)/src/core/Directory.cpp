@@ -48,7 +48,11 @@ CDirectory::AddItem(const DirectoryInfo &dirinfo)
 	if(FindItem(dirinfo.name, offset, size))
 		return;
 #endif
-	entries[numEntries++] = dirinfo;
+	entries[numEntries] = dirinfo;
+#ifdef HASHED_NAME_LOOKUP
+	index.Add(entries[numEntries].name, numEntries);
+#endif
+	numEntries++;
 }
 
 void
@@ -64,11 +68,29 @@ CDirectory::FindItem(const char *name, uint32 &offset, uint32 &size)
 {
 	int i;
 
+#ifdef HASHED_NAME_LOOKUP
+	i = index.Find(name);
+	if(i != -1){
+		offset = entries[i].offset;
+		size = entries[i].size;
+		return true;
+	}
+#else
 	for(i = 0; i < numEntries; i++)
 		if(!CGeneral::faststricmp(entries[i].name, name)){
 			offset = entries[i].offset;
 			size = entries[i].size;
 			return true;
 		}
+#endif
 	return false;
 }
+
+void
+CDirectory::Clear(void)
+{
+	numEntries = 0;
+#ifdef HASHED_NAME_LOOKUP
+	index.Clear();
+#endif
+}
@@ -1,5 +1,9 @@
 #pragma once
 
+#ifdef HASHED_NAME_LOOKUP
+#include "NameIndex.h"
+#endif
+
 class CDirectory
 {
 public:
@@ -11,6 +15,9 @@ public:
 	DirectoryInfo *entries;
 	int32 maxEntries;
 	int32 numEntries;
+#ifdef HASHED_NAME_LOOKUP
+	CNameIndex index;
+#endif
 
 	CDirectory(int32 maxEntries);
 	~CDirectory(void);
@@ -20,4 +27,5 @@ public:
 	void AddItem(const DirectoryInfo &dirinfo);
 	void AddItem(const DirectoryInfo &dirinfo, int32 imgId);
 	bool FindItem(const char *name, uint32 &offset, uint32 &size);
+	void Clear(void);
 };
@@ -29,9 +29,31 @@
 #include "Streaming.h"
 #include "ColStore.h"
 #include "Occlusion.h"
+#include "Timer.h"
+#include "LevelCache.h"
+#include "BuildingBVH.h"
+#include "ColTriangleBVH.h"
+#include "BuildingCulling.h"
 
 char CFileLoader::ms_line[256];
 
+#ifndef MASTER
+// Startup timing report, time spent on each kind of data file
+enum {
+	LOADTIME_IDE,
+	LOADTIME_IPL,
+	LOADTIME_COL,
+	LOADTIME_IMGDIR,
+	NUM_LOADTIMES
+};
+static uint32 gLoadTimes[NUM_LOADTIMES];
+#define START_LOADTIME() loadStartTime = CTimer::GetCurrentTimeInCycles()
+#define END_LOADTIME(t) gLoadTimes[t] += CTimer::GetCurrentTimeInCycles() - loadStartTime
+#else
+#define START_LOADTIME()
+#define END_LOADTIME(t)
+#endif
+
 const char*
 GetFilename(const char *filename)
 {
@@ -54,6 +76,9 @@ CFileLoader::LoadLevel(const char *filename)
 	bool objectsLoaded;
 	char *line;
 	char txdname[64];
+#ifndef MASTER
+	uint32 loadStartTime;
+#endif
 
 	savedTxd = RwTexDictionaryGetCurrent();
 	objectsLoaded = false;
@@ -63,6 +88,9 @@ CFileLoader::LoadLevel(const char *filename)
 	}
 	fd = CFileMgr::OpenFile(filename, "r");
 	assert(fd > 0);
+#ifdef LEVEL_CACHE
+	CLevelCache::Open(filename);
+#endif
 
 	for(line = LoadLine(fd); line; line = LoadLine(fd)){
 		if(*line == '#')
@@ -83,7 +111,9 @@ CFileLoader::LoadLevel(const char *filename)
 			POP_MEMID();
 		}else if(strncmp(line, "COLFILE", 7) == 0){
 			LoadingScreenLoadingFile(line+10);
+			START_LOADTIME();
 			LoadCollisionFile(line+10, 0);
+			END_LOADTIME(LOADTIME_COL);
 		}else if(strncmp(line, "MODELFILE", 9) == 0){
 			LoadingScreenLoadingFile(line + 10);
 			LoadModelFile(line + 10);
@@ -92,16 +122,22 @@ CFileLoader::LoadLevel(const char *filename)
 			LoadClumpFile(line + 9);
 		}else if(strncmp(line, "IDE", 3) == 0){
 			LoadingScreenLoadingFile(line + 4);
+			START_LOADTIME();
 			LoadObjectTypes(line + 4);
+			END_LOADTIME(LOADTIME_IDE);
 		}else if(strncmp(line, "IPL", 3) == 0){
 			if(!objectsLoaded){
 				LoadingScreenLoadingFile("Collision");
 				PUSH_MEMID(MEMID_WORLD);
 				CObjectData::Initialise("DATA\\OBJECT.DAT");
+				START_LOADTIME();
 				CStreaming::Init();
+				END_LOADTIME(LOADTIME_IMGDIR);
 				POP_MEMID();
 				PUSH_MEMID(MEMID_COLLISION);
+				START_LOADTIME();
 				CColStore::LoadAllCollision();
+				END_LOADTIME(LOADTIME_COL);
 				POP_MEMID();
 				for(int i = 0; i < MODELINFOSIZE; i++)
 					if(CModelInfo::GetModelInfo(i))
@@ -110,7 +146,9 @@ CFileLoader::LoadLevel(const char *filename)
 			}
 			PUSH_MEMID(MEMID_WORLD);
 			LoadingScreenLoadingFile(line + 4);
+			START_LOADTIME();
 			LoadScene(line + 4);
+			END_LOADTIME(LOADTIME_IPL);
 			POP_MEMID();
 		}else if(strncmp(line, "SPLASH", 6) == 0){
 #ifndef DISABLE_LOADING_SCREEN
@@ -124,6 +162,9 @@ CFileLoader::LoadLevel(const char *filename)
 	}
 
 	CFileMgr::CloseFile(fd);
+#ifdef LEVEL_CACHE
+	CLevelCache::Close();
+#endif
 	RwTexDictionarySetCurrent(savedTxd);
 
 	int i;
@@ -131,9 +172,32 @@ CFileLoader::LoadLevel(const char *filename)
 		if(CColStore::GetSlot(i))
 			CColStore::GetBoundingBox(i).Grow(120.0f);
 	CWorld::RepositionCertainDynamicObjects();
+#ifdef STATIC_BUILDING_BVH
+	CBuildingBVH::Build();
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	CBuildingCulling::Build();
+#endif
 	CColStore::RemoveAllCollision();
 }
 
+#ifndef MASTER
+void
+CFileLoader::PrintLoadTimes(void)
+{
+	float cyclesPerMs = CTimer::GetCyclesPerMillisecond();
+#ifdef HASHED_NAME_LOOKUP
+	debug("Startup load times (hashed name lookup):\n");
+#else
+	debug("Startup load times (linear name lookup):\n");
+#endif
+	debug("  IDE files:        %8.2f ms\n", gLoadTimes[LOADTIME_IDE] / cyclesPerMs);
+	debug("  IPL files:        %8.2f ms\n", gLoadTimes[LOADTIME_IPL] / cyclesPerMs);
+	debug("  COL files:        %8.2f ms\n", gLoadTimes[LOADTIME_COL] / cyclesPerMs);
+	debug("  IMG directories:  %8.2f ms\n", gLoadTimes[LOADTIME_IMGDIR] / cyclesPerMs);
+}
+#endif
+
 char*
 CFileLoader::LoadLine(int fd)
 {
@@ -286,6 +350,51 @@ CFileLoader::LoadCollisionFile(uint8 *buffer, uint32 size, uint8 colSlot)
 	return true;
 }
 
+#ifdef ASYNC_STREAM_DECODE
+// Same format as LoadCollisionFile, but only parses the models for CColStore::LoadDecodedCol to hand out later.
+// Doesn't touch model infos, pools or work_buff, so it can run on a worker thread.
+bool
+CFileLoader::DecodeCollisionFile(uint8 *buffer, uint32 size, CDecodedColModel *&models, int32 &numModels)
+{
+	uint32 modelsize, maxsize, left;
+	ColHeader *header;
+	uint8 *p, *scratch;
+	int32 i;
+
+	// count models first
+	numModels = 0;
+	maxsize = 0;
+	models = nil;
+	for(p = buffer, left = size; left > 8; numModels++){
+		header = (ColHeader*)p;
+		modelsize = header->size;
+		if(header->ident != 'LLOC'){
+			if(left-8 >= CDSTREAM_SECTOR_SIZE)
+				return false;
+			break;
+		}
+		maxsize = Max(maxsize, modelsize-24);
+		left -= 32 + (modelsize-24);
+		p += 32 + (modelsize-24);
+	}
+	if(numModels == 0)
+		return true;
+
+	models = new CDecodedColModel[numModels];
+	scratch = new uint8[maxsize];
+	for(i = 0, p = buffer; i < numModels; i++){
+		header = (ColHeader*)p;
+		modelsize = header->size;
+		memcpy(models[i].name, p+8, 24);
+		memcpy(scratch, p+32, modelsize-24);
+		p += 32 + (modelsize-24);
+		LoadCollisionModel(scratch, models[i].model, models[i].name);
+	}
+	delete[] scratch;
+	return true;
+}
+#endif
+
 void
 CFileLoader::LoadCollisionModel(uint8 *buf, CColModel &model, char *modelname)
 {
@@ -367,6 +476,13 @@ CFileLoader::LoadCollisionModel(uint8 *buf, CColModel &model, char *modelname)
 		}
 	}else
 		model.triangles = nil;
+
+#ifdef COLMODEL_TRIANGLE_BVH
+	// build it here rather than with the planes, those are thrown away all the time
+	model.triangleBVH = CColTriangleBVH::Build(model);
+	if(model.triangleBVH)
+		REGISTER_MEMPTR(&model.triangleBVH);
+#endif
 }
 
 static void
@@ -587,6 +703,17 @@ CFileLoader::AddTexDictionaries(RwTexDictionary *dst, RwTexDictionary *src)
 #define isLine3(l, a, b, c) ((l[0] == a) && (l[1] == b) && (l[2] == c))
 #define isLine4(l, a, b, c, d) ((l[0] == a) && (l[1] == b) && (l[2] == c) && (l[3] == d))
 
+static void
+SetupBigBuildings(int minID, int maxID)
+{
+	int id;
+	for(id = minID; id <= maxID; id++){
+		CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(id);
+		if(mi && mi->IsBuilding())
+			mi->SetupBigBuilding(minID, maxID);
+	}
+}
+
 void
 CFileLoader::LoadObjectTypes(const char *filename)
 {
@@ -615,6 +742,16 @@ CFileLoader::LoadObjectTypes(const char *filename)
 	pathIndex = -1;
 	debug("Loading object types from %s...\n", filename);
 
+#ifdef LEVEL_CACHE
+	uint8 *records;
+	uint32 size;
+	if(CLevelCache::StartFile(filename, records, size)){
+		ReplayLevelRecords(records, size, minID, maxID);
+		SetupBigBuildings(minID, maxID);
+		return;
+	}
+#endif
+
 	fd = CFileMgr::OpenFile(filename, "rb");
 	assert(fd > 0);
 	for(line = CFileLoader::LoadLine(fd); line; line = CFileLoader::LoadLine(fd)){
@@ -677,12 +814,11 @@ CFileLoader::LoadObjectTypes(const char *filename)
 		}
 	}
 	CFileMgr::CloseFile(fd);
+#ifdef LEVEL_CACHE
+	CLevelCache::EndFile();
+#endif
 
-	for(id = minID; id <= maxID; id++){
-		CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(id);
-		if(mi && mi->IsBuilding())
-			mi->SetupBigBuilding(minID, maxID);
-	}
+	SetupBigBuildings(minID, maxID);
 }
 
 void
@@ -704,249 +840,318 @@ SetModelInfoFlags(CSimpleModelInfo *mi, uint32 flags)
 int
 CFileLoader::LoadObject(const char *line)
 {
-	int id, numObjs;
-	char model[24], txd[24];
-	float dist[3];
-	uint32 flags;
-	int damaged;
-	CSimpleModelInfo *mi;
+	ObjectDef def;
 
-	if(sscanf(line, "%d %s %s %d", &id, model, txd, &numObjs) != 4)
+	if(sscanf(line, "%d %s %s %d", &def.id, def.model, def.txd, &def.numObjs) != 4)
 		return 0;	// game returns return value
 
-	switch(numObjs){
+	switch(def.numObjs){
 	case 1:
 		sscanf(line, "%d %s %s %d %f %d",
-			&id, model, txd, &numObjs, &dist[0], &flags);
-		damaged = 0;
+			&def.id, def.model, def.txd, &def.numObjs, &def.dist[0], &def.flags);
+		def.damaged = 0;
 		break;
 	case 2:
 		sscanf(line, "%d %s %s %d %f %f %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &flags);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
+			&def.id, def.model, def.txd, &def.numObjs, &def.dist[0], &def.dist[1], &def.flags);
+		def.damaged = def.dist[0] < def.dist[1] ?	// Are distances increasing?
 			0 :	// Yes, no damage model
 			1;	// No, 1 is damaged
 		break;
 	case 3:
 		sscanf(line, "%d %s %s %d %f %f %f %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &dist[2], &flags);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
-				(dist[1] < dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
+			&def.id, def.model, def.txd, &def.numObjs, &def.dist[0], &def.dist[1], &def.dist[2], &def.flags);
+		def.damaged = def.dist[0] < def.dist[1] ?	// Are distances increasing?
+				(def.dist[1] < def.dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
 			1;	// No, 1 and 2 are damaged
 		break;
 	}
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_OBJS, &def, sizeof(def));
+#endif
 
-	mi = CModelInfo::AddSimpleModel(id);
-	mi->SetModelName(model);
-	mi->SetNumAtomics(numObjs);
-	mi->SetLodDistances(dist);
-	SetModelInfoFlags(mi, flags);
-	mi->m_firstDamaged = damaged;
-	mi->SetTexDictionary(txd);
-	MatchModelString(model, id);
+	return AddObject(def);
+}
 
-	return id;
+int
+CFileLoader::AddObject(const ObjectDef &def)
+{
+	CSimpleModelInfo *mi;
+
+	mi = CModelInfo::AddSimpleModel(def.id);
+	mi->SetModelName(def.model);
+	mi->SetNumAtomics(def.numObjs);
+	mi->SetLodDistances((float*)def.dist);
+	SetModelInfoFlags(mi, def.flags);
+	mi->m_firstDamaged = def.damaged;
+	mi->SetTexDictionary(def.txd);
+	MatchModelString(def.model, def.id);
+
+	return def.id;
 }
 
 int
 CFileLoader::LoadTimeObject(const char *line)
 {
-	int id, numObjs;
-	char model[24], txd[24];
-	float dist[3];
-	uint32 flags;
-	int timeOn, timeOff;
-	int damaged;
-	CTimeModelInfo *mi, *other;
+	ObjectDef def;
 
-	if(sscanf(line, "%d %s %s %d", &id, model, txd, &numObjs) != 4)
+	if(sscanf(line, "%d %s %s %d", &def.id, def.model, def.txd, &def.numObjs) != 4)
 		return 0;	// game returns return value
 
-	switch(numObjs){
+	switch(def.numObjs){
 	case 1:
 		sscanf(line, "%d %s %s %d %f %d %d %d",
-			&id, model, txd, &numObjs, &dist[0], &flags, &timeOn, &timeOff);
-		damaged = 0;
+			&def.id, def.model, def.txd, &def.numObjs, &def.dist[0], &def.flags, &def.timeOn, &def.timeOff);
+		def.damaged = 0;
 		break;
 	case 2:
 		sscanf(line, "%d %s %s %d %f %f %d %d %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &flags, &timeOn, &timeOff);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
+			&def.id, def.model, def.txd, &def.numObjs, &def.dist[0], &def.dist[1], &def.flags, &def.timeOn, &def.timeOff);
+		def.damaged = def.dist[0] < def.dist[1] ?	// Are distances increasing?
 			0 :	// Yes, no damage model
 			1;	// No, 1 is damaged
 		break;
 	case 3:
 		sscanf(line, "%d %s %s %d %f %f %f %d %d %d",
-			&id, model, txd, &numObjs, &dist[0], &dist[1], &dist[2], &flags, &timeOn, &timeOff);
-		damaged = dist[0] < dist[1] ?	// Are distances increasing?
-				(dist[1] < dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
+			&def.id, def.model, def.txd, &def.numObjs, &def.dist[0], &def.dist[1], &def.dist[2], &def.flags, &def.timeOn, &def.timeOff);
+		def.damaged = def.dist[0] < def.dist[1] ?	// Are distances increasing?
+				(def.dist[1] < def.dist[2] ? 0 : 2) :	// Yes, only 2 can still be a damage model
 			1;	// No, 1 and 2 are damaged
 		break;
 	}
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_TOBJ, &def, sizeof(def));
+#endif
+
+	return AddTimeObject(def);
+}
+
+int
+CFileLoader::AddTimeObject(const ObjectDef &def)
+{
+	CTimeModelInfo *mi, *other;
 
-	mi = CModelInfo::AddTimeModel(id);
-	mi->SetModelName(model);
-	mi->SetNumAtomics(numObjs);
-	mi->SetLodDistances(dist);
-	SetModelInfoFlags(mi, flags);
-	mi->m_firstDamaged = damaged;
-	mi->SetTimes(timeOn, timeOff);
-	mi->SetTexDictionary(txd);
+	mi = CModelInfo::AddTimeModel(def.id);
+	mi->SetModelName(def.model);
+	mi->SetNumAtomics(def.numObjs);
+	mi->SetLodDistances((float*)def.dist);
+	SetModelInfoFlags(mi, def.flags);
+	mi->m_firstDamaged = def.damaged;
+	mi->SetTimes(def.timeOn, def.timeOff);
+	mi->SetTexDictionary(def.txd);
 	other = mi->FindOtherTimeModel();
 	if(other)
-		other->SetOtherTimeModel(id);
-	MatchModelString(model, id);
+		other->SetOtherTimeModel(def.id);
+	MatchModelString(def.model, def.id);
 
-	return id;
+	return def.id;
 }
 
 int
 CFileLoader::LoadWeaponObject(const char *line)
 {
-	int id, numObjs;
-	char model[24], txd[24], animFile[16];
-	float dist;
-	CWeaponModelInfo *mi;
+	WeaponObjectDef def;
+	int numObjs;
 
-	sscanf(line, "%d %s %s %s %d %f", &id, model, txd, animFile, &numObjs, &dist);
+	sscanf(line, "%d %s %s %s %d %f", &def.id, def.model, def.txd, def.animFile, &numObjs, &def.dist);
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_WEAP, &def, sizeof(def));
+#endif
 
-	mi = CModelInfo::AddWeaponModel(id);
-	mi->SetModelName(model);
+	return AddWeaponObject(def);
+}
+
+int
+CFileLoader::AddWeaponObject(const WeaponObjectDef &def)
+{
+	CWeaponModelInfo *mi;
+
+	mi = CModelInfo::AddWeaponModel(def.id);
+	mi->SetModelName(def.model);
 	mi->SetNumAtomics(1);
-	mi->m_lodDistances[0] = dist;
-	mi->SetTexDictionary(txd);
-	mi->SetAnimFile(animFile);
+	mi->m_lodDistances[0] = def.dist;
+	mi->SetTexDictionary(def.txd);
+	mi->SetAnimFile(def.animFile);
 	mi->SetColModel(&CTempColModels::ms_colModelWeapon);
-	MatchModelString(model, id);
-	return id;
+	MatchModelString(def.model, def.id);
+	return def.id;
 }
 
 void
 CFileLoader::LoadClumpObject(const char *line)
 {
-	int id;
-	char model[24], txd[24];
-	CClumpModelInfo *mi;
+	ClumpObjectDef def;
 
-	if(sscanf(line, "%d %s %s", &id, model, txd) == 3){
-		mi = CModelInfo::AddClumpModel(id);
-		mi->SetModelName(model);
-		mi->SetTexDictionary(txd);
-		mi->SetColModel(&CTempColModels::ms_colModelBBox);
+	if(sscanf(line, "%d %s %s", &def.id, def.model, def.txd) == 3){
+#ifdef LEVEL_CACHE
+		CLevelCache::AddRecord(LEVELREC_HIER, &def, sizeof(def));
+#endif
+		AddClumpObject(def);
 	}
 }
 
+void
+CFileLoader::AddClumpObject(const ClumpObjectDef &def)
+{
+	CClumpModelInfo *mi;
+
+	mi = CModelInfo::AddClumpModel(def.id);
+	mi->SetModelName(def.model);
+	mi->SetTexDictionary(def.txd);
+	mi->SetColModel(&CTempColModels::ms_colModelBBox);
+}
+
 void
 CFileLoader::LoadVehicleObject(const char *line)
 {
-	int id;
-	char model[24], txd[24];
-	char type[8], handlingId[16], gamename[32], animFile[16], vehclass[12];
-	uint32 frequency, comprules;
-	int32 level, misc;
-	float wheelScale;
-	CVehicleModelInfo *mi;
+	VehicleObjectDef def;
+	char type[8], vehclass[12];
 	char *p;
 
 	sscanf(line, "%d %s %s %s %s %s %s %s %d %d %x %d %f",
-		&id, model, txd,
-		type, handlingId, gamename, animFile, vehclass,
-		&frequency, &level, &comprules, &misc, &wheelScale);
-
-	mi = CModelInfo::AddVehicleModel(id);
-	mi->SetModelName(model);
-	mi->SetTexDictionary(txd);
-	mi->SetAnimFile(animFile);
-	for(p = gamename; *p; p++)
+		&def.id, def.model, def.txd,
+		type, def.handlingId, def.gameName, def.animFile, vehclass,
+		&def.frequency, &def.level, &def.compRules, &def.misc, &def.wheelScale);
+
+	for(p = def.gameName; *p; p++)
 		if(*p == '_') *p = ' ';
-	strcpy(mi->m_gameName, gamename);
-	mi->m_level = level;
-	mi->m_compRules = comprules;
 
-	if(strcmp(type, "car") == 0){
-		mi->m_wheelId = misc;
-		mi->m_wheelScale = wheelScale;
-		mi->m_vehicleType = VEHICLE_TYPE_CAR;
-	}else if(strcmp(type, "boat") == 0){
-		mi->m_vehicleType = VEHICLE_TYPE_BOAT;
-	}else if(strcmp(type, "train") == 0){
-		mi->m_vehicleType = VEHICLE_TYPE_TRAIN;
-	}else if(strcmp(type, "heli") == 0){
-		mi->m_vehicleType = VEHICLE_TYPE_HELI;
-	}else if(strcmp(type, "plane") == 0){
-		mi->m_planeLodId = misc;
-		mi->m_wheelScale = 1.0f;
-		mi->m_vehicleType = VEHICLE_TYPE_PLANE;
-	}else if(strcmp(type, "bike") == 0){
-		mi->m_bikeSteerAngle = misc;
-		mi->m_wheelScale = wheelScale;
-		mi->m_vehicleType = VEHICLE_TYPE_BIKE;
-	}else
+	if(strcmp(type, "car") == 0)
+		def.vehicleType = VEHICLE_TYPE_CAR;
+	else if(strcmp(type, "boat") == 0)
+		def.vehicleType = VEHICLE_TYPE_BOAT;
+	else if(strcmp(type, "train") == 0)
+		def.vehicleType = VEHICLE_TYPE_TRAIN;
+	else if(strcmp(type, "heli") == 0)
+		def.vehicleType = VEHICLE_TYPE_HELI;
+	else if(strcmp(type, "plane") == 0)
+		def.vehicleType = VEHICLE_TYPE_PLANE;
+	else if(strcmp(type, "bike") == 0)
+		def.vehicleType = VEHICLE_TYPE_BIKE;
+	else{
 		assert(0);
-
-	mi->m_handlingId = mod_HandlingManager.GetHandlingId(handlingId);
+		def.vehicleType = -1;
+	}
 
 	if(strcmp(vehclass, "normal") == 0)
-		mi->m_vehicleClass = CCarCtrl::NORMAL;
+		def.vehicleClass = CCarCtrl::NORMAL;
 	else if(strcmp(vehclass, "poorfamily") == 0)
-		mi->m_vehicleClass = CCarCtrl::POOR;
+		def.vehicleClass = CCarCtrl::POOR;
 	else if(strcmp(vehclass, "richfamily") == 0)
-		mi->m_vehicleClass = CCarCtrl::RICH;
+		def.vehicleClass = CCarCtrl::RICH;
 	else if(strcmp(vehclass, "executive") == 0)
-		mi->m_vehicleClass = CCarCtrl::EXEC;
+		def.vehicleClass = CCarCtrl::EXEC;
 	else if(strcmp(vehclass, "worker") == 0)
-		mi->m_vehicleClass = CCarCtrl::WORKER;
+		def.vehicleClass = CCarCtrl::WORKER;
 	else if(strcmp(vehclass, "big") == 0)
-		mi->m_vehicleClass = CCarCtrl::BIG;
+		def.vehicleClass = CCarCtrl::BIG;
 	else if(strcmp(vehclass, "taxi") == 0)
-		mi->m_vehicleClass = CCarCtrl::TAXI;
+		def.vehicleClass = CCarCtrl::TAXI;
 	else if(strcmp(vehclass, "moped") == 0)
-		mi->m_vehicleClass = CCarCtrl::MOPED;
+		def.vehicleClass = CCarCtrl::MOPED;
 	else if(strcmp(vehclass, "motorbike") == 0)
-		mi->m_vehicleClass = CCarCtrl::MOTORBIKE;
+		def.vehicleClass = CCarCtrl::MOTORBIKE;
 	else if(strcmp(vehclass, "leisureboat") == 0)
-		mi->m_vehicleClass = CCarCtrl::LEISUREBOAT;
+		def.vehicleClass = CCarCtrl::LEISUREBOAT;
 	else if(strcmp(vehclass, "workerboat") == 0)
-		mi->m_vehicleClass = CCarCtrl::WORKERBOAT;
-	else if(strcmp(vehclass, "ignore") == 0) {
+		def.vehicleClass = CCarCtrl::WORKERBOAT;
+	else if(strcmp(vehclass, "ignore") == 0)
+		def.vehicleClass = -1;
+	else
+		def.vehicleClass = -2;	// game leaves the class alone
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_CARS, &def, sizeof(def));
+#endif
+
+	AddVehicleObject(def);
+}
+
+void
+CFileLoader::AddVehicleObject(const VehicleObjectDef &def)
+{
+	CVehicleModelInfo *mi;
+
+	mi = CModelInfo::AddVehicleModel(def.id);
+	mi->SetModelName(def.model);
+	mi->SetTexDictionary(def.txd);
+	mi->SetAnimFile(def.animFile);
+	strcpy(mi->m_gameName, def.gameName);
+	mi->m_level = def.level;
+	mi->m_compRules = def.compRules;
+
+	switch(def.vehicleType){
+	case VEHICLE_TYPE_CAR:
+		mi->m_wheelId = def.misc;
+		mi->m_wheelScale = def.wheelScale;
+		mi->m_vehicleType = VEHICLE_TYPE_CAR;
+		break;
+	case VEHICLE_TYPE_BOAT:
+	case VEHICLE_TYPE_TRAIN:
+	case VEHICLE_TYPE_HELI:
+		mi->m_vehicleType = def.vehicleType;
+		break;
+	case VEHICLE_TYPE_PLANE:
+		mi->m_planeLodId = def.misc;
+		mi->m_wheelScale = 1.0f;
+		mi->m_vehicleType = VEHICLE_TYPE_PLANE;
+		break;
+	case VEHICLE_TYPE_BIKE:
+		mi->m_bikeSteerAngle = def.misc;
+		mi->m_wheelScale = def.wheelScale;
+		mi->m_vehicleType = VEHICLE_TYPE_BIKE;
+		break;
+	}
+
+	mi->m_handlingId = mod_HandlingManager.GetHandlingId(def.handlingId);
+
+	if(def.vehicleClass == -1){
 		mi->m_vehicleClass = -1;
 		return;
 	}
-	CCarCtrl::AddToCarArray(id, mi->m_vehicleClass);
-	mi->m_frequency = frequency;
+	if(def.vehicleClass >= 0)
+		mi->m_vehicleClass = def.vehicleClass;
+	CCarCtrl::AddToCarArray(def.id, mi->m_vehicleClass);
+	mi->m_frequency = def.frequency;
 }
 
 void
 CFileLoader::LoadPedObject(const char *line)
 {
-	int id;
-	char model[24], txd[24];
-	char pedType[24], pedStats[24], animGroup[24], animFile[16];
-	int carsCanDrive;
-	CPedModelInfo *mi;
-	int animGroupId;
-	int radio1, radio2;
+	PedObjectDef def;
+	char animGroup[24];
 
 	sscanf(line, "%d %s %s %s %s %s %x %s %d %d",
-	          &id, model, txd,
-	          pedType, pedStats, animGroup, &carsCanDrive,
-		  animFile, &radio1, &radio2);
-
-	mi = CModelInfo::AddPedModel(id);
-	mi->SetModelName(model);
-	mi->SetTexDictionary(txd);
-	mi->SetAnimFile(animFile);
-	mi->SetColModel(&CTempColModels::ms_colModelPed1);
-	mi->m_pedType = CPedType::FindPedType(pedType);
-	mi->m_pedStatType = CPedStats::GetPedStatType(pedStats);
-	for(animGroupId = 0; animGroupId < NUM_ANIM_ASSOC_GROUPS; animGroupId++)
-		if(strcmp(animGroup, CAnimManager::GetAnimGroupName((AssocGroupId)animGroupId)) == 0)
+	          &def.id, def.model, def.txd,
+	          def.pedType, def.pedStats, animGroup, &def.carsCanDrive,
+		  def.animFile, &def.radio1, &def.radio2);
+
+	for(def.animGroup = 0; def.animGroup < NUM_ANIM_ASSOC_GROUPS; def.animGroup++)
+		if(strcmp(animGroup, CAnimManager::GetAnimGroupName((AssocGroupId)def.animGroup)) == 0)
 			break;
-	assert(animGroupId < NUM_ANIM_ASSOC_GROUPS);
-	mi->m_animGroup = animGroupId;
-	mi->m_carsCanDrive = carsCanDrive;
-	mi->radio1 = radio1;
-	mi->radio2 = radio2;
+	assert(def.animGroup < NUM_ANIM_ASSOC_GROUPS);
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_PEDS, &def, sizeof(def));
+#endif
+
+	AddPedObject(def);
+}
+
+void
+CFileLoader::AddPedObject(const PedObjectDef &def)
+{
+	CPedModelInfo *mi;
+
+	mi = CModelInfo::AddPedModel(def.id);
+	mi->SetModelName(def.model);
+	mi->SetTexDictionary(def.txd);
+	mi->SetAnimFile(def.animFile);
+	mi->SetColModel(&CTempColModels::ms_colModelPed1);
+	mi->m_pedType = CPedType::FindPedType((char*)def.pedType);
+	mi->m_pedStatType = CPedStats::GetPedStatType((char*)def.pedStats);
+	mi->m_animGroup = def.animGroup;
+	mi->m_carsCanDrive = def.carsCanDrive;
+	mi->radio1 = def.radio1;
+	mi->radio2 = def.radio2;
 }
 
 int
@@ -959,136 +1164,168 @@ CFileLoader::LoadPathHeader(const char *line, int &type)
 	return id;
 }
 
-void
-CFileLoader::LoadPedPathNode(const char *line, int id, int node)
+static void
+LoadPathNode(const char *line, int id, int node, int pathType)
 {
-	int type, next, cross, numLeft, numRight, speed, flags;
-	float x, y, z, width, spawnRate;
+	PathNodeDef def;
 
+	def.id = id;
+	def.node = node;
+	def.pathType = pathType;
 	if(sscanf(line, "%d %d %d %f %f %f %f %d %d %d %d %f",
-			&type, &next, &cross, &x, &y, &z, &width, &numLeft, &numRight,
-			&speed, &flags, &spawnRate) != 12)
-		spawnRate = 1.0f;
+			&def.type, &def.next, &def.cross, &def.x, &def.y, &def.z, &def.width, &def.numLeft, &def.numRight,
+			&def.speed, &def.flags, &def.spawnRate) != 12)
+		def.spawnRate = 1.0f;
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_PATHNODE, &def, sizeof(def));
+#endif
 
-	if(id == -1)
-		ThePaths.StoreDetachedNodeInfoPed(node, type, next, x, y, z,
-			width, !!cross, !!(flags&1), !!(flags&4), spawnRate*15.0f);
-	else
-		ThePaths.StoreNodeInfoPed(id, node, type, next, x, y, z,
-			width, !!cross, spawnRate*15.0f);
+	CFileLoader::AddPathNode(def);
 }
 
 void
-CFileLoader::LoadCarPathNode(const char *line, int id, int node, bool waterPath)
+CFileLoader::LoadPedPathNode(const char *line, int id, int node)
 {
-	int type, next, cross, numLeft, numRight, speed, flags;
-	float x, y, z, width, spawnRate;
+	LoadPathNode(line, id, node, 0);
+}
 
-	if(sscanf(line, "%d %d %d %f %f %f %f %d %d %d %d %f",
-			&type, &next, &cross, &x, &y, &z, &width, &numLeft, &numRight,
-			&speed, &flags, &spawnRate) != 12)
-		spawnRate = 1.0f;
+void
+CFileLoader::LoadCarPathNode(const char *line, int id, int node, bool waterPath)
+{
+	LoadPathNode(line, id, node, waterPath ? 2 : 1);
+}
 
-	if(id == -1)
-		ThePaths.StoreDetachedNodeInfoCar(node, type, next, x, y, z, width, numLeft, numRight,
-			!!(flags&1), !!(flags&4), speed, !!(flags&2), waterPath, spawnRate * 15, false);
-	else
-		ThePaths.StoreNodeInfoCar(id, node, type, next, x, y, z, 0, numLeft, numRight,
-			!!(flags&1), !!(flags&4), speed, !!(flags&2), waterPath, spawnRate * 15);
+void
+CFileLoader::AddPathNode(const PathNodeDef &def)
+{
+	bool waterPath = def.pathType == 2;
+
+	if(def.pathType == 0){
+		if(def.id == -1)
+			ThePaths.StoreDetachedNodeInfoPed(def.node, def.type, def.next, def.x, def.y, def.z,
+				def.width, !!def.cross, !!(def.flags&1), !!(def.flags&4), def.spawnRate*15.0f);
+		else
+			ThePaths.StoreNodeInfoPed(def.id, def.node, def.type, def.next, def.x, def.y, def.z,
+				def.width, !!def.cross, def.spawnRate*15.0f);
+	}else{
+		if(def.id == -1)
+			ThePaths.StoreDetachedNodeInfoCar(def.node, def.type, def.next, def.x, def.y, def.z, def.width, def.numLeft, def.numRight,
+				!!(def.flags&1), !!(def.flags&4), def.speed, !!(def.flags&2), waterPath, def.spawnRate * 15, false);
+		else
+			ThePaths.StoreNodeInfoCar(def.id, def.node, def.type, def.next, def.x, def.y, def.z, 0, def.numLeft, def.numRight,
+				!!(def.flags&1), !!(def.flags&4), def.speed, !!(def.flags&2), waterPath, def.spawnRate * 15);
+	}
 }
 
 
 void
 CFileLoader::Load2dEffect(const char *line)
 {
-	int id, r, g, b, a, type, ptype;
-	float x, y, z;
-	char corona[32], shadow[32];
-	int shadowIntens, lightType, roadReflection, flare, flags, probability;
-	CBaseModelInfo *mi;
-	C2dEffect *effect;
+	Effect2dDef def;
 	char *p;
 
-	sscanf(line, "%d %f %f %f %d %d %d %d %d", &id, &x, &y, &z, &r, &g, &b, &a, &type);
-
-	CTxdStore::PushCurrentTxd();
-	CTxdStore::SetCurrentTxd(CTxdStore::FindTxdSlot("particle"));
+	memset(&def, 0, sizeof(def));
+	sscanf(line, "%d %f %f %f %d %d %d %d %d", &def.id, &def.pos.x, &def.pos.y, &def.pos.z,
+		&def.r, &def.g, &def.b, &def.a, &def.type);
 
-	mi = CModelInfo::GetModelInfo(id);
-	effect = CModelInfo::Get2dEffectStore().Alloc();
-	mi->Add2dEffect(effect);
-	effect->pos = CVector(x, y, z);
-	effect->col = CRGBA(r, g, b, a);
-	effect->type = type;
-
-	switch(effect->type){
+	switch(def.type){
 	case EFFECT_LIGHT:
 		while(*line++ != '"');
-		p = corona;
+		p = def.corona;
 		while(*line != '"') *p++ = *line++;
 		*p = '\0';
 		line++;
 
 		while(*line++ != '"');
-		p = shadow;
+		p = def.shadow;
 		while(*line != '"') *p++ = *line++;
 		*p = '\0';
 		line++;
 
 		sscanf(line, "%f %f %f %f %d %d %d %d %d",
-			&effect->light.dist,
-			&effect->light.range,
-			&effect->light.size,
-			&effect->light.shadowSize,
-			&shadowIntens, &lightType, &roadReflection, &flare, &flags);
-		effect->light.corona = RwTextureRead(corona, nil);
-		effect->light.shadow = RwTextureRead(shadow, nil);
-		effect->light.shadowIntensity = shadowIntens;
-		effect->light.lightType = lightType;
-		effect->light.roadReflection = roadReflection;
-		effect->light.flareType = flare;
+			&def.dist, &def.range, &def.size, &def.shadowSize,
+			&def.shadowIntensity, &def.lightType, &def.roadReflection, &def.flareType, &def.flags);
+		break;
+
+	case EFFECT_PARTICLE:
+		sscanf(line, "%*d %*f %*f %*f %*d %*d %*d %*d %*d %d %f %f %f %f",
+			&def.particleType, &def.dir.x, &def.dir.y, &def.dir.z, &def.scale);
+		break;
+
+	case EFFECT_ATTRACTOR:
+		sscanf(line, "%*d %*f %*f %*f %*d %*d %*d %*d %*d %d %f %f %f %d",
+			&def.flags, &def.dir.x, &def.dir.y, &def.dir.z, &def.probability);
+		break;
+
+	case EFFECT_PED_ATTRACTOR:
+		sscanf(line, "%*d %*f %*f %*f %*d %*d %*d %*d %*d %d %f %f %f %f %f %f",
+			&def.probability,
+			&def.dir.x, &def.dir.y, &def.dir.z,
+			&def.useDir.x, &def.useDir.y, &def.useDir.z);
+		break;
+	}
+
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_2DFX, &def, sizeof(def));
+#endif
+	Add2dEffect(def);
+}
+
+void
+CFileLoader::Add2dEffect(const Effect2dDef &def)
+{
+	CBaseModelInfo *mi;
+	C2dEffect *effect;
+	int flags;
+
+	CTxdStore::PushCurrentTxd();
+	CTxdStore::SetCurrentTxd(CTxdStore::FindTxdSlot("particle"));
+
+	mi = CModelInfo::GetModelInfo(def.id);
+	effect = CModelInfo::Get2dEffectStore().Alloc();
+	mi->Add2dEffect(effect);
+	effect->pos = def.pos;
+	effect->col = CRGBA(def.r, def.g, def.b, def.a);
+	effect->type = def.type;
 
+	switch(effect->type){
+	case EFFECT_LIGHT:
+		effect->light.dist = def.dist;
+		effect->light.range = def.range;
+		effect->light.size = def.size;
+		effect->light.shadowSize = def.shadowSize;
+		effect->light.corona = RwTextureRead(def.corona, nil);
+		effect->light.shadow = RwTextureRead(def.shadow, nil);
+		effect->light.shadowIntensity = def.shadowIntensity;
+		effect->light.lightType = def.lightType;
+		effect->light.roadReflection = def.roadReflection;
+		effect->light.flareType = def.flareType;
+
+		flags = def.flags;
 		if(flags & LIGHTFLAG_FOG_ALWAYS)
 			flags &= ~LIGHTFLAG_FOG_NORMAL;
 		effect->light.flags = flags;
 		break;
 
 	case EFFECT_PARTICLE:
-		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %f",
-			&id, &x, &y, &z, &r, &g, &b, &a, &type,
-			&effect->particle.particleType,
-			&effect->particle.dir.x,
-			&effect->particle.dir.y,
-			&effect->particle.dir.z,
-			&effect->particle.scale);
+		effect->particle.particleType = def.particleType;
+		effect->particle.dir = def.dir;
+		effect->particle.scale = def.scale;
 		break;
 
 	case EFFECT_ATTRACTOR:
-		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %d",
-			&id, &x, &y, &z, &r, &g, &b, &a, &type,
-			&flags,
-			&effect->attractor.dir.x,
-			&effect->attractor.dir.y,
-			&effect->attractor.dir.z,
-			&probability);
-		effect->attractor.type = flags;
+		effect->attractor.type = def.flags;
+		effect->attractor.dir = def.dir;
 #ifdef FIX_BUGS
-		effect->attractor.probability = clamp(probability, 0, 255);
+		effect->attractor.probability = clamp(def.probability, 0, 255);
 #else
-		effect->attractor.probability = probability;
+		effect->attractor.probability = def.probability;
 #endif
 		break;
 	case EFFECT_PED_ATTRACTOR:
-		sscanf(line, "%d %f %f %f %d %d %d %d %d %d %f %f %f %f %f %f",
-			&id, &x, &y, &z, &r, &g, &b, &a, &type,
-			&ptype,
-			&effect->pedattr.queueDir.x,
-			&effect->pedattr.queueDir.y,
-			&effect->pedattr.queueDir.z,
-			&effect->pedattr.useDir.x,
-			&effect->pedattr.useDir.y,
-			&effect->pedattr.useDir.z);
-		effect->pedattr.type = ptype;
+		effect->pedattr.type = def.probability;
+		effect->pedattr.queueDir = def.dir;
+		effect->pedattr.useDir = def.useDir;
 		break;
 	}
 
@@ -1116,6 +1353,17 @@ CFileLoader::LoadScene(const char *filename)
 	pathIndex = -1;
 	debug("Creating objects from %s...\n", filename);
 
+#ifdef LEVEL_CACHE
+	uint8 *records;
+	uint32 size;
+	int minID = INT32_MAX, maxID = -1;
+	if(CLevelCache::StartFile(filename, records, size)){
+		ReplayLevelRecords(records, size, minID, maxID);
+		debug("Finished loading IPL\n");
+		return;
+	}
+#endif
+
 	fd = CFileMgr::OpenFile(filename, "rb");
 	assert(fd > 0);
 	for(line = CFileLoader::LoadLine(fd); line; line = CFileLoader::LoadLine(fd)){
@@ -1167,36 +1415,64 @@ CFileLoader::LoadScene(const char *filename)
 		}
 	}
 	CFileMgr::CloseFile(fd);
+#ifdef LEVEL_CACHE
+	CLevelCache::EndFile();
+#endif
 
 	debug("Finished loading IPL\n");
 }
 
+
 void
 CFileLoader::LoadObjectInstance(const char *line)
 {
-	int id;
+	InstanceDef def;
+	InstancePlacement inst;
 	char name[24];
-	RwV3d trans, scale, axis;
-	float angle;
-	CSimpleModelInfo *mi;
 	RwMatrix *xform;
-	CEntity *entity;
-	float area;
 
 	if(sscanf(line, "%d %s %f %f %f %f %f %f %f %f %f %f %f",
-	          &id, name, &area,
-	          &trans.x, &trans.y, &trans.z,
-	          &scale.x, &scale.y, &scale.z,
-	          &axis.x, &axis.y, &axis.z, &angle) != 13){
+	          &def.id, name, &def.area,
+	          &def.trans.x, &def.trans.y, &def.trans.z,
+	          &def.scale.x, &def.scale.y, &def.scale.z,
+	          &def.axis.x, &def.axis.y, &def.axis.z, &def.angle) != 13){
 		if(sscanf(line, "%d %s %f %f %f %f %f %f %f %f %f %f",
-		          &id, name,
-		          &trans.x, &trans.y, &trans.z,
-		          &scale.x, &scale.y, &scale.z,
-		          &axis.x, &axis.y, &axis.z, &angle) != 12)
+		          &def.id, name,
+		          &def.trans.x, &def.trans.y, &def.trans.z,
+		          &def.scale.x, &def.scale.y, &def.scale.z,
+		          &def.axis.x, &def.axis.y, &def.axis.z, &def.angle) != 12)
 			return;
-		area = 0;
+		def.area = 0;
 	}
 
+	if(CModelInfo::GetModelInfo(def.id) == nil)
+		return;
+
+	xform = RwMatrixCreate();
+	RwMatrixRotate(xform, &def.axis, -RADTODEG(2.0f * acosf(def.angle)), rwCOMBINEREPLACE);
+	RwMatrixTranslate(xform, &def.trans, rwCOMBINEPOSTCONCAT);
+	CMatrix mat(xform, true);
+	inst.id = def.id;
+	inst.area = def.area;
+	inst.right = mat.GetRight();
+	inst.forward = mat.GetForward();
+	inst.up = mat.GetUp();
+	inst.pos = mat.GetPosition();
+
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_INST, &inst, sizeof(inst));
+#endif
+	AddObjectInstance(inst);
+}
+
+void
+CFileLoader::AddObjectInstance(const InstancePlacement &inst)
+{
+	int id = inst.id;
+	CSimpleModelInfo *mi;
+	CMatrix mat;
+	CEntity *entity;
+
 	mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(id);
 	if(mi == nil)
 		return;
@@ -1205,10 +1481,10 @@ CFileLoader::LoadObjectInstance(const char *line)
 	if(!CStreaming::IsObjectInCdImage(id))
 		debug("Not in cdimage %s\n", mi->GetModelName());
 
-	angle = -RADTODEG(2.0f * acosf(angle));
-	xform = RwMatrixCreate();
-	RwMatrixRotate(xform, &axis, angle, rwCOMBINEREPLACE);
-	RwMatrixTranslate(xform, &trans, rwCOMBINEPOSTCONCAT);
+	mat.GetRight() = inst.right;
+	mat.GetForward() = inst.forward;
+	mat.GetUp() = inst.up;
+	mat.GetPosition() = inst.pos;
 
 	if(mi->GetObjectID() == -1){
 		if(ThePaths.IsPathObject(id)){
@@ -1217,9 +1493,9 @@ CFileLoader::LoadObjectInstance(const char *line)
 		}else
 			entity = new CBuilding;
 		entity->SetModelIndexNoCreate(id);
-		entity->GetMatrix() = CMatrix(xform);
+		entity->GetMatrix() = mat;
 		entity->m_level = CTheZones::GetLevelFromPosition(&entity->GetPosition());
-		entity->m_area = area;
+		entity->m_area = inst.area;
 		if(mi->IsBuilding()){
 			if(mi->m_isBigBuilding)
 				entity->SetupBigBuilding();
@@ -1242,44 +1518,60 @@ CFileLoader::LoadObjectInstance(const char *line)
 	}else{
 		entity = new CDummyObject;
 		entity->SetModelIndexNoCreate(id);
-		entity->GetMatrix() = CMatrix(xform);
+		entity->GetMatrix() = mat;
 		CWorld::Add(entity);
 		if(IsGlass(entity->GetModelIndex()) && !mi->m_isArtistGlass)
 			entity->bIsVisible = false;
 		entity->m_level = CTheZones::GetLevelFromPosition(&entity->GetPosition());
-		entity->m_area = area;
+		entity->m_area = inst.area;
 	}
+}
 
-	RwMatrixDestroy(xform);
+static void
+AddZone(const ZoneDef &def)
+{
+	char name[24];
+
+	// CreateZone upper cases the name in place
+	strncpy(name, def.name, sizeof(name));
+	name[sizeof(name)-1] = '\0';
+	CTheZones::CreateZone(name, (eZoneType)def.type, def.minx, def.miny, def.minz, def.maxx, def.maxy, def.maxz, (eLevelName)def.level);
 }
 
 void
 CFileLoader::LoadZone(const char *line)
 {
-	char name[24];
-	int type, level;
-	float minx, miny, minz;
-	float maxx, maxy, maxz;
+	ZoneDef def;
+
+	if(sscanf(line, "%s %d %f %f %f %f %f %f %d", def.name, &def.type, &def.minx, &def.miny, &def.minz, &def.maxx, &def.maxy, &def.maxz, &def.level) == 9){
+#ifdef LEVEL_CACHE
+		CLevelCache::AddRecord(LEVELREC_ZONE, &def, sizeof(def));
+#endif
+		AddZone(def);
+	}
+}
 
-	if(sscanf(line, "%s %d %f %f %f %f %f %f %d", name, &type, &minx, &miny, &minz, &maxx, &maxy, &maxz, &level) == 9)
-		CTheZones::CreateZone(name, (eZoneType)type, minx, miny, minz, maxx, maxy, maxz, (eLevelName)level);
+static void
+AddCullZone(const CullZoneDef &def)
+{
+	CCullZones::AddCullZone(def.pos, def.minx, def.maxx, def.miny, def.maxy, def.minz, def.maxz, def.flags, def.wantedLevelDrop);
 }
 
 void
 CFileLoader::LoadCullZone(const char *line)
 {
-	CVector pos;
-	float minx, miny, minz;
-	float maxx, maxy, maxz;
-	int flags;
-	int wantedLevelDrop = 0;
+	CullZoneDef def;
 
+	def.wantedLevelDrop = 0;
 	sscanf(line, "%f %f %f %f %f %f %f %f %f %d %d",
-		&pos.x, &pos.y, &pos.z,
-		&minx, &miny, &minz,
-		&maxx, &maxy, &maxz,
-		&flags, &wantedLevelDrop);
-	CCullZones::AddCullZone(pos, minx, maxx, miny, maxy, minz, maxz, flags, wantedLevelDrop);
+		&def.pos.x, &def.pos.y, &def.pos.z,
+		&def.minx, &def.miny, &def.minz,
+		&def.maxx, &def.maxy, &def.maxz,
+		&def.flags, &def.wantedLevelDrop);
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_CULL, &def, sizeof(def));
+#endif
+	AddCullZone(def);
 }
 
 // unused
@@ -1292,19 +1584,100 @@ CFileLoader::LoadPickup(const char *line)
 	sscanf(line, "%d %f %f %f", &id, &x, &y, &z);
 }
 
+static void
+AddOcclusionVolume(const OcclusionDef &def)
+{
+	COcclusion::AddOne(def.x, def.y, def.z + def.height/2.0f, def.width, def.length, def.height, def.angle);
+}
+
 void
 CFileLoader::LoadOcclusionVolume(const char *line)
 {
-	float x, y, z;
-	float width, length, height;
-	float angle;
+	OcclusionDef def;
 
 	sscanf(line, "%f %f %f %f %f %f %f",
-		&x, &y, &z,
-		&width, &length, &height,
-		&angle);
-	COcclusion::AddOne(x, y, z + height/2.0f, width, length, height, angle);
+		&def.x, &def.y, &def.z,
+		&def.width, &def.length, &def.height,
+		&def.angle);
+#ifdef LEVEL_CACHE
+	CLevelCache::AddRecord(LEVELREC_OCCL, &def, sizeof(def));
+#endif
+	AddOcclusionVolume(def);
+}
+
+#ifdef LEVEL_CACHE
+// Creates everything recorded for one IDE or IPL file by the level cache
+void
+CFileLoader::ReplayLevelRecords(uint8 *records, uint32 size, int &minID, int &maxID)
+{
+	LevelCacheRecord *rec;
+	uint8 *data;
+	uint32 dataSize;
+	int id;
+
+	while(size >= sizeof(LevelCacheRecord)){
+		rec = (LevelCacheRecord*)records;
+		if(rec->size < sizeof(LevelCacheRecord) || rec->size > size)
+			break;
+		data = records + sizeof(LevelCacheRecord);
+		dataSize = rec->size - sizeof(LevelCacheRecord);
+		records += rec->size;
+		size -= rec->size;
+
+		switch(rec->type){
+#define CHECK_SIZE(s) if(dataSize < (s)) continue
+		case LEVELREC_OBJS:
+		case LEVELREC_TOBJ:
+			CHECK_SIZE(sizeof(ObjectDef));
+			id = rec->type == LEVELREC_OBJS ? AddObject(*(ObjectDef*)data) : AddTimeObject(*(ObjectDef*)data);
+			if(id > maxID) maxID = id;
+			if(id < minID) minID = id;
+			break;
+		case LEVELREC_WEAP:
+			CHECK_SIZE(sizeof(WeaponObjectDef));
+			AddWeaponObject(*(WeaponObjectDef*)data);
+			break;
+		case LEVELREC_HIER:
+			CHECK_SIZE(sizeof(ClumpObjectDef));
+			AddClumpObject(*(ClumpObjectDef*)data);
+			break;
+		case LEVELREC_CARS:
+			CHECK_SIZE(sizeof(VehicleObjectDef));
+			AddVehicleObject(*(VehicleObjectDef*)data);
+			break;
+		case LEVELREC_PEDS:
+			CHECK_SIZE(sizeof(PedObjectDef));
+			AddPedObject(*(PedObjectDef*)data);
+			break;
+		case LEVELREC_PATHNODE:
+			CHECK_SIZE(sizeof(PathNodeDef));
+			AddPathNode(*(PathNodeDef*)data);
+			break;
+		case LEVELREC_2DFX:
+			CHECK_SIZE(sizeof(Effect2dDef));
+			Add2dEffect(*(Effect2dDef*)data);
+			break;
+		case LEVELREC_INST:
+			CHECK_SIZE(sizeof(InstancePlacement));
+			AddObjectInstance(*(InstancePlacement*)data);
+			break;
+		case LEVELREC_ZONE:
+			CHECK_SIZE(sizeof(ZoneDef));
+			AddZone(*(ZoneDef*)data);
+			break;
+		case LEVELREC_CULL:
+			CHECK_SIZE(sizeof(CullZoneDef));
+			AddCullZone(*(CullZoneDef*)data);
+			break;
+		case LEVELREC_OCCL:
+			CHECK_SIZE(sizeof(OcclusionDef));
+			AddOcclusionVolume(*(OcclusionDef*)data);
+			break;
+#undef CHECK_SIZE
+		}
+	}
 }
+#endif
 
 
 // unused
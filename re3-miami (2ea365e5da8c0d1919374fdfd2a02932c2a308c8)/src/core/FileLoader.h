@@ -1,16 +1,148 @@
 #pragma once
 
+// Parsed IDE/IPL lines
+struct ObjectDef
+{
+	int32 id;
+	char model[24];
+	char txd[24];
+	int32 numObjs;
+	float dist[3];
+	uint32 flags;
+	int32 damaged;
+	int32 timeOn, timeOff;	// tobj only
+};
+
+struct WeaponObjectDef
+{
+	int32 id;
+	char model[24];
+	char txd[24];
+	char animFile[16];
+	float dist;
+};
+
+struct ClumpObjectDef
+{
+	int32 id;
+	char model[24];
+	char txd[24];
+};
+
+struct VehicleObjectDef
+{
+	int32 id;
+	char model[24];
+	char txd[24];
+	char handlingId[16];
+	char gameName[32];	// with spaces
+	char animFile[16];
+	int32 vehicleType;
+	int32 vehicleClass;	// -1 for ignore
+	uint32 frequency, compRules;
+	int32 level, misc;
+	float wheelScale;
+};
+
+struct PedObjectDef
+{
+	int32 id;
+	char model[24];
+	char txd[24];
+	char pedType[24];
+	char pedStats[24];
+	char animFile[16];
+	int32 animGroup;
+	int32 carsCanDrive;
+	int32 radio1, radio2;
+};
+
+struct PathNodeDef
+{
+	int32 id;	// -1 for nodes of an IPL
+	int32 node;
+	int32 pathType;	// 0 ped, 1 car, 2 water
+	int32 type, next, cross, numLeft, numRight, speed, flags;
+	float x, y, z, width, spawnRate;
+};
+
+struct Effect2dDef
+{
+	int32 id;
+	CVector pos;
+	int32 r, g, b, a;
+	int32 type;
+	// light
+	char corona[32], shadow[32];
+	float dist, range, size, shadowSize;
+	int32 shadowIntensity, lightType, roadReflection, flareType;
+	int32 flags;	// light flags or attractor type
+	// particle
+	int32 particleType;
+	float scale;
+	// particle, attractor and ped attractor
+	CVector dir;
+	CVector useDir;
+	int32 probability;	// or ped attractor type
+};
+
+struct InstanceDef
+{
+	int32 id;
+	float area;
+	RwV3d trans, scale, axis;
+	float angle;
+};
+
+// Where an instance ends up, the rotation already turned into a matrix
+struct InstancePlacement
+{
+	int32 id;
+	float area;
+	CVector right, forward, up, pos;
+};
+
+struct ZoneDef
+{
+	char name[24];
+	int32 type, level;
+	float minx, miny, minz;
+	float maxx, maxy, maxz;
+};
+
+struct CullZoneDef
+{
+	CVector pos;
+	float minx, miny, minz;
+	float maxx, maxy, maxz;
+	int32 flags;
+	int32 wantedLevelDrop;
+};
+
+struct OcclusionDef
+{
+	float x, y, z;
+	float width, length, height;
+	float angle;
+};
+
 class CFileLoader
 {
 	static char ms_line[256];
 public:
 	static void LoadLevel(const char *filename);
+#ifndef MASTER
+	static void PrintLoadTimes(void);
+#endif
 	static char *LoadLine(int fd);
 	static RwTexDictionary *LoadTexDictionary(const char *filename);
 	static void LoadCollisionFile(const char *filename, uint8 colSlot);
 	static bool LoadCollisionFileFirstTime(uint8 *buffer, uint32 size, uint8 colSlot);
 	static bool LoadCollisionFile(uint8 *buffer, uint32 size, uint8 colSlot);
 	static void LoadCollisionModel(uint8 *buf, struct CColModel &model, char *name);
+#ifdef ASYNC_STREAM_DECODE
+	static bool DecodeCollisionFile(uint8 *buffer, uint32 size, struct CDecodedColModel *&models, int32 &numModels);
+#endif
 	static void LoadModelFile(const char *filename);
 	static RpAtomic *FindRelatedModelInfoCB(RpAtomic *atomic, void *data);
 	static void LoadClumpFile(const char *filename);
@@ -24,22 +156,34 @@ public:
 
 	static void LoadObjectTypes(const char *filename);
 	static int LoadObject(const char *line);
+	static int AddObject(const ObjectDef &def);
 	static int LoadTimeObject(const char *line);
+	static int AddTimeObject(const ObjectDef &def);
 	static int LoadWeaponObject(const char *line);
+	static int AddWeaponObject(const WeaponObjectDef &def);
 	static void LoadClumpObject(const char *line);
+	static void AddClumpObject(const ClumpObjectDef &def);
 	static void LoadVehicleObject(const char *line);
+	static void AddVehicleObject(const VehicleObjectDef &def);
 	static void LoadPedObject(const char *line);
+	static void AddPedObject(const PedObjectDef &def);
 	static int LoadPathHeader(const char *line, int &type);
 	static void LoadPedPathNode(const char *line, int id, int node);
 	static void LoadCarPathNode(const char *line, int id, int node, bool waterPath);
+	static void AddPathNode(const PathNodeDef &def);
 	static void Load2dEffect(const char *line);
+	static void Add2dEffect(const Effect2dDef &def);
 
 	static void LoadScene(const char *filename);
 	static void LoadObjectInstance(const char *line);
+	static void AddObjectInstance(const InstancePlacement &inst);
 	static void LoadZone(const char *line);
 	static void LoadCullZone(const char *line);
 	static void LoadPickup(const char *line);
 	static void LoadOcclusionVolume(const char *line);
+#ifdef LEVEL_CACHE
+	static void ReplayLevelRecords(uint8 *records, uint32 size, int &minID, int &maxID);
+#endif
 
 	static void ReloadPaths(const char *filename);
 	static void ReloadObjectTypes(const char *filename);
@@ -10,6 +10,7 @@
 #include "CarCtrl.h"
 #include "CarGen.h"
 #include "CdStream.h"
+#include "JobPool.h"
 #include "Clock.h"
 #include "Clouds.h"
 #include "Collision.h"
@@ -163,6 +164,7 @@ CGame::InitialiseOnceBeforeRW(void)
 {
 	CFileMgr::Initialise();
 	CdStreamInit(MAX_CDCHANNELS);
+	CJobPool::Initialise();
 	debug("size of matrix %d\n", sizeof(CMatrix));
 	debug("size of placeable %d\n", sizeof(CPlaceable));
 	debug("size of entity %d\n", sizeof(CEntity));
@@ -267,6 +269,9 @@ CGame::InitialiseRenderWare(void)
 #ifdef EXTENDED_PIPELINES
 	CustomPipes::CustomPipeInit();	// need Scene.world for this
 #endif
+#ifdef INSTANCED_WORLD_RENDER
+	WorldRender::CreateInstancing();
+#endif
 #ifdef SCREEN_DROPLETS
 	ScreenDroplets::InitDraw();
 #endif
@@ -282,6 +287,9 @@ void CGame::ShutdownRenderWare(void)
 #ifdef EXTENDED_PIPELINES
 	CustomPipes::CustomPipeShutdown();
 #endif
+#ifdef INSTANCED_WORLD_RENDER
+	WorldRender::DestroyInstancing();
+#endif
 
 	DestroySplashScreen();
 	CHud::Shutdown();
@@ -353,6 +361,7 @@ CGame::FinalShutdown(void)
 	CTxdStore::Shutdown();
 	CPedStats::Shutdown();
 	CdStreamShutdown();
+	CJobPool::Shutdown();
 }
 
 bool CGame::Initialise(const char* datFile)
@@ -440,6 +449,9 @@ bool CGame::Initialise(const char* datFile)
 
 	CFileLoader::LoadLevel("DATA\\DEFAULT.DAT");
 	CFileLoader::LoadLevel(datFile);
+#ifndef MASTER
+	CFileLoader::PrintLoadTimes();
+#endif
 #ifdef EXTENDED_PIPELINES
 	// for generic fallback
 	CustomPipes::SetTxdFindCallback();
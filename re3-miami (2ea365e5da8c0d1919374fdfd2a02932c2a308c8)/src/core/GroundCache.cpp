@@ -0,0 +1,283 @@
+#include "common.h"
+
+#ifdef GROUND_HEIGHT_CACHE
+#include "General.h"
+#include "Entity.h"
+#include "ModelInfo.h"
+#include "World.h"
+#include "ColStore.h"
+#include "GroundCache.h"
+
+#define GROUNDCACHE_TOLERANCE 0.05f	// how far samples may be off the plane
+#define GROUNDCACHE_MARGIN 0.5f	// 3d queries closer than this to the surface still go to the world
+
+CGroundCacheCell CGroundCache::ms_aCells[GROUNDCACHE_TILESIZE][GROUNDCACHE_TILESIZE];
+int32 CGroundCache::ms_numUsedCells;
+bool CGroundCache::ms_bEnabled = true;
+int32 CGroundCache::ms_numHits;
+int32 CGroundCache::ms_numMisses;
+int32 CGroundCache::ms_numRough;
+int32 CGroundCache::ms_numInvalidated;
+
+static float
+GetCellCentre(int16 i)
+{
+	return (i + 0.5f) * GROUNDCACHE_CELLSIZE;
+}
+
+// Top surface at x,y, the same line FindGroundZForCoord uses
+static bool
+SampleTopSurface(float x, float y, float &z, bool &dummy)
+{
+	CColPoint point;
+	CEntity *entity;
+	if(!CWorld::ProcessVerticalLine(CVector(x, y, 1000.0f), -1000.0f, point, entity, true, false, false, false, true, false, nil))
+		return false;
+	z = point.point.z;
+	dummy = entity->IsDummy();
+	return true;
+}
+
+// Centre and corners of the cell. The 3d queries don't look at dummies,
+// so a cell with one on top would answer them wrongly.
+void
+CGroundCache::FillCell(CGroundCacheCell *cell)
+{
+	int i, numHits;
+	float cx = GetCellCentre(cell->x);
+	float cy = GetCellCentre(cell->y);
+	float d = GROUNDCACHE_CELLSIZE/2.0f - 0.01f;
+	float offsets[5][2] = { { 0.0f, 0.0f }, { -d, -d }, { d, -d }, { -d, d }, { d, d } };
+	float z[5];
+	bool dummy = false;
+	bool isDummy;
+
+	numHits = 0;
+	for(i = 0; i < 5; i++){
+		if(SampleTopSurface(cx + offsets[i][0], cy + offsets[i][1], z[i], isDummy)){
+			numHits++;
+			dummy |= isDummy;
+		}
+	}
+	if(numHits == 0){
+		cell->state = GROUNDCELL_NOGROUND;
+		return;
+	}
+	if(numHits < 5 || dummy){
+		cell->state = GROUNDCELL_ROUGH;
+		return;
+	}
+
+	cell->z = z[0];
+	cell->dzdx = (z[2] + z[4] - z[1] - z[3]) / (4.0f*d);
+	cell->dzdy = (z[3] + z[4] - z[1] - z[2]) / (4.0f*d);
+	cell->state = GROUNDCELL_FLAT;
+	for(i = 1; i < 5; i++)
+		if(Abs(z[0] + offsets[i][0]*cell->dzdx + offsets[i][1]*cell->dzdy - z[i]) > GROUNDCACHE_TOLERANCE)
+			cell->state = GROUNDCELL_ROUGH;
+}
+
+// nil if the cell can't answer (yet)
+CGroundCacheCell*
+CGroundCache::LookupCell(float x, float y)
+{
+	if(!ms_bEnabled)
+		return nil;
+
+	int16 cx = Floor(x / GROUNDCACHE_CELLSIZE);
+	int16 cy = Floor(y / GROUNDCACHE_CELLSIZE);
+	CGroundCacheCell *cell = &ms_aCells[cy & (GROUNDCACHE_TILESIZE-1)][cx & (GROUNDCACHE_TILESIZE-1)];
+
+	if(cell->state == GROUNDCELL_EMPTY || cell->x != cx || cell->y != cy){
+		// only sample cells that are asked for more than once
+		if(cell->state == GROUNDCELL_EMPTY)
+			ms_numUsedCells++;
+		cell->x = cx;
+		cell->y = cy;
+		cell->state = GROUNDCELL_TOUCHED;
+		ms_numMisses++;
+		return nil;
+	}
+	if(cell->state == GROUNDCELL_TOUCHED){
+		ms_numMisses++;
+		// holes in the collision aren't worth remembering
+		if(!CColStore::HasCollisionLoaded(CVector2D(GetCellCentre(cx), GetCellCentre(cy))))
+			return nil;
+		FillCell(cell);
+		if(cell->state == GROUNDCELL_ROUGH)
+			return nil;
+		return cell;
+	}
+	if(cell->state == GROUNDCELL_ROUGH){
+		ms_numRough++;
+		return nil;
+	}
+	ms_numHits++;
+	return cell;
+}
+
+static float
+GetCellZ(const CGroundCacheCell *cell, float x, float y)
+{
+	return cell->z + (x - GetCellCentre(cell->x))*cell->dzdx + (y - GetCellCentre(cell->y))*cell->dzdy;
+}
+
+bool
+CGroundCache::FindGroundZForCoord(float x, float y, float &z, bool &found)
+{
+	CGroundCacheCell *cell = LookupCell(x, y);
+	if(cell == nil)
+		return false;
+	found = cell->state == GROUNDCELL_FLAT;
+	if(found)
+		z = GetCellZ(cell, x, y);
+	return true;
+}
+
+// Nothing is above the top surface, so from above it that's the ground
+bool
+CGroundCache::FindGroundZFor3DCoord(float x, float y, float z, float &groundZ, bool &found)
+{
+	CGroundCacheCell *cell = LookupCell(x, y);
+	if(cell == nil)
+		return false;
+	found = cell->state == GROUNDCELL_FLAT;
+	if(found){
+		groundZ = GetCellZ(cell, x, y);
+		if(z < groundZ + GROUNDCACHE_MARGIN)
+			return false;
+	}
+	return true;
+}
+
+// and nothing above it either
+bool
+CGroundCache::IsClearAbove(float x, float y, float z)
+{
+	CGroundCacheCell *cell = LookupCell(x, y);
+	if(cell == nil)
+		return false;
+	return cell->state == GROUNDCELL_NOGROUND || z >= GetCellZ(cell, x, y) + GROUNDCACHE_MARGIN;
+}
+
+static bool
+CellTouchesRect(const CGroundCacheCell *cell, const CRect &rect)
+{
+	float x = GetCellCentre(cell->x);
+	float y = GetCellCentre(cell->y);
+	return x + GROUNDCACHE_CELLSIZE/2.0f >= rect.left && x - GROUNDCACHE_CELLSIZE/2.0f <= rect.right &&
+		y + GROUNDCACHE_CELLSIZE/2.0f >= rect.top && y - GROUNDCACHE_CELLSIZE/2.0f <= rect.bottom;
+}
+
+// Only the slots the cells under rect map to, unless rect is as big as the table
+void
+CGroundCache::Invalidate(const CRect &rect)
+{
+	int i, cx, cy;
+	CGroundCacheCell *cell;
+
+	if(ms_numUsedCells == 0)
+		return;
+	int cx0 = Floor(rect.left / GROUNDCACHE_CELLSIZE) - 1;
+	int cx1 = Floor(rect.right / GROUNDCACHE_CELLSIZE) + 1;
+	int cy0 = Floor(rect.top / GROUNDCACHE_CELLSIZE) - 1;
+	int cy1 = Floor(rect.bottom / GROUNDCACHE_CELLSIZE) + 1;
+	if(cx1 - cx0 >= GROUNDCACHE_TILESIZE || cy1 - cy0 >= GROUNDCACHE_TILESIZE){
+		for(i = 0; i < GROUNDCACHE_TILESIZE*GROUNDCACHE_TILESIZE; i++){
+			cell = &ms_aCells[0][i];
+			if(cell->state == GROUNDCELL_EMPTY || !CellTouchesRect(cell, rect))
+				continue;
+			cell->state = GROUNDCELL_EMPTY;
+			ms_numUsedCells--;
+			ms_numInvalidated++;
+		}
+		return;
+	}
+	for(cy = cy0; cy <= cy1; cy++)
+		for(cx = cx0; cx <= cx1; cx++){
+			cell = &ms_aCells[cy & (GROUNDCACHE_TILESIZE-1)][cx & (GROUNDCACHE_TILESIZE-1)];
+			// the slot may hold a cell from somewhere else
+			if(cell->state == GROUNDCELL_EMPTY || cell->x != cx || cell->y != cy || !CellTouchesRect(cell, rect))
+				continue;
+			cell->state = GROUNDCELL_EMPTY;
+			ms_numUsedCells--;
+			ms_numInvalidated++;
+		}
+}
+
+// Buildings and dummies that come, go or change model
+void
+CGroundCache::InvalidateEntity(CEntity *entity)
+{
+	if(ms_numUsedCells == 0 || CModelInfo::GetModelInfo(entity->GetModelIndex())->GetColModel() == nil)
+		return;
+	Invalidate(entity->GetBoundRect());
+}
+
+void
+CGroundCache::Clear(void)
+{
+	int i;
+	for(i = 0; i < GROUNDCACHE_TILESIZE*GROUNDCACHE_TILESIZE; i++)
+		ms_aCells[0][i].state = GROUNDCELL_EMPTY;
+	ms_numUsedCells = 0;
+}
+
+void
+CGroundCache::PrintStats(void)
+{
+	int i;
+	int32 numStates[GROUNDCELL_ROUGH+1] = { 0 };
+	int32 numQueries = ms_numHits + ms_numMisses + ms_numRough;
+
+	for(i = 0; i < GROUNDCACHE_TILESIZE*GROUNDCACHE_TILESIZE; i++)
+		numStates[ms_aCells[0][i].state]++;
+	debug("Ground cache: %d queries, %d hits (%.1f%%), %d misses, %d rough, %d cells invalidated\n",
+		numQueries, ms_numHits, numQueries ? 100.0f*ms_numHits/numQueries : 0.0f,
+		ms_numMisses, ms_numRough, ms_numInvalidated);
+	debug("Ground cache cells: %d flat, %d no ground, %d rough, %d touched, %d empty\n",
+		numStates[GROUNDCELL_FLAT], numStates[GROUNDCELL_NOGROUND], numStates[GROUNDCELL_ROUGH],
+		numStates[GROUNDCELL_TOUCHED], numStates[GROUNDCELL_EMPTY]);
+	ms_numHits = 0;
+	ms_numMisses = 0;
+	ms_numRough = 0;
+	ms_numInvalidated = 0;
+}
+
+// Random points in every cell that answers, against the real query
+void
+CGroundCache::CheckAgainstWorld(void)
+{
+	int i, j;
+	int32 numCells = 0, numErrors = 0;
+	float maxError = 0.0f;
+	float x, y, z, cachedZ;
+	bool dummy;
+
+	for(i = 0; i < GROUNDCACHE_TILESIZE*GROUNDCACHE_TILESIZE; i++){
+		CGroundCacheCell *cell = &ms_aCells[0][i];
+		if(cell->state != GROUNDCELL_FLAT && cell->state != GROUNDCELL_NOGROUND)
+			continue;
+		numCells++;
+		for(j = 0; j < 4; j++){
+			x = GetCellCentre(cell->x) + CGeneral::GetRandomNumberInRange(-GROUNDCACHE_CELLSIZE/2.0f, GROUNDCACHE_CELLSIZE/2.0f);
+			y = GetCellCentre(cell->y) + CGeneral::GetRandomNumberInRange(-GROUNDCACHE_CELLSIZE/2.0f, GROUNDCACHE_CELLSIZE/2.0f);
+			if(!SampleTopSurface(x, y, z, dummy)){
+				if(cell->state == GROUNDCELL_FLAT)
+					numErrors++;
+				continue;
+			}
+			if(cell->state == GROUNDCELL_NOGROUND){
+				numErrors++;
+				continue;
+			}
+			cachedZ = GetCellZ(cell, x, y);
+			maxError = Max(maxError, Abs(cachedZ - z));
+			if(Abs(cachedZ - z) > GROUNDCACHE_TOLERANCE)
+				numErrors++;
+		}
+	}
+	debug("Ground cache check: %d cells, %d of %d points off by more than %.2f, max error %.2f\n",
+		numCells, numErrors, numCells*4, GROUNDCACHE_TOLERANCE, maxError);
+}
+#endif
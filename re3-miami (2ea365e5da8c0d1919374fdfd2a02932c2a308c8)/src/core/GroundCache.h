@@ -0,0 +1,59 @@
+#pragma once
+
+class CEntity;
+class CRect;
+
+#define GROUNDCACHE_CELLSIZE 2.0f
+#define GROUNDCACHE_TILESIZE 64	// cells per side, the table wraps around every 128m
+
+// Heights of the topmost building surface in small cells around wherever the
+// ground queries are asked, filled in lazily. A cell is sampled at its centre and
+// corners the second time it's asked for, and only answers from then on if all
+// samples lie on one plane; anything bumpier keeps going to CWorld::ProcessVerticalLine.
+// Cells are thrown away when collision in their area is loaded or removed.
+
+enum {
+	GROUNDCELL_EMPTY,
+	GROUNDCELL_TOUCHED,	// asked for once
+	GROUNDCELL_FLAT,
+	GROUNDCELL_NOGROUND,
+	GROUNDCELL_ROUGH,
+};
+
+struct CGroundCacheCell
+{
+	int16 x;
+	int16 y;
+	uint8 state;
+	float z;	// at the centre
+	float dzdx;
+	float dzdy;
+};
+
+class CGroundCache
+{
+	static CGroundCacheCell ms_aCells[GROUNDCACHE_TILESIZE][GROUNDCACHE_TILESIZE];
+	static int32 ms_numUsedCells;
+
+	static CGroundCacheCell *LookupCell(float x, float y);
+	static void FillCell(CGroundCacheCell *cell);
+public:
+	static bool ms_bEnabled;
+	static int32 ms_numHits;
+	static int32 ms_numMisses;
+	static int32 ms_numRough;
+	static int32 ms_numInvalidated;
+
+	// These return true if the cache could answer the CWorld query of the same name
+	static bool FindGroundZForCoord(float x, float y, float &z, bool &found);
+	static bool FindGroundZFor3DCoord(float x, float y, float z, float &groundZ, bool &found);
+	// true if FindRoofZFor3DCoord is known to find nothing
+	static bool IsClearAbove(float x, float y, float z);
+
+	static void Invalidate(const CRect &rect);
+	static void InvalidateEntity(CEntity *entity);
+	static void Clear(void);
+
+	static void PrintStats(void);
+	static void CheckAgainstWorld(void);
+};
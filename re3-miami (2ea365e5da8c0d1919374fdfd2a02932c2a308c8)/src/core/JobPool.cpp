@@ -0,0 +1,316 @@
+#define WITHWINDOWS
+#include "common.h"
+#ifndef _WIN32
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#endif
+
+#include "JobPool.h"
+
+struct Job
+{
+	JobFunc func;
+	void *data;
+	CJobCounter *counter;
+};
+
+int32 CJobPool::ms_numThreads;
+bool CJobPool::ms_bEnabled = true;
+
+static Job gJobQueue[JOBPOOL_QUEUESIZE];
+static int32 gJobQueueHead;
+static int32 gNumQueuedJobs;
+static bool gbJobPoolShutdown;
+static JOBLOCAL bool gbHoldsWorldLock;
+
+#ifdef _WIN32
+static CRITICAL_SECTION gJobLock;
+static HANDLE gJobSema;	// one count per queued job
+static HANDLE gJobThreads[JOBPOOL_MAXTHREADS];
+static CRITICAL_SECTION gWorldLock;
+
+#define LockJobs() EnterCriticalSection(&gJobLock)
+#define UnlockJobs() LeaveCriticalSection(&gJobLock)
+#define YieldJobs() Sleep(0)
+#else
+static pthread_mutex_t gJobLock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t gJobCond = PTHREAD_COND_INITIALIZER;
+static pthread_t gJobThreads[JOBPOOL_MAXTHREADS];
+static pthread_mutex_t gWorldLock = PTHREAD_MUTEX_INITIALIZER;
+
+#define LockJobs() pthread_mutex_lock(&gJobLock)
+#define UnlockJobs() pthread_mutex_unlock(&gJobLock)
+#define YieldJobs() sched_yield()
+#endif
+
+// Called with the lock held
+static bool
+PopJob(Job *job)
+{
+	if(gNumQueuedJobs == 0)
+		return false;
+	*job = gJobQueue[gJobQueueHead];
+	gJobQueueHead = (gJobQueueHead + 1) % JOBPOOL_QUEUESIZE;
+	gNumQueuedJobs--;
+	return true;
+}
+
+static void
+RunJob(Job *job)
+{
+	job->func(job->data);
+	LockJobs();
+	job->counter->pending--;
+	UnlockJobs();
+}
+
+#ifdef _WIN32
+static DWORD WINAPI
+JobThread(LPVOID param)
+#else
+static void*
+JobThread(void *param)
+#endif
+{
+	Job job;
+
+	for(;;){
+#ifdef _WIN32
+		WaitForSingleObject(gJobSema, INFINITE);
+		LockJobs();
+#else
+		LockJobs();
+		while(gNumQueuedJobs == 0 && !gbJobPoolShutdown)
+			pthread_cond_wait(&gJobCond, &gJobLock);
+#endif
+		if(gbJobPoolShutdown){
+			UnlockJobs();
+			break;
+		}
+		bool haveJob = PopJob(&job);
+		UnlockJobs();
+		// on windows the job may already have been taken by a helping thread
+		if(haveJob)
+			RunJob(&job);
+	}
+	return 0;
+}
+
+static int32
+GetNumProcessors(void)
+{
+#ifdef _WIN32
+	SYSTEM_INFO info;
+	GetSystemInfo(&info);
+	return info.dwNumberOfProcessors;
+#else
+	return sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+}
+
+void
+CJobPool::Initialise(int32 numThreads)
+{
+	int32 i, maxThreads;
+
+	// never more workers than there are other cores, and none at all
+	// when the pool is switched off or nothing that uses it is compiled in
+	maxThreads = clamp(GetNumProcessors() - 1, 0, JOBPOOL_MAXTHREADS);
+	if(numThreads < 0 || numThreads > maxThreads)
+		numThreads = maxThreads;
+#if defined(ASYNC_STREAM_DECODE) || defined(ISLAND_WORLD_PROCESS) || defined(PARALLEL_ANIM_UPDATE) || defined(PARALLEL_SCAN_WORLD)
+	if(!ms_bEnabled)
+		numThreads = 0;
+#else
+	numThreads = 0;
+#endif
+
+	gJobQueueHead = 0;
+	gNumQueuedJobs = 0;
+	gbJobPoolShutdown = false;
+	ms_numThreads = 0;
+
+#ifdef _WIN32
+	InitializeCriticalSection(&gJobLock);
+	InitializeCriticalSection(&gWorldLock);
+	gJobSema = CreateSemaphore(nil, 0, JOBPOOL_QUEUESIZE + JOBPOOL_MAXTHREADS, nil);
+	if(gJobSema == nil){
+		debug("CJobPool: failed to create semaphore, running jobs on the game thread\n");
+		return;
+	}
+#endif
+
+	for(i = 0; i < numThreads; i++){
+#ifdef _WIN32
+		// island jobs run the whole collision code, give them some room
+		gJobThreads[i] = CreateThread(nil, 256*1024, JobThread, nil, 0, nil);
+		if(gJobThreads[i] == nil)
+			break;
+#else
+		if(pthread_create(&gJobThreads[i], nil, JobThread, nil) != 0)
+			break;
+#endif
+		ms_numThreads++;
+	}
+	debug("CJobPool: %d worker threads\n", ms_numThreads);
+}
+
+void
+CJobPool::Shutdown(void)
+{
+	int32 i;
+
+	LockJobs();
+	gbJobPoolShutdown = true;
+	UnlockJobs();
+#ifdef _WIN32
+	if(gJobSema)
+		ReleaseSemaphore(gJobSema, ms_numThreads, nil);
+	for(i = 0; i < ms_numThreads; i++){
+		WaitForSingleObject(gJobThreads[i], INFINITE);
+		CloseHandle(gJobThreads[i]);
+	}
+	if(gJobSema){
+		CloseHandle(gJobSema);
+		gJobSema = nil;
+	}
+	DeleteCriticalSection(&gJobLock);
+	DeleteCriticalSection(&gWorldLock);
+#else
+	pthread_cond_broadcast(&gJobCond);
+	for(i = 0; i < ms_numThreads; i++)
+		pthread_join(gJobThreads[i], nil);
+#endif
+	ms_numThreads = 0;
+}
+
+void
+CJobPool::Submit(JobFunc func, void *data, CJobCounter *counter)
+{
+	Job job;
+	job.func = func;
+	job.data = data;
+	job.counter = counter;
+
+	LockJobs();
+	counter->pending++;
+	if(GetNumThreads() == 0 || gNumQueuedJobs == JOBPOOL_QUEUESIZE){
+		UnlockJobs();
+		RunJob(&job);
+		return;
+	}
+	gJobQueue[(gJobQueueHead + gNumQueuedJobs) % JOBPOOL_QUEUESIZE] = job;
+	gNumQueuedJobs++;
+	UnlockJobs();
+#ifdef _WIN32
+	ReleaseSemaphore(gJobSema, 1, nil);
+#else
+	pthread_cond_signal(&gJobCond);
+#endif
+}
+
+bool
+CJobPool::IsDone(CJobCounter *counter)
+{
+	bool done;
+	LockJobs();
+	done = counter->pending == 0;
+	UnlockJobs();
+	return done;
+}
+
+// Helps out with queued jobs until everything on the counter has finished
+void
+CJobPool::Wait(CJobCounter *counter)
+{
+	Job job;
+
+	for(;;){
+		LockJobs();
+		if(counter->pending == 0){
+			UnlockJobs();
+			return;
+		}
+		bool haveJob = PopJob(&job);
+		UnlockJobs();
+		if(haveJob)
+			RunJob(&job);
+		else
+			YieldJobs();
+	}
+}
+
+struct ParallelForRange
+{
+	JobRangeFunc func;
+	void *data;
+	int32 start;
+	int32 end;
+};
+
+static void
+ParallelForJob(void *data)
+{
+	ParallelForRange *range = (ParallelForRange*)data;
+	for(int32 i = range->start; i < range->end; i++)
+		range->func(i, range->data);
+}
+
+// Splits [0, n) into one range per thread (including the caller) and waits for all of them
+void
+CJobPool::ParallelFor(int32 n, JobRangeFunc func, void *data)
+{
+	ParallelForRange ranges[JOBPOOL_MAXTHREADS+1];
+	CJobCounter counter;
+	int32 i, numRanges, start;
+
+	numRanges = Min(GetNumThreads() + 1, n);
+	if(numRanges <= 1){
+		for(i = 0; i < n; i++)
+			func(i, data);
+		return;
+	}
+
+	start = 0;
+	for(i = 0; i < numRanges; i++){
+		ranges[i].func = func;
+		ranges[i].data = data;
+		ranges[i].start = start;
+		ranges[i].end = start + (n - start) / (numRanges - i);
+		start = ranges[i].end;
+	}
+	// caller takes the first range itself
+	for(i = 1; i < numRanges; i++)
+		Submit(ParallelForJob, &ranges[i], &counter);
+	ParallelForJob(&ranges[0]);
+	Wait(&counter);
+}
+
+void
+CJobPool::LockWorld(void)
+{
+#ifdef _WIN32
+	EnterCriticalSection(&gWorldLock);
+#else
+	pthread_mutex_lock(&gWorldLock);
+#endif
+	gbHoldsWorldLock = true;
+}
+
+void
+CJobPool::UnlockWorld(void)
+{
+	gbHoldsWorldLock = false;
+#ifdef _WIN32
+	LeaveCriticalSection(&gWorldLock);
+#else
+	pthread_mutex_unlock(&gWorldLock);
+#endif
+}
+
+bool
+CJobPool::HoldsWorldLock(void)
+{
+	return gbHoldsWorldLock;
+}
@@ -0,0 +1,41 @@
+#pragma once
+
+// Small pool of worker threads for CPU-bound jobs.
+// Jobs must not touch RW, the pools or anything else owned by the game thread,
+// unless the game thread is waiting on them and they hold the world lock.
+// Without workers (or with a full queue) jobs are simply run by the caller.
+
+typedef void (*JobFunc)(void *data);
+typedef void (*JobRangeFunc)(int32 i, void *data);
+
+#define JOBPOOL_QUEUESIZE 256
+#define JOBPOOL_MAXTHREADS 7
+
+struct CJobCounter
+{
+	volatile int32 pending;
+
+	CJobCounter(void) : pending(0) {}
+};
+
+class CJobPool
+{
+	static int32 ms_numThreads;
+public:
+	static bool ms_bEnabled;
+
+	static void Initialise(int32 numThreads = -1);
+	static void Shutdown(void);
+	static int32 GetNumThreads(void) { return ms_bEnabled ? ms_numThreads : 0; }
+
+	static void Submit(JobFunc func, void *data, CJobCounter *counter);
+	static bool IsDone(CJobCounter *counter);
+	static void Wait(CJobCounter *counter);
+	static void ParallelFor(int32 n, JobRangeFunc func, void *data);
+
+	// Jobs that have to touch game state after all take turns on this lock.
+	// They can let go of it around work that only reads what they own.
+	static void LockWorld(void);
+	static void UnlockWorld(void);
+	static bool HoldsWorldLock(void);
+};
@@ -0,0 +1,268 @@
+#include "common.h"
+
+#ifdef LEVEL_CACHE
+#include <sys/types.h>
+#include <sys/stat.h>
+#include "crossplatform.h"
+#include "FileMgr.h"
+#include "LevelCache.h"
+
+#define LEVELCACHE_IDENT 0x434C564C	// "LVLC"
+#define LEVELCACHE_VERSION 2	// bump when any of the record structs change
+#define LEVELCACHE_MAXFILES 256
+
+struct LevelCacheHeader
+{
+	uint32 ident;
+	uint32 version;
+	uint32 numFiles;
+	uint32 dataSize;	// file table and records following this header
+};
+
+struct LevelCacheFile
+{
+	char name[64];
+	uint64 modTime;
+	uint32 textSize;
+	uint32 offset;	// into the records
+	uint32 size;
+	uint32 pad;
+};
+
+static bool gbLevelCacheOpen;
+static bool gbLevelCacheDirty;
+static bool gbLevelCacheFailed;
+static char gLevelCacheName[256];
+
+// blob written by the last run
+static uint8 *gpOldCache;
+static LevelCacheFile *gpOldFiles;
+static uint32 gNumOldFiles;
+static uint8 *gpOldRecords;
+static uint32 gOldRecordsSize;
+
+// what this run loaded, written back if anything changed
+static LevelCacheFile gFiles[LEVELCACHE_MAXFILES];
+static uint32 gNumFiles;
+static uint8 *gpRecords;
+static uint32 gRecordsSize;
+static uint32 gRecordsCapacity;
+static int32 gCurrentFile = -1;
+
+// Size and modification time, without reading the file
+static bool
+StatTextFile(const char *filename, uint64 &modTime, uint32 &size)
+{
+	struct stat st;
+	int ret;
+
+#ifdef _WIN32
+	ret = stat(filename, &st);
+#else
+	char *real = casepath(filename);
+	ret = stat(real ? real : filename, &st);
+	free(real);
+#endif
+	if(ret != 0)
+		return false;
+	modTime = st.st_mtime;
+	size = st.st_size;
+	return true;
+}
+
+static bool
+GrowRecords(uint32 size)
+{
+	if(gRecordsSize + size <= gRecordsCapacity)
+		return true;
+	uint32 capacity = Max(gRecordsCapacity*2, 64*1024u);
+	while(capacity < gRecordsSize + size)
+		capacity *= 2;
+	uint8 *records = (uint8*)realloc(gpRecords, capacity);
+	if(records == nil)
+		return false;
+	gpRecords = records;
+	gRecordsCapacity = capacity;
+	return true;
+}
+
+static void
+ReadCache(void)
+{
+	LevelCacheHeader header;
+	uint32 tableSize, i;
+	int fd;
+
+	fd = CFileMgr::OpenFile(gLevelCacheName, "rb");
+	if(fd <= 0)
+		return;
+	if(CFileMgr::Read(fd, (char*)&header, sizeof(header)) != sizeof(header) ||
+	   header.ident != LEVELCACHE_IDENT || header.version != LEVELCACHE_VERSION ||
+	   header.numFiles > LEVELCACHE_MAXFILES){
+		CFileMgr::CloseFile(fd);
+		return;
+	}
+	tableSize = header.numFiles*sizeof(LevelCacheFile);
+	if(header.dataSize < tableSize){
+		CFileMgr::CloseFile(fd);
+		return;
+	}
+	gpOldCache = (uint8*)malloc(header.dataSize);
+	if(gpOldCache == nil || CFileMgr::Read(fd, (char*)gpOldCache, header.dataSize) != header.dataSize){
+		free(gpOldCache);
+		gpOldCache = nil;
+		CFileMgr::CloseFile(fd);
+		return;
+	}
+	CFileMgr::CloseFile(fd);
+
+	gpOldFiles = (LevelCacheFile*)gpOldCache;
+	gpOldRecords = gpOldCache + tableSize;
+	gOldRecordsSize = header.dataSize - tableSize;
+	for(i = 0; i < header.numFiles; i++)
+		if(gpOldFiles[i].offset > gOldRecordsSize || gpOldFiles[i].size > gOldRecordsSize - gpOldFiles[i].offset){
+			free(gpOldCache);
+			gpOldCache = nil;
+			return;
+		}
+	gNumOldFiles = header.numFiles;
+}
+
+static void
+WriteCache(void)
+{
+	LevelCacheHeader header;
+	int fd;
+	bool ok;
+
+	fd = CFileMgr::OpenFileForWriting(gLevelCacheName);
+	if(fd <= 0){
+		debug("Couldn't write level cache %s\n", gLevelCacheName);
+		return;
+	}
+	header.ident = LEVELCACHE_IDENT;
+	header.version = LEVELCACHE_VERSION;
+	header.numFiles = gNumFiles;
+	header.dataSize = gNumFiles*sizeof(LevelCacheFile) + gRecordsSize;
+	ok = CFileMgr::Write(fd, (char*)&header, sizeof(header)) == sizeof(header) &&
+		CFileMgr::Write(fd, (char*)gFiles, gNumFiles*sizeof(LevelCacheFile)) == gNumFiles*sizeof(LevelCacheFile) &&
+		CFileMgr::Write(fd, (char*)gpRecords, gRecordsSize) == gRecordsSize;
+	CFileMgr::CloseFile(fd);
+	if(ok)
+		debug("Wrote level cache %s, %d files %d bytes\n", gLevelCacheName, gNumFiles, header.dataSize);
+	else
+		debug("Couldn't write level cache %s\n", gLevelCacheName);
+}
+
+void
+CLevelCache::Open(const char *datFile)
+{
+	Close();
+	if(strlen(datFile) + 7 > sizeof(gLevelCacheName))
+		return;
+	sprintf(gLevelCacheName, "%s.cache", datFile);
+	ReadCache();
+	gbLevelCacheOpen = true;
+	gbLevelCacheDirty = false;
+	gbLevelCacheFailed = false;
+}
+
+void
+CLevelCache::Close(void)
+{
+	if(gbLevelCacheOpen && !gbLevelCacheFailed && (gbLevelCacheDirty || gNumFiles != gNumOldFiles))
+		WriteCache();
+
+	free(gpOldCache);
+	gpOldCache = nil;
+	gpOldFiles = nil;
+	gNumOldFiles = 0;
+	free(gpRecords);
+	gpRecords = nil;
+	gRecordsSize = 0;
+	gRecordsCapacity = 0;
+	gNumFiles = 0;
+	gCurrentFile = -1;
+	gbLevelCacheOpen = false;
+}
+
+// true if records of an unchanged file are in the cache, they stay valid until Close.
+// Otherwise the caller parses the text and everything it adds until EndFile is recorded.
+bool
+CLevelCache::StartFile(const char *filename, uint8 *&records, uint32 &size)
+{
+	LevelCacheFile *file;
+	uint32 i;
+
+	if(!gbLevelCacheOpen || gbLevelCacheFailed)
+		return false;
+	assert(gCurrentFile == -1);
+	if(gNumFiles >= LEVELCACHE_MAXFILES || strlen(filename) >= sizeof(file->name)){
+		gbLevelCacheFailed = true;
+		return false;
+	}
+
+	file = &gFiles[gNumFiles];
+	memset(file, 0, sizeof(*file));
+	strcpy(file->name, filename);
+	if(!StatTextFile(filename, file->modTime, file->textSize)){
+		gbLevelCacheFailed = true;
+		return false;
+	}
+	file->offset = gRecordsSize;
+
+	for(i = 0; i < gNumOldFiles; i++){
+		LevelCacheFile *old = &gpOldFiles[i];
+		if(old->modTime != file->modTime || old->textSize != file->textSize ||
+		   strncmp(old->name, file->name, sizeof(old->name)) != 0)
+			continue;
+		// keep it for the next blob
+		if(!GrowRecords(old->size)){
+			gbLevelCacheFailed = true;
+			return false;
+		}
+		memcpy(gpRecords + gRecordsSize, gpOldRecords + old->offset, old->size);
+		gRecordsSize += old->size;
+		file->size = old->size;
+		if(i != gNumFiles)
+			gbLevelCacheDirty = true;	// order changed
+		gNumFiles++;
+		records = gpOldRecords + old->offset;
+		size = old->size;
+		return true;
+	}
+
+	gCurrentFile = gNumFiles++;
+	gbLevelCacheDirty = true;
+	return false;
+}
+
+void
+CLevelCache::EndFile(void)
+{
+	if(gCurrentFile == -1)
+		return;
+	gFiles[gCurrentFile].size = gRecordsSize - gFiles[gCurrentFile].offset;
+	gCurrentFile = -1;
+}
+
+void
+CLevelCache::AddRecord(int32 type, const void *data, int32 size)
+{
+	LevelCacheRecord rec;
+
+	if(gCurrentFile == -1)
+		return;
+	rec.type = type;
+	rec.size = (sizeof(rec) + size + 3) & ~3;
+	if(!GrowRecords(rec.size)){
+		gbLevelCacheFailed = true;
+		gCurrentFile = -1;
+		return;
+	}
+	memcpy(gpRecords + gRecordsSize, &rec, sizeof(rec));
+	memcpy(gpRecords + gRecordsSize + sizeof(rec), data, size);
+	memset(gpRecords + gRecordsSize + sizeof(rec) + size, 0, rec.size - sizeof(rec) - size);
+	gRecordsSize += rec.size;
+}
+#endif
@@ -0,0 +1,41 @@
+#pragma once
+
+// Binary cache of parsed IDE/IPL files, one blob per level DAT file.
+// Every file in the blob is keyed by its size and modification time, so unchanged
+// files are never opened. Files that changed are parsed again and the blob is
+// rewritten at the end of CFileLoader::LoadLevel.
+// Records hold the parsed model info fields, with names already resolved where
+// they don't depend on other data files, and the final matrix of every instance.
+// Replaying them only fills in the model infos and creates the entities.
+
+enum
+{
+	LEVELREC_OBJS,
+	LEVELREC_TOBJ,
+	LEVELREC_WEAP,
+	LEVELREC_HIER,
+	LEVELREC_CARS,
+	LEVELREC_PEDS,
+	LEVELREC_PATHNODE,
+	LEVELREC_2DFX,
+	LEVELREC_INST,
+	LEVELREC_ZONE,
+	LEVELREC_CULL,
+	LEVELREC_OCCL
+};
+
+struct LevelCacheRecord
+{
+	uint32 type;
+	uint32 size;	// including this header, multiple of 4
+};
+
+class CLevelCache
+{
+public:
+	static void Open(const char *datFile);
+	static void Close(void);
+	static bool StartFile(const char *filename, uint8 *&records, uint32 &size);
+	static void EndFile(void);
+	static void AddRecord(int32 type, const void *data, int32 size);
+};
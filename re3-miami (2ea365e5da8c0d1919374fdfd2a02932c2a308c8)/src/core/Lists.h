@@ -77,6 +77,9 @@ public:
 	CPtrList *list;		// list in sector
 	CPtrNode *listnode;	// node in list
 	CSector *sector;
+#ifdef SECTOR_ENTITY_ARRAYS
+	int32 arrayIndex;	// in the sector array mirroring list
+#endif
 
 	CEntryInfoNode *prev;
 	CEntryInfoNode *next;
@@ -0,0 +1,134 @@
+#include "common.h"
+
+#include "General.h"
+#include "NameIndex.h"
+
+#define NAMEINDEX_MINSIZE 64
+
+// FNV-1a over the upper case name, so it agrees with CGeneral::faststricmp
+uint32
+CNameIndex::GetKey(const char *name)
+{
+	uint32 key = 2166136261u;
+	for(; *name; name++){
+#ifndef ASCII_STRCMP
+		key ^= (uint8)toupper(*name);
+#else
+		key ^= (uint8)__ascii_toupper(*name);
+#endif
+		key *= 16777619u;
+	}
+	return key;
+}
+
+void
+CNameIndex::Shutdown(void)
+{
+	delete[] m_entries;
+	m_entries = nil;
+	m_size = 0;
+	m_numEntries = 0;
+}
+
+void
+CNameIndex::Clear(void)
+{
+	int32 i;
+	for(i = 0; i < m_size; i++)
+		m_entries[i].name = nil;
+	m_numEntries = 0;
+}
+
+void
+CNameIndex::Insert(const char *name, uint32 key, int32 value)
+{
+	int32 i = key & (m_size-1);
+	while(m_entries[i].name)
+		i = (i+1) & (m_size-1);
+	m_entries[i].name = name;
+	m_entries[i].key = key;
+	m_entries[i].value = value;
+	m_numEntries++;
+}
+
+void
+CNameIndex::Grow(void)
+{
+	int32 i;
+	Entry *oldEntries = m_entries;
+	int32 oldSize = m_size;
+
+	m_size = m_size ? m_size*2 : NAMEINDEX_MINSIZE;
+	m_entries = new Entry[m_size];
+	m_numEntries = 0;
+	for(i = 0; i < m_size; i++)
+		m_entries[i].name = nil;
+	for(i = 0; i < oldSize; i++)
+		if(oldEntries[i].name)
+			Insert(oldEntries[i].name, oldEntries[i].key, oldEntries[i].value);
+	delete[] oldEntries;
+}
+
+// name has to stay valid (and unchanged) until it's removed again
+void
+CNameIndex::Add(const char *name, int32 value)
+{
+	// keep at least half the table empty so probe sequences stay short
+	if((m_numEntries+1)*2 > m_size)
+		Grow();
+	Insert(name, GetKey(name), value);
+}
+
+void
+CNameIndex::Remove(const char *name, int32 value)
+{
+	int32 i, j, home;
+	uint32 key;
+
+	if(m_size == 0)
+		return;
+	key = GetKey(name);
+	for(i = key & (m_size-1); m_entries[i].name; i = (i+1) & (m_size-1))
+		if(m_entries[i].key == key && m_entries[i].value == value &&
+		   !CGeneral::faststricmp(m_entries[i].name, name))
+			break;
+	if(m_entries[i].name == nil)
+		return;
+
+	// Shift following entries back into the hole so no probe sequence gets broken
+	j = i;
+	for(;;){
+		j = (j+1) & (m_size-1);
+		if(m_entries[j].name == nil)
+			break;
+		home = m_entries[j].key & (m_size-1);
+		// entry can stay if its home slot lies cyclically in (i, j]
+		if(i <= j ? i < home && home <= j : i < home || home <= j)
+			continue;
+		m_entries[i] = m_entries[j];
+		i = j;
+	}
+	m_entries[i].name = nil;
+	m_numEntries--;
+}
+
+// Lowest value in [minValue, maxValue] registered under name, -1 if there is none
+int32
+CNameIndex::Find(const char *name, int32 minValue, int32 maxValue)
+{
+	int32 i, found;
+	uint32 key;
+
+	if(m_size == 0)
+		return -1;
+	found = -1;
+	key = GetKey(name);
+	for(i = key & (m_size-1); m_entries[i].name; i = (i+1) & (m_size-1)){
+		Entry *e = &m_entries[i];
+		if(e->key != key || e->value < minValue || e->value > maxValue)
+			continue;
+		if((found == -1 || e->value < found) && !CGeneral::faststricmp(e->name, name))
+			found = e->value;
+	}
+	return found;
+}
@@ -0,0 +1,36 @@
+#pragma once
+
+// Case insensitive name -> index map for the stores that used to find names
+// with a linear faststricmp scan (models, txds, cols, anim blocks, IMG directories).
+// Open addressing with linear probing. The names aren't copied,
+// stores register a pointer to the name they already keep in their slot.
+// Several entries may share a name, Find returns the lowest value like the linear scans did.
+
+class CNameIndex
+{
+	struct Entry
+	{
+		const char *name;	// nil if unused
+		uint32 key;
+		int32 value;
+	};
+
+	Entry *m_entries;
+	int32 m_size;	// always a power of two
+	int32 m_numEntries;
+
+	void Grow(void);
+	void Insert(const char *name, uint32 key, int32 value);
+public:
+	CNameIndex(void) : m_entries(nil), m_size(0), m_numEntries(0) {}
+	~CNameIndex(void) { Shutdown(); }
+
+	void Shutdown(void);
+	void Clear(void);
+	void Add(const char *name, int32 value);
+	void Remove(const char *name, int32 value);
+	int32 Find(const char *name, int32 minValue = 0, int32 maxValue = INT32_MAX);
+	int32 GetNumEntries(void) { return m_numEntries; }
+
+	static uint32 GetKey(const char *name);
+};
@@ -0,0 +1,70 @@
+#include "common.h"
+
+#ifdef SECTOR_ENTITY_ARRAYS
+#include "Lists.h"
+#include "Entity.h"
+#include "ModelInfo.h"
+#include "SectorArray.h"
+
+#define SECTORARRAY_MINSIZE 8
+
+void
+CSectorArray::Add(CEntity *entity, CEntryInfoNode *info)
+{
+	CSectorArrayEntry *e;
+	CColModel *col;
+
+	if(m_numEntries == m_maxEntries){
+		int32 max = m_maxEntries ? m_maxEntries*2 : SECTORARRAY_MINSIZE;
+		e = (CSectorArrayEntry*)realloc(m_entries, max*sizeof(CSectorArrayEntry));
+		assert(e);
+		m_entries = e;
+		m_maxEntries = max;
+	}
+	e = &m_entries[m_numEntries];
+	e->entity = entity;
+	e->info = info;
+	if(info)
+		info->arrayIndex = m_numEntries;
+	col = entity->IsBuilding() || entity->IsDummy() ? entity->GetColModel() : nil;
+	if(col){
+		e->centre = entity->GetMatrix() * col->boundingSphere.center;
+		e->radius = col->boundingSphere.radius;
+	}else
+		e->radius = -1.0f;
+	m_numEntries++;
+}
+
+// for entities without entry info
+void
+CSectorArray::Remove(CEntity *entity)
+{
+	int32 i;
+	for(i = 0; i < m_numEntries; i++)
+		if(m_entries[i].entity == entity){
+			RemoveAt(i);
+			return;
+		}
+}
+
+void
+CSectorArray::RemoveAt(int32 i)
+{
+	assert(i >= 0 && i < m_numEntries);
+	m_numEntries--;
+	if(i != m_numEntries){
+		m_entries[i] = m_entries[m_numEntries];
+		if(m_entries[i].info)
+			m_entries[i].info->arrayIndex = i;
+	}
+}
+
+void
+CSectorArray::Shutdown(void)
+{
+	free(m_entries);
+	m_entries = nil;
+	m_numEntries = 0;
+	m_maxEntries = 0;
+}
+#endif
@@ -0,0 +1,33 @@
+#pragma once
+
+class CEntity;
+class CEntryInfoNode;
+
+// Contiguous mirror of one sector list, so the world queries walk an array of
+// pointers instead of chasing list nodes all over the pool.
+// The CPtrList stays the master copy, every insert and delete on a sector list
+// is repeated here. Removal swaps the last entry into the hole, entities that
+// keep entry info (physicals and dummies) store their index in CEntryInfoNode
+// so they're removed in O(1). Order is not the order of the list.
+
+struct CSectorArrayEntry
+{
+	CEntity *entity;
+	CEntryInfoNode *info;	// nil for buildings
+	CVector centre;	// world space bounding sphere of entities that don't move
+	float radius;	// < 0 if not cached
+};
+
+class CSectorArray
+{
+public:
+	CSectorArrayEntry *m_entries;
+	int32 m_numEntries;
+	int32 m_maxEntries;
+
+	void Add(CEntity *entity, CEntryInfoNode *info);
+	void Remove(CEntity *entity);
+	void RemoveAt(int32 i);
+	void Flush(void) { m_numEntries = 0; }
+	void Shutdown(void);
+};
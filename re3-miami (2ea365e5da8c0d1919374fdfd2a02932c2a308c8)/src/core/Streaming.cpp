@@ -37,6 +37,10 @@
 #include "Font.h"
 #include "Frontend.h"
 #include "VarConsole.h"
+#include "JobPool.h"
+#ifdef PREDICTIVE_STREAMING
+#include "PathFind.h"
+#endif
 
 bool CStreaming::ms_disableStreaming;
 bool CStreaming::ms_bLoadingBigModel;
@@ -73,6 +77,55 @@ int32 CStreaming::ms_imageOffsets[NUMCDIMAGES];
 int32 CStreaming::ms_lastImageRead;
 int32 CStreaming::ms_imageSize;
 size_t CStreaming::ms_memoryAvailable;
+#ifdef ASYNC_STREAM_DECODE
+bool CStreaming::ms_bAsyncDecode = true;
+int32 CStreaming::ms_frameBudget = 4;
+bool CStreaming::ms_bUseFrameBudget;
+uint32 CStreaming::ms_frameStartTime;
+#endif
+#ifdef STREAMING_DEADLINES
+bool CStreaming::ms_bDeadlineScheduling = true;
+int32 CStreaming::ms_deadlineSlack = 500;
+uint32 CStreaming::ms_aRequestDeadlines[NUMSTREAMINFO];
+float CStreaming::ms_fCameraSpeed;
+CVector CStreaming::ms_vecLastCameraPos;
+int32 CStreaming::ms_numUrgentRequests;
+int32 CStreaming::ms_numDeadlinesMet;
+int32 CStreaming::ms_numDeadlinesMissed;
+int32 CStreaming::ms_maxDeadlineMiss;
+#endif
+#ifdef PREDICTIVE_STREAMING
+bool CStreaming::ms_bPredictiveStreaming = true;
+float CStreaming::ms_fPredictionTime = 3.0f;
+float CStreaming::ms_fPredictionMinSpeed = 15.0f;
+CVector CStreaming::ms_aPredictedPositions[NUMPREDICTEDPOSITIONS];
+int32 CStreaming::ms_numPredictedPositions;
+uint8 CStreaming::ms_aPredictionState[STREAM_OFFSET_TXD];
+int32 CStreaming::ms_numPredictionHits;
+int32 CStreaming::ms_numPredictionLate;
+int32 CStreaming::ms_numPredictionMisses;
+
+// which AddModelsToRequestList is running
+enum
+{
+	PREDICTPASS_NONE,
+	PREDICTPASS_CAMERA,
+	PREDICTPASS_AHEAD,
+};
+static int8 gPredictionPass;
+static int32 gLastPredictionNode = -1;
+#endif
+#ifdef STREAMING_MEMORY_BUDGET
+bool CStreaming::ms_bMemoryBudget = true;
+int32 CStreaming::ms_memoryCapMB;
+int32 CStreaming::ms_aCategoryQuota[NUM_STREAMCATS] = { 60, 30, 60, 100, 30 };
+size_t CStreaming::ms_aCategoryMemory[NUM_STREAMCATS];
+int32 CStreaming::ms_aCategoryFiles[NUM_STREAMCATS];
+int32 CStreaming::ms_numBudgetEvictions;
+uint32 CStreaming::ms_aLastUsedTime[NUMSTREAMINFO];
+float CStreaming::ms_aUseDistance[STREAM_OFFSET_TXD];
+const char *CStreaming::ms_aCategoryNames[NUM_STREAMCATS] = { "Models", "LODs", "Textures", "Collision", "Animation" };
+#endif
 
 int32 desiredNumVehiclesLoaded = 12;
 
@@ -159,6 +212,12 @@ CStreaming::Init2(void)
 	ms_disableStreaming = false;
 	ms_memoryUsed = 0;
 	ms_bLoadingBigModel = false;
+#ifdef STREAMING_MEMORY_BUDGET
+	for(i = 0; i < NUM_STREAMCATS; i++){
+		ms_aCategoryMemory[i] = 0;
+		ms_aCategoryFiles[i] = 0;
+	}
+#endif
 
 	// init channels
 
@@ -298,6 +357,9 @@ CStreaming::ReInit(void)
 void
 CStreaming::Shutdown(void)
 {
+#ifdef ASYNC_STREAM_DECODE
+	CommitDecodedFiles(true);
+#endif
 	RwFreeAlign(ms_pStreamingBuffer[0]);
 	ms_streamingBufferSize = 0;
 	if(ms_pExtraObjectsDir) {
@@ -334,9 +396,25 @@ CStreaming::Update(void)
 	if(CTimer::GetIsPaused())
 		return;
 
+#ifdef STREAMING_DEADLINES
+	UpdateCameraSpeed();
+#endif
+
 	LoadBigBuildingsWhenNeeded();
+#ifdef PREDICTIVE_STREAMING
+	PredictPlayerPath();
+	if(!ms_disableStreaming && TheCamera.GetPosition().z < 55.0f){
+		// count what the camera finds loaded while we're predicting
+		if(ms_numPredictedPositions > 0)
+			gPredictionPass = PREDICTPASS_CAMERA;
+		AddModelsToRequestList(TheCamera.GetPosition(), 0);
+		gPredictionPass = PREDICTPASS_NONE;
+		AddPredictedModelsToRequestList();
+	}
+#else
 	if(!ms_disableStreaming && TheCamera.GetPosition().z < 55.0f)
 		AddModelsToRequestList(TheCamera.GetPosition(), 0);
+#endif
 
 	DeleteFarAwayRwObjects(TheCamera.GetPosition());
 
@@ -350,7 +428,18 @@ CStreaming::Update(void)
 		StreamZoneModels(FindPlayerCoors());
 	}
 
+#ifdef ASYNC_STREAM_DECODE
+	ms_frameStartTime = CTimer::GetCurrentTimeInCycles();
+	ms_bUseFrameBudget = true;
+	CommitDecodedFiles(false);
+	LoadRequestedModels();
+	ms_bUseFrameBudget = false;
+#else
 	LoadRequestedModels();
+#endif
+#ifdef STREAMING_MEMORY_BUDGET
+	EnforceCategoryQuotas();
+#endif
 
 	if(CWorld::Players[0].m_pRemoteVehicle){
 		CColStore::AddCollisionNeededAtPosn(FindPlayerCoors());
@@ -360,6 +449,9 @@ CStreaming::Update(void)
 		CColStore::LoadCollision(FindPlayerCoors());
 		CColStore::EnsureCollisionIsInMemory(FindPlayerCoors());
 	}
+#ifdef ASYNC_COLLISION_STREAMING
+	CColStore::KeepPhysicalsOnFallbackGround();
+#endif
 
 	// TODO: PrintRequestList
 	//if (CPad::GetPad(1)->GetLeftShoulder2JustDown() && CPad::GetPad(1)->GetRightShoulder1() && CPad::GetPad(1)->GetRightShoulder2())
@@ -668,6 +760,12 @@ CStreaming::ConvertBufferToObject(int8 *buf, int32 streamId)
 		ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_LOADED;
 #ifndef USE_CUSTOM_ALLOCATOR
 		ms_memoryUsed += ms_aInfoForModel[streamId].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+#endif
+#ifdef STREAMING_MEMORY_BUDGET
+		UpdateBudgetMemory(streamId, true);
+#endif
+#ifdef STREAMING_DEADLINES
+		CheckRequestDeadline(streamId);
 #endif
 	}
 
@@ -736,6 +834,12 @@ CStreaming::FinishLoadingLargeFile(int8 *buf, int32 streamId)
 #ifndef USE_CUSTOM_ALLOCATOR
 	ms_memoryUsed += ms_aInfoForModel[streamId].GetCdSize() * CDSTREAM_SECTOR_SIZE;
 #endif
+#ifdef STREAMING_MEMORY_BUDGET
+	UpdateBudgetMemory(streamId, true);
+#endif
+#ifdef STREAMING_DEADLINES
+	CheckRequestDeadline(streamId);
+#endif
 
 	if(!success){
 		RemoveModel(streamId);
@@ -754,10 +858,206 @@ CStreaming::FinishLoadingLargeFile(int8 *buf, int32 streamId)
 	return true;
 }
 
+#ifdef ASYNC_STREAM_DECODE
+// COL and IFP files are decoded by the job pool from a private copy of the streaming buffer,
+// the game thread only hands the results out in CommitDecodedFiles.
+// DFF and TXD files need RW so they're still converted on the game thread.
+struct CDecodeJob
+{
+	int32 streamId;
+	bool cancelled;
+	bool success;
+	uint8 *buffer;
+	RwMemory mem;
+	RwStream *stream;
+	CAnimBlock *animBlock;
+	CDecodedColModel *colModels;
+	int32 numColModels;
+	CJobCounter counter;
+	CDecodeJob *next;
+};
+
+// committed in the order they were queued
+static CDecodeJob *pFirstDecodeJob;
+static CDecodeJob *pLastDecodeJob;
+
+static void
+DecodeJob(void *data)
+{
+	CDecodeJob *job = (CDecodeJob*)data;
+
+	if(job->streamId < STREAM_OFFSET_ANIM)
+		job->success = CFileLoader::DecodeCollisionFile(job->buffer, job->mem.length, job->colModels, job->numColModels);
+	else{
+		CAnimManager::LoadAnimBlockAnims(job->stream, job->animBlock, true);
+		job->success = true;
+	}
+}
+
+static void
+FreeDecodeJob(CDecodeJob *job)
+{
+	if(job->stream)
+		RwStreamClose(job->stream, &job->mem);
+	delete[] job->colModels;
+	delete[] job->buffer;
+	delete job;
+}
+
+bool
+CStreaming::IsFrameBudgetExceeded(void)
+{
+	if(!ms_bUseFrameBudget || ms_frameBudget <= 0)
+		return false;
+	return CTimer::GetCurrentTimeInCycles() - ms_frameStartTime > ms_frameBudget * CTimer::GetCyclesPerMillisecond();
+}
+
+// Returns false if the file has to go through ConvertBufferToObject
+bool
+CStreaming::QueueDecode(int8 *buf, int32 streamId)
+{
+	CDecodeJob *job;
+	int32 size;
+
+	if(!ms_bAsyncDecode || streamId < STREAM_OFFSET_COL)
+		return false;
+
+	if(streamId >= STREAM_OFFSET_ANIM &&
+	   (ms_aInfoForModel[streamId].m_flags & STREAMFLAGS_KEEP_IN_MEMORY) == 0 &&
+	   !AreAnimsUsedByRequestedModels(streamId - STREAM_OFFSET_ANIM)){
+		RemoveModel(streamId);
+		return true;
+	}
+
+	size = ms_aInfoForModel[streamId].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+	job = new CDecodeJob;
+	job->streamId = streamId;
+	job->cancelled = false;
+	job->success = false;
+	job->buffer = new uint8[size];
+	memcpy(job->buffer, buf, size);
+	job->mem.start = job->buffer;
+	job->mem.length = size;
+	job->stream = nil;
+	job->animBlock = nil;
+	job->colModels = nil;
+	job->numColModels = 0;
+	job->next = nil;
+	if(streamId >= STREAM_OFFSET_ANIM){
+		// read the header here so the block's range of anims is reserved before the next file comes in
+		job->stream = RwStreamOpen(rwSTREAMMEMORY, rwSTREAMREAD, &job->mem);
+		job->animBlock = CAnimManager::LoadAnimBlockHeader(job->stream);
+	}
+
+	if(pLastDecodeJob)
+		pLastDecodeJob->next = job;
+	else
+		pFirstDecodeJob = job;
+	pLastDecodeJob = job;
+	ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_DECODING;
+	CJobPool::Submit(DecodeJob, job, &job->counter);
+	return true;
+}
+
+// Hand finished files out to the stores. Unless all is set this stops
+// at the first file that isn't decoded yet or when the frame budget is used up.
+void
+CStreaming::CommitDecodedFiles(bool all)
+{
+	CDecodeJob *job;
+	int32 streamId;
+
+	while(pFirstDecodeJob){
+		job = pFirstDecodeJob;
+		if(!all && (!CJobPool::IsDone(&job->counter) || IsFrameBudgetExceeded()))
+			break;
+		CJobPool::Wait(&job->counter);
+		pFirstDecodeJob = job->next;
+		if(pFirstDecodeJob == nil)
+			pLastDecodeJob = nil;
+
+		streamId = job->streamId;
+		if(job->cancelled){
+			FreeDecodeJob(job);
+			continue;
+		}
+
+		if(!job->success){
+			if(streamId < STREAM_OFFSET_ANIM)
+				debug("Failed to load %s.col\n", CColStore::GetColName(streamId - STREAM_OFFSET_COL));
+			else
+				debug("Failed to load %s.ifp\n", CAnimManager::GetAnimationBlock(streamId - STREAM_OFFSET_ANIM)->name);
+			FreeDecodeJob(job);
+			RemoveModel(streamId);
+			ReRequestModel(streamId);
+			continue;
+		}
+
+		if(streamId < STREAM_OFFSET_ANIM)
+			CColStore::LoadDecodedCol(streamId - STREAM_OFFSET_COL, job->colModels, job->numColModels);
+		else{
+			job->animBlock->isLoaded = true;
+			CAnimManager::CreateAnimAssocGroups();
+			if(CanRemoveModel(streamId))
+				ms_aInfoForModel[streamId].AddToList(&ms_startLoadedList);
+		}
+		ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_LOADED;
+		ms_memoryUsed += ms_aInfoForModel[streamId].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+#ifdef STREAMING_MEMORY_BUDGET
+		UpdateBudgetMemory(streamId, true);
+#endif
+#ifdef STREAMING_DEADLINES
+		CheckRequestDeadline(streamId);
+#endif
+		FreeDecodeJob(job);
+	}
+}
+
+// Called by RemoveModel. The result is thrown away when the job gets committed.
+void
+CStreaming::CancelDecode(int32 streamId)
+{
+	CDecodeJob *job;
+
+	for(job = pFirstDecodeJob; job; job = job->next)
+		if(job->streamId == streamId && !job->cancelled){
+			// the worker may still be writing to the anim block, which could be requested again right away
+			CJobPool::Wait(&job->counter);
+			if(streamId >= STREAM_OFFSET_ANIM)
+				CAnimManager::RemoveAnimBlock(streamId - STREAM_OFFSET_ANIM);
+			job->cancelled = true;
+			return;
+		}
+}
+#endif
+
 void
 CStreaming::RequestModel(int32 id, int32 flags)
 {
 	CSimpleModelInfo *mi;
+#ifdef STREAMING_DEADLINES
+	bool newRequest = false;
+#endif
+
+#ifdef PREDICTIVE_STREAMING
+	if(gPredictionPass != PREDICTPASS_NONE && id < STREAM_OFFSET_TXD){
+		bool loaded = ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED;
+		uint8 &state = ms_aPredictionState[id];
+		if(gPredictionPass == PREDICTPASS_AHEAD){
+			if(!loaded && state == PREDICTION_NONE)
+				state = PREDICTION_REQUESTED;
+		}else if(state != PREDICTION_COUNTED){
+			if(loaded){
+				if(state == PREDICTION_REQUESTED)
+					ms_numPredictionHits++;
+			}else if(state == PREDICTION_REQUESTED)
+				ms_numPredictionLate++;
+			else
+				ms_numPredictionMisses++;
+			state = PREDICTION_COUNTED;
+		}
+	}
+#endif
 
 	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_INQUEUE){
 		// updgrade to priority
@@ -779,6 +1079,10 @@ CStreaming::RequestModel(int32 id, int32 flags)
 				mi->m_alpha = 255;
 		}
 
+#ifdef STREAMING_MEMORY_BUDGET
+		ms_aLastUsedTime[id] = CTimer::GetTimeInMilliseconds();
+#endif
+
 		// reinsert into list
 		if(ms_aInfoForModel[id].m_next){
 			ms_aInfoForModel[id].RemoveFromList();
@@ -800,13 +1104,110 @@ CStreaming::RequestModel(int32 id, int32 flags)
 			ms_numModelsRequested++;
 			if(flags & STREAMFLAGS_PRIORITY)
 				ms_numPriorityRequests++;
+#ifdef STREAMING_DEADLINES
+			newRequest = true;
+#endif
+#ifdef MAPPED_IMG
+			// have the kernel page the file in before RequestModelStream gets to it
+			uint32 posn, size;
+			if(ms_aInfoForModel[id].GetCdPosnAndSize(posn, size))
+				CdStreamPrefetch(posn, size);
+#endif
 		}
 
 		ms_aInfoForModel[id].m_loadState = STREAMSTATE_INQUEUE;
 		ms_aInfoForModel[id].m_flags = flags;
 	}
+
+#ifdef STREAMING_DEADLINES
+	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_INQUEUE){
+		if(newRequest)
+			ms_aRequestDeadlines[id] = CTimer::GetTimeInMilliseconds() + STREAMDEADLINE_MAX;
+		// callers that know better lower this afterwards
+		if(flags & STREAMFLAGS_PRIORITY)
+			SetRequestDeadline(id, STREAMDEADLINE_PRIORITY);
+		else if(flags & STREAMFLAGS_SCRIPTOWNED)
+			SetRequestDeadline(id, STREAMDEADLINE_SCRIPT);
+		else
+			SetRequestDeadline(id, STREAMDEADLINE_DEFAULT);
+	}
+#endif
 }
 
+#ifdef STREAMING_DEADLINES
+static void
+LowerRequestDeadline(int32 id, uint32 deadline)
+{
+	if(CStreaming::ms_aInfoForModel[id].m_loadState == STREAMSTATE_INQUEUE &&
+	   (int32)(deadline - CStreaming::ms_aRequestDeadlines[id]) < 0)
+		CStreaming::ms_aRequestDeadlines[id] = deadline;
+}
+
+// Request has to be loaded within time ms. Only ever makes deadlines earlier,
+// a model's txd and anims are due when the model is.
+void
+CStreaming::SetRequestDeadline(int32 id, int32 time)
+{
+	uint32 deadline = CTimer::GetTimeInMilliseconds() + time;
+
+	LowerRequestDeadline(id, deadline);
+	if(id < STREAM_OFFSET_TXD){
+		CBaseModelInfo *mi = CModelInfo::GetModelInfo(id);
+		LowerRequestDeadline(mi->GetTxdSlot() + STREAM_OFFSET_TXD, deadline);
+		if(mi->GetAnimFileIndex() != -1)
+			LowerRequestDeadline(mi->GetAnimFileIndex() + STREAM_OFFSET_ANIM, deadline);
+	}
+}
+
+// Time until the camera has covered dist at its current speed
+int32
+CStreaming::GetDeadlineForDistance(float dist)
+{
+	// assume at least walking speed
+	float speed = Max(ms_fCameraSpeed, 0.005f);
+	if(dist <= 0.0f)
+		return STREAMDEADLINE_VISIBLE;
+	return Min(dist / speed, (float)STREAMDEADLINE_MAX);
+}
+
+void
+CStreaming::UpdateCameraSpeed(void)
+{
+	uint32 timeStep = CTimer::GetTimeStepInMilliseconds();
+	if(timeStep != 0){
+		float speed = (TheCamera.GetPosition() - ms_vecLastCameraPos).Magnitude() / timeStep;
+		// ignore camera cuts and teleports
+		if(speed < 0.2f)
+			ms_fCameraSpeed += (speed - ms_fCameraSpeed) * 0.1f;
+	}
+	ms_vecLastCameraPos = TheCamera.GetPosition();
+}
+
+// Called when a request has finished loading
+void
+CStreaming::CheckRequestDeadline(int32 id)
+{
+	int32 late = CTimer::GetTimeInMilliseconds() - ms_aRequestDeadlines[id];
+	if(late > 0){
+		ms_numDeadlinesMissed++;
+		ms_maxDeadlineMiss = Max(ms_maxDeadlineMiss, late);
+	}else
+		ms_numDeadlinesMet++;
+}
+
+void
+CStreaming::PrintSchedulerStats(void)
+{
+	debug("streaming: %d requests queued, %d due within %d ms, camera speed %.1f m/s\n",
+		ms_numModelsRequested, ms_numUrgentRequests, ms_deadlineSlack, ms_fCameraSpeed*1000.0f);
+	debug("streaming: %d deadlines met, %d missed, worst by %d ms\n",
+		ms_numDeadlinesMet, ms_numDeadlinesMissed, ms_maxDeadlineMiss);
+	ms_numDeadlinesMet = 0;
+	ms_numDeadlinesMissed = 0;
+	ms_maxDeadlineMiss = 0;
+}
+#endif
+
 #define BIGBUILDINGFLAGS STREAMFLAGS_DONT_REMOVE
 
 void
@@ -1088,6 +1489,10 @@ CStreaming::RemoveModel(int32 id)
 		return;
 
 	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED){
+#ifdef PREDICTIVE_STREAMING
+		if(id < STREAM_OFFSET_TXD)
+			ms_aPredictionState[id] = PREDICTION_NONE;
+#endif
 		if(id < STREAM_OFFSET_TXD)
 			CModelInfo::GetModelInfo(id)->DeleteRwObject();
 		else if(id >= STREAM_OFFSET_TXD && id < STREAM_OFFSET_COL)
@@ -1099,6 +1504,9 @@ CStreaming::RemoveModel(int32 id)
 			CAnimManager::RemoveAnimBlock(id - STREAM_OFFSET_ANIM);
 		}
 		ms_memoryUsed -= ms_aInfoForModel[id].GetCdSize()*CDSTREAM_SECTOR_SIZE;
+#ifdef STREAMING_MEMORY_BUDGET
+		UpdateBudgetMemory(id, false);
+#endif
 	}
 
 	if(ms_aInfoForModel[id].m_next){
@@ -1128,6 +1536,11 @@ CStreaming::RemoveModel(int32 id)
 		}
 	}
 
+#ifdef ASYNC_STREAM_DECODE
+	if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_DECODING)
+		CancelDecode(id);
+#endif
+
 	ms_aInfoForModel[id].m_loadState = STREAMSTATE_NOTLOADED;
 }
 
@@ -1364,6 +1777,18 @@ CStreaming::RemoveLeastUsedModel(uint32 excludeMask)
 	CStreamingInfo *si;
 	int streamId;
 
+#ifdef STREAMING_MEMORY_BUDGET
+	if(ms_bMemoryBudget){
+		streamId = FindEvictionCandidate(-1, excludeMask);
+		if(streamId != -1){
+			RemoveModel(streamId);
+			ms_numBudgetEvictions++;
+			return true;
+		}
+		return (ms_numVehiclesLoaded > 7 || CGame::currArea != AREA_MAIN_MAP && ms_numVehiclesLoaded > 4) && RemoveLoadedVehicle();
+	}
+#endif
+
 	for(si = ms_endLoadedList.m_prev; si != &ms_startLoadedList; si = si->m_prev){
 		if(si->m_flags & excludeMask)
 			continue;
@@ -1391,6 +1816,153 @@ CStreaming::RemoveLeastUsedModel(uint32 excludeMask)
 	return (ms_numVehiclesLoaded > 7 || CGame::currArea != AREA_MAIN_MAP && ms_numVehiclesLoaded > 4) && RemoveLoadedVehicle();
 }
 
+#ifdef STREAMING_MEMORY_BUDGET
+#define EVICT_DEFAULT_DIST 80.0f	// for files that have no distance, the streaming radius
+
+int32
+CStreaming::GetStreamCategory(int32 id)
+{
+	if(id < STREAM_OFFSET_TXD){
+		CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(id);
+		return mi->IsSimple() && mi->m_isBigBuilding ? STREAMCAT_LODS : STREAMCAT_MODELS;
+	}
+	if(id < STREAM_OFFSET_COL)
+		return STREAMCAT_TEXTURES;
+	if(id < STREAM_OFFSET_ANIM)
+		return STREAMCAT_COLLISION;
+	return STREAMCAT_ANIMATION;
+}
+
+size_t
+CStreaming::GetMemoryBudget(void)
+{
+	if(ms_bMemoryBudget && ms_memoryCapMB > 0)
+		return (size_t)ms_memoryCapMB * 1024 * 1024;
+	return ms_memoryAvailable;
+}
+
+// Same sizes ms_memoryUsed goes by
+void
+CStreaming::UpdateBudgetMemory(int32 id, bool loaded)
+{
+	int32 cat = GetStreamCategory(id);
+	size_t size = ms_aInfoForModel[id].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+	uint32 time = CTimer::GetTimeInMilliseconds();
+
+	if(loaded){
+		ms_aCategoryMemory[cat] += size;
+		ms_aCategoryFiles[cat]++;
+		ms_aLastUsedTime[id] = time;
+	}else{
+		ms_aCategoryMemory[cat] -= size;
+		ms_aCategoryFiles[cat]--;
+		// dependencies are only unused from now on
+		if(id < STREAM_OFFSET_TXD){
+			CBaseModelInfo *mi = CModelInfo::GetModelInfo(id);
+			ms_aLastUsedTime[mi->GetTxdSlot() + STREAM_OFFSET_TXD] = time;
+			if(mi->GetAnimFileIndex() != -1)
+				ms_aLastUsedTime[mi->GetAnimFileIndex() + STREAM_OFFSET_ANIM] = time;
+		}
+	}
+}
+
+// Called for every instance that wants the model, keeps the closest one of this frame
+void
+CStreaming::MarkModelUsed(int32 id, float dist)
+{
+	uint32 time = CTimer::GetTimeInMilliseconds();
+	if(ms_aLastUsedTime[id] != time || dist < ms_aUseDistance[id])
+		ms_aUseDistance[id] = dist;
+	ms_aLastUsedTime[id] = time;
+}
+
+// Same rules as RemoveLeastUsedModel. Collision isn't in here, CColStore::LoadCollision manages it.
+bool
+CStreaming::CanEvictModel(int32 id)
+{
+	if(id < STREAM_OFFSET_TXD)
+		return CModelInfo::GetModelInfo(id)->GetNumRefs() == 0;
+	if(id < STREAM_OFFSET_COL)
+		return CTxdStore::GetNumRefs(id - STREAM_OFFSET_TXD) == 0 &&
+			!IsTxdUsedByRequestedModels(id - STREAM_OFFSET_TXD);
+	if(id >= STREAM_OFFSET_ANIM)
+		return CAnimManager::GetNumRefsToAnimBlock(id - STREAM_OFFSET_ANIM) == 0 &&
+			!AreAnimsUsedByRequestedModels(id - STREAM_OFFSET_ANIM);
+	return false;
+}
+
+// What we save by removing a file, big far away files that haven't been used for long go first
+float
+CStreaming::GetEvictionCost(int32 id)
+{
+	float size = ms_aInfoForModel[id].GetCdSize() * CDSTREAM_SECTOR_SIZE;
+	float age = CTimer::GetTimeInMilliseconds() - ms_aLastUsedTime[id];
+	float dist = id < STREAM_OFFSET_TXD ? ms_aUseDistance[id] : EVICT_DEFAULT_DIST;
+	// offsets so a file that is close or was just used still ranks by the other terms
+	return size * (dist + 10.0f) * (age + 1000.0f);
+}
+
+// Removable loaded file with the highest eviction cost, -1 for none
+int32
+CStreaming::FindEvictionCandidate(int32 category, uint32 excludeMask)
+{
+	CStreamingInfo *si;
+	int32 streamId, best;
+	float cost, bestCost;
+
+	best = -1;
+	bestCost = -1.0f;
+	for(si = ms_endLoadedList.m_prev; si != &ms_startLoadedList; si = si->m_prev){
+		if(si->m_flags & excludeMask)
+			continue;
+		streamId = si - ms_aInfoForModel;
+		if(category != -1 && GetStreamCategory(streamId) != category)
+			continue;
+		cost = GetEvictionCost(streamId);
+		if(cost > bestCost && CanEvictModel(streamId)){
+			best = streamId;
+			bestCost = cost;
+		}
+	}
+	return best;
+}
+
+// Quotas are checked once per frame rather than before every load,
+// a category can go over for a frame until its files are evicted here
+void
+CStreaming::EnforceCategoryQuotas(void)
+{
+	int32 cat, streamId;
+	size_t quota;
+
+	if(!ms_bMemoryBudget)
+		return;
+	for(cat = 0; cat < NUM_STREAMCATS; cat++){
+		if(ms_aCategoryQuota[cat] >= 100)
+			continue;
+		quota = GetMemoryBudget() / 100 * ms_aCategoryQuota[cat];
+		while(ms_aCategoryMemory[cat] > quota){
+			streamId = FindEvictionCandidate(cat, STREAMFLAGS_20);
+			if(streamId == -1)
+				break;
+			RemoveModel(streamId);
+			ms_numBudgetEvictions++;
+		}
+	}
+}
+
+void
+CStreaming::PrintMemoryBudget(void)
+{
+	int32 cat;
+
+	debug("streaming: %zu of %zu KB used, %d evictions\n", ms_memoryUsed/1024, GetMemoryBudget()/1024, ms_numBudgetEvictions);
+	for(cat = 0; cat < NUM_STREAMCATS; cat++)
+		debug("streaming: %-9s %6zu KB in %4d files, quota %zu KB\n", ms_aCategoryNames[cat],
+			ms_aCategoryMemory[cat]/1024, ms_aCategoryFiles[cat], GetMemoryBudget() / 100 * ms_aCategoryQuota[cat] / 1024);
+}
+#endif
+
 void
 CStreaming::RemoveAllUnusedModels(void)
 {
@@ -1732,6 +2304,9 @@ CStreaming::StreamVehiclesAndPeds(void)
 		model = CCarCtrl::ChooseCarModelToLoad(mostRequestedRating);
 		if(!HasModelLoaded(model)){
 			RequestModel(model, STREAMFLAGS_DEPENDENCY);
+#ifdef STREAMING_DEADLINES
+			SetRequestDeadline(model, STREAMDEADLINE_POPULATION);
+#endif
 			timeBeforeNextLoad = 350;
 		}
 		CCarCtrl::NumRequestsOfCarRating[mostRequestedRating] = 0;
@@ -1986,6 +2561,10 @@ inline bool
 ModelNotLoaded(int32 modelId)
 {
 	CStreamingInfo *si = &CStreaming::ms_aInfoForModel[modelId];
+#ifdef ASYNC_STREAM_DECODE
+	if(si->m_loadState == STREAMSTATE_DECODING)
+		return false;
+#endif
 	return si->m_loadState != STREAMSTATE_LOADED && si->m_loadState != STREAMSTATE_READING;
 }
 
@@ -2001,6 +2580,17 @@ CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
 	uint32 posn, size;
 	int streamIdFirst, streamIdNext;
 	uint32 posnFirst, posnNext;
+#ifdef STREAMING_DEADLINES
+	int streamIdUrgentFirst, streamIdUrgentNext;
+	uint32 posnUrgentFirst, posnUrgentNext;
+	uint32 urgentTime = CTimer::GetTimeInMilliseconds() + ms_deadlineSlack;
+
+	streamIdUrgentFirst = -1;
+	streamIdUrgentNext = -1;
+	posnUrgentFirst = UINT32_MAX;
+	posnUrgentNext = UINT32_MAX;
+	ms_numUrgentRequests = 0;
+#endif
 
 	streamIdFirst = -1;
 	streamIdNext = -1;
@@ -2041,6 +2631,20 @@ CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
 				streamIdNext = streamId;
 				posnNext = posn;
 			}
+#ifdef STREAMING_DEADLINES
+			// same again for the requests that are due soon
+			if((int32)(ms_aRequestDeadlines[streamId] - urgentTime) <= 0){
+				ms_numUrgentRequests++;
+				if(posn < posnUrgentFirst){
+					streamIdUrgentFirst = streamId;
+					posnUrgentFirst = posn;
+				}
+				if(posn < posnUrgentNext && posn >= (uint32)lastPosn){
+					streamIdUrgentNext = streamId;
+					posnUrgentNext = posn;
+				}
+			}
+#endif
 		}else{
 			// empty file
 			DecrementRef(streamId);
@@ -2053,6 +2657,13 @@ CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
 	if(streamIdNext == -1)
 		streamIdNext = streamIdFirst;
 
+#ifdef STREAMING_DEADLINES
+	// Read what's due soon first, still in disk order so reads stay sequential,
+	// RequestModelStream then adds the adjacent files to the same read
+	if(ms_bDeadlineScheduling && streamIdUrgentFirst != -1)
+		streamIdNext = streamIdUrgentNext != -1 ? streamIdUrgentNext : streamIdUrgentFirst;
+#endif
+
 	if(streamIdNext == -1 && ms_numPriorityRequests != 0){
 		// try non-priority files
 		ms_numPriorityRequests = 0;
@@ -2067,8 +2678,22 @@ CStreaming::GetNextFileOnCd(int32 lastPosn, bool priority)
  * Files larger than the buffer size can only be loaded by channel 0,
  * which then uses both buffers, while channel 1 is idle.
  * ms_bLoadingBigModel is set to true to indicate this state.
+ * With MAPPED_IMG none of this applies to mapped images,
+ * the files are parsed straight from the mapping.
  */
 
+// Where the data of a channel read ends up
+static int8*
+GetReadBuffer(int32 ch, uint32 posn, uint32 size)
+{
+#ifdef MAPPED_IMG
+	int8 *data = (int8*)CdStreamGetMappedData(posn, size);
+	if(data)
+		return data;
+#endif
+	return CStreaming::ms_pStreamingBuffer[ch];
+}
+
 // Make channel read from disc
 void
 CStreaming::RequestModelStream(int32 ch)
@@ -2078,6 +2703,9 @@ CStreaming::RequestModelStream(int32 ch)
 	uint32 posn, size, unused;
 	int i;
 	int haveBigFile, havePed;
+#ifdef MAPPED_IMG
+	bool mapped;
+#endif
 
 	lastPosn = CdStreamGetLastPosn();
 	imgOffset = GetCdImageOffset(lastPosn);
@@ -2106,7 +2734,12 @@ CStreaming::RequestModelStream(int32 ch)
 		return;
 
 	ms_aInfoForModel[streamId].GetCdPosnAndSize(posn, size);
+#ifdef MAPPED_IMG
+	mapped = CdStreamGetMappedData(imgOffset+posn, size) != nil;
+	if(!mapped && size > (uint32)ms_streamingBufferSize){
+#else
 	if(size > (uint32)ms_streamingBufferSize){
+#endif
 		// Can only load big models on channel 0, and 1 has to be idle
 		if(ch == 1 || ms_channel[1].state != CHANNELSTATE_IDLE)
 			return;
@@ -2145,7 +2778,12 @@ CStreaming::RequestModelStream(int32 ch)
 		totalSize += size;
 
 		// To big for buffer, remove again
+#ifdef MAPPED_IMG
+		if(mapped ? i > 0 && CdStreamGetMappedData(imgOffset+posn, totalSize) == nil :
+		            totalSize > ms_streamingBufferSize && i > 0){
+#else
 		if(totalSize > ms_streamingBufferSize && i > 0){
+#endif
 			totalSize -= size;
 			break;
 		}
@@ -2185,6 +2823,10 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 {
 	int status;
 	int i, id, cdsize;
+	int8 *buf;
+#ifdef ASYNC_STREAM_DECODE
+	bool processedFile = false;
+#endif
 
 	status = CdStreamGetStatus(ch);
 	if(status != STREAM_NONE){
@@ -2197,9 +2839,10 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 		return false;
 	}
 
+	buf = GetReadBuffer(ch, ms_channel[ch].position, ms_channel[ch].size);
 	if(ms_channel[ch].state == CHANNELSTATE_STARTED){
 		ms_channel[ch].state = CHANNELSTATE_IDLE;
-		FinishLoadingLargeFile(&ms_pStreamingBuffer[ch][ms_channel[ch].offsets[0]*CDSTREAM_SECTOR_SIZE],
+		FinishLoadingLargeFile(&buf[ms_channel[ch].offsets[0]*CDSTREAM_SECTOR_SIZE],
 			ms_channel[ch].streamIds[0]);
 		ms_channel[ch].streamIds[0] = -1;
 	}else{
@@ -2209,6 +2852,16 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 			if(id == -1)
 				continue;
 
+#ifdef ASYNC_STREAM_DECODE
+			// Out of time for this frame, leave the rest of the channel for the next one.
+			// CdStreamGetStatus keeps returning STREAM_NONE so we'll just end up here again.
+			if(processedFile && ms_channel[ch].state != CHANNELSTATE_STARTED && IsFrameBudgetExceeded()){
+				ms_channel[ch].state = CHANNELSTATE_READING;
+				return true;
+			}
+			processedFile = true;
+#endif
+
 			cdsize = ms_aInfoForModel[id].GetCdSize();
 			if(id < STREAM_OFFSET_TXD && CModelInfo::GetModelInfo(id)->GetModelType() == MITYPE_VEHICLE &&
 			   ms_numVehiclesLoaded >= desiredNumVehiclesLoaded &&
@@ -2222,7 +2875,10 @@ CStreaming::ProcessLoadingChannel(int32 ch)
 					RemoveTxd(CModelInfo::GetModelInfo(id)->GetTxdSlot());
 			}else{
 				MakeSpaceFor(cdsize * CDSTREAM_SECTOR_SIZE);
-				ConvertBufferToObject(&ms_pStreamingBuffer[ch][ms_channel[ch].offsets[i]*CDSTREAM_SECTOR_SIZE],
+#ifdef ASYNC_STREAM_DECODE
+				if(!QueueDecode(&buf[ms_channel[ch].offsets[i]*CDSTREAM_SECTOR_SIZE], id))
+#endif
+				ConvertBufferToObject(&buf[ms_channel[ch].offsets[i]*CDSTREAM_SECTOR_SIZE],
 					id);
 				if(ms_aInfoForModel[id].m_loadState == STREAMSTATE_STARTED){
 					// queue for second part
@@ -2445,6 +3101,7 @@ CStreaming::LoadAllRequestedModels(bool priority)
 	int imgOffset, streamId, status;
 	int i;
 	uint32 posn, size;
+	int8 *buf;
 
 	int numRequests = 4*ms_numModelsRequested;
 
@@ -2456,6 +3113,9 @@ CStreaming::LoadAllRequestedModels(bool priority)
 		numRequests = ms_numPriorityRequests;
 
 	FlushChannels();
+#ifdef ASYNC_STREAM_DECODE
+	CommitDecodedFiles(true);
+#endif
 	imgOffset = GetCdImageOffset(CdStreamGetLastPosn());
 
 	while(ms_endRequestedList.m_prev != &ms_startRequestedList && numRequests > 0){
@@ -2474,10 +3134,11 @@ CStreaming::LoadAllRequestedModels(bool priority)
 			while(CdStreamSync(0) || status == STREAM_NONE);
 			ms_aInfoForModel[streamId].m_loadState = STREAMSTATE_READING;
 
+			buf = GetReadBuffer(0, imgOffset+posn, size);
 			MakeSpaceFor(size * CDSTREAM_SECTOR_SIZE);
-			ConvertBufferToObject(ms_pStreamingBuffer[0], streamId);
+			ConvertBufferToObject(buf, streamId);
 			if(ms_aInfoForModel[streamId].m_loadState == STREAMSTATE_STARTED)
-				FinishLoadingLargeFile(ms_pStreamingBuffer[0], streamId);
+				FinishLoadingLargeFile(buf, streamId);
 
 			if(streamId < STREAM_OFFSET_TXD){
 				CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(streamId);
@@ -2643,8 +3304,12 @@ CStreaming::ProcessEntitiesInSectorList(CPtrList &list, float x, float y, float
 				pos = CVector2D(e->GetPosition());
 				if(xmin < pos.x && pos.x < xmax &&
 				   ymin < pos.y && pos.y < ymax &&
-				   (CVector2D(x, y) - pos).MagnitudeSqr() < lodDistSq)
+				   (CVector2D(x, y) - pos).MagnitudeSqr() < lodDistSq){
 					RequestModel(e->GetModelIndex(), flags);
+#ifdef STREAMING_MEMORY_BUDGET
+					MarkModelUsed(e->GetModelIndex(), (CVector2D(x, y) - pos).Magnitude());
+#endif
+				}
 			}
 		}
 	}
@@ -2665,12 +3330,166 @@ CStreaming::ProcessEntitiesInSectorList(CPtrList &list, int32 flags)
 		e->m_scanCode = CWorld::GetCurrentScanCode();
 		if(!e->bStreamingDontDelete && IsAreaVisible(e->m_area) && !e->bDontStream && e->bIsVisible){
 			CTimeModelInfo *mi = (CTimeModelInfo*)CModelInfo::GetModelInfo(e->GetModelIndex());
-			if (mi->GetModelType() != MITYPE_TIME || CClock::GetIsTimeInRange(mi->GetTimeOn(), mi->GetTimeOff()))
+			if (mi->GetModelType() != MITYPE_TIME || CClock::GetIsTimeInRange(mi->GetTimeOn(), mi->GetTimeOff())){
 				RequestModel(e->GetModelIndex(), flags);
+#ifdef STREAMING_MEMORY_BUDGET
+				MarkModelUsed(e->GetModelIndex(), 0.0f);	// same sector
+#endif
+			}
 		}
 	}
 }
 
+#ifdef PREDICTIVE_STREAMING
+#define PREDICT_MAX_DIST 320.0f
+#define PREDICT_ROAD_DIST 20.0f
+
+// Car node closest to pos, or -1 if we're off road
+static int32
+FindPredictionStartNode(const CVector &pos)
+{
+	int32 node, next;
+	int i;
+	float dist, closestDist;
+	bool moved;
+
+	node = gLastPredictionNode;
+	if(node >= 0 && node < ThePaths.m_numCarPathNodes){
+		// walk from last frame's node, much cheaper than looking at all of them
+		closestDist = (ThePaths.m_pathNodes[node].GetPosition() - pos).MagnitudeSqr2D();
+		do{
+			moved = false;
+			CPathNode *n = &ThePaths.m_pathNodes[node];
+			for(i = 0; i < n->numLinks; i++){
+				next = ThePaths.ConnectedNode(n->firstLink + i);
+				dist = (ThePaths.m_pathNodes[next].GetPosition() - pos).MagnitudeSqr2D();
+				if(dist < closestDist){
+					closestDist = dist;
+					node = next;
+					moved = true;
+					break;
+				}
+			}
+		}while(moved);
+		if(closestDist < sq(PREDICT_ROAD_DIST))
+			return gLastPredictionNode = node;
+	}
+	// full search is slow, don't do it every frame when off road
+	if((CTimer::GetFrameCounter() & 7) != 0)
+		return -1;
+	return gLastPredictionNode = ThePaths.FindNodeClosestToCoors(pos, PATH_CAR, PREDICT_ROAD_DIST);
+}
+
+// Walk from a to b and remember a position wherever the next sample distance is crossed
+static void
+AddPredictedSegment(const CVector &a, const CVector &b, float &travelled, float &nextSample, float dist)
+{
+	float len = (b - a).Magnitude2D();
+	if(len <= 0.0f)
+		return;
+	while(nextSample <= travelled + len && CStreaming::ms_numPredictedPositions < NUMPREDICTEDPOSITIONS){
+		CStreaming::ms_aPredictedPositions[CStreaming::ms_numPredictedPositions++] =
+			a + (b - a)*((nextSample - travelled)/len);
+		// the camera scan covers STREAM_DIST around the camera, so step by that
+		nextSample = nextSample < dist ? Min(nextSample + STREAM_DIST, dist) : dist + 1.0f;
+	}
+	travelled += len;
+}
+
+// Follow the car paths from the player's vehicle, picking the link that goes
+// straightest at every node, or just go along the velocity when off road.
+void
+CStreaming::PredictPlayerPath(void)
+{
+	CVector pos, dir, nodePos, linkDir;
+	float speed, dist, travelled, nextSample, dot, bestDot;
+	int32 node, prevNode, next, bestNode;
+	int i, step;
+
+	ms_numPredictedPositions = 0;
+	if(!ms_bPredictiveStreaming || CReplay::IsPlayingBack() || CGame::currArea != AREA_MAIN_MAP)
+		return;
+
+	pos = FindPlayerEntity()->GetPosition();
+	dir = FindPlayerSpeed() * 50.0f;	// move speed is per 1/50 s
+	dir.z = 0.0f;
+	speed = dir.Magnitude2D();
+	if(speed < ms_fPredictionMinSpeed)
+		return;
+	dir /= speed;
+	dist = Min(speed*ms_fPredictionTime, PREDICT_MAX_DIST);
+	travelled = 0.0f;
+	nextSample = Min(STREAM_DIST, dist);
+
+	node = FindPredictionStartNode(pos);
+	prevNode = -1;
+	for(step = 0; node >= 0 && step < 32 && travelled < dist; step++){
+		nodePos = ThePaths.m_pathNodes[node].GetPosition();
+		// closest node might be behind us
+		if(DotProduct2D(nodePos - pos, dir) > 0.0f){
+			linkDir = nodePos - pos;
+			linkDir.z = 0.0f;
+			if(linkDir.MagnitudeSqr2D() > 1.0f){
+				linkDir.Normalise2D();
+				dir = linkDir;
+			}
+			AddPredictedSegment(pos, nodePos, travelled, nextSample, dist);
+			pos = nodePos;
+		}
+
+		bestNode = -1;
+		bestDot = 0.5f;	// don't take turns sharper than 60 deg
+		CPathNode *n = &ThePaths.m_pathNodes[node];
+		for(i = 0; i < n->numLinks; i++){
+			next = ThePaths.ConnectedNode(n->firstLink + i);
+			if(next == prevNode)
+				continue;
+			linkDir = ThePaths.m_pathNodes[next].GetPosition() - nodePos;
+			linkDir.z = 0.0f;
+			linkDir.Normalise2D();
+			dot = DotProduct2D(linkDir, dir);
+			if(dot > bestDot){
+				bestDot = dot;
+				bestNode = next;
+			}
+		}
+		prevNode = node;
+		node = bestNode;
+	}
+
+	// off road or the road ended
+	if(travelled < dist)
+		AddPredictedSegment(pos, pos + dir*(dist - travelled), travelled, nextSample, dist);
+}
+
+// Request what's around the predicted positions, like AddModelsToRequestList does
+// for the camera. Txds and anims come along as dependencies and CColStore::LoadCollision
+// keeps the collision for the predicted positions.
+void
+CStreaming::AddPredictedModelsToRequestList(void)
+{
+	int i;
+
+	gPredictionPass = PREDICTPASS_AHEAD;
+	for(i = 0; i < ms_numPredictedPositions; i++)
+		AddModelsToRequestList(ms_aPredictedPositions[i], 0);
+	gPredictionPass = PREDICTPASS_NONE;
+}
+
+void
+CStreaming::PrintPredictionStats(void)
+{
+	int32 total = ms_numPredictionHits + ms_numPredictionLate + ms_numPredictionMisses;
+	debug("streaming: %d models reached the camera at speed, %d loaded because of the prediction, %d predicted but still loading, %d not predicted\n",
+		total, ms_numPredictionHits, ms_numPredictionLate, ms_numPredictionMisses);
+	if(total > 0)
+		debug("streaming: prediction hit rate %.1f%%\n", ms_numPredictionHits*100.0f/total);
+	ms_numPredictionHits = 0;
+	ms_numPredictionLate = 0;
+	ms_numPredictionMisses = 0;
+}
+#endif
+
 void
 CStreaming::DeleteFarAwayRwObjects(const CVector &pos)
 {
@@ -3083,11 +3902,22 @@ CStreaming::MakeSpaceFor(int32 size)
 	}
 #undef MB
 #endif
+#ifdef STREAMING_MEMORY_BUDGET
+	size_t budget = GetMemoryBudget();
+	// a file bigger than the whole budget can't fit, make as much room as there is
+	size_t target = (size_t)size >= budget ? 0 : budget - size;
+	while(ms_memoryUsed >= target)
+		if(!RemoveLeastUsedModel(STREAMFLAGS_20)){
+			DeleteRwObjectsBehindCamera(target);
+			return;
+		}
+#else
 	while(ms_memoryUsed >= ms_memoryAvailable - size)
 		if(!RemoveLeastUsedModel(STREAMFLAGS_20)){
 			DeleteRwObjectsBehindCamera(ms_memoryAvailable - size);
 			return;
 		}
+#endif
 }
 
 void
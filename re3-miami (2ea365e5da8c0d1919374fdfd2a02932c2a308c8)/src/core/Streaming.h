@@ -29,7 +29,47 @@ enum StreamLoadState
 	STREAMSTATE_INQUEUE   = 2,
 	STREAMSTATE_READING   = 3,	// channel is reading
 	STREAMSTATE_STARTED   = 4,	// first part loaded
+#ifdef ASYNC_STREAM_DECODE
+	STREAMSTATE_DECODING  = 5,	// being decoded on a worker thread
+#endif
+};
+
+#ifdef PREDICTIVE_STREAMING
+#define NUMPREDICTEDPOSITIONS 4
+
+enum
+{
+	PREDICTION_NONE,
+	PREDICTION_REQUESTED,	// requested ahead of the camera
+	PREDICTION_COUNTED,	// reached the camera, counted as hit or miss
+};
+#endif
+
+#ifdef STREAMING_MEMORY_BUDGET
+// What the memory budget is split into, same as the MEMID_STREAM_* ids
+enum
+{
+	STREAMCAT_MODELS,
+	STREAMCAT_LODS,
+	STREAMCAT_TEXTURES,
+	STREAMCAT_COLLISION,
+	STREAMCAT_ANIMATION,
+	NUM_STREAMCATS
+};
+#endif
+
+#ifdef STREAMING_DEADLINES
+// How long a request may take to load, in ms
+enum
+{
+	STREAMDEADLINE_PRIORITY = 0,
+	STREAMDEADLINE_VISIBLE = 100,	// in draw range already, would pop in
+	STREAMDEADLINE_SCRIPT = 1000,
+	STREAMDEADLINE_POPULATION = 3000,
+	STREAMDEADLINE_DEFAULT = 5000,
+	STREAMDEADLINE_MAX = 10000,
 };
+#endif
 
 enum ChannelState
 {
@@ -112,6 +152,45 @@ public:
 	static int32 ms_lastImageRead;
 	static int32 ms_imageSize;
 	static size_t ms_memoryAvailable;
+#ifdef ASYNC_STREAM_DECODE
+	static bool ms_bAsyncDecode;
+	static int32 ms_frameBudget;	// ms per frame for converting and committing streamed files, 0 is unlimited
+	static bool ms_bUseFrameBudget;
+	static uint32 ms_frameStartTime;
+#endif
+#ifdef STREAMING_DEADLINES
+	static bool ms_bDeadlineScheduling;
+	static int32 ms_deadlineSlack;	// requests due within this many ms are read before anything else
+	static uint32 ms_aRequestDeadlines[NUMSTREAMINFO];
+	static float ms_fCameraSpeed;	// units per ms, smoothed
+	static CVector ms_vecLastCameraPos;
+	static int32 ms_numUrgentRequests;
+	static int32 ms_numDeadlinesMet;
+	static int32 ms_numDeadlinesMissed;
+	static int32 ms_maxDeadlineMiss;
+#endif
+#ifdef PREDICTIVE_STREAMING
+	static bool ms_bPredictiveStreaming;
+	static float ms_fPredictionTime;	// how far ahead in seconds
+	static float ms_fPredictionMinSpeed;	// m/s, below this the camera scan is enough
+	static CVector ms_aPredictedPositions[NUMPREDICTEDPOSITIONS];
+	static int32 ms_numPredictedPositions;
+	static uint8 ms_aPredictionState[STREAM_OFFSET_TXD];
+	static int32 ms_numPredictionHits;	// loaded in time because of the prediction
+	static int32 ms_numPredictionLate;	// predicted but still loading
+	static int32 ms_numPredictionMisses;	// not predicted and not loaded
+#endif
+#ifdef STREAMING_MEMORY_BUDGET
+	static bool ms_bMemoryBudget;
+	static int32 ms_memoryCapMB;	// use this instead of ms_memoryAvailable, 0 for no cap
+	static int32 ms_aCategoryQuota[NUM_STREAMCATS];	// percent of the budget
+	static const char *ms_aCategoryNames[NUM_STREAMCATS];
+	static size_t ms_aCategoryMemory[NUM_STREAMCATS];
+	static int32 ms_aCategoryFiles[NUM_STREAMCATS];
+	static int32 ms_numBudgetEvictions;
+	static uint32 ms_aLastUsedTime[NUMSTREAMINFO];
+	static float ms_aUseDistance[STREAM_OFFSET_TXD];	// of the closest instance when last used
+#endif
 
 	static void Init(void);
 	static void Init2(void);
@@ -122,6 +201,35 @@ public:
 	static void LoadCdDirectory(const char *dirname, int32 n);
 	static bool ConvertBufferToObject(int8 *buf, int32 streamId);
 	static bool FinishLoadingLargeFile(int8 *buf, int32 streamId);
+#ifdef ASYNC_STREAM_DECODE
+	static bool QueueDecode(int8 *buf, int32 streamId);
+	static void CommitDecodedFiles(bool all);
+	static void CancelDecode(int32 streamId);
+	static bool IsFrameBudgetExceeded(void);
+#endif
+#ifdef STREAMING_DEADLINES
+	static void SetRequestDeadline(int32 id, int32 time);
+	static int32 GetDeadlineForDistance(float dist);
+	static void UpdateCameraSpeed(void);
+	static void CheckRequestDeadline(int32 id);
+	static void PrintSchedulerStats(void);
+#endif
+#ifdef STREAMING_MEMORY_BUDGET
+	static int32 GetStreamCategory(int32 id);
+	static size_t GetMemoryBudget(void);
+	static void UpdateBudgetMemory(int32 id, bool loaded);
+	static void MarkModelUsed(int32 id, float dist);
+	static bool CanEvictModel(int32 id);
+	static float GetEvictionCost(int32 id);
+	static int32 FindEvictionCandidate(int32 category, uint32 excludeMask);
+	static void EnforceCategoryQuotas(void);
+	static void PrintMemoryBudget(void);
+#endif
+#ifdef PREDICTIVE_STREAMING
+	static void PredictPlayerPath(void);
+	static void AddPredictedModelsToRequestList(void);
+	static void PrintPredictionStats(void);
+#endif
 	static bool HasModelLoaded(int32 id) { return ms_aInfoForModel[id].m_loadState == STREAMSTATE_LOADED; }
 	static bool HasTxdLoaded(int32 id) { return HasModelLoaded(id+STREAM_OFFSET_TXD); }
 	static bool HasColLoaded(int32 id) { return HasModelLoaded(id+STREAM_OFFSET_COL); }
@@ -15,7 +15,7 @@ class CTimer
 	static uint32 m_snPreviousTimeInMilliseconds;
 	static uint32 m_FrameCounter;
 	static float ms_fTimeScale;
-	static float ms_fTimeStep;
+	static JOBLOCAL float ms_fTimeStep;
 	static float ms_fTimeStepNonClipped;
 public:
 	static bool  m_UserPause;
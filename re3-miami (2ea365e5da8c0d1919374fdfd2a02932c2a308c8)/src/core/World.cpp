@@ -1,14 +1,32 @@
 #include "common.h"
+#include "Automobile.h"
+#include "Bike.h"
 #include "Camera.h"
 #include "CarCtrl.h"
 #include "CopPed.h"
 #include "CutsceneMgr.h"
 #include "DMAudio.h"
+#ifdef SECTOR_ENTITY_ARRAYS
+#include "Dummy.h"
+#endif
+#ifdef STATIC_BUILDING_BVH
+#include "BuildingBVH.h"
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+#include "GroundCache.h"
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+#include "BuildingCulling.h"
+#endif
+#ifdef ANIM_LOD
+#include "AnimLod.h"
+#endif
 #include "EventList.h"
 #include "Explosion.h"
 #include "Fire.h"
 #include "Garages.h"
 #include "Glass.h"
+#include "JobPool.h"
 #include "Messages.h"
 #include "ModelIndices.h"
 #include "ParticleObject.h"
@@ -21,17 +39,28 @@
 #include "RpAnimBlend.h"
 #include "Shadows.h"
 #include "TempColModels.h"
+#include "timebars.h"
 #include "WaterLevel.h"
 #include "World.h"
 
 #define OBJECT_REPOSITION_OFFSET_Z 2.0f
 
-CColPoint gaTempSphereColPoints[MAX_COLLISION_POINTS];
+JOBLOCAL CColPoint gaTempSphereColPoints[MAX_COLLISION_POINTS];
 
 CPtrList CWorld::ms_bigBuildingsList[NUM_LEVELS];
 CPtrList CWorld::ms_listMovingEntityPtrs;
 CSector CWorld::ms_aSectors[NUMSECTORS_Y][NUMSECTORS_X];
-uint16 CWorld::ms_nCurrentScanCode;
+JOBLOCAL uint16 CWorld::ms_nCurrentScanCode;
+#ifdef SECTOR_ENTITY_ARRAYS
+CSectorArray CWorld::ms_aSectorArrays[NUMSECTORS_Y][NUMSECTORS_X][NUMSECTORENTITYLISTS];
+bool CWorld::bUseSectorArrays = true;
+#endif
+#ifdef ISLAND_WORLD_PROCESS
+uint16 CWorld::ms_nScanCodeCounter;
+bool CWorld::bProcessByIslands = true;
+bool CWorld::bParallelIslands = true;
+bool CWorld::bCheckIslands;
+#endif
 
 uint8 CWorld::PlayerInFocus;
 CPlayerInfo CWorld::Players[NUMPLAYERS];
@@ -46,7 +75,7 @@ bool CWorld::bDoingCarCollisions;
 bool CWorld::bIncludeCarTyres;
 bool CWorld::bIncludeBikers;
 
-CColPoint CWorld::m_aTempColPts[MAX_COLLISION_POINTS];
+JOBLOCAL CColPoint CWorld::m_aTempColPts[MAX_COLLISION_POINTS];
 
 void
 CWorld::Initialise()
@@ -72,6 +101,9 @@ CWorld::Add(CEntity *ent)
 	else
 		ent->Add();
 
+#ifdef GROUND_HEIGHT_CACHE
+	if(ent->IsBuilding() || ent->IsDummy()) CGroundCache::InvalidateEntity(ent);
+#endif
 	if(ent->IsBuilding() || ent->IsDummy()) return;
 
 	if(!ent->GetIsStatic()) ((CPhysical *)ent)->AddToMovingList();
@@ -87,11 +119,80 @@ CWorld::Remove(CEntity *ent)
 	else
 		ent->Remove();
 
+#ifdef GROUND_HEIGHT_CACHE
+	if(ent->IsBuilding() || ent->IsDummy()) CGroundCache::InvalidateEntity(ent);
+#endif
 	if(ent->IsBuilding() || ent->IsDummy()) return;
 
 	if(!ent->GetIsStatic()) ((CPhysical *)ent)->RemoveFromMovingList();
 }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+static_assert(sizeof(CSector) == NUMSECTORENTITYLISTS*sizeof(CPtrList), "CSector has to be just its lists");
+
+// nil if list isn't a sector list
+CSectorArray*
+CWorld::GetSectorArray(CPtrList *list)
+{
+	uintptr i = ((uintptr)list - (uintptr)&ms_aSectors[0][0].m_lists[0]) / sizeof(CPtrList);
+	if(i >= NUMSECTORS_X*NUMSECTORS_Y*NUMSECTORENTITYLISTS)
+		return nil;
+	return &ms_aSectorArrays[0][0][0] + i;
+}
+
+static CEntryInfoNode*
+FindEntryInfo(CEntity *e, CPtrList *list)
+{
+	CEntryInfoNode *node = nil;
+	if(e->IsVehicle() || e->IsPed() || e->IsObject())
+		node = ((CPhysical*)e)->m_entryInfoList.first;
+	else if(e->IsDummy())
+		node = ((CDummy*)e)->m_entryInfoList.first;
+	for(; node; node = node->next)
+		if(node->list == list)
+			return node;
+	return nil;
+}
+
+// After something copied the lists behind our back (replays)
+void
+CWorld::RebuildSectorArrays(void)
+{
+	int i;
+	CPtrNode *node;
+	CPtrList *lists = &ms_aSectors[0][0].m_lists[0];
+	CSectorArray *arrays = &ms_aSectorArrays[0][0][0];
+	for(i = 0; i < NUMSECTORS_X*NUMSECTORS_Y*NUMSECTORENTITYLISTS; i++){
+		arrays[i].Flush();
+		for(node = lists[i].first; node; node = node->next)
+			arrays[i].Add((CEntity*)node->item, FindEntryInfo((CEntity*)node->item, &lists[i]));
+	}
+}
+
+void
+CWorld::ShutDownSectorArrays(void)
+{
+	int i;
+	CSectorArray *arrays = &ms_aSectorArrays[0][0][0];
+	for(i = 0; i < NUMSECTORS_X*NUMSECTORS_Y*NUMSECTORENTITYLISTS; i++)
+		arrays[i].Shutdown();
+}
+#endif
+
+#if defined(SECTOR_ENTITY_ARRAYS) || defined(BATCHED_LINE_OF_SIGHT)
+// Cached spheres are in world space, so unlike CCollision's sphere test
+// this doesn't need the entity's matrix
+static bool
+LineMissesSphere(const CColLine &line, const CVector &centre, float radius)
+{
+	CVector dir = line.p1 - line.p0;
+	CVector diff = centre - line.p0;
+	float len = dir.MagnitudeSqr();
+	float t = len > 0.0f ? clamp(DotProduct(diff, dir)/len, 0.0f, 1.0f) : 0.0f;
+	return (diff - dir*t).MagnitudeSqr() > sq(radius);
+}
+#endif
+
 void
 CWorld::ClearScanCodes(void)
 {
@@ -177,6 +278,13 @@ CWorld::ProcessLineOfSight(const CVector &point1, const CVector &point2, CColPoi
 	entity = nil;
 	dist = 1.0f;
 
+#ifdef STATIC_BUILDING_BVH
+	if(checkBuildings && CBuildingBVH::IsUsable()) {
+		CBuildingBVH::ProcessLineOfSight(CColLine(point1, point2), point, dist, entity, ignoreSeeThrough, ignoreShootThrough);
+		checkBuildings = false;
+	}
+#endif
+
 	xstart = GetSectorIndexX(point1.x);
 	ystart = GetSectorIndexY(point1.y);
 	xend = GetSectorIndexX(point2.x);
@@ -188,7 +296,12 @@ CWorld::ProcessLineOfSight(const CVector &point1, const CVector &point2, CColPoi
 
 	if(xstart == xend && ystart == yend) {
 		// Only one sector
+#ifdef STATIC_BUILDING_BVH
+		ProcessLineOfSightSector(*GetSector(xstart, ystart), LOSARGS);
+		return dist < 1.0f;
+#else
 		return ProcessLineOfSightSector(*GetSector(xstart, ystart), LOSARGS);
+#endif
 	} else if(xstart == xend) {
 		// Only step in y
 		if(ystart < yend)
@@ -327,6 +440,13 @@ bool
 CWorld::ProcessLineOfSightSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist,
                                      CEntity *&entity, bool ignoreSeeThrough, bool ignoreSomeObjects, bool ignoreShootThrough)
 {
+#ifdef SECTOR_ENTITY_ARRAYS
+	if(bUseSectorArrays){
+		CSectorArray *array = GetSectorArray(&list);
+		if(array)
+			return ProcessLineOfSightSectorArray(*array, line, point, dist, entity, ignoreSeeThrough, ignoreSomeObjects, ignoreShootThrough);
+	}
+#endif
 	bool deadPeds = false;
 	bool bikers = false;
 	bool carTyres = false;
@@ -390,6 +510,465 @@ CWorld::ProcessLineOfSightSectorList(CPtrList &list, const CColLine &line, CColP
 		return false;
 }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+bool
+CWorld::ProcessLineOfSightSectorArray(CSectorArray &array, const CColLine &line, CColPoint &point, float &dist,
+                                      CEntity *&entity, bool ignoreSeeThrough, bool ignoreSomeObjects, bool ignoreShootThrough)
+{
+	bool deadPeds = false;
+	bool bikers = false;
+	bool carTyres = false;
+	float mindist = dist;
+	CSectorArrayEntry *it, *end;
+	CEntity *e;
+	CColModel *colmodel;
+	CColModel tyreCol;
+	CColSphere tyreSpheres[6];
+	CColPoint tyreColPoint;
+	float tyreDist;
+
+	if(array.m_numEntries == 0)
+		return false;
+	e = array.m_entries[0].entity;
+	if(bIncludeCarTyres && e->IsVehicle()){
+		carTyres = true;
+		tyreCol.numTriangles = 0;
+		tyreCol.numBoxes = 0;
+		tyreCol.numLines = 0;
+		tyreCol.spheres = tyreSpheres;
+		tyreCol.numSpheres = ARRAY_SIZE(tyreSpheres);
+	}
+	if(bIncludeDeadPeds && e->IsPed()) deadPeds = true;
+	if(bIncludeBikers && e->IsPed()) bikers = true;
+
+	for(it = array.m_entries, end = it + array.m_numEntries; it != end; it++) {
+		if(it->radius >= 0.0f && LineMissesSphere(line, it->centre, it->radius))
+			continue;
+		e = it->entity;
+		if(e->m_scanCode != GetCurrentScanCode() && e != pIgnoreEntity && (e->bUsesCollision || deadPeds || bikers) &&
+		   !(ignoreSomeObjects && CameraToIgnoreThisObject(e))) {
+			colmodel = nil;
+			tyreDist = mindist;
+			e->m_scanCode = GetCurrentScanCode();
+
+			if(e->IsPed()) {
+				if(e->bUsesCollision || deadPeds && ((CPed *)e)->m_nPedState == PED_DEAD || bikers && ((CPed*)e)->InVehicle() && (((CPed*)e)->m_pMyVehicle->IsBike() || ((CPed*)e)->m_pMyVehicle->IsBoat())) {
+					colmodel = ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->AnimatePedColModelSkinned(e->GetClump());
+				} else
+					colmodel = nil;
+
+			} else if(e->bUsesCollision)
+				colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+
+			if(colmodel && CCollision::ProcessLineOfSight(line, e->GetMatrix(), *colmodel, point, mindist,
+			                                              ignoreSeeThrough, ignoreShootThrough))
+				entity = e;
+			if(carTyres && ((CVehicle*)e)->SetUpWheelColModel(&tyreCol) && CCollision::ProcessLineOfSight(line, e->GetMatrix(), tyreCol, tyreColPoint, tyreDist, false, ignoreShootThrough)){
+				float dp1 = DotProduct(line.p1 - line.p0, e->GetRight());
+				float dp2 = DotProduct(point.point - e->GetPosition(), e->GetRight());
+				if(tyreDist < mindist || dp1 < -0.85f && dp2 > 0.0f || dp1 > 0.85f && dp2 < 0.0f){
+					mindist = tyreDist;
+					point = tyreColPoint;
+					entity = e;
+				}
+			}
+		}
+	}
+	tyreCol.spheres = nil;
+
+	if(mindist < dist) {
+		dist = mindist;
+		return true;
+	} else
+		return false;
+}
+#endif
+
+#ifdef BATCHED_LINE_OF_SIGHT
+#define MAXLINESECTORS 64	// longer lines go through the single line queries
+
+// Entity of a sector list that passed the tests that don't depend on the line
+struct CBatchCandidate
+{
+	CEntity *entity;
+	CVector centre;
+	float radius;	// < 0 if the bounding sphere isn't enough (peds, car tyres)
+	bool peds;
+	bool tyres;
+};
+
+// All candidates of one sector, in the order the single line queries see them
+struct CBatchSector
+{
+	CSector *sector;
+	int32 first;
+	int32 count;
+};
+
+static CSector **pBatchPaths;
+static int32 maxBatchPaths;
+static int32 *pBatchPathLengths;
+static int32 maxBatchPathLengths;
+static CBatchSector *pBatchSectors;
+static int32 maxBatchSectors;
+static CBatchCandidate *pBatchCandidates;
+static int32 maxBatchCandidates;
+static int32 numBatchCandidates;
+
+template<typename T> static void
+GrowBatchBuffer(T *&buf, int32 &max, int32 needed)
+{
+	if(needed <= max)
+		return;
+	max = Max(needed, max*2);
+	buf = (T*)realloc(buf, max*sizeof(T));
+	assert(buf);
+}
+
+static bool
+AddPathSector(CSector **path, int32 &n, int x, int y)
+{
+	if(n == MAXLINESECTORS)
+		return false;
+	path[n++] = CWorld::GetSector(x, y);
+	return true;
+}
+
+static bool
+AddPathColumn(CSector **path, int32 &n, int x, int y1, int y2)
+{
+	int y;
+	if(y1 < y2){
+		for(y = y1; y <= y2; y++)
+			if(!AddPathSector(path, n, x, y)) return false;
+	}else{
+		for(y = y1; y >= y2; y--)
+			if(!AddPathSector(path, n, x, y)) return false;
+	}
+	return true;
+}
+
+// The sectors ProcessLineOfSight walks through, in the same order.
+// Returns their number or -1 if there are too many
+static int32
+GetLinePath(const CVector &point1, const CVector &point2, CSector **path)
+{
+	int32 n = 0;
+	int x, y1, y2;
+	int xstart = CWorld::GetSectorIndexX(point1.x);
+	int ystart = CWorld::GetSectorIndexY(point1.y);
+	int xend = CWorld::GetSectorIndexX(point2.x);
+	int yend = CWorld::GetSectorIndexY(point2.y);
+
+	if(xstart == xend)
+		return AddPathColumn(path, n, xstart, ystart, yend) ? n : -1;
+	if(ystart == yend){
+		if(xstart < xend){
+			for(x = xstart; x <= xend; x++)
+				if(!AddPathSector(path, n, x, ystart)) return -1;
+		}else{
+			for(x = xstart; x >= xend; x--)
+				if(!AddPathSector(path, n, x, ystart)) return -1;
+		}
+		return n;
+	}
+
+	float m = (point2.y - point1.y) / (point2.x - point1.x);
+	if(point1.x < point2.x){
+		y1 = ystart;
+		y2 = CWorld::GetSectorIndexY((CWorld::GetWorldX(xstart + 1) - point1.x) * m + point1.y);
+		if(!AddPathColumn(path, n, xstart, y1, y2)) return -1;
+		for(x = xstart + 1; x < xend; x++){
+			y1 = y2;
+			y2 = CWorld::GetSectorIndexY((CWorld::GetWorldX(x + 1) - point1.x) * m + point1.y);
+			if(!AddPathColumn(path, n, x, y1, y2)) return -1;
+		}
+	}else{
+		y1 = ystart;
+		y2 = CWorld::GetSectorIndexY((CWorld::GetWorldX(xstart) - point1.x) * m + point1.y);
+		if(!AddPathColumn(path, n, xstart, y1, y2)) return -1;
+		for(x = xstart - 1; x > xend; x--){
+			y1 = y2;
+			y2 = CWorld::GetSectorIndexY((CWorld::GetWorldX(x) - point1.x) * m + point1.y);
+			if(!AddPathColumn(path, n, x, y1, y2)) return -1;
+		}
+	}
+	if(!AddPathColumn(path, n, xend, y2, yend)) return -1;
+	return n;
+}
+
+static void
+AddBatchCandidates(CPtrList &list, bool clearOnly, bool ignoreSomeObjects, bool peds, bool vehicles)
+{
+	CPtrNode *node;
+	CEntity *e;
+	CBatchCandidate *c;
+	bool deadPeds = peds && !clearOnly && CWorld::bIncludeDeadPeds;
+	bool bikers = peds && !clearOnly && CWorld::bIncludeBikers;
+	bool tyres = vehicles && !clearOnly && CWorld::bIncludeCarTyres;
+
+	for(node = list.first; node; node = node->next) {
+		e = (CEntity *)node->item;
+		if(e == CWorld::pIgnoreEntity || !(e->bUsesCollision || deadPeds || bikers) ||
+		   ignoreSomeObjects && CWorld::CameraToIgnoreThisObject(e))
+			continue;
+		GrowBatchBuffer(pBatchCandidates, maxBatchCandidates, numBatchCandidates+1);
+		c = &pBatchCandidates[numBatchCandidates++];
+		c->entity = e;
+		c->peds = deadPeds || bikers;
+		c->tyres = tyres;
+		if(e->IsPed() || tyres)
+			c->radius = -1.0f;
+		else{
+			e->GetBoundCentre(c->centre);
+			c->radius = e->GetBoundRadius();
+		}
+	}
+}
+
+static int
+CompareBatchSectors(const void *a, const void *b)
+{
+	uintptr sa = (uintptr)*(CSector**)a;
+	uintptr sb = (uintptr)*(CSector**)b;
+	return sa < sb ? -1 : sa > sb ? 1 : 0;
+}
+
+static CBatchSector*
+FindBatchSector(CSector *sector, int32 numSectors)
+{
+	int32 lo = 0;
+	int32 hi = numSectors-1;
+	while(lo <= hi){
+		int32 mid = (lo+hi)/2;
+		if(pBatchSectors[mid].sector == sector)
+			return &pBatchSectors[mid];
+		if((uintptr)pBatchSectors[mid].sector < (uintptr)sector)
+			lo = mid+1;
+		else
+			hi = mid-1;
+	}
+	assert(0);
+	return nil;
+}
+
+// Walks every sector list touched by the batch once and keeps what's left,
+// returns the number of sectors. Path lengths are -1 for lines that didn't fit
+static int32
+GatherBatchCandidates(CWorldRay *rays, int32 numRays, bool clearOnly, bool checkBuildings,
+                      bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSomeObjects)
+{
+	int32 i, n, numSectors;
+	CSector **sorted;
+
+	// paths, followed by a sorted copy to find the unique sectors
+	GrowBatchBuffer(pBatchPaths, maxBatchPaths, numRays*MAXLINESECTORS*2);
+	GrowBatchBuffer(pBatchPathLengths, maxBatchPathLengths, numRays);
+	sorted = &pBatchPaths[numRays*MAXLINESECTORS];
+	n = 0;
+	for(i = 0; i < numRays; i++){
+		pBatchPathLengths[i] = GetLinePath(rays[i].start, rays[i].end, &pBatchPaths[i*MAXLINESECTORS]);
+		if(pBatchPathLengths[i] > 0){
+			memcpy(&sorted[n], &pBatchPaths[i*MAXLINESECTORS], pBatchPathLengths[i]*sizeof(CSector*));
+			n += pBatchPathLengths[i];
+		}
+	}
+	qsort(sorted, n, sizeof(CSector*), CompareBatchSectors);
+
+	numSectors = 0;
+	numBatchCandidates = 0;
+	for(i = 0; i < n; i++){
+		if(i > 0 && sorted[i] == sorted[i-1])
+			continue;
+		GrowBatchBuffer(pBatchSectors, maxBatchSectors, numSectors+1);
+		CBatchSector &s = pBatchSectors[numSectors++];
+		CSector &sector = *sorted[i];
+		s.sector = sorted[i];
+		s.first = numBatchCandidates;
+		if(checkBuildings){
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_BUILDINGS], clearOnly, false, false, false);
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_BUILDINGS_OVERLAP], clearOnly, false, false, false);
+		}
+		if(checkVehicles){
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_VEHICLES], clearOnly, false, false, true);
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_VEHICLES_OVERLAP], clearOnly, false, false, true);
+		}
+		if(checkPeds){
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_PEDS], clearOnly, false, true, false);
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_PEDS_OVERLAP], clearOnly, false, true, false);
+		}
+		if(checkObjects){
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_OBJECTS], clearOnly, ignoreSomeObjects, false, false);
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_OBJECTS_OVERLAP], clearOnly, ignoreSomeObjects, false, false);
+		}
+		if(checkDummies){
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_DUMMIES], clearOnly, false, false, false);
+			AddBatchCandidates(sector.m_lists[ENTITYLIST_DUMMIES_OVERLAP], clearOnly, false, false, false);
+		}
+		s.count = numBatchCandidates - s.first;
+	}
+	return numSectors;
+}
+
+// Same as the loop body of ProcessLineOfSightSectorList
+static void
+ProcessLineOfSightCandidate(const CBatchCandidate &c, const CColLine &line, CColPoint &point, float &mindist, CEntity *&entity,
+                            bool ignoreSeeThrough, bool ignoreShootThrough)
+{
+	CEntity *e = c.entity;
+	CColModel *colmodel = nil;
+	CColModel tyreCol;
+	CColSphere tyreSpheres[6];
+	CColPoint tyreColPoint;
+	float tyreDist = mindist;
+
+	e->m_scanCode = CWorld::GetCurrentScanCode();
+
+	if(e->IsPed()) {
+		if(e->bUsesCollision || c.peds && CWorld::bIncludeDeadPeds && ((CPed *)e)->m_nPedState == PED_DEAD ||
+		   c.peds && CWorld::bIncludeBikers && ((CPed*)e)->InVehicle() && (((CPed*)e)->m_pMyVehicle->IsBike() || ((CPed*)e)->m_pMyVehicle->IsBoat()))
+			colmodel = ((CPedModelInfo *)CModelInfo::GetModelInfo(e->GetModelIndex()))->AnimatePedColModelSkinned(e->GetClump());
+	} else if(e->bUsesCollision)
+		colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+
+	if(colmodel && CCollision::ProcessLineOfSight(line, e->GetMatrix(), *colmodel, point, mindist,
+	                                              ignoreSeeThrough, ignoreShootThrough))
+		entity = e;
+	if(c.tyres){
+		tyreCol.numTriangles = 0;
+		tyreCol.numBoxes = 0;
+		tyreCol.numLines = 0;
+		tyreCol.spheres = tyreSpheres;
+		tyreCol.numSpheres = ARRAY_SIZE(tyreSpheres);
+		if(((CVehicle*)e)->SetUpWheelColModel(&tyreCol) && CCollision::ProcessLineOfSight(line, e->GetMatrix(), tyreCol, tyreColPoint, tyreDist, false, ignoreShootThrough)){
+			float dp1 = DotProduct(line.p1 - line.p0, e->GetRight());
+			float dp2 = DotProduct(point.point - e->GetPosition(), e->GetRight());
+			if(tyreDist < mindist || dp1 < -0.85f && dp2 > 0.0f || dp1 > 0.85f && dp2 < 0.0f){
+				mindist = tyreDist;
+				point = tyreColPoint;
+				entity = e;
+			}
+		}
+		tyreCol.spheres = nil;
+	}
+}
+
+// Like calling ProcessLineOfSight for every ray, but every sector list the rays
+// pass through is only walked once and entities that can't be hit are thrown out
+// before the lines are looked at. Results are the same as for single lines.
+void
+CWorld::ProcessLinesOfSightBatch(CWorldRay *rays, int32 numRays, bool checkBuildings, bool checkVehicles, bool checkPeds,
+                                 bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects, bool ignoreShootThrough)
+{
+	int32 i, j, k, numSectors;
+	float dist;
+	bool checkSectorBuildings = checkBuildings;
+
+#ifdef STATIC_BUILDING_BVH
+	if(checkBuildings && CBuildingBVH::IsUsable())
+		checkSectorBuildings = false;
+#endif
+	numSectors = GatherBatchCandidates(rays, numRays, false, checkSectorBuildings, checkVehicles, checkPeds,
+	                                   checkObjects, checkDummies, ignoreSomeObjects);
+
+	for(i = 0; i < numRays; i++){
+		CWorldRay &ray = rays[i];
+		if(pBatchPathLengths[i] < 0){
+			ray.hit = ProcessLineOfSight(ray.start, ray.end, ray.point, ray.entity, checkBuildings, checkVehicles, checkPeds,
+			                             checkObjects, checkDummies, ignoreSeeThrough, ignoreSomeObjects, ignoreShootThrough);
+			continue;
+		}
+
+		CColLine line(ray.start, ray.end);
+		AdvanceCurrentScanCode();
+		ray.entity = nil;
+		dist = 1.0f;
+#ifdef STATIC_BUILDING_BVH
+		if(checkBuildings && !checkSectorBuildings)
+			CBuildingBVH::ProcessLineOfSight(line, ray.point, dist, ray.entity, ignoreSeeThrough, ignoreShootThrough);
+#endif
+		for(j = 0; j < pBatchPathLengths[i]; j++){
+			CBatchSector *s = FindBatchSector(pBatchPaths[i*MAXLINESECTORS + j], numSectors);
+			for(k = s->first; k < s->first + s->count; k++){
+				CBatchCandidate &c = pBatchCandidates[k];
+				if(c.entity->m_scanCode == GetCurrentScanCode() ||
+				   c.radius >= 0.0f && LineMissesSphere(line, c.centre, c.radius))
+					continue;
+				ProcessLineOfSightCandidate(c, line, ray.point, dist, ray.entity, ignoreSeeThrough, ignoreShootThrough);
+			}
+		}
+		ray.hit = dist < 1.0f;
+	}
+}
+
+// hit is set if the line is blocked, like !GetIsLineOfSightClear
+void
+CWorld::GetIsLinesOfSightClearBatch(CWorldRay *rays, int32 numRays, bool checkBuildings, bool checkVehicles, bool checkPeds,
+                                    bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects)
+{
+	int32 i, j, k, numSectors;
+	bool checkSectorBuildings = checkBuildings;
+
+#ifdef STATIC_BUILDING_BVH
+	if(checkBuildings && CBuildingBVH::IsUsable())
+		checkSectorBuildings = false;
+#endif
+	numSectors = GatherBatchCandidates(rays, numRays, true, checkSectorBuildings, checkVehicles, checkPeds,
+	                                   checkObjects, checkDummies, ignoreSomeObjects);
+
+	for(i = 0; i < numRays; i++){
+		CWorldRay &ray = rays[i];
+		ray.entity = nil;
+		if(pBatchPathLengths[i] < 0){
+			ray.hit = !GetIsLineOfSightClear(ray.start, ray.end, checkBuildings, checkVehicles, checkPeds,
+			                                 checkObjects, checkDummies, ignoreSeeThrough, ignoreSomeObjects);
+			continue;
+		}
+
+		CColLine line(ray.start, ray.end);
+		AdvanceCurrentScanCode();
+		ray.hit = false;
+#ifdef STATIC_BUILDING_BVH
+		if(checkBuildings && !checkSectorBuildings && !CBuildingBVH::GetIsLineOfSightClear(line, ignoreSeeThrough)){
+			ray.hit = true;
+			continue;
+		}
+#endif
+		for(j = 0; j < pBatchPathLengths[i] && !ray.hit; j++){
+			CBatchSector *s = FindBatchSector(pBatchPaths[i*MAXLINESECTORS + j], numSectors);
+			for(k = s->first; k < s->first + s->count; k++){
+				CEntity *e = pBatchCandidates[k].entity;
+				if(e->m_scanCode == GetCurrentScanCode() ||
+				   pBatchCandidates[k].radius >= 0.0f && LineMissesSphere(line, pBatchCandidates[k].centre, pBatchCandidates[k].radius))
+					continue;
+				e->m_scanCode = GetCurrentScanCode();
+				if(CCollision::TestLineOfSight(line, e->GetMatrix(), *CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel(), ignoreSeeThrough, false)){
+					ray.hit = true;
+					break;
+				}
+			}
+		}
+	}
+}
+
+void
+CWorld::ShutDownLineOfSightBatches(void)
+{
+	free(pBatchPaths);
+	free(pBatchPathLengths);
+	free(pBatchSectors);
+	free(pBatchCandidates);
+	pBatchPaths = nil;
+	pBatchPathLengths = nil;
+	pBatchSectors = nil;
+	pBatchCandidates = nil;
+	maxBatchPaths = 0;
+	maxBatchPathLengths = 0;
+	maxBatchSectors = 0;
+	maxBatchCandidates = 0;
+}
+#endif
+
 bool
 CWorld::ProcessVerticalLine(const CVector &point1, float z2, CColPoint &point, CEntity *&entity, bool checkBuildings,
                             bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies,
@@ -401,6 +980,32 @@ CWorld::ProcessVerticalLine(const CVector &point1, float z2, CColPoint &point, C
 	int secY = GetSectorIndexY(point1.y);
 	secX = clamp(secX, 0, NUMSECTORS_X-1);
 	secY = clamp(secY, 0, NUMSECTORS_Y-1);
+#ifdef STATIC_BUILDING_BVH
+	if(checkBuildings && CBuildingBVH::IsUsable()) {
+		CColLine line(point1, point2);
+		float dist = 1.0f;
+		bool hit = CBuildingBVH::ProcessVerticalLine(line, point, dist, entity, ignoreSeeThrough, poly);
+		if(!checkVehicles && !checkPeds && !checkObjects && !checkDummies)
+			return hit;
+
+		// everything else still comes from the sector, keep whichever hit is closer
+		CColPoint sectorPoint;
+		CEntity *sectorEntity = nil;
+		CStoredCollPoly sectorPoly;
+		if(poly)
+			sectorPoly = *poly;
+		if(ProcessVerticalLineSector(*GetSector(secX, secY), line, sectorPoint, sectorEntity, false, checkVehicles,
+		                             checkPeds, checkObjects, checkDummies, ignoreSeeThrough, poly ? &sectorPoly : nil) &&
+		   (!hit || (sectorPoint.point - point1).MagnitudeSqr() < (point.point - point1).MagnitudeSqr())) {
+			point = sectorPoint;
+			entity = sectorEntity;
+			if(poly)
+				*poly = sectorPoly;
+			hit = true;
+		}
+		return hit;
+	}
+#endif
 	return ProcessVerticalLineSector(*GetSector(secX, secY),
 	                                 CColLine(point1, point2), point, entity, checkBuildings, checkVehicles,
 	                                 checkPeds, checkObjects, checkDummies, ignoreSeeThrough, poly);
@@ -455,6 +1060,13 @@ bool
 CWorld::ProcessVerticalLineSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist,
                                       CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly)
 {
+#ifdef SECTOR_ENTITY_ARRAYS
+	if(bUseSectorArrays){
+		CSectorArray *array = GetSectorArray(&list);
+		if(array)
+			return ProcessVerticalLineSectorArray(*array, line, point, dist, entity, ignoreSeeThrough, poly);
+	}
+#endif
 	float mindist = dist;
 	CPtrNode *node;
 	CEntity *e;
@@ -479,6 +1091,38 @@ CWorld::ProcessVerticalLineSectorList(CPtrList &list, const CColLine &line, CCol
 		return false;
 }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+bool
+CWorld::ProcessVerticalLineSectorArray(CSectorArray &array, const CColLine &line, CColPoint &point, float &dist,
+                                       CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly)
+{
+	float mindist = dist;
+	CSectorArrayEntry *it, *end;
+	CEntity *e;
+	CColModel *colmodel;
+
+	for(it = array.m_entries, end = it + array.m_numEntries; it != end; it++) {
+		if(it->radius >= 0.0f && LineMissesSphere(line, it->centre, it->radius))
+			continue;
+		e = it->entity;
+		if(e->m_scanCode != GetCurrentScanCode() && e->bUsesCollision) {
+			e->m_scanCode = GetCurrentScanCode();
+
+			colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+			if(CCollision::ProcessVerticalLine(line, e->GetMatrix(), *colmodel, point, mindist,
+			                                   ignoreSeeThrough, false, poly))
+				entity = e;
+		}
+	}
+
+	if(mindist < dist) {
+		dist = mindist;
+		return true;
+	} else
+		return false;
+}
+#endif
+
 bool
 CWorld::GetIsLineOfSightClear(const CVector &point1, const CVector &point2, bool checkBuildings, bool checkVehicles,
                               bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough,
@@ -490,6 +1134,14 @@ CWorld::GetIsLineOfSightClear(const CVector &point1, const CVector &point2, bool
 
 	AdvanceCurrentScanCode();
 
+#ifdef STATIC_BUILDING_BVH
+	if(checkBuildings && CBuildingBVH::IsUsable()) {
+		if(!CBuildingBVH::GetIsLineOfSightClear(CColLine(point1, point2), ignoreSeeThrough))
+			return false;
+		checkBuildings = false;
+	}
+#endif
+
 	xstart = GetSectorIndexX(point1.x);
 	ystart = GetSectorIndexY(point1.y);
 	xend = GetSectorIndexX(point2.x);
@@ -654,6 +1306,13 @@ bool
 CWorld::GetIsLineOfSightSectorListClear(CPtrList &list, const CColLine &line, bool ignoreSeeThrough,
                                         bool ignoreSomeObjects)
 {
+#ifdef SECTOR_ENTITY_ARRAYS
+	if(bUseSectorArrays){
+		CSectorArray *array = GetSectorArray(&list);
+		if(array)
+			return GetIsLineOfSightSectorArrayClear(*array, line, ignoreSeeThrough, ignoreSomeObjects);
+	}
+#endif
 	CPtrNode *node;
 	CEntity *e;
 	CColModel *colmodel;
@@ -677,10 +1336,50 @@ CWorld::GetIsLineOfSightSectorListClear(CPtrList &list, const CColLine &line, bo
 	return true;
 }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+bool
+CWorld::GetIsLineOfSightSectorArrayClear(CSectorArray &array, const CColLine &line, bool ignoreSeeThrough,
+                                         bool ignoreSomeObjects)
+{
+	CSectorArrayEntry *it, *end;
+	CEntity *e;
+	CColModel *colmodel;
+
+	for(it = array.m_entries, end = it + array.m_numEntries; it != end; it++) {
+		if(it->radius >= 0.0f && LineMissesSphere(line, it->centre, it->radius))
+			continue;
+		e = it->entity;
+		if(e->m_scanCode != GetCurrentScanCode() && e->bUsesCollision) {
+
+			e->m_scanCode = GetCurrentScanCode();
+
+			if(e != pIgnoreEntity && !(ignoreSomeObjects && CameraToIgnoreThisObject(e))) {
+
+				colmodel = CModelInfo::GetModelInfo(e->GetModelIndex())->GetColModel();
+
+				if(CCollision::TestLineOfSight(line, e->GetMatrix(), *colmodel, ignoreSeeThrough, false))
+					return false;
+			}
+		}
+	}
+
+	return true;
+}
+#endif
+
 void
 CWorld::FindObjectsInRangeSectorList(CPtrList &list, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects,
                                      int16 lastObject, CEntity **objects)
 {
+#ifdef SECTOR_ENTITY_ARRAYS
+	if(bUseSectorArrays){
+		CSectorArray *array = GetSectorArray(&list);
+		if(array){
+			FindObjectsInRangeSectorArray(*array, centre, radius, ignoreZ, numObjects, lastObject, objects);
+			return;
+		}
+	}
+#endif
 	float radiusSqr = radius * radius;
 	float objDistSqr;
 
@@ -703,6 +1402,35 @@ CWorld::FindObjectsInRangeSectorList(CPtrList &list, Const CVector &centre, floa
 	}
 }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+void
+CWorld::FindObjectsInRangeSectorArray(CSectorArray &array, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects,
+                                      int16 lastObject, CEntity **objects)
+{
+	float radiusSqr = radius * radius;
+	float objDistSqr;
+	CSectorArrayEntry *it, *end;
+
+	for(it = array.m_entries, end = it + array.m_numEntries; it != end; it++) {
+		CEntity *object = it->entity;
+		if(object->m_scanCode != GetCurrentScanCode()) {
+			object->m_scanCode = GetCurrentScanCode();
+
+			CVector diff = centre - object->GetPosition();
+			if(ignoreZ)
+				objDistSqr = diff.MagnitudeSqr2D();
+			else
+				objDistSqr = diff.MagnitudeSqr();
+
+			if(objDistSqr < radiusSqr && *numObjects < lastObject) {
+				if(objects) { objects[*numObjects] = object; }
+				(*numObjects)++;
+			}
+		}
+	}
+}
+#endif
+
 void
 CWorld::FindObjectsInRange(Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects, int16 lastObject,
                            CEntity **objects, bool checkBuildings, bool checkVehicles, bool checkPeds,
@@ -878,6 +1606,14 @@ CWorld::TestSphereAgainstWorld(CVector centre, float radius, CEntity *entityToIg
 
 	AdvanceCurrentScanCode();
 
+#ifdef STATIC_BUILDING_BVH
+	if(checkBuildings && CBuildingBVH::IsUsable()) {
+		foundE = CBuildingBVH::TestSphere(centre, radius, entityToIgnore);
+		if(foundE) return foundE;
+		checkBuildings = false;
+	}
+#endif
+
 	for(int curY = minY; curY <= maxY; curY++) {
 		for(int curX = minX; curX <= maxX; curX++) {
 			CSector *sector = GetSector(curX, curY);
@@ -994,6 +1730,12 @@ CWorld::FindGroundZForCoord(float x, float y)
 {
 	CColPoint point;
 	CEntity *ent;
+#ifdef GROUND_HEIGHT_CACHE
+	float z;
+	bool found;
+	if(CGroundCache::FindGroundZForCoord(x, y, z, found))
+		return found ? z : 20.0f;
+#endif
 	if(ProcessVerticalLine(CVector(x, y, 1000.0f), -1000.0f, point, ent, true, false, false, false, true, false,
 	                       nil))
 		return point.point.z;
@@ -1006,6 +1748,14 @@ CWorld::FindGroundZFor3DCoord(float x, float y, float z, bool *found)
 {
 	CColPoint point;
 	CEntity *ent;
+#ifdef GROUND_HEIGHT_CACHE
+	float groundZ;
+	bool cachedFound;
+	if(CGroundCache::FindGroundZFor3DCoord(x, y, z, groundZ, cachedFound)) {
+		if(found) *found = cachedFound;
+		return cachedFound ? groundZ : 0.0f;
+	}
+#endif
 	if(ProcessVerticalLine(CVector(x, y, z), -1000.0f, point, ent, true, false, false, false, false, false, nil)) {
 		if(found) *found = true;
 		return point.point.z;
@@ -1020,6 +1770,12 @@ CWorld::FindRoofZFor3DCoord(float x, float y, float z, bool *found)
 {
 	CColPoint point;
 	CEntity *ent;
+#ifdef GROUND_HEIGHT_CACHE
+	if(CGroundCache::IsClearAbove(x, y, z)) {
+		if(found) *found = false;
+		return 20.0f;
+	}
+#endif
 	if(ProcessVerticalLine(CVector(x, y, z), 1000.0f, point, ent, true, false, false, false, true, false, nil)) {
 		if(found) *found = true;
 		return point.point.z;
@@ -1661,6 +2417,15 @@ CWorld::AddParticles(void)
 void
 CWorld::ShutDown(void)
 {
+#ifdef STATIC_BUILDING_BVH
+	CBuildingBVH::Shutdown();
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	CBuildingCulling::Shutdown();
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+	CGroundCache::Clear();
+#endif
 	for(int i = 0; i < NUMSECTORS_X * NUMSECTORS_Y; i++) {
 		CSector *pSector = GetSector(i % NUMSECTORS_X, i / NUMSECTORS_Y);
 		for(CPtrNode *pNode = pSector->m_lists[ENTITYLIST_BUILDINGS].first; pNode; pNode = pNode->next) {
@@ -1741,6 +2506,12 @@ CWorld::ShutDown(void)
 		}
 	}
 	ms_listMovingEntityPtrs.Flush();
+#ifdef SECTOR_ENTITY_ARRAYS
+	ShutDownSectorArrays();
+#endif
+#ifdef BATCHED_LINE_OF_SIGHT
+	ShutDownLineOfSightBatches();
+#endif
 }
 
 void
@@ -1894,6 +2665,15 @@ CWorld::SetPedsOnFire(float x, float y, float z, float radius, CEntity *reason)
 void
 CWorld::RemoveStaticObjects()
 {
+#ifdef STATIC_BUILDING_BVH
+	CBuildingBVH::Shutdown();
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	CBuildingCulling::Shutdown();
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+	CGroundCache::Clear();
+#endif
 	for(int i = 0; i < NUMSECTORS_X * NUMSECTORS_Y; i++) {
 		CSector *pSector = GetSector(i % NUMSECTORS_X, i / NUMSECTORS_Y);
 		for(CPtrNode *pNode = pSector->m_lists[ENTITYLIST_BUILDINGS].first; pNode; pNode = pNode->next) {
@@ -1915,7 +2695,495 @@ CWorld::RemoveStaticObjects()
 		pSector->m_lists[ENTITYLIST_BUILDINGS_OVERLAP].Flush();
 		pSector->m_lists[ENTITYLIST_DUMMIES].Flush();
 		pSector->m_lists[ENTITYLIST_DUMMIES_OVERLAP].Flush();
+#ifdef SECTOR_ENTITY_ARRAYS
+		GetSectorArray(&pSector->m_lists[ENTITYLIST_BUILDINGS])->Flush();
+		GetSectorArray(&pSector->m_lists[ENTITYLIST_BUILDINGS_OVERLAP])->Flush();
+		GetSectorArray(&pSector->m_lists[ENTITYLIST_DUMMIES])->Flush();
+		GetSectorArray(&pSector->m_lists[ENTITYLIST_DUMMIES_OVERLAP])->Flush();
+#endif
+	}
+}
+
+static void
+ProcessMovingEntityCollision(CEntity *movingEnt)
+{
+	if(!movingEnt->bIsInSafePosition) {
+		movingEnt->ProcessCollision();
+		movingEnt->GetMatrix().UpdateRW();
+		movingEnt->UpdateRwFrame();
+	}
+}
+
+static void
+ProcessStuckEntityCollision(CEntity *movingEnt)
+{
+	if(!movingEnt->bIsInSafePosition) {
+		movingEnt->bIsStuck = true;
+		movingEnt->ProcessCollision();
+		movingEnt->GetMatrix().UpdateRW();
+		movingEnt->UpdateRwFrame();
+		if(!movingEnt->bIsInSafePosition) { movingEnt->bIsStuck = true; }
+	}
+}
+
+static void
+ProcessMovingEntityShift(CEntity *movingEnt)
+{
+	if(!movingEnt->bIsInSafePosition) {
+		movingEnt->ProcessShift();
+		movingEnt->GetMatrix().UpdateRW();
+		movingEnt->UpdateRwFrame();
+		if(!movingEnt->bIsInSafePosition) { movingEnt->bIsStuck = true; }
+	}
+}
+
+static void
+ProcessMovingEntityLastShift(CPhysical *movingEnt)
+{
+	if(!movingEnt->bIsInSafePosition) {
+		movingEnt->ProcessShift();
+		movingEnt->GetMatrix().UpdateRW();
+		movingEnt->UpdateRwFrame();
+		if(!movingEnt->bIsInSafePosition) {
+			movingEnt->bIsStuck = true;
+			if(movingEnt->GetStatus() == STATUS_PLAYER) {
+				printf("STUCK: Final Step: Player Entity %d Is Stuck\n", movingEnt->GetModelIndex());
+				movingEnt->m_vecMoveSpeed *= Pow(0.707f, CTimer::GetTimeStep());
+				movingEnt->ApplyMoveSpeed();
+				movingEnt->ApplyTurnSpeed();
+			}
+		}
+	}
+}
+
+enum {
+	MOVINGPASS_COLLISION,
+	MOVINGPASS_STUCK,
+	MOVINGPASS_SHIFT,
+	MOVINGPASS_LASTSHIFT
+};
+
+static void
+ProcessMovingEntityPass(CPhysical *movingEnt, int32 pass)
+{
+	switch(pass){
+	case MOVINGPASS_COLLISION: ProcessMovingEntityCollision(movingEnt); break;
+	case MOVINGPASS_STUCK: ProcessStuckEntityCollision(movingEnt); break;
+	case MOVINGPASS_SHIFT: ProcessMovingEntityShift(movingEnt); break;
+	case MOVINGPASS_LASTSHIFT: ProcessMovingEntityLastShift(movingEnt); break;
+	}
+}
+
+static void
+ProcessMovingListPass(int32 pass)
+{
+	for(CPtrNode *node = CWorld::GetMovingEntityList().first; node; node = node->next)
+		ProcessMovingEntityPass((CPhysical*)node->item, pass);
+}
+
+// Each pass is done for all moving entities before the next one starts
+static void
+ProcessMovingEntityPasses(void (*processPass)(int32 pass))
+{
+	CWorld::bNoMoreCollisionTorque = false;
+	processPass(MOVINGPASS_COLLISION);
+	CWorld::bNoMoreCollisionTorque = true;
+	for(int i = 0; i < 4; i++)
+		processPass(MOVINGPASS_COLLISION);
+	processPass(MOVINGPASS_STUCK);
+	CWorld::bSecondShift = false;
+	processPass(MOVINGPASS_SHIFT);
+	CWorld::bSecondShift = true;
+	processPass(MOVINGPASS_LASTSHIFT);
+}
+
+#ifdef ISLAND_WORLD_PROCESS
+#define MAXISLANDENTITIES (NUMPEDS + NUMVEHICLES + NUMOBJECTS)
+#define ISLAND_MARGIN 1.0f	// entities can be pushed a bit further than they move on their own
+
+// Moving entities whose swept bounds share no sector can't touch each other in a pass.
+// They mustn't reach the same building or standing entity either, so anything in the
+// overlap list of a sector an island uses brings all sectors it is in to the island.
+// Every pass is handed to the job pool island by island and finished before the next
+// pass starts, just like the serial loops. The jobs hold the world lock except in
+// CCollision::ProcessColModels, which is what actually runs in parallel; scan codes,
+// the time step and the collision scratch buffers are JOBLOCAL for that.
+// Islands and their entities are in the order of the moving list.
+struct CWorldIsland
+{
+	int32 first;
+	int32 count;
+};
+
+static CPhysical *aIslandEntities[MAXISLANDENTITIES];
+static CPhysical *aListEntities[MAXISLANDENTITIES];
+static int16 aIslandParents[MAXISLANDENTITIES];
+static int16 aIslandOfRoot[MAXISLANDENTITIES];
+static CWorldIsland aIslands[MAXISLANDENTITIES];
+static int16 aSectorOwners[NUMSECTORS_Y][NUMSECTORS_X];
+static bool aSectorOverlapsClaimed[NUMSECTORS_Y][NUMSECTORS_X];
+int32 CWorld::ms_numIslands;
+int32 CWorld::ms_numIslandEntities;
+int32 CWorld::ms_largestIsland;
+
+static int32 gIslandPass;
+static float gIslandTimeStep;
+static bool gbIslandsInParallel;
+
+static int16
+FindIslandRoot(int16 i)
+{
+	while(aIslandParents[i] != i){
+		aIslandParents[i] = aIslandParents[aIslandParents[i]];
+		i = aIslandParents[i];
 	}
+	return i;
+}
+
+// the smaller index stays the root, so roots are the first island entity in the list
+static void
+JoinIslands(int16 a, int16 b)
+{
+	a = FindIslandRoot(a);
+	b = FindIslandRoot(b);
+	if(a < b)
+		aIslandParents[b] = a;
+	else if(b < a)
+		aIslandParents[a] = b;
+}
+
+static void
+ClaimIslandSectors(int16 i, const CRect &bounds)
+{
+	int x, y, xstart, xend, ystart, yend;
+
+	xstart = clamp(CWorld::GetSectorIndexX(bounds.left), 0, NUMSECTORS_X-1);
+	xend = clamp(CWorld::GetSectorIndexX(bounds.right), 0, NUMSECTORS_X-1);
+	ystart = clamp(CWorld::GetSectorIndexY(bounds.top), 0, NUMSECTORS_Y-1);
+	yend = clamp(CWorld::GetSectorIndexY(bounds.bottom), 0, NUMSECTORS_Y-1);
+	for(y = ystart; y <= yend; y++)
+		for(x = xstart; x <= xend; x++){
+			if(aSectorOwners[y][x] < 0)
+				aSectorOwners[y][x] = i;
+			else
+				JoinIslands(i, aSectorOwners[y][x]);
+		}
+}
+
+// Whatever is in the overlap lists is in other sectors as well, whoever reaches it there
+// has to be in the same island. Each entity is only looked at once per build.
+static void
+ClaimOverlapSectors(int16 i, int x, int y)
+{
+	static int aOverlapLists[] = {
+		ENTITYLIST_BUILDINGS_OVERLAP, ENTITYLIST_OBJECTS_OVERLAP, ENTITYLIST_VEHICLES_OVERLAP,
+		ENTITYLIST_PEDS_OVERLAP, ENTITYLIST_DUMMIES_OVERLAP
+	};
+	CSector *sector = CWorld::GetSector(x, y);
+	CPtrNode *node;
+
+	for(int l = 0; l < ARRAY_SIZE(aOverlapLists); l++)
+		for(node = sector->m_lists[aOverlapLists[l]].first; node; node = node->next){
+			CEntity *e = (CEntity*)node->item;
+			if(e->m_scanCode == CWorld::GetCurrentScanCode())
+				continue;
+			e->m_scanCode = CWorld::GetCurrentScanCode();
+			ClaimIslandSectors(i, e->GetBoundRect());
+		}
+}
+
+// Returns false if the moving list is too long, which shouldn't happen
+bool
+CWorld::BuildMovingIslands(void)
+{
+	int16 i, n;
+	int x, y, xstart, xend, ystart, yend;
+	CPtrNode *node;
+	CPhysical *ent;
+
+	n = 0;
+	for(node = ms_listMovingEntityPtrs.first; node; node = node->next){
+		if(n == MAXISLANDENTITIES)
+			return false;
+		aIslandEntities[n++] = (CPhysical*)node->item;
+	}
+
+	memset(aSectorOwners, 0xFF, sizeof(aSectorOwners));
+	memset(aSectorOverlapsClaimed, 0, sizeof(aSectorOverlapsClaimed));
+	AdvanceCurrentScanCode();
+	for(i = 0; i < n; i++)
+		aIslandParents[i] = i;
+	for(i = 0; i < n; i++){
+		ent = aIslandEntities[i];
+		CRect bounds = ent->GetBoundRect();
+		bounds.Grow(Max(Abs(ent->m_vecMoveSpeed.x), Abs(ent->m_vecMoveSpeed.y))*CTimer::GetTimeStep() + ISLAND_MARGIN);
+		ClaimIslandSectors(i, bounds);
+		xstart = clamp(GetSectorIndexX(bounds.left), 0, NUMSECTORS_X-1);
+		xend = clamp(GetSectorIndexX(bounds.right), 0, NUMSECTORS_X-1);
+		ystart = clamp(GetSectorIndexY(bounds.top), 0, NUMSECTORS_Y-1);
+		yend = clamp(GetSectorIndexY(bounds.bottom), 0, NUMSECTORS_Y-1);
+		for(y = ystart; y <= yend; y++)
+			for(x = xstart; x <= xend; x++)
+				if(!aSectorOverlapsClaimed[y][x]){
+					aSectorOverlapsClaimed[y][x] = true;
+					ClaimOverlapSectors(i, x, y);
+				}
+	}
+
+	// count, then sort into islands keeping list order
+	ms_numIslands = 0;
+	for(i = 0; i < n; i++)
+		aIslandOfRoot[i] = -1;
+	for(i = 0; i < n; i++){
+		int16 root = FindIslandRoot(i);
+		if(aIslandOfRoot[root] < 0){
+			aIslandOfRoot[root] = ms_numIslands;
+			aIslands[ms_numIslands].count = 0;
+			ms_numIslands++;
+		}
+		aIslands[aIslandOfRoot[root]].count++;
+	}
+	ms_largestIsland = 0;
+	for(i = 0; i < ms_numIslands; i++){
+		aIslands[i].first = i == 0 ? 0 : aIslands[i-1].first + aIslands[i-1].count;
+		ms_largestIsland = Max(ms_largestIsland, aIslands[i].count);
+		aIslands[i].count = 0;
+	}
+	memcpy(aListEntities, aIslandEntities, n*sizeof(CPhysical*));
+	for(i = 0; i < n; i++){
+		CWorldIsland &island = aIslands[aIslandOfRoot[FindIslandRoot(i)]];
+		aIslandEntities[island.first + island.count++] = aListEntities[i];
+	}
+	ms_numIslandEntities = n;
+	return true;
+}
+
+static void
+ProcessIslandJob(int32 i, void *data)
+{
+	CWorldIsland &island = aIslands[i];
+
+	if(gbIslandsInParallel){
+		CJobPool::LockWorld();
+		CTimer::SetTimeStep(gIslandTimeStep);
+	}
+	for(int32 j = island.first; j < island.first + island.count; j++)
+		// taken off the list earlier in this pass, the list loop wouldn't get to it either
+		if(aIslandEntities[j]->m_movingListNode)
+			ProcessMovingEntityPass(aIslandEntities[j], gIslandPass);
+	if(gbIslandsInParallel)
+		CJobPool::UnlockWorld();
+}
+
+// Islands are built again for every pass, so entities that started moving
+// in the last one are in and the sectors fit where everything is now
+static void
+ProcessIslandPass(int32 pass)
+{
+	if(!CWorld::BuildMovingIslands()){
+		ProcessMovingListPass(pass);
+		return;
+	}
+	gIslandPass = pass;
+	gbIslandsInParallel = CWorld::bParallelIslands && CJobPool::GetNumThreads() > 0 && CWorld::ms_numIslands > 1;
+	if(gbIslandsInParallel){
+		gIslandTimeStep = CTimer::GetTimeStep();
+		// the codes can't be cleared while jobs use them, so leave plenty for the pass
+		if(CWorld::ms_nScanCodeCounter > 0x8000){
+			CWorld::ClearScanCodes();
+			CWorld::ms_nScanCodeCounter = 1;
+		}
+	}
+	CJobPool::ParallelFor(CWorld::ms_numIslands, ProcessIslandJob, nil);
+}
+
+// What the passes change on an entity, compared bit for bit by the check
+struct CIslandCheckState
+{
+	CPhysical *entity;
+	CVector right, forward, up, pos;
+	CVector moveSpeed, turnSpeed;
+	CVector moveFriction, turnFriction;
+	float distanceTravelled;
+	float damageImpulse;
+	CEntity *damageEntity;
+	CVector damageNormal;
+	CEntity *collisionRecords[PHYSICAL_MAX_COLLISIONRECORDS];
+	float springRatios[4];
+	uint8 numCollisionRecords;
+	uint8 surfaceTouched;
+	bool isStuck;
+	bool isInSafePosition;
+	bool hasHitWall;
+};
+
+static CIslandCheckState aIslandCheckStates[MAXISLANDENTITIES];
+static CIslandCheckState aIslandCheckSerial[MAXISLANDENTITIES];
+
+static float*
+GetSpringRatios(CPhysical *ent)
+{
+	if(ent->IsVehicle() && ((CVehicle*)ent)->IsCar())
+		return ((CAutomobile*)ent)->m_aSuspensionSpringRatio;
+	if(ent->IsVehicle() && ((CVehicle*)ent)->IsBike())
+		return ((CBike*)ent)->m_aSuspensionSpringRatio;
+	return nil;
+}
+
+static void
+SaveIslandCheckState(CIslandCheckState &st, CPhysical *ent)
+{
+	memset(&st, 0, sizeof(st));	// compared with memcmp
+	st.entity = ent;
+	st.right = ent->GetMatrix().GetRight();
+	st.forward = ent->GetMatrix().GetForward();
+	st.up = ent->GetMatrix().GetUp();
+	st.pos = ent->GetMatrix().GetPosition();
+	st.moveSpeed = ent->m_vecMoveSpeed;
+	st.turnSpeed = ent->m_vecTurnSpeed;
+	st.moveFriction = ent->m_vecMoveFriction;
+	st.turnFriction = ent->m_vecTurnFriction;
+	st.distanceTravelled = ent->m_fDistanceTravelled;
+	st.damageImpulse = ent->m_fDamageImpulse;
+	st.damageEntity = ent->m_pDamageEntity;
+	st.damageNormal = ent->m_vecDamageNormal;
+	memcpy(st.collisionRecords, ent->m_aCollisionRecords, sizeof(st.collisionRecords));
+	if(GetSpringRatios(ent))
+		memcpy(st.springRatios, GetSpringRatios(ent), sizeof(st.springRatios));
+	st.numCollisionRecords = ent->m_nCollisionRecords;
+	st.surfaceTouched = ent->m_nSurfaceTouched;
+	st.isStuck = ent->bIsStuck;
+	st.isInSafePosition = ent->bIsInSafePosition;
+	st.hasHitWall = ent->bHasHitWall;
+}
+
+static void
+RestoreIslandCheckState(const CIslandCheckState &st)
+{
+	CPhysical *ent = st.entity;
+	ent->GetMatrix().GetRight() = st.right;
+	ent->GetMatrix().GetForward() = st.forward;
+	ent->GetMatrix().GetUp() = st.up;
+	ent->GetMatrix().GetPosition() = st.pos;
+	ent->m_vecMoveSpeed = st.moveSpeed;
+	ent->m_vecTurnSpeed = st.turnSpeed;
+	ent->m_vecMoveFriction = st.moveFriction;
+	ent->m_vecTurnFriction = st.turnFriction;
+	ent->m_fDistanceTravelled = st.distanceTravelled;
+	ent->m_fDamageImpulse = st.damageImpulse;
+	ent->m_pDamageEntity = st.damageEntity;
+	ent->m_vecDamageNormal = st.damageNormal;
+	memcpy(ent->m_aCollisionRecords, st.collisionRecords, sizeof(st.collisionRecords));
+	if(GetSpringRatios(ent))
+		memcpy(GetSpringRatios(ent), st.springRatios, sizeof(st.springRatios));
+	ent->m_nCollisionRecords = st.numCollisionRecords;
+	ent->m_nSurfaceTouched = st.surfaceTouched;
+	ent->bIsStuck = st.isStuck;
+	ent->bIsInSafePosition = st.isInSafePosition;
+	ent->bHasHitWall = st.hasHitWall;
+	ent->GetMatrix().UpdateRW();
+	ent->UpdateRwFrame();
+	ent->RemoveAndAdd();
+}
+
+// Runs the passes over the list, puts the moving entities back where they were and runs
+// them again by islands, then reports entities that came out differently.
+// Damage, sounds, particles and the like happen twice on checked frames.
+static void
+CheckMovingIslands(void)
+{
+	int32 i, n, numMismatches, firstMismatch;
+	CPtrNode *node;
+
+	n = 0;
+	for(node = CWorld::GetMovingEntityList().first; node; node = node->next){
+		if(n == MAXISLANDENTITIES){
+			ProcessMovingEntityPasses(ProcessIslandPass);
+			return;
+		}
+		SaveIslandCheckState(aIslandCheckStates[n++], (CPhysical*)node->item);
+	}
+
+	ProcessMovingEntityPasses(ProcessMovingListPass);
+
+	// can only run them again on the same list
+	i = 0;
+	for(node = CWorld::GetMovingEntityList().first; node; node = node->next, i++)
+		if(i == n || node->item != aIslandCheckStates[i].entity)
+			break;
+	if(node || i != n){
+		debug("Moving islands check: moving list changed during the passes, not checked\n");
+		return;
+	}
+	for(i = 0; i < n; i++){
+		SaveIslandCheckState(aIslandCheckSerial[i], aIslandCheckStates[i].entity);
+		RestoreIslandCheckState(aIslandCheckStates[i]);
+	}
+
+	ProcessMovingEntityPasses(ProcessIslandPass);
+
+	numMismatches = 0;
+	firstMismatch = -1;
+	for(i = 0; i < n; i++){
+		SaveIslandCheckState(aIslandCheckStates[i], aIslandCheckSerial[i].entity);
+		if(memcmp(&aIslandCheckStates[i], &aIslandCheckSerial[i], sizeof(CIslandCheckState)) != 0)
+			if(numMismatches++ == 0)
+				firstMismatch = i;
+	}
+	if(numMismatches > 0){
+		CPhysical *ent = aIslandCheckSerial[firstMismatch].entity;
+		debug("Moving islands check: %d of %d entities differ from the serial passes, first is model %d at %.2f %.2f %.2f\n",
+			numMismatches, n, ent->GetModelIndex(), ent->GetPosition().x, ent->GetPosition().y, ent->GetPosition().z);
+	}
+}
+
+void
+CWorld::ProcessMovingIslands(void)
+{
+	if(bCheckIslands)
+		CheckMovingIslands();
+	else
+		ProcessMovingEntityPasses(ProcessIslandPass);
+}
+
+void
+CWorld::PrintIslandStats(void)
+{
+	debug("Moving islands: %d entities in %d islands, largest %d, %d job threads\n",
+		ms_numIslandEntities, ms_numIslands, ms_largestIsland, bParallelIslands ? CJobPool::GetNumThreads() : 0);
+}
+#endif
+
+#ifdef PARALLEL_ANIM_UPDATE
+#define MAXANIMUPDATEJOBS 128
+
+static AnimBlendClumpUpdateJob aAnimUpdateJobs[MAXANIMUPDATEJOBS];
+static int32 numAnimUpdateJobs;
+
+static void
+FlushClumpAnimations(void)
+{
+	RpAnimBlendClumpUpdateAnimationsBatch(aAnimUpdateJobs, numAnimUpdateJobs);
+	numAnimUpdateJobs = 0;
+}
+#endif
+
+// Queued and updated in batches with PARALLEL_ANIM_UPDATE, FlushClumpAnimations finishes them
+static void
+UpdateClumpAnimations(RpClump *clump, float timeDelta, bool doRender = true)
+{
+#ifdef PARALLEL_ANIM_UPDATE
+	if(gbParallelAnimUpdate){
+		if(numAnimUpdateJobs == MAXANIMUPDATEJOBS)
+			FlushClumpAnimations();
+		AnimBlendClumpUpdateJob *job = &aAnimUpdateJobs[numAnimUpdateJobs++];
+		job->clump = clump;
+		job->timeDelta = timeDelta;
+		job->doRender = doRender;
+		return;
+	}
+#endif
+	RpAnimBlendClumpUpdateAnimations(clump, timeDelta, doRender);
 }
 
 void
@@ -1946,19 +3214,29 @@ CWorld::Process(void)
 		CRecordDataForChase::ProcessControlCars();
 		CRecordDataForChase::SaveOrRetrieveCarPositions();
 	} else {
+		tbStartTimer(0, "Animation");
 		for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 			CEntity *movingEnt = (CEntity *)node->item;
 			if(!movingEnt->bRemoveFromWorld && movingEnt->m_rwObject && RwObjectGetType(movingEnt->m_rwObject) == rpCLUMP &&
 			   RpAnimBlendClumpGetFirstAssociation(movingEnt->GetClump())) {
 				if (movingEnt->IsObject())
-					RpAnimBlendClumpUpdateAnimations(movingEnt->GetClump(), CTimer::GetTimeStepNonClippedInSeconds());
+					UpdateClumpAnimations(movingEnt->GetClump(), CTimer::GetTimeStepNonClippedInSeconds());
 				else {
 					if (!movingEnt->bOffscreen)
 						movingEnt->bOffscreen = !movingEnt->GetIsOnScreen();
-					RpAnimBlendClumpUpdateAnimations(movingEnt->GetClump(), CTimer::GetTimeStepInSeconds(), !movingEnt->bOffscreen);
+					float timeDelta = CTimer::GetTimeStepInSeconds();
+#ifdef ANIM_LOD
+					if (movingEnt->IsPed() && !CAnimLod::Update((CPed*)movingEnt, timeDelta))
+						continue;
+#endif
+					UpdateClumpAnimations(movingEnt->GetClump(), timeDelta, !movingEnt->bOffscreen);
 				}
 			}
 		}
+#ifdef PARALLEL_ANIM_UPDATE
+		FlushClumpAnimations();
+#endif
+		tbEndTimer("Animation");
 		for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 			CPhysical *movingEnt = (CPhysical *)node->item;
 			if(movingEnt->bRemoveFromWorld) {
@@ -1988,66 +3266,13 @@ CWorld::Process(void)
 				movingEnt->GetMatrix().UpdateRW();
 				movingEnt->UpdateRwFrame();
 			}
-		} else {
-			bNoMoreCollisionTorque = false;
-			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
-				CEntity *movingEnt = (CEntity *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
-					movingEnt->ProcessCollision();
-					movingEnt->GetMatrix().UpdateRW();
-					movingEnt->UpdateRwFrame();
-				}
-			}
-			bNoMoreCollisionTorque = true;
-			for(int i = 0; i < 4; i++) {
-				for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
-					CEntity *movingEnt = (CEntity *)node->item;
-					if(!movingEnt->bIsInSafePosition) {
-						movingEnt->ProcessCollision();
-						movingEnt->GetMatrix().UpdateRW();
-						movingEnt->UpdateRwFrame();
-					}
-				}
-			}
-			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
-				CEntity *movingEnt = (CEntity *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
-					movingEnt->bIsStuck = true;
-					movingEnt->ProcessCollision();
-					movingEnt->GetMatrix().UpdateRW();
-					movingEnt->UpdateRwFrame();
-					if(!movingEnt->bIsInSafePosition) { movingEnt->bIsStuck = true; }
-				}
-			}
-			bSecondShift = false;
-			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
-				CEntity *movingEnt = (CEntity *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
-					movingEnt->ProcessShift();
-					movingEnt->GetMatrix().UpdateRW();
-					movingEnt->UpdateRwFrame();
-					if(!movingEnt->bIsInSafePosition) { movingEnt->bIsStuck = true; }
-				}
-			}
-			bSecondShift = true;
-			for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
-				CPhysical *movingEnt = (CPhysical *)node->item;
-				if(!movingEnt->bIsInSafePosition) {
-					movingEnt->ProcessShift();
-					movingEnt->GetMatrix().UpdateRW();
-					movingEnt->UpdateRwFrame();
-					if(!movingEnt->bIsInSafePosition) {
-						movingEnt->bIsStuck = true;
-						if(movingEnt->GetStatus() == STATUS_PLAYER) {
-							printf("STUCK: Final Step: Player Entity %d Is Stuck\n", movingEnt->GetModelIndex());
-							movingEnt->m_vecMoveSpeed *= Pow(0.707f, CTimer::GetTimeStep());
-							movingEnt->ApplyMoveSpeed();
-							movingEnt->ApplyTurnSpeed();
-						}
-					}
-				}
-			}
-		}
+		} else
+#ifdef ISLAND_WORLD_PROCESS
+		if(bProcessByIslands)
+			ProcessMovingIslands();
+		else
+#endif
+			ProcessMovingEntityPasses(ProcessMovingListPass);
 		for(CPtrNode *node = ms_listMovingEntityPtrs.first; node; node = node->next) {
 			CPed *movingPed = (CPed *)node->item;
 			if(movingPed->IsPed()) {
@@ -4,6 +4,9 @@
 #include "Lists.h"
 #include "PlayerInfo.h"
 #include "Collision.h"
+#ifdef SECTOR_ENTITY_ARRAYS
+#include "SectorArray.h"
+#endif
 
 /* Sectors span from -2400 to 1600 in x and -2000 to 2000 y.
  * With 80x80 sectors, each is 50x50 units. */
@@ -49,12 +52,27 @@ public:
 
 VALIDATE_SIZE(CSector, 0x28);
 
+#ifdef BATCHED_LINE_OF_SIGHT
+// One line of a batched query, point and entity are only valid if hit is set
+struct CWorldRay
+{
+	CVector start;
+	CVector end;
+	CColPoint point;
+	CEntity *entity;
+	bool hit;
+};
+#endif
+
 class CWorld
 {
 	static CPtrList ms_bigBuildingsList[NUM_LEVELS];
 	static CPtrList ms_listMovingEntityPtrs;
 	static CSector ms_aSectors[NUMSECTORS_Y][NUMSECTORS_X];
-	static uint16 ms_nCurrentScanCode;
+	static JOBLOCAL uint16 ms_nCurrentScanCode;
+#ifdef SECTOR_ENTITY_ARRAYS
+	static CSectorArray ms_aSectorArrays[NUMSECTORS_Y][NUMSECTORS_X][NUMSECTORENTITYLISTS];
+#endif
 
 public:
 	static uint8 PlayerInFocus;
@@ -68,7 +86,19 @@ public:
 	static bool bDoingCarCollisions;
 	static bool bIncludeCarTyres;
 	static bool bIncludeBikers;
-	static CColPoint m_aTempColPts[MAX_COLLISION_POINTS];
+	static JOBLOCAL CColPoint m_aTempColPts[MAX_COLLISION_POINTS];
+#ifdef SECTOR_ENTITY_ARRAYS
+	static bool bUseSectorArrays;
+#endif
+#ifdef ISLAND_WORLD_PROCESS
+	static bool bProcessByIslands;
+	static bool bParallelIslands;
+	static bool bCheckIslands;
+	static uint16 ms_nScanCodeCounter;
+	static int32 ms_numIslands;
+	static int32 ms_numIslandEntities;
+	static int32 ms_largestIsland;
+#endif
 
 	static void Remove(CEntity *entity);
 	static void Add(CEntity *entity);
@@ -76,13 +106,33 @@ public:
 	static CSector *GetSector(int x, int y) { if (x > NUMSECTORS_X - 1 || y > NUMSECTORS_Y - 1) return &ms_aSectors[0][0]; return &ms_aSectors[y][x]; }
 	static CPtrList &GetBigBuildingList(eLevelName i) { return ms_bigBuildingsList[i]; }
 	static CPtrList &GetMovingEntityList(void) { return ms_listMovingEntityPtrs; }
+#ifdef SECTOR_ENTITY_ARRAYS
+	static CSectorArray *GetSectorArray(CPtrList *list);
+	static void RebuildSectorArrays(void);
+	static void ShutDownSectorArrays(void);
+	static bool ProcessLineOfSightSectorArray(CSectorArray &array, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, bool ignoreSomeObjects, bool ignoreShootThrough);
+	static bool ProcessVerticalLineSectorArray(CSectorArray &array, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly);
+	static bool GetIsLineOfSightSectorArrayClear(CSectorArray &array, const CColLine &line, bool ignoreSeeThrough, bool ignoreSomeObjects);
+	static void FindObjectsInRangeSectorArray(CSectorArray &array, Const CVector &centre, float radius, bool ignoreZ, int16 *numObjects, int16 lastObject, CEntity **objects);
+#endif
 	static uint16 GetCurrentScanCode(void) { return ms_nCurrentScanCode; }
+#ifdef ISLAND_WORLD_PROCESS
+	// Island jobs each keep the last code they got from the shared counter
+	static void AdvanceCurrentScanCode(void){
+		if(++CWorld::ms_nScanCodeCounter == 0){
+			CWorld::ClearScanCodes();
+			CWorld::ms_nScanCodeCounter = 1;
+		}
+		CWorld::ms_nCurrentScanCode = CWorld::ms_nScanCodeCounter;
+	}
+#else
 	static void AdvanceCurrentScanCode(void){
 		if(++CWorld::ms_nCurrentScanCode == 0){
 			CWorld::ClearScanCodes();
 			CWorld::ms_nCurrentScanCode = 1;
 		}
 	}
+#endif
 	static void ClearScanCodes(void);
 	static void ClearExcitingStuffFromArea(const CVector &pos, float radius, bool bRemoveProjectilesAndTidyUpShadows);
 
@@ -95,6 +145,11 @@ public:
 	static bool ProcessVerticalLineSector(CSector &sector, const CColLine &line, CColPoint &point, CEntity *&entity, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, CStoredCollPoly *poly);
 	static bool ProcessVerticalLineSectorList(CPtrList &list, const CColLine &line, CColPoint &point, float &dist, CEntity *&entity, bool ignoreSeeThrough, CStoredCollPoly *poly);
 	static bool GetIsLineOfSightClear(const CVector &point1, const CVector &point2, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+#ifdef BATCHED_LINE_OF_SIGHT
+	static void ProcessLinesOfSightBatch(CWorldRay *rays, int32 numRays, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false, bool ignoreShootThrough = false);
+	static void GetIsLinesOfSightClearBatch(CWorldRay *rays, int32 numRays, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
+	static void ShutDownLineOfSightBatches(void);
+#endif
 	static bool GetIsLineOfSightSectorClear(CSector &sector, const CColLine &line, bool checkBuildings, bool checkVehicles, bool checkPeds, bool checkObjects, bool checkDummies, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
 	static bool GetIsLineOfSightSectorListClear(CPtrList &list, const CColLine &line, bool ignoreSeeThrough, bool ignoreSomeObjects = false);
 	
@@ -151,6 +206,11 @@ public:
 	static void RepositionOneObject(CEntity* pEntity);
 	static void RemoveStaticObjects();
 	static void Process();
+#ifdef ISLAND_WORLD_PROCESS
+	static bool BuildMovingIslands(void);
+	static void ProcessMovingIslands(void);
+	static void PrintIslandStats(void);
+#endif
 	static void TriggerExplosion(const CVector& position, float fRadius, float fPower, CEntity* pCreator, bool bProcessVehicleBombTimer);
 	static void TriggerExplosionSectorList(CPtrList& list, const CVector& position, float fRadius, float fPower, CEntity* pCreator, bool bProcessVehicleBombTimer);
 	static void UseDetonator(CEntity *pEntity);
@@ -173,4 +233,4 @@ public:
 	static void FindPlayerSlotWithPedPointer(void*);
 };
 
-extern CColPoint gaTempSphereColPoints[MAX_COLLISION_POINTS];
+extern JOBLOCAL CColPoint gaTempSphereColPoints[MAX_COLLISION_POINTS];
@@ -131,6 +131,13 @@ typedef ptrdiff_t ssize_t;
 
 #define ALIGNPTR(p) (void*)((((uintptr)(void*)p) + sizeof(void*)-1) & ~(sizeof(void*)-1))
 
+// Game state that the island jobs of CWorld::Process need a copy of per thread
+#ifdef ISLAND_WORLD_PROCESS
+#define JOBLOCAL thread_local
+#else
+#define JOBLOCAL
+#endif
+
 // PDP-10 like byte functions
 #define MASK(p, s) (((1<<(s))-1) << (p))
 inline uint32 dpb(uint32 b, uint32 p, uint32 s, uint32 w)
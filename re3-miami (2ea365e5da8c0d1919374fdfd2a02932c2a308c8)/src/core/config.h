@@ -402,8 +402,50 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 #if !defined(_WIN32) && !defined(__SWITCH__)
 	//#define ONE_THREAD_PER_CHANNEL // Don't use if you're not on SSD/Flash - also not utilized too much right now(see commented LoadAllRequestedModels in Streaming.cpp)
 	#define FLUSHABLE_STREAMING // Make it possible to interrupt reading when processing file isn't needed anymore.
+	//#define BATCHED_CDSTREAM // Split channel reads into segments and submit them all at once (io_uring on linux, preadv threads otherwise), replaces CdStreamPosix.cpp
+	//#define MAPPED_IMG // mmap the IMG archives and parse streamed files straight from the mapping instead of reading them into the streaming buffers, needs a 64 bit address space
 #endif
 #define BIG_IMG // Not complete - allows to read larger img files
+#define HASHED_NAME_LOOKUP // Find models, txds, cols, anim blocks and IMG directory entries by name through a hash index instead of linear scans
+//#define LEVEL_CACHE // Cache parsed IDE/IPL files in a binary blob next to the level DAT file, only files whose text changed are parsed again
+//#define ASYNC_STREAM_DECODE // Decode streamed COL and IFP files on worker threads and keep DFF/TXD conversion within a per-frame budget
+//#define STREAMING_DEADLINES // Give streaming requests a deadline from camera distance, speed and requester, read the ones due soon first
+//#define PREDICTIVE_STREAMING // Request models and collision where the player's vehicle will be in a few seconds
+//#define ASYNC_COLLISION_STREAMING // Don't stall the game for collision that was loaded before, hold everything on a coarse height field until it's back
+//#define STREAMING_MEMORY_BUDGET // Per category streaming memory quotas, evict by size, distance and time since last use
+#ifdef USE_CUSTOM_ALLOCATOR
+#undef ASYNC_STREAM_DECODE // CMemoryHeap isn't thread safe
+#endif
+
+// World
+//#define SECTOR_ENTITY_ARRAYS // Mirror the sector lists in contiguous arrays and run the world queries over those
+//#define STATIC_BUILDING_BVH // Bounding volume hierarchy over buildings for line of sight, vertical line and sphere tests
+//#define COLMODEL_TRIANGLE_BVH // Per colmodel triangle BVH so line and sphere tests skip most triangles of big meshes
+//#define SIMD_COLLISION // SSE2/NEON prefilters for the triangle and box loops in CCollision
+#ifdef VU_COLLISION
+#undef SIMD_COLLISION // PS2 has the VU0 loops instead
+#endif
+//#define BATCHED_LINE_OF_SIGHT // CWorld::ProcessLinesOfSightBatch, walks the sector lists once for many lines
+//#define GROUND_HEIGHT_CACHE // Cache flat ground heights per 2m cell for the FindGroundZ/FindRoofZ queries
+//#define ISLAND_WORLD_PROCESS // Run the collision passes of CWorld::Process island by island on the job pool
+
+// Animation
+//#define PARALLEL_ANIM_UPDATE // Evaluate the animations of moving entities on the job pool, blending and callbacks stay on the game thread
+//#define SIMD_ANIM_UPDATE // SSE2/NEON slerp and lerp of four frames at a time in the frame update
+//#define ANIM_LOD // Update the anims of small peds on screen every second or fourth frame
+
+// Render list
+//#define PARALLEL_SCAN_WORLD // Do the frustum and occlusion tests of CRenderer::ScanWorld per sector row on the job pool
+//#define SIMD_FRUSTUM_CULLING // Classify packed building bounds against the camera eight at a time before ScanWorld
+//#define SOFTWARE_OCCLUSION // Draw the collision of big nearby buildings into a small CPU depth buffer and cull entities hidden behind it
+//#define SORTED_WORLD_RENDER // Draw the opaque meshes of the new renderer's world passes sorted by shader, texture and depth
+#ifndef NEW_RENDERER
+#undef SORTED_WORLD_RENDER
+#endif
+//#define INSTANCED_WORLD_RENDER // Draw repeated opaque world props with one instanced draw per model, GL3 only
+#if !defined(SORTED_WORLD_RENDER) || !defined(RW_GL3) || defined(RW_GLES2)
+#undef INSTANCED_WORLD_RENDER
+#endif
 
 //#define SQUEEZE_PERFORMANCE
 #ifdef SQUEEZE_PERFORMANCE
@@ -496,6 +538,30 @@ static_assert(false, "SUPPORT_XBOX_SCRIPT and SUPPORT_MOBILE_SCRIPT are mutually
 #undef IMPROVED_CAMERA
 #undef FREE_CAM
 #undef BIG_IMG
+#undef HASHED_NAME_LOOKUP
+#undef LEVEL_CACHE
+#undef ASYNC_STREAM_DECODE
+#undef STREAMING_DEADLINES
+#undef PREDICTIVE_STREAMING
+#undef ASYNC_COLLISION_STREAMING
+#undef STREAMING_MEMORY_BUDGET
+#undef BATCHED_CDSTREAM
+#undef MAPPED_IMG
+#undef SECTOR_ENTITY_ARRAYS
+#undef STATIC_BUILDING_BVH
+#undef COLMODEL_TRIANGLE_BVH
+#undef SIMD_COLLISION
+#undef BATCHED_LINE_OF_SIGHT
+#undef GROUND_HEIGHT_CACHE
+#undef ISLAND_WORLD_PROCESS
+#undef PARALLEL_ANIM_UPDATE
+#undef SIMD_ANIM_UPDATE
+#undef ANIM_LOD
+#undef PARALLEL_SCAN_WORLD
+#undef SIMD_FRUSTUM_CULLING
+#undef SOFTWARE_OCCLUSION
+#undef SORTED_WORLD_RENDER
+#undef INSTANCED_WORLD_RENDER
 
 #undef RADIO_SCROLL_TO_PREV_STATION
 #endif
@@ -68,11 +68,17 @@
 #include "debugmenu.h"
 #include "Clock.h"
 #include "Occlusion.h"
+#ifdef SOFTWARE_OCCLUSION
+#include "OcclusionBuffer.h"
+#endif
 #include "Ropes.h"
 #include "postfx.h"
 #include "custompipes.h"
 #include "screendroplets.h"
 #include "VarConsole.h"
+#ifdef STREAMING_MEMORY_BUDGET
+#include "Streaming.h"
+#endif
 
 GlobalScene Scene;
 
@@ -114,6 +120,9 @@ void DebugMenuPopulate(void);
 #ifndef FINAL
 bool gbPrintMemoryUsage;
 #endif
+#if !defined(FINAL) && defined(SORTED_WORLD_RENDER)
+bool gbPrintWorldRenderStats;
+#endif
 
 #ifdef GTA_PS2
 #define WANT_TO_LOAD TheMemoryCard.m_bWantToLoad
@@ -1025,8 +1034,59 @@ return;
 	AsciiToUnicode(gString, gUString);
 	CFont::PrintString(400.0f, y, gUString);
 	y += 12.0f;
+
+#ifdef STREAMING_MEMORY_BUDGET
+	y += 12.0f;
+	sprintf(gString, "Streaming budget: %d/%d KB", (int)(CStreaming::ms_memoryUsed/1024), (int)(CStreaming::GetMemoryBudget()/1024));
+	AsciiToUnicode(gString, gUString);
+	CFont::PrintString(400.0f, y, gUString);
+	y += 12.0f;
+
+	for(int i = 0; i < NUM_STREAMCATS; i++){
+		sprintf(gString, "%s: %d/%d KB, %d files", CStreaming::ms_aCategoryNames[i], (int)(CStreaming::ms_aCategoryMemory[i]/1024),
+			(int)(CStreaming::GetMemoryBudget()/100*CStreaming::ms_aCategoryQuota[i]/1024), CStreaming::ms_aCategoryFiles[i]);
+		AsciiToUnicode(gString, gUString);
+		CFont::PrintString(400.0f, y, gUString);
+		y += 12.0f;
+	}
+#endif
 }
 
+#if !defined(FINAL) && defined(SORTED_WORLD_RENDER)
+// Opaque building meshes drawn by the new renderer this frame
+void
+PrintWorldRenderStats(void)
+{
+	CFont::SetFontStyle(FONT_BANK);
+	CFont::SetBackgroundOff();
+	CFont::SetWrapx(640.0f);
+	CFont::SetScale(0.4f, 0.75f);
+	CFont::SetCentreOff();
+	CFont::SetCentreSize(640.0f);
+	CFont::SetJustifyOff();
+	CFont::SetPropOn();
+	CFont::SetColor(CRGBA(200, 200, 200, 200));
+	CFont::SetBackGroundOnlyTextOff();
+	CFont::SetDropShadowPosition(0);
+
+	sprintf(gString, "World meshes: %d %s", WorldRender::numMeshes, WorldRender::bSortCommands ? "sorted" : "unsorted");
+	AsciiToUnicode(gString, gUString);
+	CFont::PrintString(400.0f, 24.0f, gUString);
+
+#ifdef INSTANCED_WORLD_RENDER
+	sprintf(gString, "Draw calls: %d, %d meshes instanced", WorldRender::numDrawCalls, WorldRender::numInstancedMeshes);
+#else
+	sprintf(gString, "Draw calls: %d", WorldRender::numDrawCalls);
+#endif
+	AsciiToUnicode(gString, gUString);
+	CFont::PrintString(400.0f, 36.0f, gUString);
+
+	sprintf(gString, "State changes: %d", WorldRender::numStateChanges);
+	AsciiToUnicode(gString, gUString);
+	CFont::PrintString(400.0f, 48.0f, gUString);
+}
+#endif
+
 void
 DisplayGameDebugText()
 {
@@ -1041,6 +1101,10 @@ DisplayGameDebugText()
 
 	if(gbPrintMemoryUsage)
 		PrintMemoryUsage();
+#ifdef SORTED_WORLD_RENDER
+	if(gbPrintWorldRenderStats)
+		PrintWorldRenderStats();
+#endif
 #endif
 
 	char str[200];
@@ -1391,6 +1455,9 @@ Render2dStuff(void)
 	CDarkel::DrawMessages();
 	CGarages::PrintMessages();
 	CPad::PrintErrorMessage();
+#ifdef SOFTWARE_OCCLUSION
+	COcclusionBuffer::Render();
+#endif
 	CFont::DrawFonts();
 #ifndef MASTER
 	COcclusion::Render();
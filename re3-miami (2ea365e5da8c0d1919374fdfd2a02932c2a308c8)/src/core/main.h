@@ -23,6 +23,9 @@ extern bool gbShowTimebars;
 #ifndef FINAL
 extern bool gbPrintMemoryUsage;
 #endif
+#if !defined(FINAL) && defined(SORTED_WORLD_RENDER)
+extern bool gbPrintWorldRenderStats;
+#endif
 
 class CSprite2d;
 
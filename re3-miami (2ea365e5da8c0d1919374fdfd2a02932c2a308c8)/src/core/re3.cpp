@@ -12,6 +12,7 @@
 #include "Vehicle.h"
 #include "ModelIndices.h"
 #include "Streaming.h"
+#include "CdStream.h"
 #include "Boat.h"
 #include "Heli.h"
 #include "Automobile.h"
@@ -36,6 +37,30 @@
 #include "Camera.h"
 #include "MBlur.h"
 #include "ControllerConfig.h"
+#ifdef ASYNC_COLLISION_STREAMING
+#include "ColStore.h"
+#endif
+#ifdef STATIC_BUILDING_BVH
+#include "BuildingBVH.h"
+#endif
+#ifdef SIMD_COLLISION
+#include "CollisionSimd.h"
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+#include "GroundCache.h"
+#endif
+#if defined(PARALLEL_ANIM_UPDATE) || defined(SIMD_ANIM_UPDATE)
+#include "RpAnimBlend.h"
+#endif
+#ifdef ANIM_LOD
+#include "AnimLod.h"
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+#include "BuildingCulling.h"
+#endif
+#ifdef SOFTWARE_OCCLUSION
+#include "OcclusionBuffer.h"
+#endif
 
 #ifdef DONT_TRUST_RECOGNIZED_JOYSTICKS
 #include "crossplatform.h"
@@ -407,6 +432,13 @@ bool LoadINISettings()
 	ReadIniIfExists("CustomPipesValues", "GlossMult", &CustomPipes::GlossMult);
 #endif
 	ReadIniIfExists("Rendering", "BackfaceCulling", &gBackfaceCulling);
+#ifdef STREAMING_MEMORY_BUDGET
+	ReadIniIfExists("Streaming", "MemoryCapMB", &CStreaming::ms_memoryCapMB);
+	ReadIniIfExists("Streaming", "ModelsQuota", &CStreaming::ms_aCategoryQuota[STREAMCAT_MODELS]);
+	ReadIniIfExists("Streaming", "LODsQuota", &CStreaming::ms_aCategoryQuota[STREAMCAT_LODS]);
+	ReadIniIfExists("Streaming", "TexturesQuota", &CStreaming::ms_aCategoryQuota[STREAMCAT_TEXTURES]);
+	ReadIniIfExists("Streaming", "AnimationQuota", &CStreaming::ms_aCategoryQuota[STREAMCAT_ANIMATION]);
+#endif
 #ifdef NEW_RENDERER
 	ReadIniIfExists("Rendering", "NewRenderer", &gbNewRenderer);
 #endif
@@ -499,6 +531,13 @@ void SaveINISettings()
 	StoreIni("CustomPipesValues", "GlossMult", CustomPipes::GlossMult);
 #endif
 	StoreIni("Rendering", "BackfaceCulling", gBackfaceCulling);
+#ifdef STREAMING_MEMORY_BUDGET
+	StoreIni("Streaming", "MemoryCapMB", CStreaming::ms_memoryCapMB);
+	StoreIni("Streaming", "ModelsQuota", CStreaming::ms_aCategoryQuota[STREAMCAT_MODELS]);
+	StoreIni("Streaming", "LODsQuota", CStreaming::ms_aCategoryQuota[STREAMCAT_LODS]);
+	StoreIni("Streaming", "TexturesQuota", CStreaming::ms_aCategoryQuota[STREAMCAT_TEXTURES]);
+	StoreIni("Streaming", "AnimationQuota", CStreaming::ms_aCategoryQuota[STREAMCAT_ANIMATION]);
+#endif
 #ifdef NEW_RENDERER
 	StoreIni("Rendering", "NewRenderer", gbNewRenderer);
 #endif
@@ -672,6 +711,90 @@ PlaceOnRoad(void)
 		((CAutomobile*)veh)->PlaceOnRoadProperly();
 }
 
+#ifdef SECTOR_ENTITY_ARRAYS
+static float
+TimeWorldQueries(const CVector &pos)
+{
+	int i, j;
+	int16 n;
+	CColPoint point;
+	CEntity *entity;
+	static CEntity *objects[1024];
+	uint32 start = CTimer::GetCurrentTimeInCycles();
+	for(i = 0; i < 100; i++){
+		CWorld::FindObjectsInRange(pos, 100.0f, false, &n, ARRAY_SIZE(objects), objects, true, true, true, true, true);
+		for(j = 0; j < 16; j++){
+			float angle = j*TWOPI/16;
+			CVector end = pos + CVector(Cos(angle), Sin(angle), 0.0f)*150.0f;
+			CWorld::ProcessLineOfSight(pos, end, point, entity, true, true, true, true, true, false);
+			CWorld::GetIsLineOfSightClear(pos, end, true, true, true, true, true, false);
+			CWorld::ProcessVerticalLine(CVector(end.x, end.y, pos.z + 50.0f), pos.z - 100.0f, point, entity, true, false, false, false, false, false, nil);
+		}
+	}
+	return (float)(CTimer::GetCurrentTimeInCycles() - start) / CTimer::GetCyclesPerMillisecond();
+}
+
+// Same queries around the player, once over the sector lists and once over the arrays
+static void
+BenchmarkSectorArrays(void)
+{
+	CVector pos = FindPlayerCoors() + CVector(0.0f, 0.0f, 1.0f);
+	bool useArrays = CWorld::bUseSectorArrays;
+	float listTime, arrayTime;
+
+	CWorld::bUseSectorArrays = false;
+	TimeWorldQueries(pos);
+	listTime = TimeWorldQueries(pos);
+	CWorld::bUseSectorArrays = true;
+	TimeWorldQueries(pos);
+	arrayTime = TimeWorldQueries(pos);
+	CWorld::bUseSectorArrays = useArrays;
+	debug("world queries: sector lists %.2f ms, sector arrays %.2f ms\n", listTime, arrayTime);
+}
+#endif
+
+#ifdef STATIC_BUILDING_BVH
+// Lines and ground probes around the player through the building BVH and through the sectors,
+// counts the lines where the two disagree
+static void
+CompareBuildingBVH(void)
+{
+	int i, pass, mismatches;
+	CVector pos = FindPlayerCoors() + CVector(0.0f, 0.0f, 1.0f);
+	CColPoint point;
+	CEntity *entity;
+	CEntity *hits[64];
+	float time[2];
+	bool enabled = CBuildingBVH::ms_bEnabled;
+
+	mismatches = 0;
+	for(pass = 0; pass < 2; pass++){
+		CBuildingBVH::ms_bEnabled = pass == 1;
+		uint32 start = CTimer::GetCurrentTimeInCycles();
+		for(i = 0; i < 64*20; i++){
+			float angle = (i%64)*TWOPI/64;
+			CVector end = pos + CVector(Cos(angle), Sin(angle), (i%5 - 2)*0.1f)*400.0f;
+			entity = nil;
+			CWorld::ProcessLineOfSight(pos, end, point, entity, true, false, false, false, false, false);
+			CWorld::GetIsLineOfSightClear(pos, end, true, false, false, false, false, false);
+			CWorld::ProcessVerticalLine(CVector(end.x, end.y, pos.z + 100.0f), pos.z - 200.0f, point, entity, true, false, false, false, false, false, nil);
+			if(i < 64){
+				CWorld::ProcessLineOfSight(pos, end, point, entity, true, false, false, false, false, false);
+				if(pass == 0)
+					hits[i] = entity;
+				else if(hits[i] != entity)
+					mismatches++;
+			}
+		}
+		time[pass] = (float)(CTimer::GetCurrentTimeInCycles() - start) / CTimer::GetCyclesPerMillisecond();
+	}
+	CBuildingBVH::ms_bEnabled = enabled;
+	CBuildingBVH::PrintStats();
+	debug("building queries: sectors %.2f ms, BVH %.2f ms, %d of 64 lines hit a different building\n",
+		time[0], time[1], mismatches);
+}
+#endif
+
 static void
 ResetCamStatics(void)
 {
@@ -984,6 +1107,104 @@ extern bool gbRenderWorld2;
 #ifdef TIMEBARS
 		DebugMenuAddVarBool8("Debug", "Show Timebars", &gbShowTimebars, nil);
 #endif
+#ifdef BATCHED_CDSTREAM
+		DebugMenuAddCmd("Streaming", "Print CdStream latency", CdStreamPrintStats);
+#endif
+#ifdef ASYNC_STREAM_DECODE
+		DebugMenuAddVarBool8("Streaming", "Decode COL/IFP on worker threads", &CStreaming::ms_bAsyncDecode, nil);
+		DebugMenuAddVar("Streaming", "Frame budget (ms)", &CStreaming::ms_frameBudget, nil, 1, 0, 50, nil);
+#endif
+#ifdef STREAMING_DEADLINES
+		DebugMenuAddVarBool8("Streaming", "Deadline scheduling", &CStreaming::ms_bDeadlineScheduling, nil);
+		DebugMenuAddVar("Streaming", "Deadline slack (ms)", &CStreaming::ms_deadlineSlack, nil, 100, 0, 5000, nil);
+		DebugMenuAddCmd("Streaming", "Print request scheduler stats", CStreaming::PrintSchedulerStats);
+#endif
+#ifdef PREDICTIVE_STREAMING
+		DebugMenuAddVarBool8("Streaming", "Predictive streaming", &CStreaming::ms_bPredictiveStreaming, nil);
+		DebugMenuAddVar("Streaming", "Prediction time (s)", &CStreaming::ms_fPredictionTime, nil, 0.5f, 0.0f, 10.0f);
+		DebugMenuAddVar("Streaming", "Prediction min speed (m/s)", &CStreaming::ms_fPredictionMinSpeed, nil, 1.0f, 0.0f, 100.0f);
+		DebugMenuAddCmd("Streaming", "Print prediction stats", CStreaming::PrintPredictionStats);
+#endif
+#ifdef ASYNC_COLLISION_STREAMING
+		DebugMenuAddVarBool8("Streaming", "Don't wait for collision", &CColStore::ms_bAsyncCollision, nil);
+		DebugMenuAddVar("Streaming", "Collision look ahead (s)", &CColStore::ms_fLookAheadTime, nil, 0.5f, 0.0f, 10.0f);
+		DebugMenuAddVar("Streaming", "Collision look ahead radius", &CColStore::ms_fLookAheadRadius, nil, 10.0f, 0.0f, 200.0f);
+#endif
+#ifdef STREAMING_MEMORY_BUDGET
+		DebugMenuAddVarBool8("Streaming", "Memory budget", &CStreaming::ms_bMemoryBudget, nil);
+		DebugMenuAddVar("Streaming", "Memory cap (MB)", &CStreaming::ms_memoryCapMB, nil, 8, 0, 1024, nil);
+		DebugMenuAddVar("Streaming", "Models quota (%)", &CStreaming::ms_aCategoryQuota[STREAMCAT_MODELS], nil, 5, 0, 100, nil);
+		DebugMenuAddVar("Streaming", "LODs quota (%)", &CStreaming::ms_aCategoryQuota[STREAMCAT_LODS], nil, 5, 0, 100, nil);
+		DebugMenuAddVar("Streaming", "Textures quota (%)", &CStreaming::ms_aCategoryQuota[STREAMCAT_TEXTURES], nil, 5, 0, 100, nil);
+		DebugMenuAddVar("Streaming", "Animation quota (%)", &CStreaming::ms_aCategoryQuota[STREAMCAT_ANIMATION], nil, 5, 0, 100, nil);
+		DebugMenuAddCmd("Streaming", "Print memory budget", CStreaming::PrintMemoryBudget);
+#endif
+#ifdef SECTOR_ENTITY_ARRAYS
+		DebugMenuAddVarBool8("World", "Use sector arrays", &CWorld::bUseSectorArrays, nil);
+		DebugMenuAddCmd("World", "Benchmark world queries", BenchmarkSectorArrays);
+#endif
+#ifdef STATIC_BUILDING_BVH
+		DebugMenuAddVarBool8("World", "Use building BVH", &CBuildingBVH::ms_bEnabled, nil);
+		DebugMenuAddCmd("World", "Rebuild building BVH", CBuildingBVH::Build);
+		DebugMenuAddCmd("World", "Compare building BVH with sectors", CompareBuildingBVH);
+#endif
+#ifdef COLMODEL_TRIANGLE_BVH
+		DebugMenuAddVarBool8("World", "Use col model triangle BVH", &CCollision::ms_bUseTriangleBVH, nil);
+#endif
+#ifdef COLLISION_TRIANGLE_LISTS
+		DebugMenuAddCmd("World", "Print triangle list stats", CCollision::PrintTriangleStats);
+#endif
+#ifdef SIMD_COLLISION
+		DebugMenuAddVarBool8("World", "Use SIMD collision", &CCollisionSimd::ms_bEnabled, nil);
+		DebugMenuAddCmd("World", "Check SIMD collision against scalar", CCollisionSimd::CheckAgainstScalar);
+#endif
+#ifdef GROUND_HEIGHT_CACHE
+		DebugMenuAddVarBool8("World", "Use ground height cache", &CGroundCache::ms_bEnabled, nil);
+		DebugMenuAddCmd("World", "Print ground height cache stats", CGroundCache::PrintStats);
+		DebugMenuAddCmd("World", "Check ground height cache", CGroundCache::CheckAgainstWorld);
+#endif
+#ifdef ISLAND_WORLD_PROCESS
+		DebugMenuAddVarBool8("World", "Process moving entities by islands", &CWorld::bProcessByIslands, nil);
+		DebugMenuAddVarBool8("World", "Process islands in parallel", &CWorld::bParallelIslands, nil);
+		DebugMenuAddVarBool8("World", "Check islands against serial passes", &CWorld::bCheckIslands, nil);
+		DebugMenuAddCmd("World", "Print moving island stats", CWorld::PrintIslandStats);
+#endif
+#ifdef PARALLEL_ANIM_UPDATE
+		DebugMenuAddVarBool8("Animation", "Parallel animation update", &gbParallelAnimUpdate, nil);
+#endif
+#ifdef SIMD_ANIM_UPDATE
+		DebugMenuAddVarBool8("Animation", "SIMD frame update", &gbSimdAnimUpdate, nil);
+		DebugMenuAddCmd("Animation", "Benchmark frame update", BenchmarkFrameUpdateSimd);
+#endif
+#ifdef ANIM_LOD
+		DebugMenuAddVarBool8("Animation", "Anim LOD", &CAnimLod::ms_bEnabled, nil);
+		DebugMenuAddVarBool8("Animation", "Show anim LODs", &CAnimLod::ms_bShowLods, nil);
+		DebugMenuAddVar("Animation", "Half rate below size", &CAnimLod::ms_fHalfRateSize, nil, 0.005f, 0.0f, 1.0f);
+		DebugMenuAddVar("Animation", "Quarter rate below size", &CAnimLod::ms_fQuarterRateSize, nil, 0.005f, 0.0f, 1.0f);
+#endif
+#ifdef PARALLEL_SCAN_WORLD
+		DebugMenuAddVarBool8("Render", "Parallel world scan", &CRenderer::ms_bParallelScanWorld, nil);
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+		DebugMenuAddVarBool8("Render", "SIMD building culling", &CBuildingCulling::ms_bEnabled, nil);
+		DebugMenuAddCmd("Render", "Rebuild building culling", CBuildingCulling::Build);
+		DebugMenuAddCmd("Render", "Benchmark building culling", CBuildingCulling::Benchmark);
+#endif
+#ifdef SOFTWARE_OCCLUSION
+		DebugMenuAddVarBool8("Render", "Occlusion buffer", &COcclusionBuffer::ms_bEnabled, nil);
+		DebugMenuAddVarBool8("Render", "Show occlusion buffer", &COcclusionBuffer::ms_bShowBuffer, nil);
+		DebugMenuAddVar("Render", "Occluder range", &COcclusionBuffer::ms_fOccluderRange, nil, 10.0f, 20.0f, 500.0f);
+		DebugMenuAddVar("Render", "Min occluder radius", &COcclusionBuffer::ms_fMinOccluderRadius, nil, 1.0f, 1.0f, 100.0f);
+#endif
+#ifdef SORTED_WORLD_RENDER
+		DebugMenuAddVarBool8("Render", "Sort world meshes", &WorldRender::bSortCommands, nil);
+#ifdef INSTANCED_WORLD_RENDER
+		DebugMenuAddVarBool8("Render", "Instance world meshes", &WorldRender::bInstancing, nil);
+#endif
+#ifndef FINAL
+		DebugMenuAddVarBool8("Render", "Print world render stats", &gbPrintWorldRenderStats, nil);
+#endif
+#endif
 #ifdef MISSION_SWITCHER
 		DebugMenuEntry *missionEntry;
 		static const char* missions[] = {
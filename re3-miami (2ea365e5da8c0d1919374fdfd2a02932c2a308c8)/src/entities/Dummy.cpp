@@ -36,7 +36,11 @@ CDummy::Add(void)
 				list = &s->m_lists[ENTITYLIST_DUMMIES_OVERLAP];
 			CPtrNode *node = list->InsertItem(this);
 			assert(node);
+#ifdef SECTOR_ENTITY_ARRAYS
+			CWorld::GetSectorArray(list)->Add(this, m_entryInfoList.InsertItem(list, node, s));
+#else
 			m_entryInfoList.InsertItem(list, node, s);
+#endif
 		}
 }
 
@@ -46,6 +50,9 @@ CDummy::Remove(void)
 	CEntryInfoNode *node, *next;
 	for(node = m_entryInfoList.first; node; node = next){
 		next = node->next;
+#ifdef SECTOR_ENTITY_ARRAYS
+		CWorld::GetSectorArray(node->list)->RemoveAt(node->arrayIndex);
+#endif
 		node->list->DeleteNode(node->listnode);
 		m_entryInfoList.DeleteNode(node);
 	}
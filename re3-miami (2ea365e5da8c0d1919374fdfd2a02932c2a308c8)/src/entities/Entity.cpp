@@ -7,6 +7,12 @@
 #include "Entity.h"
 #include "Object.h"
 #include "World.h"
+#ifdef STATIC_BUILDING_BVH
+#include "BuildingBVH.h"
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+#include "BuildingCulling.h"
+#endif
 #include "Camera.h"
 #include "Glass.h"
 #include "Weather.h"
@@ -544,7 +550,18 @@ CEntity::Add(void)
 				break;
 			}
 			list->InsertItem(this);
+#ifdef SECTOR_ENTITY_ARRAYS
+			CWorld::GetSectorArray(list)->Add(this, nil);
+#endif
 		}
+#ifdef STATIC_BUILDING_BVH
+	if(IsBuilding())
+		CBuildingBVH::AddBuilding(this);
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	if(IsBuilding())
+		CBuildingCulling::AddBuilding(this);
+#endif
 }
 
 void
@@ -604,7 +621,18 @@ CEntity::Remove(void)
 				break;
 			}
 			list->RemoveItem(this);
+#ifdef SECTOR_ENTITY_ARRAYS
+			CWorld::GetSectorArray(list)->Remove(this);
+#endif
 		}
+#ifdef STATIC_BUILDING_BVH
+	if(IsBuilding())
+		CBuildingBVH::RemoveBuilding(this);
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	if(IsBuilding())
+		CBuildingCulling::RemoveBuilding(this);
+#endif
 }
 
 float
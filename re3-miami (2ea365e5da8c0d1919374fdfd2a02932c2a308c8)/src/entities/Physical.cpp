@@ -139,7 +139,11 @@ CPhysical::Add(void)
 			}
 			CPtrNode *node = list->InsertItem(this);
 			assert(node);
+#ifdef SECTOR_ENTITY_ARRAYS
+			CWorld::GetSectorArray(list)->Add(this, m_entryInfoList.InsertItem(list, node, s));
+#else
 			m_entryInfoList.InsertItem(list, node, s);
+#endif
 		}
 }
 
@@ -149,6 +153,9 @@ CPhysical::Remove(void)
 	CEntryInfoNode *node, *next;
 	for(node = m_entryInfoList.first; node; node = next){
 		next = node->next;
+#ifdef SECTOR_ENTITY_ARRAYS
+		CWorld::GetSectorArray(node->list)->RemoveAt(node->arrayIndex);
+#endif
 		node->list->DeleteNode(node->listnode);
 		m_entryInfoList.DeleteNode(node);
 	}
@@ -205,12 +212,22 @@ CPhysical::RemoveAndAdd(void)
 				// If we still have old nodes, use them
 				next->list->RemoveNode(next->listnode);
 				list->InsertNode(next->listnode);
+#ifdef SECTOR_ENTITY_ARRAYS
+				if(next->list != list){
+					CWorld::GetSectorArray(next->list)->RemoveAt(next->arrayIndex);
+					CWorld::GetSectorArray(list)->Add(this, next);
+				}
+#endif
 				next->list = list;
 				next->sector = s;
 				next = next->next;
 			}else{
 				CPtrNode *node = list->InsertItem(this);
+#ifdef SECTOR_ENTITY_ARRAYS
+				CWorld::GetSectorArray(list)->Add(this, m_entryInfoList.InsertItem(list, node, s));
+#else
 				m_entryInfoList.InsertItem(list, node, s);
+#endif
 			}
 		}
 
@@ -218,6 +235,9 @@ CPhysical::RemoveAndAdd(void)
 	CEntryInfoNode *node;
 	for(node = next; node; node = next){
 		next = node->next;
+#ifdef SECTOR_ENTITY_ARRAYS
+		CWorld::GetSectorArray(node->list)->RemoveAt(node->arrayIndex);
+#endif
 		node->list->DeleteNode(node->listnode);
 		m_entryInfoList.DeleteNode(node);
 	}
@@ -1416,7 +1436,7 @@ CPhysical::ProcessShiftSectorList(CPtrList *lists)
 bool
 CPhysical::ProcessCollisionSectorList_SimpleCar(CPtrList *lists)
 {
-	static CColPoint aColPoints[MAX_COLLISION_POINTS];
+	static JOBLOCAL CColPoint aColPoints[MAX_COLLISION_POINTS];
 	float radius;
 	CVector center;
 	int listtype;
@@ -1583,7 +1603,7 @@ collision:
 bool
 CPhysical::ProcessCollisionSectorList(CPtrList *lists)
 {
-	static CColPoint aColPoints[MAX_COLLISION_POINTS];
+	static JOBLOCAL CColPoint aColPoints[MAX_COLLISION_POINTS];
 	float radius;
 	CVector center;
 	CPtrList *list;
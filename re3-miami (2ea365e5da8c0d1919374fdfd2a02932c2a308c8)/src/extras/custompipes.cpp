@@ -541,3 +541,63 @@ SetTxdFindCallback(void)
 }
 
 #endif
+
+#ifdef SORTED_WORLD_RENDER
+#include "custompipes.h"
+
+namespace WorldRender
+{
+
+bool bSortCommands = true;
+int numMeshes;
+int numDrawCalls;
+int numStateChanges;
+
+// Draws of the same mesh end up next to each other, nearest first.
+// depth is 0 at the camera and 1 at the far plane.
+uint64
+MakeSortKey(int pipeline, void *texture, void *mesh, float depth)
+{
+	uint64 tex = ((uintptr)texture >> 4) & 0x3FFFFFFF;
+	uint64 id = ((uintptr)mesh >> 4) & 0xFFFF;
+	uint64 z = clamp(depth, 0.0f, 1.0f) * 0xFFFF;
+	return (uint64)(pipeline & 3) << 62 | tex << 32 | id << 16 | z;
+}
+
+// LSD radix sort, a byte at a time. Bytes that are the same in all keys are skipped.
+void
+SortCommands(RenderCommand *commands, RenderCommand *tmp, int n)
+{
+	int i, shift;
+	int32 counts[256];
+	int32 sum, c;
+	RenderCommand *src = commands;
+	RenderCommand *dst = tmp;
+	RenderCommand *swap;
+
+	if(n < 2)
+		return;
+	for(shift = 0; shift < 64; shift += 8){
+		memset(counts, 0, sizeof(counts));
+		for(i = 0; i < n; i++)
+			counts[(src[i].key >> shift) & 0xFF]++;
+		if(counts[(src[0].key >> shift) & 0xFF] == n)
+			continue;
+		sum = 0;
+		for(i = 0; i < 256; i++){
+			c = counts[i];
+			counts[i] = sum;
+			sum += c;
+		}
+		for(i = 0; i < n; i++)
+			dst[counts[(src[i].key >> shift) & 0xFF]++] = src[i];
+		swap = src;
+		src = dst;
+		dst = swap;
+	}
+	if(src != commands)
+		memcpy(commands, src, n*sizeof(RenderCommand));
+}
+
+}
+#endif
@@ -140,6 +140,29 @@ extern int numBlendInsts[3];
 void AtomicFirstPass(RpAtomic *atomic, int pass);
 void AtomicFullyTransparent(RpAtomic *atomic, int pass, int fadeAlpha);
 void RenderBlendPass(int pass);
+#ifdef SORTED_WORLD_RENDER
+// Opaque meshes from AtomicFirstPass are recorded with a sort key
+// and drawn in key order by FlushCommands at the end of a world pass
+struct RenderCommand
+{
+	uint64 key;	// pipeline, texture, mesh, depth from the top bits down
+	int32 mesh;
+};
+extern bool bSortCommands;
+extern int numMeshes;
+extern int numDrawCalls;
+extern int numStateChanges;
+uint64 MakeSortKey(int pipeline, void *texture, void *mesh, float depth);
+void SortCommands(RenderCommand *commands, RenderCommand *tmp, int n);
+void FlushCommands(void);
+#endif
+#ifdef INSTANCED_WORLD_RENDER
+// Runs of the same mesh in the sorted commands are drawn with one instanced draw
+extern bool bInstancing;
+extern int numInstancedMeshes;
+void CreateInstancing(void);
+void DestroyInstancing(void);
+#endif
 }
 
 #endif
@@ -594,6 +594,125 @@ IsTextureTransparent(RwTexture *tex)
 	return PLUGINOFFSET(rw::d3d::D3dRaster, tex->raster, rw::d3d::nativeRasterOffset)->hasAlpha;
 }
 
+#ifdef SORTED_WORLD_RENDER
+#define MAXOPAQUEINSTS 4000
+#define MAXRENDERCOMMANDS 16384
+
+struct OpaqueMesh
+{
+	BuildingInst *building;
+	rw::d3d9::InstanceData *inst;
+};
+static BuildingInst opaqueInsts[MAXOPAQUEINSTS];
+static int numOpaqueInsts;
+static OpaqueMesh opaqueMeshes[MAXRENDERCOMMANDS];
+static RenderCommand commands[MAXRENDERCOMMANDS];
+static RenderCommand sortTmp[MAXRENDERCOMMANDS];
+static int numCommands;
+
+// Queue the opaque meshes of a building, true if it has any that need blending
+static bool
+RecordOpaqueMeshes(BuildingInst *building, float depth)
+{
+	using namespace rw;
+	using namespace rw::d3d9;
+
+	if(numOpaqueInsts == MAXOPAQUEINSTS || numCommands + building->instHeader->numMeshes > MAXRENDERCOMMANDS)
+		FlushCommands();
+
+	// the blend list entry is reused unless something is deferred
+	BuildingInst *opaque = &opaqueInsts[numOpaqueInsts++];
+	*opaque = *building;
+
+	bool defer = false;
+	InstanceData *inst = building->instHeader->inst;
+	for(rw::uint32 i = 0; i < building->instHeader->numMeshes; i++, inst++){
+		Material *m = inst->material;
+
+		if(inst->vertexAlpha || m->color.alpha != 255 ||
+		   IsTextureTransparent(m->texture)){
+			defer = true;
+			continue;
+		}
+
+		// lighting and texturing pick the ambient and pixel shader
+		int pipeline = building->lighting<<1 | (m->texture != nil);
+		commands[numCommands].key = MakeSortKey(pipeline, m->texture, inst, depth);
+		commands[numCommands].mesh = numCommands;
+		opaqueMeshes[numCommands].building = opaque;
+		opaqueMeshes[numCommands].inst = inst;
+		numCommands++;
+		numMeshes++;
+	}
+	return defer;
+}
+
+// Draw the queued meshes in key order, only changing state that differs from the last mesh
+void
+FlushCommands(void)
+{
+	using namespace rw;
+	using namespace rw::d3d;
+	using namespace rw::d3d9;
+
+	if(numCommands == 0)
+		return;
+
+	SortCommands(commands, sortTmp, numCommands);
+
+	BuildingInst *building = nil;
+	InstanceDataHeader *header = nil;
+	Material *material = nil;
+	Texture *texture = nil;
+	int lighting = -1;
+	int textured = -1;
+
+	setVertexShader(default_amb_VS);
+	for(int i = 0; i < numCommands; i++){
+		OpaqueMesh *mesh = &opaqueMeshes[commands[i].mesh];
+		Material *m = mesh->inst->material;
+
+		if(mesh->building->instHeader != header){
+			header = mesh->building->instHeader;
+			setStreamSource(0, header->vertexStream[0].vertexBuffer, 0, header->vertexStream[0].stride);
+			setIndices(header->indexBuffer);
+			setVertexDeclaration(header->vertexDeclaration);
+			numStateChanges++;
+		}
+		if(mesh->building != building){
+			building = mesh->building;
+			d3ddevice->SetVertexShaderConstantF(VSLOC_combined, (float*)&building->combinedMat, 4);
+			numStateChanges++;
+		}
+		if(building->lighting != lighting){
+			lighting = building->lighting;
+			setAmbient(lighting ? pAmbient->color : black);
+			numStateChanges++;
+		}
+		if(m != material){
+			material = m;
+			setMaterial(m->color, m->surfaceProps);
+			numStateChanges++;
+		}
+		if((m->texture != nil) != textured){
+			textured = m->texture != nil;
+			setPixelShader(textured ? default_tex_PS : default_PS);
+			numStateChanges++;
+		}
+		if(m->texture && m->texture != texture){
+			texture = m->texture;
+			d3d::setTexture(0, texture);
+			numStateChanges++;
+		}
+
+		drawInst(header, mesh->inst);
+		numDrawCalls++;
+	}
+	numCommands = 0;
+	numOpaqueInsts = 0;
+}
+#endif
+
 // Render all opaque meshes and put atomics that needs blending
 // into the deferred list.
 void
@@ -616,6 +735,15 @@ AtomicFirstPass(RpAtomic *atomic, int pass)
 	bool defer = false;
 	SetMatrix(building, atomic->getFrame()->getLTM());
 
+#ifdef SORTED_WORLD_RENDER
+	if(bSortCommands){
+		V3d dist = sub(atomic->getFrame()->getLTM()->pos, engine->currentCamera->getFrame()->getLTM()->pos);
+		if(RecordOpaqueMeshes(building, length(dist) / engine->currentCamera->farPlane))
+			numBlendInsts[pass]++;
+		return;
+	}
+#endif
+
 	InstanceData *inst = building->instHeader->inst;
 	for(rw::uint32 i = 0; i < building->instHeader->numMeshes; i++, inst++){
 		Material *m = inst->material;
@@ -638,6 +766,9 @@ AtomicFirstPass(RpAtomic *atomic, int pass)
 			else
 				setAmbient(black);
 			setupDone = true;
+#ifdef SORTED_WORLD_RENDER
+			numStateChanges += 3;
+#endif
 		}
 
 		setMaterial(m->color, m->surfaceProps);
@@ -649,6 +780,11 @@ AtomicFirstPass(RpAtomic *atomic, int pass)
 			setPixelShader(default_PS);
 
 		drawInst(building->instHeader, inst);
+#ifdef SORTED_WORLD_RENDER
+		numMeshes++;
+		numDrawCalls++;
+		numStateChanges += m->texture ? 3 : 2;
+#endif
 	}
 	if(defer)
 		numBlendInsts[pass]++;
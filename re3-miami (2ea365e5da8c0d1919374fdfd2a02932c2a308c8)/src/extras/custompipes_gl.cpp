@@ -649,6 +649,248 @@ IsTextureTransparent(RwTexture *tex)
 	return PLUGINOFFSET(rw::gl3::Gl3Raster, tex->raster, rw::gl3::nativeRasterOffset)->hasAlpha;
 }
 
+#ifdef SORTED_WORLD_RENDER
+#define MAXOPAQUEINSTS 4000
+#define MAXRENDERCOMMANDS 16384
+
+struct OpaqueMesh
+{
+	BuildingInst *building;
+	rw::gl3::InstanceData *inst;
+};
+static BuildingInst opaqueInsts[MAXOPAQUEINSTS];
+static int numOpaqueInsts;
+static OpaqueMesh opaqueMeshes[MAXRENDERCOMMANDS];
+static RenderCommand commands[MAXRENDERCOMMANDS];
+static RenderCommand sortTmp[MAXRENDERCOMMANDS];
+static int numCommands;
+
+// Queue the opaque meshes of a building, true if it has any that need blending
+static bool
+RecordOpaqueMeshes(BuildingInst *building, float depth)
+{
+	using namespace rw;
+	using namespace rw::gl3;
+
+	if(numOpaqueInsts == MAXOPAQUEINSTS || numCommands + building->instHeader->numMeshes > MAXRENDERCOMMANDS)
+		FlushCommands();
+
+	// the blend list entry is reused unless something is deferred
+	BuildingInst *opaque = &opaqueInsts[numOpaqueInsts++];
+	*opaque = *building;
+
+	bool defer = false;
+	InstanceData *inst = building->instHeader->inst;
+	for(rw::uint32 i = 0; i < building->instHeader->numMeshes; i++, inst++){
+		Material *m = inst->material;
+
+		if(inst->vertexAlpha || m->color.alpha != 255 ||
+		   IsTextureTransparent(m->texture)){
+			defer = true;
+			continue;
+		}
+
+		commands[numCommands].key = MakeSortKey(building->lighting, m->texture, inst, depth);
+		commands[numCommands].mesh = numCommands;
+		opaqueMeshes[numCommands].building = opaque;
+		opaqueMeshes[numCommands].inst = inst;
+		numCommands++;
+		numMeshes++;
+	}
+	return defer;
+}
+
+#ifdef INSTANCED_WORLD_RENDER
+#define MININSTANCES 4
+#define MAXINSTANCES 256
+
+// after librw's attributes, GL has at least 16
+enum {
+	ATTRIB_INSTANCE0 = 13,
+	ATTRIB_INSTANCE1,
+	ATTRIB_INSTANCE2
+};
+static const char *instanceDecl =
+	"#define ATTRIB_INSTANCE0 13\n"
+	"#define ATTRIB_INSTANCE1 14\n"
+	"#define ATTRIB_INSTANCE2 15\n";
+
+bool bInstancing = true;
+int numInstancedMeshes;
+
+static rw::gl3::Shader *instancedShader;
+static uint32 instanceVbo;
+static float instanceRows[MAXINSTANCES*12];
+
+void
+CreateInstancing(void)
+{
+	using namespace rw::gl3;
+
+	{
+#include "shaders/simple_fs_gl.inc"
+#include "shaders/instancedWorld_gl.inc"
+	const char *vs[] = { shaderDecl, instanceDecl, header_vert_src, instancedWorld_vert_src, nil };
+	const char *fs[] = { shaderDecl, header_frag_src, simple_frag_src, nil };
+	instancedShader = Shader::create(vs, fs);
+	assert(instancedShader);
+	}
+
+	glGenBuffers(1, &instanceVbo);
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(instanceRows), nil, GL_STREAM_DRAW);
+}
+
+void
+DestroyInstancing(void)
+{
+	instancedShader->destroy();
+	instancedShader = nil;
+
+	glDeleteBuffers(1, &instanceVbo);
+}
+
+// Commands first to first+count-1 all draw the same mesh, only the world matrix differs
+static void
+DrawInstanced(rw::gl3::InstanceDataHeader *header, rw::gl3::InstanceData *inst, int first, int count)
+{
+	using namespace rw;
+	using namespace rw::gl3;
+
+	int i;
+	for(i = 0; i < count; i++){
+		Matrix *mat = &opaqueMeshes[commands[first+i].mesh].building->matrix;
+		float *row = &instanceRows[i*12];
+		row[0] = mat->right.x; row[1] = mat->up.x; row[2] = mat->at.x; row[3] = mat->pos.x;
+		row[4] = mat->right.y; row[5] = mat->up.y; row[6] = mat->at.y; row[7] = mat->pos.y;
+		row[8] = mat->right.z; row[9] = mat->up.z; row[10] = mat->at.z; row[11] = mat->pos.z;
+	}
+
+	glBindBuffer(GL_ARRAY_BUFFER, instanceVbo);
+	glBufferData(GL_ARRAY_BUFFER, sizeof(instanceRows), nil, GL_STREAM_DRAW);
+	glBufferSubData(GL_ARRAY_BUFFER, 0, count*12*sizeof(float), instanceRows);
+	for(i = 0; i < 3; i++){
+		glEnableVertexAttribArray(ATTRIB_INSTANCE0+i);
+		glVertexAttribPointer(ATTRIB_INSTANCE0+i, 4, GL_FLOAT, GL_FALSE, 12*sizeof(float), (void*)(i*4*sizeof(float)));
+		glVertexAttribDivisor(ATTRIB_INSTANCE0+i, 1);
+	}
+
+	flushCache();
+	glDrawElementsInstanced(header->primType, inst->numIndex, GL_UNSIGNED_SHORT, (void*)(uintptr)inst->offset, count);
+
+	for(i = 0; i < 3; i++){
+		glVertexAttribDivisor(ATTRIB_INSTANCE0+i, 0);
+		glDisableVertexAttribArray(ATTRIB_INSTANCE0+i);
+	}
+}
+#endif
+
+// Draw the queued meshes in key order, only changing state that differs from the last mesh
+void
+FlushCommands(void)
+{
+	using namespace rw;
+	using namespace rw::gl3;
+
+	if(numCommands == 0)
+		return;
+
+	SortCommands(commands, sortTmp, numCommands);
+
+	WorldLights lights;
+	lights.numAmbients = 1;
+	lights.numDirectionals = 0;
+	lights.numLocals = 0;
+
+	BuildingInst *building = nil;
+	InstanceDataHeader *header = nil;
+	Material *material = nil;
+	Texture *texture = nil;
+	int lighting = -1;
+
+	defaultShader->use();
+	for(int i = 0; i < numCommands; i++){
+		OpaqueMesh *mesh = &opaqueMeshes[commands[i].mesh];
+		Material *m = mesh->inst->material;
+
+#ifdef INSTANCED_WORLD_RENDER
+		int count = 1;
+		if(bInstancing)
+			while(i+count < numCommands && count < MAXINSTANCES &&
+			      opaqueMeshes[commands[i+count].mesh].inst == mesh->inst)
+				count++;
+		Shader *shader = count >= MININSTANCES ? instancedShader : defaultShader;
+		if(shader != currentShader){
+			shader->use();
+			numStateChanges++;
+			// uniforms belong to the program
+			building = nil;
+			lighting = -1;
+			material = nil;
+		}
+#endif
+		if(mesh->building->instHeader != header){
+#ifndef RW_GL_USE_VAOS
+			if(header)
+				disableAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+			header = mesh->building->instHeader;
+#ifdef RW_GL_USE_VAOS
+			glBindVertexArray(header->vao);
+#else
+			glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, header->ibo);
+			glBindBuffer(GL_ARRAY_BUFFER, header->vbo);
+			setAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+			numStateChanges++;
+		}
+		// instances get their matrices from the instance buffer
+#ifdef INSTANCED_WORLD_RENDER
+		if(mesh->building != building && count < MININSTANCES){
+#else
+		if(mesh->building != building){
+#endif
+			building = mesh->building;
+			setWorldMatrix(&building->matrix);
+			numStateChanges++;
+		}
+		if(mesh->building->lighting != lighting){
+			lighting = mesh->building->lighting;
+			lights.ambient = lighting ? pAmbient->color : black;
+			setLights(&lights);
+			numStateChanges++;
+		}
+		if(m != material){
+			material = m;
+			setMaterial(m->color, m->surfaceProps);
+			numStateChanges++;
+		}
+		if(m->texture != texture || i == 0){
+			texture = m->texture;
+			setTexture(0, texture);
+			numStateChanges++;
+		}
+
+#ifdef INSTANCED_WORLD_RENDER
+		if(count >= MININSTANCES){
+			DrawInstanced(header, mesh->inst, i, count);
+			numDrawCalls++;
+			numInstancedMeshes += count;
+			i += count-1;
+			continue;
+		}
+#endif
+		drawInst(header, mesh->inst);
+		numDrawCalls++;
+	}
+#ifndef RW_GL_USE_VAOS
+	disableAttribPointers(header->attribDesc, header->numAttribs);
+#endif
+	numCommands = 0;
+	numOpaqueInsts = 0;
+}
+#endif
+
 // Render all opaque meshes and put atomics that needs blending
 // into the deferred list.
 void
@@ -679,6 +921,15 @@ AtomicFirstPass(RpAtomic *atomic, int pass)
 	bool defer = false;
 	building->matrix = *atomic->getFrame()->getLTM();
 
+#ifdef SORTED_WORLD_RENDER
+	if(bSortCommands){
+		V3d dist = sub(building->matrix.pos, engine->currentCamera->getFrame()->getLTM()->pos);
+		if(RecordOpaqueMeshes(building, length(dist) / engine->currentCamera->farPlane))
+			numBlendInsts[pass]++;
+		return;
+	}
+#endif
+
 	InstanceData *inst = building->instHeader->inst;
 	for(rw::uint32 i = 0; i < building->instHeader->numMeshes; i++, inst++){
 		Material *m = inst->material;
@@ -702,6 +953,9 @@ AtomicFirstPass(RpAtomic *atomic, int pass)
 #endif
 			setLights(&lights);
 			setupDone = true;
+#ifdef SORTED_WORLD_RENDER
+			numStateChanges += 3;
+#endif
 		}
 
 		setMaterial(m->color, m->surfaceProps);
@@ -709,6 +963,11 @@ AtomicFirstPass(RpAtomic *atomic, int pass)
 		setTexture(0, m->texture);
 
 		drawInst(building->instHeader, inst);
+#ifdef SORTED_WORLD_RENDER
+		numMeshes++;
+		numDrawCalls++;
+		numStateChanges += 2;
+#endif
 	}
 #ifndef RW_GL_USE_VAOS
 	disableAttribPointers(building->instHeader->attribDesc, building->instHeader->numAttribs);
@@ -0,0 +1,31 @@
+VSIN(ATTRIB_POS)	vec3 in_pos;
+VSIN(ATTRIB_INSTANCE0)	vec4 in_world0;
+VSIN(ATTRIB_INSTANCE1)	vec4 in_world1;
+VSIN(ATTRIB_INSTANCE2)	vec4 in_world2;
+
+VSOUT vec4 v_color;
+VSOUT vec2 v_tex0;
+VSOUT float v_fog;
+
+void
+main(void)
+{
+	// the world matrix comes per instance as its first three rows
+	vec4 Vertex = vec4(dot(in_world0, vec4(in_pos, 1.0)),
+	                   dot(in_world1, vec4(in_pos, 1.0)),
+	                   dot(in_world2, vec4(in_pos, 1.0)), 1.0);
+	gl_Position = u_proj * u_view * Vertex;
+	vec3 Normal = vec3(dot(in_world0.xyz, in_normal),
+	                   dot(in_world1.xyz, in_normal),
+	                   dot(in_world2.xyz, in_normal));
+
+	v_tex0 = in_tex0;
+
+	v_color = in_color;
+	v_color.rgb += u_ambLight.rgb*surfAmbient;
+	v_color.rgb += DoDynamicLight(Vertex.xyz, Normal)*surfDiffuse;
+	v_color = clamp(v_color, 0.0, 1.0);
+	v_color *= u_matColor;
+
+	v_fog = DoFog(gl_Position.w);
+}
@@ -0,0 +1,144 @@
+#pragma once
+
+// Four float vectors, SSE2 on x86 and NEON on ARM with a plain C fallback.
+// Masks have all bits set in lanes where the comparison is true.
+
+#if defined(__SSE2__) || defined(_M_X64) || defined(_M_AMD64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define SIMD4_SSE2
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define SIMD4_NEON
+#include <arm_neon.h>
+#endif
+
+#if defined(SIMD4_SSE2)
+typedef __m128 vfloat;
+typedef __m128 vmask;
+
+static inline vfloat Load(const float *f) { return _mm_loadu_ps(f); }
+static inline void Store(float *f, vfloat a) { _mm_storeu_ps(f, a); }
+static inline vfloat Splat(float f) { return _mm_set1_ps(f); }
+// four int16 to float
+static inline vfloat LoadInt16(const int16 *s)
+{
+	__m128i i = _mm_loadl_epi64((const __m128i*)s);
+	return _mm_cvtepi32_ps(_mm_srai_epi32(_mm_unpacklo_epi16(i, i), 16));
+}
+static inline vfloat Add(vfloat a, vfloat b) { return _mm_add_ps(a, b); }
+static inline vfloat Sub(vfloat a, vfloat b) { return _mm_sub_ps(a, b); }
+static inline vfloat Mul(vfloat a, vfloat b) { return _mm_mul_ps(a, b); }
+static inline vfloat Div(vfloat a, vfloat b) { return _mm_div_ps(a, b); }
+static inline vfloat RecipSqrt(vfloat a) { return _mm_div_ps(_mm_set1_ps(1.0f), _mm_sqrt_ps(a)); }
+static inline vfloat VMin(vfloat a, vfloat b) { return _mm_min_ps(a, b); }
+static inline vfloat VMax(vfloat a, vfloat b) { return _mm_max_ps(a, b); }
+static inline vfloat VAbs(vfloat a) { return _mm_andnot_ps(_mm_set1_ps(-0.0f), a); }
+static inline vfloat Neg(vfloat a) { return _mm_xor_ps(_mm_set1_ps(-0.0f), a); }
+static inline vmask CmpLe(vfloat a, vfloat b) { return _mm_cmple_ps(a, b); }
+static inline vmask CmpGe(vfloat a, vfloat b) { return _mm_cmpge_ps(a, b); }
+static inline vmask CmpLt(vfloat a, vfloat b) { return _mm_cmplt_ps(a, b); }
+static inline vmask CmpGt(vfloat a, vfloat b) { return _mm_cmpgt_ps(a, b); }
+static inline vmask CmpEq(vfloat a, vfloat b) { return _mm_cmpeq_ps(a, b); }
+static inline vmask And(vmask a, vmask b) { return _mm_and_ps(a, b); }
+static inline vmask Or(vmask a, vmask b) { return _mm_or_ps(a, b); }
+// a where m is set, b elsewhere
+static inline vfloat Select(vmask m, vfloat a, vfloat b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+static inline int32 MoveMask(vmask m) { return _mm_movemask_ps(m); }
+static inline void Transpose(vfloat &a, vfloat &b, vfloat &c, vfloat &d) { _MM_TRANSPOSE4_PS(a, b, c, d); }
+
+#elif defined(SIMD4_NEON)
+typedef float32x4_t vfloat;
+typedef uint32x4_t vmask;
+
+static inline vfloat Load(const float *f) { return vld1q_f32(f); }
+static inline void Store(float *f, vfloat a) { vst1q_f32(f, a); }
+static inline vfloat Splat(float f) { return vdupq_n_f32(f); }
+static inline vfloat LoadInt16(const int16 *s) { return vcvtq_f32_s32(vmovl_s16(vld1_s16(s))); }
+static inline vfloat Add(vfloat a, vfloat b) { return vaddq_f32(a, b); }
+static inline vfloat Sub(vfloat a, vfloat b) { return vsubq_f32(a, b); }
+static inline vfloat Mul(vfloat a, vfloat b) { return vmulq_f32(a, b); }
+#ifdef __aarch64__
+static inline vfloat Div(vfloat a, vfloat b) { return vdivq_f32(a, b); }
+static inline vfloat RecipSqrt(vfloat a) { return vdivq_f32(vdupq_n_f32(1.0f), vsqrtq_f32(a)); }
+#else
+static inline vfloat Div(vfloat a, vfloat b)
+{
+	// no divide on ARMv7, refine the estimate twice to get close to full precision
+	vfloat r = vrecpeq_f32(b);
+	r = vmulq_f32(r, vrecpsq_f32(b, r));
+	r = vmulq_f32(r, vrecpsq_f32(b, r));
+	return vmulq_f32(a, r);
+}
+static inline vfloat RecipSqrt(vfloat a)
+{
+	vfloat r = vrsqrteq_f32(a);
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+	r = vmulq_f32(r, vrsqrtsq_f32(vmulq_f32(a, r), r));
+	return r;
+}
+#endif
+static inline vfloat VMin(vfloat a, vfloat b) { return vminq_f32(a, b); }
+static inline vfloat VMax(vfloat a, vfloat b) { return vmaxq_f32(a, b); }
+static inline vfloat VAbs(vfloat a) { return vabsq_f32(a); }
+static inline vfloat Neg(vfloat a) { return vnegq_f32(a); }
+static inline vmask CmpLe(vfloat a, vfloat b) { return vcleq_f32(a, b); }
+static inline vmask CmpGe(vfloat a, vfloat b) { return vcgeq_f32(a, b); }
+static inline vmask CmpLt(vfloat a, vfloat b) { return vcltq_f32(a, b); }
+static inline vmask CmpGt(vfloat a, vfloat b) { return vcgtq_f32(a, b); }
+static inline vmask CmpEq(vfloat a, vfloat b) { return vceqq_f32(a, b); }
+static inline vmask And(vmask a, vmask b) { return vandq_u32(a, b); }
+static inline vmask Or(vmask a, vmask b) { return vorrq_u32(a, b); }
+static inline vfloat Select(vmask m, vfloat a, vfloat b) { return vbslq_f32(m, a, b); }
+static inline int32 MoveMask(vmask m)
+{
+	static const uint32 bits[4] = { 1, 2, 4, 8 };
+	uint32x4_t b = vandq_u32(m, vld1q_u32(bits));
+	uint32x2_t s = vadd_u32(vget_low_u32(b), vget_high_u32(b));
+	return vget_lane_u32(vpadd_u32(s, s), 0);
+}
+static inline void Transpose(vfloat &a, vfloat &b, vfloat &c, vfloat &d)
+{
+	float32x4x2_t ab = vtrnq_f32(a, b);
+	float32x4x2_t cd = vtrnq_f32(c, d);
+	a = vcombine_f32(vget_low_f32(ab.val[0]), vget_low_f32(cd.val[0]));
+	b = vcombine_f32(vget_low_f32(ab.val[1]), vget_low_f32(cd.val[1]));
+	c = vcombine_f32(vget_high_f32(ab.val[0]), vget_high_f32(cd.val[0]));
+	d = vcombine_f32(vget_high_f32(ab.val[1]), vget_high_f32(cd.val[1]));
+}
+
+#else
+struct vfloat { float f[4]; };
+struct vmask { bool m[4]; };
+
+static inline vfloat Load(const float *f) { vfloat r; for(int i = 0; i < 4; i++) r.f[i] = f[i]; return r; }
+static inline void Store(float *f, vfloat a) { for(int i = 0; i < 4; i++) f[i] = a.f[i]; }
+static inline vfloat Splat(float f) { vfloat r; for(int i = 0; i < 4; i++) r.f[i] = f; return r; }
+static inline vfloat LoadInt16(const int16 *s) { vfloat r; for(int i = 0; i < 4; i++) r.f[i] = s[i]; return r; }
+static inline vfloat Add(vfloat a, vfloat b) { for(int i = 0; i < 4; i++) a.f[i] += b.f[i]; return a; }
+static inline vfloat Sub(vfloat a, vfloat b) { for(int i = 0; i < 4; i++) a.f[i] -= b.f[i]; return a; }
+static inline vfloat Mul(vfloat a, vfloat b) { for(int i = 0; i < 4; i++) a.f[i] *= b.f[i]; return a; }
+static inline vfloat Div(vfloat a, vfloat b) { for(int i = 0; i < 4; i++) a.f[i] /= b.f[i]; return a; }
+static inline vfloat RecipSqrt(vfloat a) { for(int i = 0; i < 4; i++) a.f[i] = 1.0f/Sqrt(a.f[i]); return a; }
+static inline vfloat VMin(vfloat a, vfloat b) { for(int i = 0; i < 4; i++) a.f[i] = Min(a.f[i], b.f[i]); return a; }
+static inline vfloat VMax(vfloat a, vfloat b) { for(int i = 0; i < 4; i++) a.f[i] = Max(a.f[i], b.f[i]); return a; }
+static inline vfloat VAbs(vfloat a) { for(int i = 0; i < 4; i++) a.f[i] = Abs(a.f[i]); return a; }
+static inline vfloat Neg(vfloat a) { for(int i = 0; i < 4; i++) a.f[i] = -a.f[i]; return a; }
+static inline vmask CmpLe(vfloat a, vfloat b) { vmask r; for(int i = 0; i < 4; i++) r.m[i] = a.f[i] <= b.f[i]; return r; }
+static inline vmask CmpGe(vfloat a, vfloat b) { vmask r; for(int i = 0; i < 4; i++) r.m[i] = a.f[i] >= b.f[i]; return r; }
+static inline vmask CmpLt(vfloat a, vfloat b) { vmask r; for(int i = 0; i < 4; i++) r.m[i] = a.f[i] < b.f[i]; return r; }
+static inline vmask CmpGt(vfloat a, vfloat b) { vmask r; for(int i = 0; i < 4; i++) r.m[i] = a.f[i] > b.f[i]; return r; }
+static inline vmask CmpEq(vfloat a, vfloat b) { vmask r; for(int i = 0; i < 4; i++) r.m[i] = a.f[i] == b.f[i]; return r; }
+static inline vmask And(vmask a, vmask b) { for(int i = 0; i < 4; i++) a.m[i] = a.m[i] && b.m[i]; return a; }
+static inline vmask Or(vmask a, vmask b) { for(int i = 0; i < 4; i++) a.m[i] = a.m[i] || b.m[i]; return a; }
+static inline vfloat Select(vmask m, vfloat a, vfloat b) { for(int i = 0; i < 4; i++) if(!m.m[i]) a.f[i] = b.f[i]; return a; }
+static inline int32 MoveMask(vmask m) { return m.m[0] | m.m[1]<<1 | m.m[2]<<2 | m.m[3]<<3; }
+static inline void Transpose(vfloat &a, vfloat &b, vfloat &c, vfloat &d)
+{
+	vfloat r[4] = { a, b, c, d };
+	for(int i = 0; i < 4; i++){
+		a.f[i] = r[i].f[0];
+		b.f[i] = r[i].f[1];
+		c.f[i] = r[i].f[2];
+		d.f[i] = r[i].f[3];
+	}
+}
+#endif
@@ -29,6 +29,15 @@ CBaseModelInfo::Shutdown(void)
 	m_txdSlot = -1;
 }
 
+#ifdef HASHED_NAME_LOOKUP
+void
+CBaseModelInfo::SetModelName(const char *name)
+{
+	strncpy(m_name, name, MAX_MODEL_NAME);
+	CModelInfo::InvalidateNameIndex();
+}
+#endif
+
 void
 CBaseModelInfo::DeleteCollisionModel(void)
 {
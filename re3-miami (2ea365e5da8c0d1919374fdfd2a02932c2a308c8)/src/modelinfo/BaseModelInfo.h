@@ -51,7 +51,11 @@ public:
 	bool IsSimple(void) { return m_type == MITYPE_SIMPLE || m_type == MITYPE_TIME || m_type == MITYPE_WEAPON; }
 	bool IsClump(void) { return m_type == MITYPE_CLUMP || m_type == MITYPE_PED || m_type == MITYPE_VEHICLE;	}
 	char *GetModelName(void) { return m_name; }
+#ifdef HASHED_NAME_LOOKUP
+	void SetModelName(const char *name);
+#else
 	void SetModelName(const char *name) { strncpy(m_name, name, MAX_MODEL_NAME); }
+#endif
 	void SetColModel(CColModel *col, bool owns = false){
 		m_colModel = col; m_bOwnsColModel = owns; }
 	CColModel *GetColModel(void) { return m_colModel; }
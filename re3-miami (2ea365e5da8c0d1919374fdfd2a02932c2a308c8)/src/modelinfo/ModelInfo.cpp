@@ -14,6 +14,10 @@ CStore<CClumpModelInfo, CLUMPMODELSIZE> CModelInfo::ms_clumpModelStore;
 CStore<CPedModelInfo, PEDMODELSIZE> CModelInfo::ms_pedModelStore;
 CStore<CVehicleModelInfo, VEHICLEMODELSIZE> CModelInfo::ms_vehicleModelStore;
 CStore<C2dEffect, TWODFXSIZE> CModelInfo::ms_2dEffectStore;
+#ifdef HASHED_NAME_LOOKUP
+CNameIndex CModelInfo::ms_nameIndex;
+bool CModelInfo::ms_bNameIndexDirty = true;
+#endif
 
 void
 CModelInfo::Initialise(void)
@@ -31,6 +35,9 @@ CModelInfo::Initialise(void)
 
 	for(i = 0; i < MODELINFOSIZE; i++)
 		ms_modelInfoPtrs[i] = nil;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	ms_2dEffectStore.Clear();
 	ms_simpleModelStore.Clear();
 	ms_timeModelStore.Clear();
@@ -122,6 +129,9 @@ CModelInfo::AddSimpleModel(int id)
 	CSimpleModelInfo *modelinfo;
 	modelinfo = CModelInfo::ms_simpleModelStore.Alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	modelinfo->Init();
 	return modelinfo;
 }
@@ -132,6 +142,9 @@ CModelInfo::AddTimeModel(int id)
 	CTimeModelInfo *modelinfo;
 	modelinfo = CModelInfo::ms_timeModelStore.Alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	modelinfo->Init();
 	return modelinfo;
 }
@@ -142,6 +155,9 @@ CModelInfo::AddWeaponModel(int id)
 	CWeaponModelInfo *modelinfo;
 	modelinfo = CModelInfo::ms_weaponModelStore.Alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	modelinfo->Init();
 	return modelinfo;
 }
@@ -152,6 +168,9 @@ CModelInfo::AddClumpModel(int id)
 	CClumpModelInfo *modelinfo;
 	modelinfo = CModelInfo::ms_clumpModelStore.Alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	modelinfo->m_clump = nil;
 	return modelinfo;
 }
@@ -162,6 +181,9 @@ CModelInfo::AddPedModel(int id)
 	CPedModelInfo *modelinfo;
 	modelinfo = CModelInfo::ms_pedModelStore.Alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	modelinfo->m_clump = nil;
 	return modelinfo;
 }
@@ -172,6 +194,9 @@ CModelInfo::AddVehicleModel(int id)
 	CVehicleModelInfo *modelinfo;
 	modelinfo = CModelInfo::ms_vehicleModelStore.Alloc();
 	CModelInfo::ms_modelInfoPtrs[id] = modelinfo;
+#ifdef HASHED_NAME_LOOKUP
+	InvalidateNameIndex();
+#endif
 	modelinfo->m_clump = nil;
 	modelinfo->m_vehicleType = -1;
 	modelinfo->m_wheelId = -1;
@@ -181,9 +206,31 @@ CModelInfo::AddVehicleModel(int id)
 	return modelinfo;
 }
 
+#ifdef HASHED_NAME_LOOKUP
+void
+CModelInfo::UpdateNameIndex(void)
+{
+	ms_nameIndex.Clear();
+	for(int i = 0; i < MODELINFOSIZE; i++)
+		if(ms_modelInfoPtrs[i])
+			ms_nameIndex.Add(ms_modelInfoPtrs[i]->GetModelName(), i);
+	ms_bNameIndexDirty = false;
+}
+#endif
+
 CBaseModelInfo*
 CModelInfo::GetModelInfo(const char *name, int *id)
 {
+#ifdef HASHED_NAME_LOOKUP
+	if(ms_bNameIndexDirty)
+		UpdateNameIndex();
+	int i = ms_nameIndex.Find(name);
+	if(i == -1)
+		return nil;
+	if(id)
+		*id = i;
+	return ms_modelInfoPtrs[i];
+#else
 	CBaseModelInfo *modelinfo;
 	for(int i = 0; i < MODELINFOSIZE; i++){
 		modelinfo = CModelInfo::ms_modelInfoPtrs[i];
@@ -194,6 +241,7 @@ CModelInfo::GetModelInfo(const char *name, int *id)
 		}
 	}
 	return nil;
+#endif
 }
 
 CBaseModelInfo*
@@ -202,6 +250,12 @@ CModelInfo::GetModelInfo(const char *name, int minIndex, int maxIndex)
 	if (minIndex > maxIndex)
 		return 0;
 
+#ifdef HASHED_NAME_LOOKUP
+	if(ms_bNameIndexDirty)
+		UpdateNameIndex();
+	int i = ms_nameIndex.Find(name, minIndex, maxIndex);
+	return i == -1 ? nil : ms_modelInfoPtrs[i];
+#else
 	CBaseModelInfo *modelinfo;
 	for(int i = minIndex; i <= maxIndex; i++){
 		modelinfo = CModelInfo::ms_modelInfoPtrs[i];
@@ -209,6 +263,7 @@ CModelInfo::GetModelInfo(const char *name, int minIndex, int maxIndex)
 			return modelinfo;
 	}
 	return nil;
+#endif
 }
 
 bool
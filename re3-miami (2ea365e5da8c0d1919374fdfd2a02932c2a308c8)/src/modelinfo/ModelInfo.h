@@ -8,6 +8,9 @@
 #include "PedModelInfo.h"
 #include "VehicleModelInfo.h"
 #include "templates.h"
+#ifdef HASHED_NAME_LOOKUP
+#include "NameIndex.h"
+#endif
 
 class CModelInfo
 {
@@ -19,6 +22,12 @@ class CModelInfo
 	static CStore<CPedModelInfo, PEDMODELSIZE> ms_pedModelStore;
 	static CStore<CVehicleModelInfo, VEHICLEMODELSIZE> ms_vehicleModelStore;
 	static CStore<C2dEffect, TWODFXSIZE> ms_2dEffectStore;
+#ifdef HASHED_NAME_LOOKUP
+	// rebuilt on the next lookup after models were added or renamed
+	static CNameIndex ms_nameIndex;
+	static bool ms_bNameIndexDirty;
+	static void UpdateNameIndex(void);
+#endif
 
 public:
 	static void Initialise(void);
@@ -45,4 +54,7 @@ public:
 	static bool IsHeliModel(int32 id);
 	static bool IsPlaneModel(int32 id);
 	static void ReInit2dEffects();
+#ifdef HASHED_NAME_LOOKUP
+	static void InvalidateNameIndex(void) { ms_bNameIndexDirty = true; }
+#endif
 };
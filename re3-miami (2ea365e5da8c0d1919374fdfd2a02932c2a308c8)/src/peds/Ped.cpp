@@ -475,8 +475,14 @@ CPed::BuildPedLists(void)
 
 		for(int y = ystart; y <= yend; y++) {
 			for(int x = xstart; x <= xend; x++) {
+#ifdef SECTOR_ENTITY_ARRAYS
+				CSectorArray *peds = CWorld::GetSectorArray(&CWorld::GetSector(x,y)->m_lists[ENTITYLIST_PEDS]);
+				for (int i = 0; i < peds->m_numEntries; i++) {
+					CPed *ped = (CPed*)peds->m_entries[i].entity;
+#else
 				for (CPtrNode *pedPtrNode = CWorld::GetSector(x,y)->m_lists[ENTITYLIST_PEDS].first; pedPtrNode; pedPtrNode = pedPtrNode->next) {
 					CPed *ped = (CPed*)pedPtrNode->item;
+#endif
 					if (ped != this && (!ped->bInVehicle || (ped->m_pMyVehicle && ped->m_pMyVehicle->IsBike()))) {
 
 						if (nThreatReactionRangeMultiplier * 30.0f > (ped->GetPosition() - GetPosition()).Magnitude2D()) {
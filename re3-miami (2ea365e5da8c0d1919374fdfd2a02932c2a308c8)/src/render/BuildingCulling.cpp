@@ -0,0 +1,248 @@
+#include "common.h"
+
+#ifdef SIMD_FRUSTUM_CULLING
+#include "Timer.h"
+#include "General.h"
+#include "Camera.h"
+#include "Draw.h"
+#include "Pools.h"
+#include "World.h"
+#include "Building.h"
+#include "ModelInfo.h"
+#include "Renderer.h"
+#include "Simd4.h"
+#include "BuildingCulling.h"
+
+#define CULL_MARGIN 1.0f	// rounding between the squared and the real distance
+
+float CBuildingCulling::ms_aCentreX[NUMCULLSLOTS];
+float CBuildingCulling::ms_aCentreY[NUMCULLSLOTS];
+float CBuildingCulling::ms_aCentreZ[NUMCULLSLOTS];
+float CBuildingCulling::ms_aRadius[NUMCULLSLOTS];
+float CBuildingCulling::ms_aPosX[NUMCULLSLOTS];
+float CBuildingCulling::ms_aPosY[NUMCULLSLOTS];
+float CBuildingCulling::ms_aPosZ[NUMCULLSLOTS];
+float CBuildingCulling::ms_aLodDistance[NUMCULLSLOTS];
+uint8 CBuildingCulling::ms_aResults[NUMCULLSLOTS];
+bool CBuildingCulling::ms_bBuilt;
+bool CBuildingCulling::ms_bResultsValid;
+bool CBuildingCulling::ms_bEnabled = true;
+
+// SetupEntityVisibility takes these through the simple model path without side effects
+// once they're too far away. Time objects fade their model info even then.
+static bool
+IsCullable(CEntity *e)
+{
+	CBaseModelInfo *mi = CModelInfo::GetModelInfo(e->GetModelIndex());
+	return !e->bIsBIGBuilding && !e->bDontStream && mi->GetModelType() == MITYPE_SIMPLE && mi->GetColModel();
+}
+
+// not what GetLargestLodDistance says, damaged atomics count too
+static float
+GetMaxLodDistance(CSimpleModelInfo *mi)
+{
+	int i;
+	float d = 0.0f;
+	for(i = 0; i < mi->m_numAtomics; i++)
+		d = Max(d, mi->m_lodDistances[i]);
+	return d;
+}
+
+void
+CBuildingCulling::ClearSlot(int32 i)
+{
+	ms_aCentreX[i] = ms_aCentreY[i] = ms_aCentreZ[i] = 0.0f;
+	ms_aPosX[i] = ms_aPosY[i] = ms_aPosZ[i] = 0.0f;
+	ms_aLodDistance[i] = 0.0f;
+	ms_aRadius[i] = -1.0f;
+	ms_aResults[i] = 0;
+}
+
+void
+CBuildingCulling::Build(void)
+{
+	int32 i, x, y;
+	CPtrNode *node;
+
+	for(i = 0; i < NUMCULLSLOTS; i++)
+		ClearSlot(i);
+	ms_bBuilt = true;
+	// buildings spanning several sectors are in the overlap lists of all of them
+	for(y = 0; y < NUMSECTORS_Y; y++)
+		for(x = 0; x < NUMSECTORS_X; x++){
+			for(node = CWorld::GetSector(x, y)->m_lists[ENTITYLIST_BUILDINGS].first; node; node = node->next)
+				AddBuilding((CEntity*)node->item);
+			for(node = CWorld::GetSector(x, y)->m_lists[ENTITYLIST_BUILDINGS_OVERLAP].first; node; node = node->next)
+				AddBuilding((CEntity*)node->item);
+		}
+}
+
+void
+CBuildingCulling::Shutdown(void)
+{
+	ms_bBuilt = false;
+	ms_bResultsValid = false;
+}
+
+void
+CBuildingCulling::AddBuilding(CEntity *entity)
+{
+	if(!ms_bBuilt || !IsCullable(entity))
+		return;
+	int32 i = CPools::GetBuildingPool()->GetJustIndex((CBuilding*)entity);
+	CVector centre = entity->GetBoundCentre();
+	ms_aCentreX[i] = centre.x;
+	ms_aCentreY[i] = centre.y;
+	ms_aCentreZ[i] = centre.z;
+	ms_aRadius[i] = entity->GetBoundRadius();
+	ms_aPosX[i] = entity->GetPosition().x;
+	ms_aPosY[i] = entity->GetPosition().y;
+	ms_aPosZ[i] = entity->GetPosition().z;
+	ms_aLodDistance[i] = GetMaxLodDistance((CSimpleModelInfo*)CModelInfo::GetModelInfo(entity->GetModelIndex()));
+	ms_aResults[i] = 0;
+}
+
+void
+CBuildingCulling::RemoveBuilding(CEntity *entity)
+{
+	if(ms_bBuilt)
+		ClearSlot(CPools::GetBuildingPool()->GetJustIndex_NoFreeAssert((CBuilding*)entity));
+}
+
+// CCamera::IsSphereVisible and the distance check of SetupEntityVisibility
+// for all slots, two vectors of four per iteration
+void
+CBuildingCulling::Classify(const CMatrix &camMatrix, const CVector &camPos, uint8 *results)
+{
+	int32 i, j, l;
+	const CVector *normals = TheCamera.m_vecFrustumNormals;
+	vfloat rx = Splat(camMatrix.rx), ry = Splat(camMatrix.ry), rz = Splat(camMatrix.rz);
+	vfloat fx = Splat(camMatrix.fx), fy = Splat(camMatrix.fy), fz = Splat(camMatrix.fz);
+	vfloat ux = Splat(camMatrix.ux), uy = Splat(camMatrix.uy), uz = Splat(camMatrix.uz);
+	vfloat px = Splat(camMatrix.px), py = Splat(camMatrix.py), pz = Splat(camMatrix.pz);
+	vfloat nearZ = Splat(CDraw::GetNearClipZ());
+	vfloat farZ = Splat(CDraw::GetFarClipZ());
+	vfloat n0x = Splat(normals[0].x), n0y = Splat(normals[0].y);
+	vfloat n1x = Splat(normals[1].x), n1y = Splat(normals[1].y);
+	vfloat n2y = Splat(normals[2].y), n2z = Splat(normals[2].z);
+	vfloat n3y = Splat(normals[3].y), n3z = Splat(normals[3].z);
+	vfloat camX = Splat(camPos.x), camY = Splat(camPos.y), camZ = Splat(camPos.z);
+	vfloat lodMult = Splat(TheCamera.LODDistMultiplier);
+	vfloat extraDist = Splat(FADE_DISTANCE + STREAM_DISTANCE + CULL_MARGIN);
+	vfloat zero = Splat(0.0f);
+
+	for(i = 0; i < NUMCULLSLOTS; i += 8)
+		for(j = i; j < i+8; j += 4){
+			vfloat x = Load(&ms_aCentreX[j]);
+			vfloat y = Load(&ms_aCentreY[j]);
+			vfloat z = Load(&ms_aCentreZ[j]);
+			vfloat r = Load(&ms_aRadius[j]);
+
+			// to camera space
+			vfloat cx = Add(Add(Add(Mul(rx, x), Mul(fx, y)), Mul(ux, z)), px);
+			vfloat cy = Add(Add(Add(Mul(ry, x), Mul(fy, y)), Mul(uy, z)), py);
+			vfloat cz = Add(Add(Add(Mul(rz, x), Mul(fz, y)), Mul(uz, z)), pz);
+			vmask outside = Or(CmpLt(Add(cy, r), nearZ), CmpGt(Sub(cy, r), farZ));
+			outside = Or(outside, CmpGt(Add(Mul(cx, n0x), Mul(cy, n0y)), r));
+			outside = Or(outside, CmpGt(Add(Mul(cx, n1x), Mul(cy, n1y)), r));
+			outside = Or(outside, CmpGt(Add(Mul(cy, n2y), Mul(cz, n2z)), r));
+			outside = Or(outside, CmpGt(Add(Mul(cy, n3y), Mul(cz, n3z)), r));
+
+			vfloat dx = Sub(Load(&ms_aPosX[j]), camX);
+			vfloat dy = Sub(Load(&ms_aPosY[j]), camY);
+			vfloat dz = Sub(Load(&ms_aPosZ[j]), camZ);
+			vfloat distSq = Add(Add(Mul(dx, dx), Mul(dy, dy)), Mul(dz, dz));
+			vfloat maxDist = Add(Mul(Load(&ms_aLodDistance[j]), lodMult), extraDist);
+			vmask far = CmpGt(distSq, Mul(maxDist, maxDist));
+
+			int32 used = MoveMask(CmpGe(r, zero));
+			int32 onScreen = ~MoveMask(outside);
+			int32 isFar = MoveMask(far);
+			for(l = 0; l < 4; l++)
+				results[j+l] = used & 1<<l ?
+					BUILDINGCULL_CLASSIFIED | (onScreen & 1<<l ? BUILDINGCULL_ONSCREEN : 0) | (isFar & 1<<l ? BUILDINGCULL_FAR : 0) :
+					0;
+		}
+}
+
+void
+CBuildingCulling::ClassifyForFrame(void)
+{
+	ms_bResultsValid = ms_bEnabled && ms_bBuilt;
+	if(ms_bResultsValid)
+		Classify(TheCamera.GetCameraMatrix(), TheCamera.GetPosition(), ms_aResults);
+}
+
+// 0 for anything the kernel didn't look at this frame
+int32
+CBuildingCulling::GetResult(CEntity *entity)
+{
+	if(!ms_bResultsValid || !entity->IsBuilding())
+		return 0;
+	return ms_aResults[CPools::GetBuildingPool()->GetJustIndex_NoFreeAssert((CBuilding*)entity)];
+}
+
+#define BENCH_STEPS 100
+
+// Flies a camera across the map and classifies all buildings at every step,
+// once with the kernel and once the way SetupEntityVisibility does it
+void
+CBuildingCulling::Benchmark(void)
+{
+	static uint8 results[NUMCULLSLOTS];
+	int32 i, step;
+	int32 numBuildings = 0, numOnScreenErrors = 0, numCullErrors = 0;
+	uint32 simdCycles = 0, scalarCycles = 0;
+	uint32 start;
+	CVector pathStart(-1000.0f, -1300.0f, 60.0f);
+	CVector pathEnd(600.0f, 1400.0f, 60.0f);
+
+	if(!ms_bBuilt)
+		Build();
+	for(i = 0; i < CPools::GetBuildingPool()->GetSize(); i++)
+		if(ms_aRadius[i] >= 0.0f)
+			numBuildings++;
+
+	for(step = 0; step < BENCH_STEPS; step++){
+		CMatrix cam, camInv;
+		CVector pos = pathStart + (pathEnd - pathStart)*((float)step/BENCH_STEPS);
+		float heading = step * TWOPI / BENCH_STEPS;
+		CVector fwd(Sin(heading), Cos(heading), -0.2f);
+		fwd.Normalise();
+		CVector right = CrossProduct(fwd, CVector(0.0f, 0.0f, 1.0f));
+		right.Normalise();
+		cam.SetUnity();
+		cam.GetRight() = right;
+		cam.GetForward() = fwd;
+		cam.GetUp() = CrossProduct(right, fwd);
+		cam.GetPosition() = pos;
+		Invert(cam, camInv);
+
+		start = CTimer::GetCurrentTimeInCycles();
+		Classify(camInv, pos, results);
+		simdCycles += CTimer::GetCurrentTimeInCycles() - start;
+
+		start = CTimer::GetCurrentTimeInCycles();
+		for(i = 0; i < CPools::GetBuildingPool()->GetSize(); i++){
+			CBuilding *b = CPools::GetBuildingPool()->GetSlot(i);
+			if(b == nil || ms_aRadius[i] < 0.0f)
+				continue;
+			CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(b->GetModelIndex());
+			bool onScreen = TheCamera.IsSphereVisible(b->GetBoundCentre(), b->GetBoundRadius(), &camInv);
+			float dist = (b->GetPosition() - pos).Magnitude();
+			bool mayBeDrawn = dist - FADE_DISTANCE - STREAM_DISTANCE < mi->GetLargestLodDistance();
+			if(onScreen != !!(results[i] & BUILDINGCULL_ONSCREEN))
+				numOnScreenErrors++;
+			if(mayBeDrawn && results[i] & BUILDINGCULL_FAR)
+				numCullErrors++;
+		}
+		scalarCycles += CTimer::GetCurrentTimeInCycles() - start;
+	}
+
+	debug("Building culling: %d buildings, %d camera positions, SIMD %.3f ms, scalar %.3f ms per frame\n",
+		numBuildings, BENCH_STEPS,
+		simdCycles / CTimer::GetCyclesPerMillisecond() / BENCH_STEPS,
+		scalarCycles / CTimer::GetCyclesPerMillisecond() / BENCH_STEPS);
+	debug("Building culling: %d on-screen mismatches, %d culled that could be drawn\n", numOnScreenErrors, numCullErrors);
+}
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+class CEntity;
+class CMatrix;
+
+#define NUMCULLSLOTS ((NUMBUILDINGS+7)&~7)
+
+enum {
+	BUILDINGCULL_CLASSIFIED = 1,	// nothing below is known otherwise
+	BUILDINGCULL_ONSCREEN = 2,	// what GetIsOnScreen would say
+	BUILDINGCULL_FAR = 4,	// too far for any of its atomics or a streaming request
+};
+
+// Bounding spheres, positions and LOD distances of the buildings in the sector
+// lists, packed by building pool slot once the level is loaded. Each frame they're
+// classified against the camera eight at a time before ScanWorld looks at them, so
+// SetupEntityVisibility only does the frustum test and distance check for the ones
+// that aren't in here (time objects, clumps, bDontStream and big buildings).
+
+class CBuildingCulling
+{
+	static float ms_aCentreX[NUMCULLSLOTS];
+	static float ms_aCentreY[NUMCULLSLOTS];
+	static float ms_aCentreZ[NUMCULLSLOTS];
+	static float ms_aRadius[NUMCULLSLOTS];	// negative for empty slots
+	static float ms_aPosX[NUMCULLSLOTS];
+	static float ms_aPosY[NUMCULLSLOTS];
+	static float ms_aPosZ[NUMCULLSLOTS];
+	static float ms_aLodDistance[NUMCULLSLOTS];
+	static uint8 ms_aResults[NUMCULLSLOTS];
+	static bool ms_bBuilt;
+	static bool ms_bResultsValid;
+
+	static void ClearSlot(int32 i);
+	static void Classify(const CMatrix &camMatrix, const CVector &camPos, uint8 *results);
+public:
+	static bool ms_bEnabled;
+
+	static void Build(void);
+	static void Shutdown(void);
+	static void AddBuilding(CEntity *entity);
+	static void RemoveBuilding(CEntity *entity);
+
+	static void ClassifyForFrame(void);
+	static int32 GetResult(CEntity *entity);
+
+	static void Benchmark(void);
+};
@@ -243,11 +243,39 @@ CCoronas::UpdateCoronaCoors(uint32 id, const CVector &coors, float drawDist, flo
 
 static RwIm2DVertex vertexbufferX[2];
 
+static void
+AddStreakPoint(CRegisteredCorona &corona, float x, float y)
+{
+	// add new streak point
+	if(corona.sightClear){
+		corona.prevX[0] = x;
+		corona.prevY[0] = y;
+		corona.prevRed[0] = corona.red;
+		corona.prevGreen[0] = corona.green;
+		corona.prevBlue[0] = corona.blue;
+		corona.hasValue[0] = true;
+	}
+
+	// if distance too big, break streak
+	if(corona.hasValue[1]){
+		if(Abs(corona.prevX[0] - corona.prevX[1]) > 50.0f ||
+		   Abs(corona.prevY[0] - corona.prevY[1]) > 50.0f)
+			corona.hasValue[0] = false;
+	}
+}
+
 void
 CCoronas::Render(void)
 {
 	int i, j;
 	int screenw, screenh;
+#ifdef BATCHED_LINE_OF_SIGHT
+	// line of sight checks that are due are done together after the loop
+	static CWorldRay losRays[NUMCORONAS];
+	static int16 losCoronas[NUMCORONAS];
+	static CVector2D losCoors[NUMCORONAS];
+	int numLOS = 0;
+#endif
 
 	screenw = RwRasterGetWidth(RwCameraGetRaster(Scene.camera));
 	screenh = RwRasterGetHeight(RwCameraGetRaster(Scene.camera));
@@ -287,27 +315,21 @@ CCoronas::Render(void)
 			}else{
 				if(CTimer::GetTimeInMilliseconds() > aCoronas[i].lastLOScheck + 2000){
 					aCoronas[i].lastLOScheck = CTimer::GetTimeInMilliseconds();
+#ifdef BATCHED_LINE_OF_SIGHT
+					losRays[numLOS].start = aCoronas[i].coors;
+					losRays[numLOS].end = TheCamera.Cams[TheCamera.ActiveCam].Source;
+					losCoronas[numLOS] = i;
+					losCoors[numLOS] = CVector2D(spriteCoors.x, spriteCoors.y);
+					numLOS++;
+				}else
+					AddStreakPoint(aCoronas[i], spriteCoors.x, spriteCoors.y);
+#else
 					aCoronas[i].sightClear = CWorld::GetIsLineOfSightClear(
 						aCoronas[i].coors, TheCamera.Cams[TheCamera.ActiveCam].Source,
 						true, true, false, false, false, true, false);
 				}
-			
-				// add new streak point
-				if(aCoronas[i].sightClear){
-					aCoronas[i].prevX[0] = spriteCoors.x;
-					aCoronas[i].prevY[0] = spriteCoors.y;
-					aCoronas[i].prevRed[0] = aCoronas[i].red;
-					aCoronas[i].prevGreen[0] = aCoronas[i].green;
-					aCoronas[i].prevBlue[0] = aCoronas[i].blue;
-					aCoronas[i].hasValue[0] = true;
-				}
-			
-				// if distance too big, break streak
-				if(aCoronas[i].hasValue[1]){
-					if(Abs(aCoronas[i].prevX[0] - aCoronas[i].prevX[1]) > 50.0f ||
-					   Abs(aCoronas[i].prevY[0] - aCoronas[i].prevY[1]) > 50.0f)
-						aCoronas[i].hasValue[0] = false;
-				}
+				AddStreakPoint(aCoronas[i], spriteCoors.x, spriteCoors.y);
+#endif
 			}
 
 
@@ -390,6 +412,17 @@ CCoronas::Render(void)
 		}
 	}
 
+#ifdef BATCHED_LINE_OF_SIGHT
+	if(numLOS > 0){
+		CWorld::GetIsLinesOfSightClearBatch(losRays, numLOS, true, true, false, false, false, true, false);
+		for(j = 0; j < numLOS; j++){
+			CRegisteredCorona &corona = aCoronas[losCoronas[j]];
+			corona.sightClear = !losRays[j].hit;
+			AddStreakPoint(corona, losCoors[j].x, losCoors[j].y);
+		}
+	}
+#endif
+
 	RwRenderStateSet(rwRENDERSTATEZWRITEENABLE, (void*)FALSE);
 	RwRenderStateSet(rwRENDERSTATEZTESTENABLE, (void*)FALSE);
 	RwRenderStateSet(rwRENDERSTATEVERTEXALPHAENABLE, (void*)TRUE);
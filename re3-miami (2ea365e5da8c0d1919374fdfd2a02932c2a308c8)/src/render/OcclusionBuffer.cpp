@@ -0,0 +1,423 @@
+#include "common.h"
+
+#ifdef SOFTWARE_OCCLUSION
+#include "main.h"
+#include "Game.h"
+#include "Camera.h"
+#include "Draw.h"
+#include "Font.h"
+#include "Sprite2d.h"
+#include "RwHelper.h"
+#include "Entity.h"
+#include "World.h"
+#include "ModelInfo.h"
+#include "Clock.h"
+#include "SurfaceTable.h"
+#include "OcclusionBuffer.h"
+
+#define OCCBUF_NEAR 1.0f	// occluders are clipped here, nothing nearer is tested
+#define OCCBUF_EMPTY 100000.0f
+#define OCCBUF_DEPTH_BIAS 0.5f	// entities have to be this far behind to be hidden
+#define MAXOCCLUDERCANDIDATES 256
+
+float COcclusionBuffer::ms_aDepth[OCCBUF_HEIGHT][OCCBUF_WIDTH];
+float COcclusionBuffer::ms_aTileMax[OCCBUF_TILES_Y][OCCBUF_TILES_X];
+CEntity *COcclusionBuffer::ms_apOccluders[MAXOCCLUDERS];
+bool COcclusionBuffer::ms_bValid;
+bool COcclusionBuffer::ms_bEnabled = true;
+bool COcclusionBuffer::ms_bShowBuffer;
+float COcclusionBuffer::ms_fOccluderRange = 150.0f;
+float COcclusionBuffer::ms_fMinOccluderRadius = 12.0f;
+int32 COcclusionBuffer::ms_numOccluders;
+int32 COcclusionBuffer::ms_numTriangles;
+int32 COcclusionBuffer::ms_numTested;
+int32 COcclusionBuffer::ms_numCulled;
+
+// View window of this frame. TheCamera.m_viewMatrix is only updated once the
+// RW camera begins its update, after the render list is made.
+static float viewWindowX;
+static float viewWindowY;
+
+struct OccluderCandidate
+{
+	CEntity *entity;
+	float score;
+};
+static OccluderCandidate aCandidates[MAXOCCLUDERCANDIDATES];
+static int32 numCandidates;
+
+// Camera space has x to the left, y into the screen and z up.
+// Buffer x and y are in pixels, z is the reciprocal depth which is linear on screen.
+static void
+Project(const CVector &v, CVector &out)
+{
+	out.x = OCCBUF_WIDTH/2.0f * (1.0f - v.x/(v.y*viewWindowX));
+	out.y = OCCBUF_HEIGHT/2.0f * (1.0f - v.z/(v.y*viewWindowY));
+	out.z = 1.0f/v.y;
+}
+
+void
+COcclusionBuffer::Clear(void)
+{
+	int i;
+	for(i = 0; i < OCCBUF_WIDTH*OCCBUF_HEIGHT; i++)
+		ms_aDepth[0][i] = OCCBUF_EMPTY;
+}
+
+// Pixels the triangle covers completely take its farthest depth over them if that's nearer.
+// Being conservative means the buffer never hides more than the occluders do on screen.
+void
+COcclusionBuffer::RasteriseTriangle(const CVector *v)
+{
+	int i, j;
+	CVector v0 = v[0];
+	CVector v1 = v[1];
+	CVector v2 = v[2];
+
+	float area = (v1.x - v0.x)*(v2.y - v0.y) - (v1.y - v0.y)*(v2.x - v0.x);
+	if(Abs(area) < 0.0001f)
+		return;
+	// both sides are drawn
+	if(area < 0.0f){
+		CVector tmp = v1;
+		v1 = v2;
+		v2 = tmp;
+		area = -area;
+	}
+
+	int i0 = Max((int)Ceil(Min(v0.x, Min(v1.x, v2.x)) - 0.5f), 0);
+	int i1 = Min((int)Floor(Max(v0.x, Max(v1.x, v2.x)) - 0.5f), OCCBUF_WIDTH-1);
+	int j0 = Max((int)Ceil(Min(v0.y, Min(v1.y, v2.y)) - 0.5f), 0);
+	int j1 = Min((int)Floor(Max(v0.y, Max(v1.y, v2.y)) - 0.5f), OCCBUF_HEIGHT-1);
+	if(i0 > i1 || j0 > j1)
+		return;
+
+	// edge functions, each is the weight of the opposite vertex times the area
+	float dx0 = v1.y - v2.y, dy0 = v2.x - v1.x;
+	float dx1 = v2.y - v0.y, dy1 = v0.x - v2.x;
+	float dx2 = v0.y - v1.y, dy2 = v1.x - v0.x;
+	float px = i0 + 0.5f;
+	float py = j0 + 0.5f;
+	float r0 = (px - v1.x)*dx0 + (py - v1.y)*dy0;
+	float r1 = (px - v2.x)*dx1 + (py - v2.y)*dy1;
+	float r2 = (px - v0.x)*dx2 + (py - v0.y)*dy2;
+	float invArea = 1.0f/area;
+	// an edge function is smallest at one of the pixel's corners, this much below the centre
+	float o0 = 0.5f*(Abs(dx0) + Abs(dy0));
+	float o1 = 0.5f*(Abs(dx1) + Abs(dy1));
+	float o2 = 0.5f*(Abs(dx2) + Abs(dy2));
+	// and the same for the reciprocal depth, the farthest point of the pixel
+	float oz = 0.5f*(Abs(dx0*v0.z + dx1*v1.z + dx2*v2.z) + Abs(dy0*v0.z + dy1*v1.z + dy2*v2.z))*invArea;
+
+	for(j = j0; j <= j1; j++){
+		float e0 = r0, e1 = r1, e2 = r2;
+		for(i = i0; i <= i1; i++){
+			if(e0 >= o0 && e1 >= o1 && e2 >= o2){
+				float invDepth = (e0*v0.z + e1*v1.z + e2*v2.z)*invArea - oz;
+				if(invDepth > 0.0f){
+					float depth = 1.0f/invDepth;
+					if(depth < ms_aDepth[j][i])
+						ms_aDepth[j][i] = depth;
+				}
+			}
+			e0 += dx0;
+			e1 += dx1;
+			e2 += dx2;
+		}
+		r0 += dy0;
+		r1 += dy1;
+		r2 += dy2;
+	}
+}
+
+// Camera space triangle, clipped against the near plane
+void
+COcclusionBuffer::DrawTriangle(const CVector &a, const CVector &b, const CVector &c)
+{
+	int i, n;
+	CVector in[3] = { a, b, c };
+	CVector clipped[4];
+	CVector projected[4];
+
+	n = 0;
+	for(i = 0; i < 3; i++){
+		const CVector &cur = in[i];
+		const CVector &next = in[(i+1)%3];
+		bool curIn = cur.y >= OCCBUF_NEAR;
+		bool nextIn = next.y >= OCCBUF_NEAR;
+		if(curIn)
+			clipped[n++] = cur;
+		if(curIn != nextIn)
+			clipped[n++] = cur + (next - cur)*((OCCBUF_NEAR - cur.y)/(next.y - cur.y));
+	}
+	if(n < 3)
+		return;
+
+	for(i = 0; i < n; i++)
+		Project(clipped[i], projected[i]);
+	RasteriseTriangle(projected);
+	if(n == 4){
+		projected[1] = projected[0];
+		RasteriseTriangle(&projected[1]);
+	}
+}
+
+void
+COcclusionBuffer::DrawOccluder(CEntity *entity)
+{
+	static const int boxTriangles[12][3] = {
+		{ 0, 1, 3 }, { 0, 3, 2 },	// bottom
+		{ 4, 6, 7 }, { 4, 7, 5 },	// top
+		{ 0, 4, 5 }, { 0, 5, 1 },	// back
+		{ 2, 3, 7 }, { 2, 7, 6 },	// front
+		{ 0, 2, 6 }, { 0, 6, 4 },	// left
+		{ 1, 5, 7 }, { 1, 7, 3 }	// right
+	};
+	int i, j;
+	CColModel *colModel = CModelInfo::GetModelInfo(entity->GetModelIndex())->GetColModel();
+	CMatrix mat = TheCamera.m_cameraMatrix * entity->GetMatrix();
+
+	// glass and fences are collision you can see through
+	for(i = 0; i < colModel->numTriangles; i++){
+		CColTriangle *tri = &colModel->triangles[i];
+		if(IsSeeThrough(tri->surface))
+			continue;
+		if(ms_numTriangles >= MAXOCCLUDERTRIANGLES)
+			return;
+		DrawTriangle(mat * colModel->vertices[tri->a].Get(),
+			mat * colModel->vertices[tri->b].Get(),
+			mat * colModel->vertices[tri->c].Get());
+		ms_numTriangles++;
+	}
+
+	for(i = 0; i < colModel->numBoxes; i++){
+		CColBox *box = &colModel->boxes[i];
+		if(IsSeeThrough(box->surface))
+			continue;
+		if(ms_numTriangles + 12 > MAXOCCLUDERTRIANGLES)
+			return;
+		CVector corners[8];
+		for(j = 0; j < 8; j++)
+			corners[j] = mat * CVector(j & 1 ? box->max.x : box->min.x,
+				j & 2 ? box->max.y : box->min.y,
+				j & 4 ? box->max.z : box->min.z);
+		for(j = 0; j < 12; j++)
+			DrawTriangle(corners[boxTriangles[j][0]], corners[boxTriangles[j][1]], corners[boxTriangles[j][2]]);
+		ms_numTriangles += 12;
+	}
+}
+
+static void
+ConsiderOccluder(CEntity *entity)
+{
+	if(entity->m_scanCode == CWorld::GetCurrentScanCode())
+		return;
+	entity->m_scanCode = CWorld::GetCurrentScanCode();
+
+	// only what's actually drawn, LODs are never in front of anything
+	if(entity->m_rwObject == nil || !entity->bIsVisible || !entity->bUsesCollision || entity->bIsBIGBuilding ||
+	   !IsAreaVisible(entity->m_area))
+		return;
+	// RW objects outlive the draw distance, the hours of time objects and fading
+	CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(entity->GetModelIndex());
+	if(mi->GetModelType() != MITYPE_SIMPLE && mi->GetModelType() != MITYPE_TIME)
+		return;
+	if(mi->GetModelType() == MITYPE_TIME){
+		CTimeModelInfo *ti = (CTimeModelInfo*)mi;
+		if(!CClock::GetIsTimeInRange(ti->GetTimeOn(), ti->GetTimeOff()))
+			return;
+	}
+	if(mi->m_alpha != 255 ||
+	   (entity->GetPosition() - TheCamera.GetPosition()).Magnitude() >= mi->GetLargestLodDistance())
+		return;
+	CColModel *colModel = mi->GetColModel();
+	if(colModel == nil || (colModel->numTriangles == 0 && colModel->numBoxes == 0))
+		return;
+	float radius = entity->GetBoundRadius();
+	if(radius < COcclusionBuffer::ms_fMinOccluderRadius)
+		return;
+	float dist = (entity->GetBoundCentre() - TheCamera.GetPosition()).Magnitude();
+	if(dist - radius > COcclusionBuffer::ms_fOccluderRange || !entity->GetIsOnScreen())
+		return;
+
+	if(numCandidates == MAXOCCLUDERCANDIDATES)
+		return;
+	aCandidates[numCandidates].entity = entity;
+	aCandidates[numCandidates].score = radius / Max(dist, 1.0f);
+	numCandidates++;
+}
+
+static int
+CompareOccluderCandidates(const void *a, const void *b)
+{
+	float sa = ((OccluderCandidate*)a)->score;
+	float sb = ((OccluderCandidate*)b)->score;
+	return sa > sb ? -1 : sa < sb ? 1 : 0;
+}
+
+// The ones that look biggest from here
+void
+COcclusionBuffer::FindOccluders(void)
+{
+	int32 x, y, i;
+	CPtrNode *node;
+	CVector pos = TheCamera.GetPosition();
+	int32 x0 = Max(CWorld::GetSectorIndexX(pos.x - ms_fOccluderRange), 0);
+	int32 x1 = Min(CWorld::GetSectorIndexX(pos.x + ms_fOccluderRange), NUMSECTORS_X-1);
+	int32 y0 = Max(CWorld::GetSectorIndexY(pos.y - ms_fOccluderRange), 0);
+	int32 y1 = Min(CWorld::GetSectorIndexY(pos.y + ms_fOccluderRange), NUMSECTORS_Y-1);
+
+	numCandidates = 0;
+	CWorld::AdvanceCurrentScanCode();
+	for(y = y0; y <= y1; y++)
+		for(x = x0; x <= x1; x++){
+			for(node = CWorld::GetSector(x, y)->m_lists[ENTITYLIST_BUILDINGS].first; node; node = node->next)
+				ConsiderOccluder((CEntity*)node->item);
+			for(node = CWorld::GetSector(x, y)->m_lists[ENTITYLIST_BUILDINGS_OVERLAP].first; node; node = node->next)
+				ConsiderOccluder((CEntity*)node->item);
+		}
+
+	qsort(aCandidates, numCandidates, sizeof(OccluderCandidate), CompareOccluderCandidates);
+	ms_numOccluders = Min(numCandidates, MAXOCCLUDERS);
+	for(i = 0; i < ms_numOccluders; i++)
+		ms_apOccluders[i] = aCandidates[i].entity;
+}
+
+void
+COcclusionBuffer::BuildTiles(void)
+{
+	int i, j, tx, ty;
+	for(ty = 0; ty < OCCBUF_TILES_Y; ty++)
+		for(tx = 0; tx < OCCBUF_TILES_X; tx++){
+			float depth = 0.0f;
+			for(j = ty*OCCBUF_TILESIZE; j < (ty+1)*OCCBUF_TILESIZE; j++)
+				for(i = tx*OCCBUF_TILESIZE; i < (tx+1)*OCCBUF_TILESIZE; i++)
+					depth = Max(depth, ms_aDepth[j][i]);
+			ms_aTileMax[ty][tx] = depth;
+		}
+}
+
+void
+COcclusionBuffer::Update(void)
+{
+	int32 i;
+
+	ms_numOccluders = 0;
+	ms_numTriangles = 0;
+	ms_numTested = 0;
+	ms_numCulled = 0;
+	ms_bValid = false;
+	if(!ms_bEnabled)
+		return;
+
+	viewWindowX = SCREEN_VIEWWINDOW;
+	viewWindowY = viewWindowX / SCREEN_ASPECT_RATIO;
+
+	Clear();
+	FindOccluders();
+	for(i = 0; i < ms_numOccluders; i++)
+		DrawOccluder(ms_apOccluders[i]);
+	BuildTiles();
+	ms_bValid = ms_numTriangles > 0;
+}
+
+// true if every pixel the sphere could cover has something in front of it
+bool
+COcclusionBuffer::IsSphereOccluded(const CVector &centre, float radius)
+{
+	int i, j, tx, ty;
+
+	if(!ms_bValid)
+		return false;
+
+	CVector v = TheCamera.m_cameraMatrix * centre;
+	float nearDepth = v.y - radius;
+	float farDepth = v.y + radius;
+	if(nearDepth <= OCCBUF_NEAR)
+		return false;
+
+	// screen rect of the camera aligned box around the sphere, camera x is to the left
+	float left = Min(-(v.x + radius)/nearDepth, -(v.x + radius)/farDepth);
+	float right = Max(-(v.x - radius)/nearDepth, -(v.x - radius)/farDepth);
+	float top = Min(-(v.z + radius)/nearDepth, -(v.z + radius)/farDepth);
+	float bottom = Max(-(v.z - radius)/nearDepth, -(v.z - radius)/farDepth);
+	int i0 = Max((int)Floor(OCCBUF_WIDTH/2.0f * (1.0f + left/viewWindowX)), 0);
+	int i1 = Min((int)Floor(OCCBUF_WIDTH/2.0f * (1.0f + right/viewWindowX)), OCCBUF_WIDTH-1);
+	int j0 = Max((int)Floor(OCCBUF_HEIGHT/2.0f * (1.0f + top/viewWindowY)), 0);
+	int j1 = Min((int)Floor(OCCBUF_HEIGHT/2.0f * (1.0f + bottom/viewWindowY)), OCCBUF_HEIGHT-1);
+	// off screen is for the frustum test to say
+	if(i0 > i1 || j0 > j1)
+		return false;
+
+	nearDepth -= OCCBUF_DEPTH_BIAS;
+	for(ty = j0/OCCBUF_TILESIZE; ty <= j1/OCCBUF_TILESIZE; ty++)
+		for(tx = i0/OCCBUF_TILESIZE; tx <= i1/OCCBUF_TILESIZE; tx++){
+			if(ms_aTileMax[ty][tx] < nearDepth)
+				continue;
+			for(j = Max(j0, ty*OCCBUF_TILESIZE); j <= Min(j1, ty*OCCBUF_TILESIZE + OCCBUF_TILESIZE-1); j++)
+				for(i = Max(i0, tx*OCCBUF_TILESIZE); i <= Min(i1, tx*OCCBUF_TILESIZE + OCCBUF_TILESIZE-1); i++)
+					if(ms_aDepth[j][i] >= nearDepth)
+						return false;
+		}
+	return true;
+}
+
+// Only from the game thread, for the counts
+bool
+COcclusionBuffer::IsEntityOccluded(CEntity *entity)
+{
+	if(!ms_bValid)
+		return false;
+	ms_numTested++;
+	if(!IsSphereOccluded(entity->GetBoundCentre(), entity->GetBoundRadius()))
+		return false;
+	ms_numCulled++;
+	return true;
+}
+
+// The buffer in the top right corner, brighter is nearer
+void
+COcclusionBuffer::Render(void)
+{
+	int i, j, k;
+
+	if(!ms_bShowBuffer)
+		return;
+
+	float scale = 2.0f;
+	float x0 = SCREEN_WIDTH - OCCBUF_WIDTH*scale - 16.0f;
+	float y0 = 16.0f;
+
+	DefinedState();
+	CSprite2d::DrawRect(CRect(x0, y0, x0 + OCCBUF_WIDTH*scale, y0 + OCCBUF_HEIGHT*scale), CRGBA(0, 0, 64, 160));
+	for(j = 0; j < OCCBUF_HEIGHT; j++)
+		for(i = 0; i < OCCBUF_WIDTH; i = k){
+			// runs of the same shade as one rect
+			int shade = ms_aDepth[j][i] == OCCBUF_EMPTY ? -1 : Min(ms_aDepth[j][i] / ms_fOccluderRange, 1.0f) * 7;
+			for(k = i+1; k < OCCBUF_WIDTH; k++){
+				int s = ms_aDepth[j][k] == OCCBUF_EMPTY ? -1 : Min(ms_aDepth[j][k] / ms_fOccluderRange, 1.0f) * 7;
+				if(s != shade)
+					break;
+			}
+			if(shade < 0)
+				continue;
+			uint8 c = 255 - shade*28;
+			CSprite2d::DrawRect(CRect(x0 + i*scale, y0 + j*scale, x0 + k*scale, y0 + (j+1)*scale), CRGBA(c, c, c, 255));
+		}
+
+	CFont::SetPropOn();
+	CFont::SetBackgroundOff();
+	CFont::SetScale(SCREEN_SCALE_X(0.4f), SCREEN_SCALE_Y(0.6f));
+	CFont::SetCentreOff();
+	CFont::SetRightJustifyOff();
+	CFont::SetJustifyOff();
+	CFont::SetWrapx(SCREEN_WIDTH);
+	CFont::SetBackGroundOnlyTextOff();
+	CFont::SetColor(CRGBA(255, 255, 255, 255));
+	CFont::SetFontStyle(FONT_BANK);
+	sprintf(gString, "%d occluders, %d triangles, %d of %d culled", ms_numOccluders, ms_numTriangles, ms_numCulled, ms_numTested);
+	AsciiToUnicode(gString, gUString);
+	CFont::PrintString(x0, y0 + OCCBUF_HEIGHT*scale + 4.0f, gUString);
+	DefinedState();
+}
+#endif
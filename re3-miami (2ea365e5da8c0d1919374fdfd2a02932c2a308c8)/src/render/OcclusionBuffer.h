@@ -0,0 +1,49 @@
+#pragma once
+
+class CEntity;
+
+#define OCCBUF_WIDTH 128
+#define OCCBUF_HEIGHT 64
+#define OCCBUF_TILESIZE 8
+#define OCCBUF_TILES_X (OCCBUF_WIDTH/OCCBUF_TILESIZE)
+#define OCCBUF_TILES_Y (OCCBUF_HEIGHT/OCCBUF_TILESIZE)
+#define MAXOCCLUDERS 48
+#define MAXOCCLUDERTRIANGLES 16384
+
+// A small depth buffer the collision of the biggest buildings around the camera is
+// drawn into on the CPU every frame, before ScanWorld. SetupEntityVisibility then drops
+// entities whose bounding sphere is behind it everywhere it covers, on top of what the
+// occlusion volumes from the IPLs hide. Every 8x8 tile also keeps its farthest depth,
+// so most tests don't have to look at single pixels.
+// Occluders only fill the pixels they cover completely, with the farthest depth they
+// have there, so nothing that shows at their edges or through gaps is hidden. Pixels
+// on the edges between two occluder triangles stay empty for that.
+
+class COcclusionBuffer
+{
+	static float ms_aDepth[OCCBUF_HEIGHT][OCCBUF_WIDTH];
+	static float ms_aTileMax[OCCBUF_TILES_Y][OCCBUF_TILES_X];
+	static CEntity *ms_apOccluders[MAXOCCLUDERS];
+	static bool ms_bValid;
+
+	static void Clear(void);
+	static void FindOccluders(void);
+	static void DrawOccluder(CEntity *entity);
+	static void DrawTriangle(const CVector &a, const CVector &b, const CVector &c);
+	static void RasteriseTriangle(const CVector *v);
+	static void BuildTiles(void);
+public:
+	static bool ms_bEnabled;
+	static bool ms_bShowBuffer;
+	static float ms_fOccluderRange;
+	static float ms_fMinOccluderRadius;
+	static int32 ms_numOccluders;
+	static int32 ms_numTriangles;
+	static int32 ms_numTested;
+	static int32 ms_numCulled;
+
+	static void Update(void);
+	static bool IsSphereOccluded(const CVector &centre, float radius);
+	static bool IsEntityOccluded(CEntity *entity);
+	static void Render(void);
+};
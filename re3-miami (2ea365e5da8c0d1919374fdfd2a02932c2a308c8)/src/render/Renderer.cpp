@@ -25,6 +25,20 @@
 #include "Renderer.h"
 #include "custompipes.h"
 #include "Frontend.h"
+#ifdef ANIM_LOD
+#include "Draw.h"
+#include "AnimLod.h"
+#endif
+#ifdef PARALLEL_SCAN_WORLD
+#include "JobPool.h"
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+#include "BuildingCulling.h"
+#endif
+#ifdef SOFTWARE_OCCLUSION
+#include "OcclusionBuffer.h"
+#endif
+#include "timebars.h"
 
 bool gbShowPedRoadGroups;
 bool gbShowCarRoadGroups;
@@ -65,6 +79,9 @@ CVector CRenderer::ms_vecCameraPosition;
 CVehicle *CRenderer::m_pFirstPersonVehicle;
 bool CRenderer::m_loadingPriority;
 float CRenderer::ms_lodDistScale = 1.2f;
+#ifdef PARALLEL_SCAN_WORLD
+bool CRenderer::ms_bParallelScanWorld = true;
+#endif
 
 // unused
 BlockedRange CRenderer::aBlockedRanges[16];
@@ -446,6 +463,9 @@ CRenderer::RenderWorld(int pass)
 			if(e->bIsBIGBuilding || IsRoad(e))
 				RenderOneBuilding(e, node->item.sort);
 		}
+#ifdef SORTED_WORLD_RENDER
+		WorldRender::FlushCommands();
+#endif
 		break;
 	case 1:
 		// Opaque
@@ -464,6 +484,9 @@ CRenderer::RenderWorld(int pass)
 		}
 		// Now we have iterated through all visible buildings (unsorted and sorted)
 		// and the transparency list is done.
+#ifdef SORTED_WORLD_RENDER
+		WorldRender::FlushCommands();
+#endif
 
 		RwRenderStateSet(rwRENDERSTATEVERTEXALPHAENABLE, (void*)TRUE);
 		RwRenderStateSet(rwRENDERSTATEZWRITEENABLE, FALSE);
@@ -563,6 +586,14 @@ CRenderer::ClearForFrame(void)
 	WorldRender::numBlendInsts[PASS_NOZ] = 0;
 	WorldRender::numBlendInsts[PASS_ADD] = 0;
 	WorldRender::numBlendInsts[PASS_BLEND] = 0;
+#ifdef SORTED_WORLD_RENDER
+	WorldRender::numMeshes = 0;
+	WorldRender::numDrawCalls = 0;
+	WorldRender::numStateChanges = 0;
+#endif
+#ifdef INSTANCED_WORLD_RENDER
+	WorldRender::numInstancedMeshes = 0;
+#endif
 }
 #endif
 
@@ -613,6 +644,38 @@ enum Visbility
 // i.e. we have to draw even at the wrong time if
 //   other != -1 && CModelInfo::GetModelInfo(other)->GetRwObject() == nil
 
+#ifdef PARALLEL_SCAN_WORLD
+// Set while the parallel scan hands an entity whose on-screen test it already did to SetupEntityVisibility
+static CEntity *pPrecomputedEntity;
+static bool bPrecomputedOnScreen;
+#endif
+
+static bool
+IsOnScreenAndUnoccluded(CEntity *ent)
+{
+#ifdef PARALLEL_SCAN_WORLD
+	if(ent == pPrecomputedEntity)
+		return bPrecomputedOnScreen;
+#endif
+#ifdef SIMD_FRUSTUM_CULLING
+	int32 cull = CBuildingCulling::GetResult(ent);
+	if(cull & BUILDINGCULL_CLASSIFIED)
+		return (cull & BUILDINGCULL_ONSCREEN) && !ent->IsEntityOccluded();
+#endif
+	return ent->GetIsOnScreen() && !ent->IsEntityOccluded();
+}
+
+#ifdef SOFTWARE_OCCLUSION
+// The occlusion buffer counts what it culls, so it's only asked here on the game thread
+static bool
+IsVisibleOnScreen(CEntity *ent)
+{
+	return IsOnScreenAndUnoccluded(ent) && !COcclusionBuffer::IsEntityOccluded(ent);
+}
+#else
+#define IsVisibleOnScreen IsOnScreenAndUnoccluded
+#endif
+
 #define OTHERUNAVAILABLE (other != -1 && CModelInfo::GetModelInfo(other)->GetRwObject() == nil)
 #define CANTIMECULL (!OTHERUNAVAILABLE)
 
@@ -624,6 +687,12 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 	int32 other;
 	float dist;
 
+#ifdef SIMD_FRUSTUM_CULLING
+	// too far for GetAtomicFromDistance and for a request
+	if(CBuildingCulling::GetResult(ent) & BUILDINGCULL_FAR)
+		return VIS_INVISIBLE;
+#endif
+
 	bool request = true;
 	if(mi->GetModelType() == MITYPE_TIME){
  		ti = (CTimeModelInfo*)mi;
@@ -669,7 +738,7 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 			// All sorts of Clumps
 			if(ent->m_rwObject == nil || !ent->bIsVisible)
 				return VIS_INVISIBLE;
-			if(!ent->GetIsOnScreen() || ent->IsEntityOccluded())
+			if(!IsVisibleOnScreen(ent))
 				return VIS_OFFSCREEN;
 			if(ent->bDrawLast){
 				dist = (ent->GetPosition() - ms_vecCameraPosition).Magnitude();
@@ -682,7 +751,7 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 		if(ent->bDontStream){
 			if(ent->m_rwObject == nil || !ent->bIsVisible)
 				return VIS_INVISIBLE;
-			if(!ent->GetIsOnScreen() || ent->IsEntityOccluded())
+			if(!IsVisibleOnScreen(ent))
 				return VIS_OFFSCREEN;
 			if(ent->bDrawLast){
 				dist = (ent->GetPosition() - ms_vecCameraPosition).Magnitude();
@@ -730,7 +799,7 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 		if(ent->m_rwObject == nil || !ent->bIsVisible)
 			return VIS_INVISIBLE;
 
-		if(!ent->GetIsOnScreen() || ent->IsEntityOccluded()){
+		if(!IsVisibleOnScreen(ent)){
 			mi->m_alpha = 255;
 			return VIS_OFFSCREEN;
 		}
@@ -781,7 +850,7 @@ CRenderer::SetupEntityVisibility(CEntity *ent)
 	if(ent->m_rwObject == nil || !ent->bIsVisible)
 		return VIS_INVISIBLE;
 
-	if(!ent->GetIsOnScreen() || ent->IsEntityOccluded()){
+	if(!IsVisibleOnScreen(ent)){
 		mi->m_alpha = 255;
 		return VIS_OFFSCREEN;
 	}else{
@@ -921,6 +990,16 @@ CRenderer::ConstructRenderList(void)
 	ms_nNoOfInVisibleEntities = 0;
 }
 	ms_vecCameraPosition = TheCamera.GetPosition();
+#ifdef SIMD_FRUSTUM_CULLING
+	tbStartTimer(0, "Building culling");
+	CBuildingCulling::ClassifyForFrame();
+	tbEndTimer("Building culling");
+#endif
+#ifdef SOFTWARE_OCCLUSION
+	tbStartTimer(0, "Occlusion buffer");
+	COcclusionBuffer::Update();
+	tbEndTimer("Occlusion buffer");
+#endif
 
 	// unused
 	pFullBlockedRanges = nil;
@@ -1066,7 +1145,11 @@ CRenderer::ScanWorld(void)
 				poly[1].y = CWorld::GetSectorY(vectors[CORNER_PRIO_LEFT].y);
 				poly[2].x = CWorld::GetSectorX(vectors[CORNER_PRIO_RIGHT].x);
 				poly[2].y = CWorld::GetSectorY(vectors[CORNER_PRIO_RIGHT].y);
+#ifdef PARALLEL_SCAN_WORLD
+				ScanSectorPolyParallel(poly, 3, ScanSectorList_Priority, ScanEntity_Priority);
+#else
 				ScanSectorPoly(poly, 3, ScanSectorList_Priority);
+#endif
 
 				// below LOD
 				poly[0].x = CWorld::GetSectorX(vectors[CORNER_CAM].x);
@@ -1075,7 +1158,11 @@ CRenderer::ScanWorld(void)
 				poly[1].y = CWorld::GetSectorY(vectors[CORNER_LOD_LEFT].y);
 				poly[2].x = CWorld::GetSectorX(vectors[CORNER_LOD_RIGHT].x);
 				poly[2].y = CWorld::GetSectorY(vectors[CORNER_LOD_RIGHT].y);
+#ifdef PARALLEL_SCAN_WORLD
+				ScanSectorPolyParallel(poly, 3, ScanSectorList, ScanEntity);
+#else
 				ScanSectorPoly(poly, 3, ScanSectorList);
+#endif
 			}else{
 				poly[0].x = CWorld::GetSectorX(vectors[CORNER_CAM].x);
 				poly[0].y = CWorld::GetSectorY(vectors[CORNER_CAM].y);
@@ -1083,9 +1170,14 @@ CRenderer::ScanWorld(void)
 				poly[1].y = CWorld::GetSectorY(vectors[CORNER_FAR_TOPLEFT].y);
 				poly[2].x = CWorld::GetSectorX(vectors[CORNER_FAR_TOPRIGHT].x);
 				poly[2].y = CWorld::GetSectorY(vectors[CORNER_FAR_TOPRIGHT].y);
+#ifdef PARALLEL_SCAN_WORLD
+				ScanSectorPolyParallel(poly, 3, ScanSectorList, ScanEntity);
+#else
 				ScanSectorPoly(poly, 3, ScanSectorList);
+#endif
 			}
-			
+
+			tbStartTimer(0, "Scan big buildings");
 #ifdef NO_ISLAND_LOADING
 			if (FrontEndMenuManager.m_PrefsIslandLoading == CMenuManager::ISLAND_LOADING_HIGH) {
 				ScanBigBuildingList(CWorld::GetBigBuildingList(LEVEL_BEACH));
@@ -1099,6 +1191,7 @@ CRenderer::ScanWorld(void)
 				ScanBigBuildingList(CWorld::GetBigBuildingList(CGame::currLevel));
 			}
 			ScanBigBuildingList(CWorld::GetBigBuildingList(LEVEL_GENERIC));
+			tbEndTimer("Scan big buildings");
 		}
 	}
 }
@@ -1207,6 +1300,10 @@ CPed::SetupLighting(void)
 	if (GetDebugDisplay() != 0 && !IsPlayer())
 		DebugRenderOnePedText();
 #endif
+#ifdef ANIM_LOD
+	if (CAnimLod::ms_bShowLods)
+		CAnimLod::RenderDebugText(this);
+#endif
 
 	if (bRenderScorched) {
 		WorldReplaceNormalLightsWithScorched(Scene.world, 0.1f);
@@ -1391,6 +1488,101 @@ CRenderer::ScanSectorPoly(RwV2d *poly, int32 numVertices, void (*scanfunc)(CPtrL
 	}
 }
 
+#ifdef PARALLEL_SCAN_WORLD
+#define MAXSCANENTITIES 4096
+
+// Entities of one ScanSectorPoly in the order the scan function would have seen them, split into sector rows
+static CEntity *aScanEntities[MAXSCANENTITIES];
+static bool aScanOnScreen[MAXSCANENTITIES];
+static int32 nScanEntities;
+static int32 aScanRowStart[NUMSECTORS_Y+1];
+static int32 nScanRows;
+static int32 nScanLastRow;
+static CPtrList *apScanSectors[NUMSECTORS_X*NUMSECTORS_Y];
+static int32 nScanSectors;
+static bool bScanOverflow;
+
+static void
+CollectSectorList(CPtrList *lists)
+{
+	CPtrNode *node;
+	CEntity *ent;
+	int i;
+	int32 row = ((CSector*)lists - CWorld::GetSector(0, 0)) / NUMSECTORS_X;
+
+	if(row != nScanLastRow){
+		aScanRowStart[nScanRows++] = nScanEntities;
+		nScanLastRow = row;
+	}
+	apScanSectors[nScanSectors++] = lists;
+	for(i = 0; i < NUMSECTORENTITYLISTS; i++)
+		for(node = lists[i].first; node; node = node->next){
+			ent = (CEntity*)node->item;
+			if(ent->m_scanCode == CWorld::GetCurrentScanCode())
+				continue;	// already seen
+			if(nScanEntities == MAXSCANENTITIES){
+				// left for the scan function
+				bScanOverflow = true;
+				continue;
+			}
+			ent->m_scanCode = CWorld::GetCurrentScanCode();
+			aScanEntities[nScanEntities++] = ent;
+		}
+}
+
+// Frustum and occlusion tests only read the entity and the camera
+static void
+ScanRowJob(int32 row, void *data)
+{
+	int32 i;
+	for(i = aScanRowStart[row]; i < aScanRowStart[row+1]; i++){
+		CEntity *ent = aScanEntities[i];
+		// SetupEntityVisibility doesn't ask for invisible ones
+		aScanOnScreen[i] = ent->bIsVisible && IsOnScreenAndUnoccluded(ent);
+	}
+}
+
+// ScanSectorPoly with the on-screen tests done per sector row on the job pool.
+// Everything else SetupEntityVisibility does creates RW objects, fades model infos in
+// or fills the sorted alpha list, so the results are applied here in scan order.
+void
+CRenderer::ScanSectorPolyParallel(RwV2d *poly, int32 numVertices, void (*scanfunc)(CPtrList *), void (*entityfunc)(CEntity *))
+{
+	int32 i;
+
+	if(!ms_bParallelScanWorld){
+		ScanSectorPoly(poly, numVertices, scanfunc);
+		return;
+	}
+
+	tbStartTimer(0, "Scan gather");
+	nScanEntities = 0;
+	nScanRows = 0;
+	nScanLastRow = -1;
+	nScanSectors = 0;
+	bScanOverflow = false;
+	ScanSectorPoly(poly, numVertices, CollectSectorList);
+	aScanRowStart[nScanRows] = nScanEntities;
+	tbEndTimer("Scan gather");
+
+	tbStartTimer(0, "Scan visibility");
+	CJobPool::ParallelFor(nScanRows, ScanRowJob, nil);
+	tbEndTimer("Scan visibility");
+
+	tbStartTimer(0, "Scan apply");
+	for(i = 0; i < nScanEntities; i++){
+		pPrecomputedEntity = aScanEntities[i];
+		bPrecomputedOnScreen = aScanOnScreen[i];
+		entityfunc(aScanEntities[i]);
+	}
+	pPrecomputedEntity = nil;
+	if(bScanOverflow)
+		for(i = 0; i < nScanSectors; i++)
+			scanfunc(apScanSectors[i]);
+	tbEndTimer("Scan apply");
+}
+#endif
+
 void
 CRenderer::InsertEntityIntoList(CEntity *ent)
 {
@@ -1430,13 +1622,53 @@ CRenderer::ScanBigBuildingList(CPtrList &list)
 			ent->bOffscreen = false;
 			break;
 		case VIS_STREAMME:
-			if(!CStreaming::ms_disableStreaming)
+			if(!CStreaming::ms_disableStreaming){
 				CStreaming::RequestModel(ent->GetModelIndex(), 0);
+#ifdef STREAMING_DEADLINES
+				CStreaming::SetRequestDeadline(ent->GetModelIndex(), STREAMDEADLINE_VISIBLE);
+#endif
+			}
 			break;
 		}
 	}
 }
 
+void
+CRenderer::ScanEntity(CEntity *ent)
+{
+	float dx, dy;
+
+	ent->bOffscreen = false;
+
+	switch(SetupEntityVisibility(ent)){
+	case VIS_VISIBLE:
+		InsertEntityIntoList(ent);
+		break;
+	case VIS_INVISIBLE:
+		if(!IsGlass(ent->GetModelIndex()))
+			break;
+		// fall through
+	case VIS_OFFSCREEN:
+		ent->bOffscreen = true;
+		dx = ms_vecCameraPosition.x - ent->GetPosition().x;
+		dy = ms_vecCameraPosition.y - ent->GetPosition().y;
+		if(dx > -30.0f && dx < 30.0f &&
+		   dy > -30.0f && dy < 30.0f &&
+		   ms_nNoOfInVisibleEntities < NUMINVISIBLEENTITIES - 1)
+			ms_aInVisibleEntityPtrs[ms_nNoOfInVisibleEntities++] = ent;
+		break;
+	case VIS_STREAMME:
+		if(!CStreaming::ms_disableStreaming)
+			if(!m_loadingPriority || CStreaming::ms_numModelsRequested < 10){
+				CStreaming::RequestModel(ent->GetModelIndex(), 0);
+#ifdef STREAMING_DEADLINES
+				CStreaming::SetRequestDeadline(ent->GetModelIndex(), STREAMDEADLINE_VISIBLE);
+#endif
+			}
+		break;
+	}
+}
+
 void
 CRenderer::ScanSectorList(CPtrList *lists)
 {
@@ -1444,7 +1676,6 @@ CRenderer::ScanSectorList(CPtrList *lists)
 	CPtrList *list;
 	CEntity *ent;
 	int i;
-	float dx, dy;
 
 	for(i = 0; i < NUMSECTORENTITYLISTS; i++){
 		list = &lists[i];
@@ -1453,32 +1684,45 @@ CRenderer::ScanSectorList(CPtrList *lists)
 			if(ent->m_scanCode == CWorld::GetCurrentScanCode())
 				continue;	// already seen
 			ent->m_scanCode = CWorld::GetCurrentScanCode();
-			ent->bOffscreen = false;
+			ScanEntity(ent);
+		}
+	}
+}
 
-			switch(SetupEntityVisibility(ent)){
-			case VIS_VISIBLE:
-				InsertEntityIntoList(ent);
-				break;
-			case VIS_INVISIBLE:
-				if(!IsGlass(ent->GetModelIndex()))
-					break;
-				// fall through
-			case VIS_OFFSCREEN:
-				ent->bOffscreen = true;
-				dx = ms_vecCameraPosition.x - ent->GetPosition().x;
-				dy = ms_vecCameraPosition.y - ent->GetPosition().y;
-				if(dx > -30.0f && dx < 30.0f &&
-				   dy > -30.0f && dy < 30.0f &&
-				   ms_nNoOfInVisibleEntities < NUMINVISIBLEENTITIES - 1)
-					ms_aInVisibleEntityPtrs[ms_nNoOfInVisibleEntities++] = ent;
-				break;
-			case VIS_STREAMME:
-				if(!CStreaming::ms_disableStreaming)
-					if(!m_loadingPriority || CStreaming::ms_numModelsRequested < 10)
-						CStreaming::RequestModel(ent->GetModelIndex(), 0);
-				break;
-			}
+void
+CRenderer::ScanEntity_Priority(CEntity *ent)
+{
+	float dx, dy;
+
+	ent->bOffscreen = false;
+
+	switch(SetupEntityVisibility(ent)){
+	case VIS_VISIBLE:
+		InsertEntityIntoList(ent);
+		break;
+	case VIS_INVISIBLE:
+		if(!IsGlass(ent->GetModelIndex()))
+			break;
+		// fall through
+	case VIS_OFFSCREEN:
+		ent->bOffscreen = true;
+		dx = ms_vecCameraPosition.x - ent->GetPosition().x;
+		dy = ms_vecCameraPosition.y - ent->GetPosition().y;
+		if(dx > -30.0f && dx < 30.0f &&
+		   dy > -30.0f && dy < 30.0f &&
+		   ms_nNoOfInVisibleEntities < NUMINVISIBLEENTITIES - 1)
+			ms_aInVisibleEntityPtrs[ms_nNoOfInVisibleEntities++] = ent;
+		break;
+	case VIS_STREAMME:
+		if(!CStreaming::ms_disableStreaming){
+			CStreaming::RequestModel(ent->GetModelIndex(), 0);
+#ifdef STREAMING_DEADLINES
+			CStreaming::SetRequestDeadline(ent->GetModelIndex(), STREAMDEADLINE_VISIBLE);
+#endif
+			if(CStreaming::ms_aInfoForModel[ent->GetModelIndex()].m_loadState != STREAMSTATE_LOADED)
+				m_loadingPriority = true;
 		}
+		break;
 	}
 }
 
@@ -1489,7 +1733,6 @@ CRenderer::ScanSectorList_Priority(CPtrList *lists)
 	CPtrList *list;
 	CEntity *ent;
 	int i;
-	float dx, dy;
 
 	for(i = 0; i < NUMSECTORENTITYLISTS; i++){
 		list = &lists[i];
@@ -1498,33 +1741,7 @@ CRenderer::ScanSectorList_Priority(CPtrList *lists)
 			if(ent->m_scanCode == CWorld::GetCurrentScanCode())
 				continue;	// already seen
 			ent->m_scanCode = CWorld::GetCurrentScanCode();
-			ent->bOffscreen = false;
-
-			switch(SetupEntityVisibility(ent)){
-			case VIS_VISIBLE:
-				InsertEntityIntoList(ent);
-				break;
-			case VIS_INVISIBLE:
-				if(!IsGlass(ent->GetModelIndex()))
-					break;
-				// fall through
-			case VIS_OFFSCREEN:
-				ent->bOffscreen = true;
-				dx = ms_vecCameraPosition.x - ent->GetPosition().x;
-				dy = ms_vecCameraPosition.y - ent->GetPosition().y;
-				if(dx > -30.0f && dx < 30.0f &&
-				   dy > -30.0f && dy < 30.0f &&
-				   ms_nNoOfInVisibleEntities < NUMINVISIBLEENTITIES - 1)
-					ms_aInVisibleEntityPtrs[ms_nNoOfInVisibleEntities++] = ent;
-				break;
-			case VIS_STREAMME:
-				if(!CStreaming::ms_disableStreaming){
-					CStreaming::RequestModel(ent->GetModelIndex(), 0);
-					if(CStreaming::ms_aInfoForModel[ent->GetModelIndex()].m_loadState != STREAMSTATE_LOADED)
-						m_loadingPriority = true;
-				}
-				break;
-			}
+			ScanEntity_Priority(ent);
 		}
 	}
 }
@@ -1581,8 +1798,15 @@ CRenderer::ScanSectorList_RequestModels(CPtrList *lists)
 			if(ent->m_scanCode == CWorld::GetCurrentScanCode())
 				continue;	// already seen
 			ent->m_scanCode = CWorld::GetCurrentScanCode();
-			if(ShouldModelBeStreamed(ent, ms_vecCameraPosition))
+			if(ShouldModelBeStreamed(ent, ms_vecCameraPosition)){
 				CStreaming::RequestModel(ent->GetModelIndex(), 0);
+#ifdef STREAMING_DEADLINES
+				// due when the camera gets close enough to draw it
+				CSimpleModelInfo *mi = (CSimpleModelInfo*)CModelInfo::GetModelInfo(ent->GetModelIndex());
+				float dist = (ent->GetPosition() - ms_vecCameraPosition).Magnitude() - mi->GetLargestLodDistance();
+				CStreaming::SetRequestDeadline(ent->GetModelIndex(), CStreaming::GetDeadlineForDistance(dist));
+#endif
+			}
 		}
 	}
 }
@@ -1631,6 +1855,19 @@ CRenderer::ShouldModelBeStreamed(CEntity *ent, const CVector &campos)
 		return dist - FADE_DISTANCE - STREAM_DISTANCE < mi->GetLargestLodDistance();
 }
 
+#ifdef ANIM_LOD
+// Bounding sphere diameter as a fraction of the screen height
+float
+CRenderer::GetProjectedSize(CEntity *ent)
+{
+	float radius = ent->GetBoundRadius();
+	float dist = (ent->GetBoundCentre() - ms_vecCameraPosition).Magnitude();
+	if(dist <= radius)
+		return 1.0f;
+	return radius / (dist * Tan(DEGTORAD(CDraw::GetFOV())/2.0f));
+}
+#endif
+
 void
 CRenderer::RemoveVehiclePedLights(CEntity *ent, bool reset)
 {
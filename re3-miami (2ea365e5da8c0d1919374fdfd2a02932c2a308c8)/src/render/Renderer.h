@@ -56,6 +56,9 @@ class CRenderer
 public:
 	static float ms_lodDistScale;
 	static bool m_loadingPriority;
+#ifdef PARALLEL_SCAN_WORLD
+	static bool ms_bParallelScanWorld;
+#endif
 
 	static void Init(void);
 	static void Shutdown(void);
@@ -84,11 +87,19 @@ public:
 	static void ScanSectorList_Priority(CPtrList *lists);
 	static void ScanSectorList_Subway(CPtrList *lists);
 	static void ScanSectorList_RequestModels(CPtrList *lists);
+	static void ScanEntity(CEntity *ent);
+	static void ScanEntity_Priority(CEntity *ent);
+#ifdef PARALLEL_SCAN_WORLD
+	static void ScanSectorPolyParallel(RwV2d *poly, int32 numVertices, void (*scanfunc)(CPtrList *), void (*entityfunc)(CEntity *));
+#endif
 
 	static void SortBIGBuildings(void);
 	static void SortBIGBuildingsForSectorList(CPtrList *list);
 
 	static bool ShouldModelBeStreamed(CEntity *ent, const CVector &campos);
+#ifdef ANIM_LOD
+	static float GetProjectedSize(CEntity *ent);
+#endif
 
 	static void RemoveVehiclePedLights(CEntity *ent, bool reset);
 
@@ -5,9 +5,15 @@
 #include "Streaming.h"
 #include "RwHelper.h"
 #include "TxdStore.h"
+#ifdef HASHED_NAME_LOOKUP
+#include "NameIndex.h"
+#endif
 
 CPool<TxdDef,TxdDef> *CTxdStore::ms_pTxdPool;
 RwTexDictionary *CTxdStore::ms_pStoredTxd;
+#ifdef HASHED_NAME_LOOKUP
+static CNameIndex gTxdNameIndex;
+#endif
 
 void
 CTxdStore::Initialise(void)
@@ -21,6 +27,9 @@ CTxdStore::Shutdown(void)
 {
 	if(ms_pTxdPool)
 		delete ms_pTxdPool;
+#ifdef HASHED_NAME_LOOKUP
+	gTxdNameIndex.Shutdown();
+#endif
 }
 
 void
@@ -43,6 +52,9 @@ CTxdStore::AddTxdSlot(const char *name)
 	def->texDict = nil;
 	def->refCount = 0;
 	strcpy(def->name, name);
+#ifdef HASHED_NAME_LOOKUP
+	gTxdNameIndex.Add(def->name, ms_pTxdPool->GetJustIndex(def));
+#endif
 	return ms_pTxdPool->GetJustIndex(def);
 }
 
@@ -52,12 +64,18 @@ CTxdStore::RemoveTxdSlot(int slot)
 	TxdDef *def = GetSlot(slot);
 	if(def->texDict)
 		RwTexDictionaryDestroy(def->texDict);
+#ifdef HASHED_NAME_LOOKUP
+	gTxdNameIndex.Remove(def->name, slot);
+#endif
 	ms_pTxdPool->Delete(def);
 }
 
 int
 CTxdStore::FindTxdSlot(const char *name)
 {
+#ifdef HASHED_NAME_LOOKUP
+	return gTxdNameIndex.Find(name);
+#else
 	int size = ms_pTxdPool->GetSize();
 	for(int i = 0; i < size; i++){
 		TxdDef *def = GetSlot(i);
@@ -65,6 +83,7 @@ CTxdStore::FindTxdSlot(const char *name)
 			return i;
 	}
 	return -1;
+#endif
 }
 
 char*
@@ -1665,6 +1665,12 @@ CWeapon::FireShotgun(CEntity *shooter, CVector *fireSource)
 	float halfAngleRange = angleRange / 2.f;
 	float angleBetweenTwoShot = angleRange / (shootsAtOnce - 1.f);
 
+#ifdef BATCHED_LINE_OF_SIGHT
+	// aim all pellets first and trace them in one go
+	CWorldRay pelletRays[5];
+	CVector2D pelletRots[5];
+	bool mouseAim = shooter == FindPlayerPed() && TheCamera.Cams[0].Using3rdPersonMouseCam();
+#endif
 	for ( int32 i = 0; i < shootsAtOnce; i++ )
 	{
 		float shootAngle = DEGTORAD(RADTODEG(halfAngleRange - angleBetweenTwoShot * i) + shooterAngle);
@@ -1672,8 +1678,10 @@ CWeapon::FireShotgun(CEntity *shooter, CVector *fireSource)
 		shootRot.Normalise();
 
 		CVector source, target;
+#ifndef BATCHED_LINE_OF_SIGHT
 		CColPoint point;
 		CEntity *victim;
+#endif
 
 		if ( shooter == FindPlayerPed() && TheCamera.Cams[0].Using3rdPersonMouseCam() )
 		{
@@ -1684,12 +1692,16 @@ CWeapon::FireShotgun(CEntity *shooter, CVector *fireSource)
 			target  = f * Left + target - source;
 			target *= info->m_fRange;
 			target += source;
+#ifdef BATCHED_LINE_OF_SIGHT
+			pelletRays[i].start = source;
+#else
 			CWorld::bIncludeCarTyres = true;
 			CWorld::bIncludeBikers = true;
 			CWorld::bIncludeDeadPeds = true;
 			ProcessLineOfSight(source, target, point, victim, m_eWeaponType, shooter, true, true, true, true, true, false, false);
 			CWorld::bIncludeDeadPeds = false;
 			CWorld::bIncludeCarTyres = false;
+#endif
 		}
 		else
 		{
@@ -1716,14 +1728,40 @@ CWeapon::FireShotgun(CEntity *shooter, CVector *fireSource)
 					target.z += info->m_fRange / distToTarget * (pos.z - target.z);
 				}
 			}
+#ifdef BATCHED_LINE_OF_SIGHT
+			pelletRays[i].start = *fireSource;
+#else
 			if (shooter == FindPlayerPed())
 				CWorld::bIncludeDeadPeds = true;
 
 			CWorld::bIncludeBikers = true;
 			ProcessLineOfSight(*fireSource, target, point, victim, m_eWeaponType, shooter, true, true, true, true, true, false, false);
 			CWorld::bIncludeDeadPeds = false;
+#endif
 		}
+#ifdef BATCHED_LINE_OF_SIGHT
+		pelletRays[i].end = target;
+		pelletRots[i] = shootRot;
+	}
+
+	// same flags as CWeapon::ProcessLineOfSight
+	CWorld::bIncludeCarTyres = mouseAim;
+	CWorld::bIncludeDeadPeds = shooter == FindPlayerPed();
+	CWorld::bIncludeBikers = true;
+	CWorld::ProcessLinesOfSightBatch(pelletRays, shootsAtOnce, true, true, true, true, true, false, false, true);
+	CWorld::bIncludeCarTyres = false;
+	CWorld::bIncludeDeadPeds = false;
+	CWorld::bIncludeBikers = false;
+
+	for ( int32 i = 0; i < shootsAtOnce; i++ )
+	{
+		CVector2D shootRot = pelletRots[i];
+		CVector target = pelletRays[i].end;
+		CColPoint &point = pelletRays[i].point;
+		CEntity *victim = pelletRays[i].entity;
+#else
 		CWorld::bIncludeBikers = false;
+#endif
 
 		if ( victim )
 		{